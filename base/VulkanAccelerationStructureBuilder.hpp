@@ -0,0 +1,383 @@
+/*
+* Ray tracing acceleration structure builder
+*
+* Batches bottom level acceleration structure builds into as few build commands as possible, using a shared scratch buffer, and compacts the results
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/** @brief Ray tracing acceleration structure and the buffer backing it */
+	struct AccelerationStructure
+	{
+		VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+		uint64_t deviceAddress = 0;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+	};
+
+	/**
+	* @brief Builds bottom level acceleration structures in batches
+	* @note All structures are placed in a single buffer that is owned by the builder, so they are released with destroy() instead of one by one
+	*/
+	class AccelerationStructureBuilder
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t structureCount = 0;
+			uint32_t batchCount = 0;
+			VkDeviceSize scratchSize = 0;
+			/** @brief Size of all structures as built */
+			VkDeviceSize buildSize = 0;
+			/** @brief Size of all structures after compaction (same as the build size if compaction is disabled) */
+			VkDeviceSize compactedSize = 0;
+		} statistics;
+
+		/** @brief Upper limit for the shared scratch buffer, builds that don't fit at once are split into multiple batches */
+		VkDeviceSize scratchBudget = 64 * 1024 * 1024;
+		/** @brief Compact the structures after building them */
+		bool compaction = true;
+
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->queue = queue;
+			device = vulkanDevice->logicalDevice;
+
+			VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
+			accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+			VkPhysicalDeviceProperties2 deviceProperties2{};
+			deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			deviceProperties2.pNext = &accelerationStructureProperties;
+			vkGetPhysicalDeviceProperties2(vulkanDevice->physicalDevice, &deviceProperties2);
+			scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+			vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device, "vkGetBufferDeviceAddressKHR"));
+			vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR"));
+			vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR"));
+			vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device, "vkGetAccelerationStructureBuildSizesKHR"));
+			vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(device, "vkGetAccelerationStructureDeviceAddressKHR"));
+			vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR"));
+			vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+			vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
+		}
+
+		/** @brief Release all acceleration structures built by this builder and their memory */
+		void destroy()
+		{
+			for (auto& accelerationStructure : accelerationStructures) {
+				vkDestroyAccelerationStructureKHR(device, accelerationStructure, nullptr);
+			}
+			accelerationStructures.clear();
+			for (auto& allocation : allocations) {
+				freeAllocation(allocation);
+			}
+			allocations.clear();
+		}
+
+		/**
+		* Add a bottom level acceleration structure to the next build
+		*
+		* @param target Acceleration structure that receives the handle and device address once built
+		* @param geometries Geometries of the acceleration structure (input data needs to stay valid until build() has been called)
+		* @param buildRanges Build ranges for the geometries
+		* @param flags Build flags, compaction is added if enabled for the builder
+		*/
+		void addBottomLevel(AccelerationStructure* target, const std::vector<VkAccelerationStructureGeometryKHR>& geometries, const std::vector<VkAccelerationStructureBuildRangeInfoKHR>& buildRanges, VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR)
+		{
+			assert(geometries.size() == buildRanges.size());
+			Request request{};
+			request.target = target;
+			request.geometries = geometries;
+			request.buildRanges = buildRanges;
+			request.flags = flags;
+			if (compaction) {
+				request.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+			}
+			requests.push_back(request);
+		}
+
+		/** @brief Build (and compact) all acceleration structures added since the last build */
+		void build()
+		{
+			if (requests.empty()) {
+				return;
+			}
+
+			// Get the sizes of all structures, which are placed in a single buffer
+			VkDeviceSize bufferSize = 0;
+			VkDeviceSize maxScratchSize = 0;
+			VkDeviceSize totalScratchSize = 0;
+			for (auto& request : requests) {
+				VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = getBuildGeometryInfo(request);
+				std::vector<uint32_t> primitiveCounts(request.buildRanges.size());
+				for (size_t i = 0; i < request.buildRanges.size(); i++) {
+					primitiveCounts[i] = request.buildRanges[i].primitiveCount;
+				}
+				request.buildSizes = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+				vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, primitiveCounts.data(), &request.buildSizes);
+				request.offset = bufferSize;
+				bufferSize += align(request.buildSizes.accelerationStructureSize, structureAlignment);
+				maxScratchSize = std::max(maxScratchSize, align(request.buildSizes.buildScratchSize, scratchAlignment));
+				totalScratchSize += align(request.buildSizes.buildScratchSize, scratchAlignment);
+			}
+
+			Allocation buildAllocation = createAllocation(bufferSize, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+			for (auto& request : requests) {
+				request.handle = createAccelerationStructure(buildAllocation.buffer, request.offset, request.buildSizes.accelerationStructureSize);
+			}
+
+			// The scratch buffer is sized once, large enough for the largest build and up to the budget for building several structures at once
+			// Extra space is added so the start address can be aligned
+			const VkDeviceSize scratchSize = std::max(maxScratchSize, std::min(totalScratchSize, scratchBudget));
+			Allocation scratchAllocation = createAllocation(scratchSize + scratchAlignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+			const VkDeviceAddress scratchAddress = align(scratchAllocation.deviceAddress, scratchAlignment);
+
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			if (compaction) {
+				VkQueryPoolCreateInfo queryPoolInfo{};
+				queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryPoolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+				queryPoolInfo.queryCount = static_cast<uint32_t>(requests.size());
+				VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+			}
+
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			if (compaction) {
+				vkCmdResetQueryPool(commandBuffer, queryPool, 0, static_cast<uint32_t>(requests.size()));
+			}
+
+			// Builds are collected into batches that share the scratch buffer, each batch is recorded with a single build command
+			// Consecutive batches reuse the scratch memory, so they need to be separated by a barrier
+			std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos;
+			std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos;
+			VkDeviceSize scratchOffset = 0;
+			uint32_t batchCount = 0;
+			auto recordBatch = [&]() {
+				if (buildGeometryInfos.empty()) {
+					return;
+				}
+				vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildGeometryInfos.size()), buildGeometryInfos.data(), buildRangeInfos.data());
+				insertBuildBarrier(commandBuffer);
+				buildGeometryInfos.clear();
+				buildRangeInfos.clear();
+				scratchOffset = 0;
+				batchCount++;
+			};
+			for (auto& request : requests) {
+				const VkDeviceSize requestScratchSize = align(request.buildSizes.buildScratchSize, scratchAlignment);
+				if (scratchOffset + requestScratchSize > scratchSize) {
+					recordBatch();
+				}
+				VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = getBuildGeometryInfo(request);
+				buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+				buildGeometryInfo.dstAccelerationStructure = request.handle;
+				buildGeometryInfo.scratchData.deviceAddress = scratchAddress + scratchOffset;
+				buildGeometryInfos.push_back(buildGeometryInfo);
+				buildRangeInfos.push_back(request.buildRanges.data());
+				scratchOffset += requestScratchSize;
+			}
+			recordBatch();
+
+			if (compaction) {
+				std::vector<VkAccelerationStructureKHR> handles;
+				for (auto& request : requests) {
+					handles.push_back(request.handle);
+				}
+				vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, static_cast<uint32_t>(handles.size()), handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+			}
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+			freeAllocation(scratchAllocation);
+
+			VkDeviceSize compactedBufferSize = bufferSize;
+			if (compaction) {
+				std::vector<VkDeviceSize> compactedSizes(requests.size());
+				VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, static_cast<uint32_t>(requests.size()), compactedSizes.size() * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+				vkDestroyQueryPool(device, queryPool, nullptr);
+
+				// Copy the structures into a buffer that only has the size required by the compacted structures
+				compactedBufferSize = 0;
+				std::vector<VkDeviceSize> compactedOffsets(requests.size());
+				for (size_t i = 0; i < requests.size(); i++) {
+					compactedOffsets[i] = compactedBufferSize;
+					compactedBufferSize += align(compactedSizes[i], structureAlignment);
+				}
+				Allocation compactedAllocation = createAllocation(compactedBufferSize, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+				commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				std::vector<VkAccelerationStructureKHR> compactedHandles(requests.size());
+				for (size_t i = 0; i < requests.size(); i++) {
+					compactedHandles[i] = createAccelerationStructure(compactedAllocation.buffer, compactedOffsets[i], compactedSizes[i]);
+					VkCopyAccelerationStructureInfoKHR copyInfo{};
+					copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+					copyInfo.src = requests[i].handle;
+					copyInfo.dst = compactedHandles[i];
+					copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+					vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+				}
+				vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+				// The originals are no longer required
+				for (size_t i = 0; i < requests.size(); i++) {
+					vkDestroyAccelerationStructureKHR(device, requests[i].handle, nullptr);
+					requests[i].handle = compactedHandles[i];
+				}
+				freeAllocation(buildAllocation);
+				allocations.push_back(compactedAllocation);
+			} else {
+				allocations.push_back(buildAllocation);
+			}
+
+			for (auto& request : requests) {
+				accelerationStructures.push_back(request.handle);
+				VkAccelerationStructureDeviceAddressInfoKHR deviceAddressInfo{};
+				deviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+				deviceAddressInfo.accelerationStructure = request.handle;
+				request.target->handle = request.handle;
+				request.target->deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &deviceAddressInfo);
+				// Memory is owned by the builder
+				request.target->buffer = VK_NULL_HANDLE;
+				request.target->memory = VK_NULL_HANDLE;
+			}
+
+			statistics.structureCount += static_cast<uint32_t>(requests.size());
+			statistics.batchCount += batchCount;
+			statistics.scratchSize = std::max(statistics.scratchSize, scratchSize);
+			statistics.buildSize += bufferSize;
+			statistics.compactedSize += compactedBufferSize;
+
+			std::cout << "Built " << requests.size() << " acceleration structure(s) in " << batchCount << " batch(es) using " << (double)scratchSize / (1024.0 * 1024.0) << " MB of scratch memory, ";
+			std::cout << (double)bufferSize / (1024.0 * 1024.0) << " MB";
+			if (compaction) {
+				std::cout << " compacted to " << (double)compactedBufferSize / (1024.0 * 1024.0) << " MB (" << (1.0 - (double)compactedBufferSize / (double)bufferSize) * 100.0 << "% saved)";
+			}
+			std::cout << "\n";
+
+			requests.clear();
+		}
+
+	private:
+		struct Allocation
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceAddress deviceAddress = 0;
+		};
+
+		struct Request
+		{
+			AccelerationStructure* target;
+			std::vector<VkAccelerationStructureGeometryKHR> geometries;
+			std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+			VkBuildAccelerationStructureFlagsKHR flags;
+			VkAccelerationStructureBuildSizesInfoKHR buildSizes;
+			VkDeviceSize offset;
+			VkAccelerationStructureKHR handle;
+		};
+
+		/** @brief Offsets of acceleration structures in their buffer need to be a multiple of 256 bytes */
+		static const VkDeviceSize structureAlignment = 256;
+
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkDeviceSize scratchAlignment = 1;
+		std::vector<Request> requests;
+		std::vector<Allocation> allocations;
+		std::vector<VkAccelerationStructureKHR> accelerationStructures;
+
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
+		PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR;
+		PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR;
+		PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR;
+		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
+		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
+		PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+		PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
+
+		static VkDeviceSize align(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		VkAccelerationStructureBuildGeometryInfoKHR getBuildGeometryInfo(const Request& request)
+		{
+			VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			buildGeometryInfo.flags = request.flags;
+			buildGeometryInfo.geometryCount = static_cast<uint32_t>(request.geometries.size());
+			buildGeometryInfo.pGeometries = request.geometries.data();
+			return buildGeometryInfo;
+		}
+
+		Allocation createAllocation(VkDeviceSize size, VkBufferUsageFlags usage)
+		{
+			Allocation allocation{};
+			VkBufferCreateInfo bufferCreateInfo{};
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = size;
+			bufferCreateInfo.usage = usage;
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &allocation.buffer));
+			VkMemoryRequirements memoryRequirements{};
+			vkGetBufferMemoryRequirements(device, allocation.buffer, &memoryRequirements);
+			VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo{};
+			memoryAllocateFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+			memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+			VkMemoryAllocateInfo memoryAllocateInfo{};
+			memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
+			memoryAllocateInfo.allocationSize = memoryRequirements.size;
+			memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &allocation.memory));
+			VK_CHECK_RESULT(vkBindBufferMemory(device, allocation.buffer, allocation.memory, 0));
+			VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
+			bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+			bufferDeviceAddressInfo.buffer = allocation.buffer;
+			allocation.deviceAddress = vkGetBufferDeviceAddressKHR(device, &bufferDeviceAddressInfo);
+			return allocation;
+		}
+
+		void freeAllocation(Allocation& allocation)
+		{
+			vkDestroyBuffer(device, allocation.buffer, nullptr);
+			vkFreeMemory(device, allocation.memory, nullptr);
+			allocation = {};
+		}
+
+		VkAccelerationStructureKHR createAccelerationStructure(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+		{
+			VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
+			accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+			accelerationStructureCreateInfo.buffer = buffer;
+			accelerationStructureCreateInfo.offset = offset;
+			accelerationStructureCreateInfo.size = size;
+			accelerationStructureCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			VkAccelerationStructureKHR handle;
+			VK_CHECK_RESULT(vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &handle));
+			return handle;
+		}
+
+		/** @brief Make acceleration structure writes of previous builds visible to following builds, copies and queries */
+		void insertBuildBarrier(VkCommandBuffer commandBuffer)
+		{
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+			memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+	};
+}
@@ -0,0 +1,442 @@
+/*
+* Chunked level of detail terrain
+*
+* The terrain is split into square tiles (geomipmapping) that are generated from a height map on worker threads as the camera moves
+* The height map stays fully resident, only the tile geometry is created and evicted around the camera
+* All tiles share one index buffer with a variant per detail level and combination of stitched edges
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanHeightmap.hpp"
+#include "VulkanTools.h"
+#include "frustum.hpp"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	class ChunkedTerrain
+	{
+	public:
+		struct Settings
+		{
+			/** @brief Number of quads along a tile edge at the highest level of detail, must be a power of two */
+			uint32_t tileResolution = 64;
+			/** @brief Size of a tile in world units */
+			float tileSize = 32.0f;
+			/** @brief Number of detail levels, each level halves the number of quads along a tile edge */
+			uint32_t lodLevels = 5;
+			/** @brief Distance up to which tiles are rendered at full detail, doubles with each following level */
+			float lodDistance = 48.0f;
+			/** @brief Radius (in tiles) around the camera in which tiles are generated */
+			uint32_t viewRadius = 8;
+			/** @brief Size of the area in world units covered by the height map, it's mirrored outside of that area */
+			float heightMapSize = 128.0f;
+			/** @brief World position of the height map's first texel */
+			glm::vec2 heightMapOrigin = glm::vec2(-64.0f);
+			/** @brief Number of worker threads generating tiles (0 = one less than the number of cores) */
+			uint32_t threadCount = 0;
+		};
+
+		struct Statistics
+		{
+			uint32_t residentTiles = 0;
+			uint32_t pendingTiles = 0;
+			uint32_t visibleTiles = 0;
+			uint32_t triangles = 0;
+		} stats;
+
+		Settings settings;
+
+		/**
+		* Create the shared index buffer and the vertex buffer holding all resident tiles
+		*
+		* @param device Device to create the buffers on
+		* @param copyQueue Queue used to upload the index buffer
+		* @param heightMap Height data the tiles are generated from, needs to stay valid until destroy() has been called
+		* @param settings Tile layout and generation settings
+		*/
+		void create(vks::VulkanDevice* device, VkQueue copyQueue, const vks::HeightMap* heightMap, const Settings& settings)
+		{
+			assert((settings.tileResolution & (settings.tileResolution - 1)) == 0);
+			assert((1u << (settings.lodLevels - 1)) <= settings.tileResolution);
+			// Vertex indices of a tile need to fit into 16 bits
+			assert((settings.tileResolution + 1) * (settings.tileResolution + 1) <= 65536);
+
+			this->device = device;
+			this->heightMap = heightMap;
+			this->settings = settings;
+			verticesPerTile = (settings.tileResolution + 1) * (settings.tileResolution + 1);
+
+			generateIndices(copyQueue);
+
+			// Tiles are kept resident one tile beyond the view radius, so moving back and forth doesn't regenerate them
+			const uint32_t residentEdge = (settings.viewRadius + 1) * 2 + 1;
+			const uint32_t slotCount = residentEdge * residentEdge;
+			// Workers write generated vertices straight into their tile's slot of this persistently mapped buffer
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&vertexBuffer,
+				slotCount * verticesPerTile * sizeof(vks::HeightMap::Vertex)));
+			VK_CHECK_RESULT(vertexBuffer.map());
+			freeSlots.resize(slotCount);
+			for (uint32_t i = 0; i < slotCount; i++) {
+				freeSlots[i] = slotCount - 1 - i;
+			}
+
+			uint32_t threadCount = settings.threadCount;
+			if (threadCount == 0) {
+				threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+			}
+			threadPool.setThreadCount(threadCount);
+		}
+
+		void destroy()
+		{
+			// Destroying the threads waits for all outstanding tile jobs
+			threadPool.threads.clear();
+			tiles.clear();
+			drawList.clear();
+			vertexBuffer.destroy();
+			indexBuffer.destroy();
+		}
+
+		/**
+		* Generate and evict tiles around the camera, select their detail levels and build the list of visible tiles
+		*
+		* @note Must not be called while a command buffer recorded with draw() is still executing, as tile slots may be reused
+		*/
+		void update(const glm::vec3& cameraPosition, vks::Frustum& frustum)
+		{
+			const int32_t radius = (int32_t)settings.viewRadius;
+			const int32_t cameraX = (int32_t)std::floor(cameraPosition.x / settings.tileSize);
+			const int32_t cameraZ = (int32_t)std::floor(cameraPosition.z / settings.tileSize);
+
+			// Evict finished tiles that are out of range, tiles still being generated are evicted once they're done
+			for (auto it = tiles.begin(); it != tiles.end();)
+			{
+				Tile* tile = it->second.get();
+				if (tile->ready && ((std::abs(tile->x - cameraX) > radius + 1) || (std::abs(tile->z - cameraZ) > radius + 1))) {
+					freeSlots.push_back(tile->slot);
+					it = tiles.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+
+			// Request missing tiles closest to the camera first
+			uint32_t pending = 0;
+			for (auto& it : tiles) {
+				if (!it.second->ready) {
+					pending++;
+				}
+			}
+			const uint32_t maxPending = static_cast<uint32_t>(threadPool.threads.size()) * 2;
+			if ((pending < maxPending) && !freeSlots.empty())
+			{
+				struct Request { int32_t x, z, distance; };
+				std::vector<Request> requests;
+				for (int32_t z = -radius; z <= radius; z++)
+				{
+					for (int32_t x = -radius; x <= radius; x++)
+					{
+						const int32_t distance = x * x + z * z;
+						if ((distance <= radius * radius) && (tiles.find(key(cameraX + x, cameraZ + z)) == tiles.end())) {
+							requests.push_back({ cameraX + x, cameraZ + z, distance });
+						}
+					}
+				}
+				std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) { return a.distance < b.distance; });
+				for (auto& request : requests)
+				{
+					if ((pending >= maxPending) || freeSlots.empty()) {
+						break;
+					}
+					std::unique_ptr<Tile> tile(new Tile());
+					tile->x = request.x;
+					tile->z = request.z;
+					tile->slot = freeSlots.back();
+					freeSlots.pop_back();
+					Tile* job = tile.get();
+					threadPool.threads[nextThread]->addJob([=] { generateTile(job); });
+					nextThread = (nextThread + 1) % threadPool.threads.size();
+					tiles[key(request.x, request.z)] = std::move(tile);
+					pending++;
+				}
+			}
+
+			// Select the detail level of each tile based on its distance to the camera
+			std::vector<Tile*> readyTiles;
+			for (auto& it : tiles)
+			{
+				Tile* tile = it.second.get();
+				if (!tile->ready) {
+					continue;
+				}
+				tile->resident = true;
+				const glm::vec3 closest = glm::clamp(cameraPosition, tile->boundsMin, tile->boundsMax);
+				const float distance = glm::length(cameraPosition - closest);
+				tile->lod = 0;
+				float lodDistance = settings.lodDistance;
+				while ((distance > lodDistance) && (tile->lod < settings.lodLevels - 1)) {
+					tile->lod++;
+					lodDistance *= 2.0f;
+				}
+				readyTiles.push_back(tile);
+			}
+
+			// Edge stitching only works between neighbours that differ by one level, so refine tiles next to much more detailed ones
+			bool changed = true;
+			while (changed)
+			{
+				changed = false;
+				for (auto tile : readyTiles)
+				{
+					for (uint32_t edge = 0; edge < 4; edge++)
+					{
+						Tile* neighbour = getNeighbour(tile, edge);
+						if (neighbour && (tile->lod > neighbour->lod + 1)) {
+							tile->lod = neighbour->lod + 1;
+							changed = true;
+						}
+					}
+				}
+			}
+
+			// Cull against the view frustum and select the index buffer variant matching the neighbours' detail levels
+			drawList.clear();
+			stats.triangles = 0;
+			for (auto tile : readyTiles)
+			{
+				const glm::vec3 center = (tile->boundsMin + tile->boundsMax) * 0.5f;
+				const float boundingRadius = glm::length(tile->boundsMax - tile->boundsMin) * 0.5f;
+				if (!frustum.checkSphere(center, boundingRadius)) {
+					continue;
+				}
+				uint32_t stitchMask = 0;
+				for (uint32_t edge = 0; edge < 4; edge++)
+				{
+					Tile* neighbour = getNeighbour(tile, edge);
+					if (neighbour && (neighbour->lod > tile->lod)) {
+						stitchMask |= (1 << edge);
+					}
+				}
+				const IndexRange& range = indexRanges[tile->lod * 16 + stitchMask];
+				drawList.push_back({ range.firstIndex, range.indexCount, (int32_t)(tile->slot * verticesPerTile) });
+				stats.triangles += range.indexCount / 3;
+			}
+
+			stats.residentTiles = static_cast<uint32_t>(readyTiles.size());
+			stats.pendingTiles = pending;
+			stats.visibleTiles = static_cast<uint32_t>(drawList.size());
+		}
+
+		/** @brief Draw all visible tiles, expects a pipeline using vks::HeightMap::Vertex as its vertex layout to be bound */
+		void draw(VkCommandBuffer commandBuffer)
+		{
+			if (drawList.empty()) {
+				return;
+			}
+			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+			for (auto& drawCall : drawList) {
+				vkCmdDrawIndexed(commandBuffer, drawCall.indexCount, 1, drawCall.firstIndex, drawCall.vertexOffset, 0);
+			}
+		}
+
+	private:
+		// Edges of a tile, used as bits of the stitch mask
+		enum Edge { edgeNegativeZ = 0, edgePositiveX = 1, edgePositiveZ = 2, edgeNegativeX = 3 };
+
+		struct Tile
+		{
+			int32_t x = 0;
+			int32_t z = 0;
+			// Slot in the vertex buffer
+			uint32_t slot = 0;
+			uint32_t lod = 0;
+			// Set by the worker thread once the vertices and bounds have been written
+			std::atomic<bool> ready{ false };
+			// Set on the main thread when it first sees the tile as ready, so all neighbour lookups of an update agree
+			bool resident = false;
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+		};
+
+		struct IndexRange
+		{
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+		};
+
+		struct DrawCall
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			int32_t vertexOffset;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		const vks::HeightMap* heightMap = nullptr;
+		vks::Buffer vertexBuffer;
+		vks::Buffer indexBuffer;
+		uint32_t verticesPerTile = 0;
+		// One range per detail level and stitch mask (lod * 16 + mask)
+		std::vector<IndexRange> indexRanges;
+		std::unordered_map<uint64_t, std::unique_ptr<Tile>> tiles;
+		std::vector<uint32_t> freeSlots;
+		std::vector<DrawCall> drawList;
+		vks::ThreadPool threadPool;
+		uint32_t nextThread = 0;
+
+		static uint64_t key(int32_t x, int32_t z)
+		{
+			return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)z;
+		}
+
+		// Returns the neighbour on the given edge if it's resident
+		Tile* getNeighbour(const Tile* tile, uint32_t edge)
+		{
+			const int32_t offsets[4][2] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+			auto it = tiles.find(key(tile->x + offsets[edge][0], tile->z + offsets[edge][1]));
+			if ((it == tiles.end()) || !it->second->resident) {
+				return nullptr;
+			}
+			return it->second.get();
+		}
+
+		// Generate the index variants for all detail levels and stitch masks into a single buffer
+		void generateIndices(VkQueue copyQueue)
+		{
+			const uint32_t n = settings.tileResolution;
+			const uint32_t row = n + 1;
+			std::vector<uint16_t> indices;
+			indexRanges.resize(settings.lodLevels * 16);
+
+			for (uint32_t lod = 0; lod < settings.lodLevels; lod++)
+			{
+				const uint32_t step = 1 << lod;
+				for (uint32_t stitchMask = 0; stitchMask < 16; stitchMask++)
+				{
+					// Vertices on stitched edges are snapped to the grid of the coarser neighbour, which closes any cracks
+					// This leaves some degenerate triangles that are skipped
+					const uint32_t coarseStep = step * 2;
+					auto vertex = [&](uint32_t x, uint32_t z) -> uint16_t {
+						if ((stitchMask & (1 << edgeNegativeZ)) && (z == 0)) x = x / coarseStep * coarseStep;
+						if ((stitchMask & (1 << edgePositiveZ)) && (z == n)) x = x / coarseStep * coarseStep;
+						if ((stitchMask & (1 << edgeNegativeX)) && (x == 0)) z = z / coarseStep * coarseStep;
+						if ((stitchMask & (1 << edgePositiveX)) && (x == n)) z = z / coarseStep * coarseStep;
+						return static_cast<uint16_t>(x + z * row);
+					};
+					auto triangle = [&](uint16_t a, uint16_t b, uint16_t c) {
+						if ((a != b) && (b != c) && (c != a)) {
+							indices.push_back(a);
+							indices.push_back(b);
+							indices.push_back(c);
+						}
+					};
+
+					IndexRange& range = indexRanges[lod * 16 + stitchMask];
+					range.firstIndex = static_cast<uint32_t>(indices.size());
+					for (uint32_t z = 0; z < n; z += step)
+					{
+						for (uint32_t x = 0; x < n; x += step)
+						{
+							const uint16_t v00 = vertex(x, z);
+							const uint16_t v10 = vertex(x + step, z);
+							const uint16_t v01 = vertex(x, z + step);
+							const uint16_t v11 = vertex(x + step, z + step);
+							triangle(v00, v10, v11);
+							triangle(v11, v01, v00);
+						}
+					}
+					range.indexCount = static_cast<uint32_t>(indices.size()) - range.firstIndex;
+				}
+			}
+
+			const VkDeviceSize indexBufferSize = indices.size() * sizeof(uint16_t);
+			vks::Buffer indexStaging;
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&indexStaging,
+				indexBufferSize,
+				indices.data()));
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&indexBuffer,
+				indexBufferSize));
+			device->copyBuffer(&indexStaging, &indexBuffer, copyQueue);
+			indexStaging.destroy();
+		}
+
+		// Runs on a worker thread
+		void generateTile(Tile* tile)
+		{
+			const uint32_t n = settings.tileResolution;
+			const uint32_t row = n + 1;
+			const float spacing = settings.tileSize / (float)n;
+			const glm::vec2 origin = glm::vec2((float)tile->x, (float)tile->z) * settings.tileSize;
+
+			// Sample all heights once, including a one vertex border for the normals at the tile edges
+			const uint32_t border = n + 3;
+			std::vector<float> heights(border * border);
+			for (uint32_t z = 0; z < border; z++)
+			{
+				for (uint32_t x = 0; x < border; x++)
+				{
+					const glm::vec2 pos = origin + glm::vec2((float)x - 1.0f, (float)z - 1.0f) * spacing;
+					const glm::vec2 uv = (pos - settings.heightMapOrigin) / settings.heightMapSize;
+					heights[x + z * border] = heightMap->sample(uv.x, uv.y);
+				}
+			}
+
+			vks::HeightMap::Vertex* vertices = static_cast<vks::HeightMap::Vertex*>(vertexBuffer.mapped) + tile->slot * verticesPerTile;
+			float minHeight = std::numeric_limits<float>::max();
+			float maxHeight = -std::numeric_limits<float>::max();
+			for (uint32_t z = 0; z < row; z++)
+			{
+				for (uint32_t x = 0; x < row; x++)
+				{
+					const uint32_t index = (x + 1) + (z + 1) * border;
+					const float height = heights[index];
+					const float dx = (heights[index + 1] - heights[index - 1]) / (2.0f * spacing);
+					const float dz = (heights[index + border] - heights[index - border]) / (2.0f * spacing);
+					const glm::vec2 pos = origin + glm::vec2((float)x, (float)z) * spacing;
+					vks::HeightMap::Vertex& vertex = vertices[x + z * row];
+					// Terrain is displaced along negative y (up)
+					vertex.pos = glm::vec3(pos.x, -height, pos.y);
+					vertex.normal = glm::normalize(glm::vec3(-dx, -1.0f, -dz));
+					vertex.uv = (pos - settings.heightMapOrigin) / settings.heightMapSize;
+					minHeight = std::min(minHeight, height);
+					maxHeight = std::max(maxHeight, height);
+				}
+			}
+
+			tile->boundsMin = glm::vec3(origin.x, -maxHeight, origin.y);
+			tile->boundsMax = glm::vec3(origin.x + settings.tileSize, -minHeight, origin.y + settings.tileSize);
+			tile->ready = true;
+		}
+	};
+}
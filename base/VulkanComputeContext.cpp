@@ -0,0 +1,531 @@
+/*
+* Headless compute context
+*
+* Runs batches of compute work without a window or swap chain
+* Uploads, dispatches and readbacks of consecutive batches overlap through a ring of persistently mapped buffers
+* Synchronization between the stages is done with timeline semaphores (VK_KHR_timeline_semaphore)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanComputeContext.h"
+#include "VulkanDebug.h"
+
+namespace vks
+{
+	static VkDeviceSize alignSize(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	void ComputeContext::createInstance()
+	{
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		vks::android::loadVulkanLibrary();
+#endif
+
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "Vulkan compute context";
+		appInfo.pEngineName = "VulkanExample";
+		// Vulkan 1.1 is required for chaining the timeline semaphore features to the device creation
+		appInfo.apiVersion = VK_API_VERSION_1_1;
+
+		// No surface extensions are requested, the context works without any window system
+		std::vector<const char*> instanceExtensions;
+		const char* validationLayerName = "VK_LAYER_KHRONOS_validation";
+
+		VkInstanceCreateInfo instanceCreateInfo{};
+		instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		instanceCreateInfo.pApplicationInfo = &appInfo;
+
+		if (settings.validation)
+		{
+			uint32_t instanceLayerCount;
+			vkEnumerateInstanceLayerProperties(&instanceLayerCount, nullptr);
+			std::vector<VkLayerProperties> instanceLayerProperties(instanceLayerCount);
+			vkEnumerateInstanceLayerProperties(&instanceLayerCount, instanceLayerProperties.data());
+			bool validationLayerPresent = false;
+			for (VkLayerProperties layer : instanceLayerProperties) {
+				if (strcmp(layer.layerName, validationLayerName) == 0) {
+					validationLayerPresent = true;
+					break;
+				}
+			}
+			if (validationLayerPresent) {
+				instanceCreateInfo.ppEnabledLayerNames = &validationLayerName;
+				instanceCreateInfo.enabledLayerCount = 1;
+				instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+			} else {
+				std::cerr << "Validation layer VK_LAYER_KHRONOS_validation not present, validation is disabled\n";
+				settings.validation = false;
+			}
+		}
+
+		instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
+		instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions.data();
+		VK_CHECK_RESULT(vkCreateInstance(&instanceCreateInfo, nullptr, &instance));
+
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		vks::android::loadVulkanFunctions(instance);
+#endif
+
+		if (settings.validation)
+		{
+			vks::debug::setupDebugging(instance, VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT, VK_NULL_HANDLE);
+		}
+	}
+
+	void ComputeContext::createDevice()
+	{
+		uint32_t deviceCount = 0;
+		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr));
+		if (deviceCount == 0) {
+			vks::tools::exitFatal("No device with Vulkan support found", -1);
+		}
+		std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()));
+		uint32_t deviceIndex = settings.deviceIndex < deviceCount ? settings.deviceIndex : 0;
+
+		vulkanDevice = new vks::VulkanDevice(physicalDevices[deviceIndex]);
+
+		// Request a graphics queue only if the implementation has one, so the graphics family index (which the compute and transfer
+		// families are compared against) is always backed by an actual queue
+		VkQueueFlags requestedQueueTypes = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+		for (auto& queueFamilyProperties : vulkanDevice->queueFamilyProperties) {
+			if (queueFamilyProperties.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				requestedQueueTypes |= VK_QUEUE_GRAPHICS_BIT;
+				break;
+			}
+		}
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+		timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+		std::vector<const char*> enabledExtensions = { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
+		VK_CHECK_RESULT(vulkanDevice->createLogicalDevice({}, enabledExtensions, &timelineSemaphoreFeatures, false, requestedQueueTypes));
+		device = vulkanDevice->logicalDevice;
+
+		// If the implementation has a dedicated transfer queue, uploads and downloads run on it in parallel to the compute queue
+		vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.compute, 0, &computeQueue);
+		vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.transfer, 0, &transferQueue);
+
+		computeCommandPool = vulkanDevice->createCommandPool(vulkanDevice->queueFamilyIndices.compute);
+		transferCommandPool = vulkanDevice->createCommandPool(vulkanDevice->queueFamilyIndices.transfer);
+
+		vkWaitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+		vkGetSemaphoreCounterValueKHR = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+		assert(vkWaitSemaphoresKHR && vkGetSemaphoreCounterValueKHR);
+
+		VkPhysicalDeviceProperties& properties = vulkanDevice->properties;
+		std::cout << "GPU: " << properties.deviceName << "\n";
+	}
+
+	/**
+	* Create a buffer that can be accessed from both the compute and the transfer queue family without ownership transfers
+	*
+	* @return Index of the memory type the buffer's memory has been allocated from
+	*/
+	uint32_t ComputeContext::createBuffer(vks::Buffer& buffer, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size)
+	{
+		buffer.device = device;
+		const uint32_t queueFamilyIndices[2] = { vulkanDevice->queueFamilyIndices.compute, vulkanDevice->queueFamilyIndices.transfer };
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		if (queueFamilyIndices[0] != queueFamilyIndices[1]) {
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = 2;
+			bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer.buffer));
+
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device, buffer.buffer, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &buffer.memory));
+
+		buffer.alignment = memReqs.alignment;
+		buffer.size = size;
+		buffer.usageFlags = usageFlags;
+		buffer.memoryPropertyFlags = memoryPropertyFlags;
+		buffer.setupDescriptor();
+		VK_CHECK_RESULT(buffer.bind());
+		return memAlloc.memoryTypeIndex;
+	}
+
+	/**
+	* Create the instance, device and all resources of the batch ring
+	*
+	* @param settings Context settings, input and output size are the maximum sizes of a single batch
+	*/
+	void ComputeContext::create(const Settings& settings)
+	{
+		this->settings = settings;
+		assert(settings.ringSize > 0);
+		assert(settings.inputSize > 0);
+		if (this->settings.inPlace) {
+			this->settings.outputSize = settings.inputSize;
+		}
+
+		createInstance();
+		createDevice();
+
+		// Each ring slot is a sub range of one large buffer, so slot offsets need to respect the descriptor and the non-coherent mapping alignment
+		const VkPhysicalDeviceLimits& limits = vulkanDevice->properties.limits;
+		const VkDeviceSize alignment = std::max(limits.minStorageBufferOffsetAlignment, limits.nonCoherentAtomSize);
+		inputSlotSize = alignSize(this->settings.inputSize, alignment);
+		outputSlotSize = alignSize(this->settings.outputSize, alignment);
+		const uint32_t ringSize = this->settings.ringSize;
+
+		// Host side buffers stay mapped for the lifetime of the context
+		createBuffer(buffers.staging, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, inputSlotSize * ringSize);
+		VK_CHECK_RESULT(buffers.staging.map());
+
+		// Prefer cached memory for readbacks, as uncached reads from the host are very slow
+		VkMemoryPropertyFlags readbackMemoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		VkBool32 cachedMemoryFound = VK_FALSE;
+		vulkanDevice->getMemoryType(~0u, readbackMemoryFlags, &cachedMemoryFound);
+		if (!cachedMemoryFound) {
+			readbackMemoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		}
+		uint32_t readbackMemoryType = createBuffer(buffers.readback, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackMemoryFlags, outputSlotSize * ringSize);
+		readbackCoherent = (vulkanDevice->memoryProperties.memoryTypes[readbackMemoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		VK_CHECK_RESULT(buffers.readback.map());
+
+		createBuffer(buffers.input, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, inputSlotSize * ringSize);
+		if (!this->settings.inPlace) {
+			createBuffer(buffers.output, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outputSlotSize * ringSize);
+		}
+
+		// All pipelines share one layout: binding 0 is the input, binding 1 the output and a small push constant block
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(Dispatch::pushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * ringSize),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, ringSize);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		// Timeline semaphores, one per stage, all starting at zero
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo{};
+		semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeCreateInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.upload));
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.compute));
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.download));
+
+		// Setup the ring slots
+		batches.resize(ringSize);
+		for (uint32_t i = 0; i < ringSize; i++) {
+			Batch& batch = batches[i];
+			batch.inputOffset = inputSlotSize * i;
+			batch.outputOffset = outputSlotSize * i;
+			batch.input = static_cast<uint8_t*>(buffers.staging.mapped) + batch.inputOffset;
+			batch.output = static_cast<uint8_t*>(buffers.readback.mapped) + batch.outputOffset;
+
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &batch.descriptorSet));
+			VkDescriptorBufferInfo inputDescriptor = { buffers.input.buffer, batch.inputOffset, inputSlotSize };
+			VkDescriptorBufferInfo outputDescriptor = this->settings.inPlace ? inputDescriptor : VkDescriptorBufferInfo{ buffers.output.buffer, batch.outputOffset, outputSlotSize };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(batch.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &inputDescriptor),
+				vks::initializers::writeDescriptorSet(batch.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &outputDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			batch.uploadCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, transferCommandPool);
+			batch.computeCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, computeCommandPool);
+			batch.downloadCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, transferCommandPool);
+		}
+	}
+
+	void ComputeContext::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		vkDeviceWaitIdle(device);
+		for (auto& pipeline : pipelines) {
+			vkDestroyPipeline(device, pipeline.second.pipeline, nullptr);
+			vkDestroyShaderModule(device, pipeline.second.shaderModule, nullptr);
+		}
+		pipelines.clear();
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		vkDestroySemaphore(device, semaphores.upload, nullptr);
+		vkDestroySemaphore(device, semaphores.compute, nullptr);
+		vkDestroySemaphore(device, semaphores.download, nullptr);
+		vkDestroyCommandPool(device, computeCommandPool, nullptr);
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
+		buffers.staging.destroy();
+		buffers.readback.destroy();
+		buffers.input.destroy();
+		buffers.output.destroy();
+		batches.clear();
+		delete vulkanDevice;
+		vulkanDevice = nullptr;
+		device = VK_NULL_HANDLE;
+		if (settings.validation) {
+			vks::debug::freeDebugCallback(instance);
+		}
+		vkDestroyInstance(instance, nullptr);
+		instance = VK_NULL_HANDLE;
+	}
+
+	/**
+	* Get a compute pipeline for the given shader, pipelines are created once and reused for all later batches
+	*
+	* @param fileName Path to the SPIR-V compute shader
+	* @param specializationConstants (Optional) Values for the specialization constants, value n is passed as constant_id n
+	*
+	* @return Pointer to the cached pipeline, stays valid until the context is destroyed
+	*/
+	ComputeContext::Pipeline* ComputeContext::getPipeline(const std::string& fileName, const std::vector<uint32_t>& specializationConstants)
+	{
+		std::string key = fileName;
+		for (auto constant : specializationConstants) {
+			key += ":" + std::to_string(constant);
+		}
+		auto it = pipelines.find(key);
+		if (it != pipelines.end()) {
+			stats.pipelinesReused++;
+			return &it->second;
+		}
+
+		Pipeline pipeline{};
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		pipeline.shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+#else
+		pipeline.shaderModule = vks::tools::loadShader(fileName.c_str(), device);
+#endif
+		assert(pipeline.shaderModule != VK_NULL_HANDLE);
+
+		std::vector<VkSpecializationMapEntry> specializationMapEntries(specializationConstants.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(specializationConstants.size()); i++) {
+			specializationMapEntries[i] = vks::initializers::specializationMapEntry(i, i * sizeof(uint32_t), sizeof(uint32_t));
+		}
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, specializationConstants.size() * sizeof(uint32_t), specializationConstants.data());
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = pipeline.shaderModule;
+		shaderStage.pName = "main";
+		shaderStage.pSpecializationInfo = specializationConstants.empty() ? nullptr : &specializationInfo;
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = shaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline.pipeline));
+		stats.pipelinesCreated++;
+
+		return &(pipelines[key] = pipeline);
+	}
+
+	void ComputeContext::waitTimeline(VkSemaphore semaphore, uint64_t value)
+	{
+		VkSemaphoreWaitInfoKHR waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+		VK_CHECK_RESULT(vkWaitSemaphoresKHR(device, &waitInfo, DEFAULT_FENCE_TIMEOUT));
+	}
+
+	/**
+	* Acquire the next slot of the batch ring for writing input data
+	*
+	* @note Blocks until the batch that previously used this slot has been read back
+	* @note Batches must be submitted in the order they have been acquired
+	*
+	* @return Pointer to the batch with its persistently mapped input memory
+	*/
+	ComputeContext::Batch* ComputeContext::acquireBatch()
+	{
+		const uint64_t ticket = nextTicket++;
+		const uint32_t ringSize = settings.ringSize;
+		Batch* batch = &batches[(ticket - 1) % ringSize];
+		if (ticket > ringSize) {
+			waitTimeline(semaphores.download, ticket - ringSize);
+		}
+		batch->ticket = ticket;
+		return batch;
+	}
+
+	/**
+	* Submit a batch for upload, dispatch and readback
+	*
+	* @param batch Batch acquired with acquireBatch whose input memory has been filled
+	* @param dispatches Dispatches to run for this batch, separated by memory barriers so later dispatches can consume earlier results
+	* @param inputSize Number of input bytes to upload
+	* @param outputSize Number of output bytes to read back
+	*
+	* @return Ticket that can be passed to isComplete or wait
+	*/
+	uint64_t ComputeContext::submitBatch(Batch* batch, const std::vector<Dispatch>& dispatches, VkDeviceSize inputSize, VkDeviceSize outputSize)
+	{
+		assert(batch->ticket == lastSubmittedTicket + 1);
+		assert(inputSize <= settings.inputSize && outputSize <= settings.outputSize);
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		// Upload from the persistently mapped staging slot to device local memory
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch->uploadCmdBuffer, &cmdBufInfo));
+		if (inputSize > 0) {
+			VkBufferCopy copyRegion = { batch->inputOffset, batch->inputOffset, inputSize };
+			vkCmdCopyBuffer(batch->uploadCmdBuffer, buffers.staging.buffer, buffers.input.buffer, 1, &copyRegion);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch->uploadCmdBuffer));
+
+		// Dispatches
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch->computeCmdBuffer, &cmdBufInfo));
+		vkCmdBindDescriptorSets(batch->computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &batch->descriptorSet, 0, nullptr);
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		for (size_t i = 0; i < dispatches.size(); i++) {
+			const Dispatch& dispatch = dispatches[i];
+			assert(dispatch.pipeline);
+			if (i > 0) {
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(batch->computeCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+			if (dispatch.pipeline->pipeline != boundPipeline) {
+				boundPipeline = dispatch.pipeline->pipeline;
+				vkCmdBindPipeline(batch->computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, boundPipeline);
+			}
+			vkCmdPushConstants(batch->computeCmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(dispatch.pushConstants), dispatch.pushConstants);
+			vkCmdDispatch(batch->computeCmdBuffer, dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch->computeCmdBuffer));
+
+		// Read back into the persistently mapped readback slot
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch->downloadCmdBuffer, &cmdBufInfo));
+		if (outputSize > 0) {
+			VkBufferCopy copyRegion = { settings.inPlace ? batch->inputOffset : batch->outputOffset, batch->outputOffset, outputSize };
+			vkCmdCopyBuffer(batch->downloadCmdBuffer, settings.inPlace ? buffers.input.buffer : buffers.output.buffer, buffers.readback.buffer, 1, &copyRegion);
+			// Make the transfer writes visible to the host
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = buffers.readback.buffer;
+			bufferBarrier.offset = batch->outputOffset;
+			bufferBarrier.size = outputSize;
+			vkCmdPipelineBarrier(batch->downloadCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch->downloadCmdBuffer));
+
+		// Chain the three stages with timeline semaphores
+		// The transfer queue can upload the next batch and read back the previous one while the compute queue is busy
+		const uint64_t ticket = batch->ticket;
+		const VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		const VkPipelineStageFlags downloadWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfos[3]{};
+		VkSubmitInfo submitInfos[3];
+		for (uint32_t i = 0; i < 3; i++) {
+			timelineInfos[i].sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfos[i].signalSemaphoreValueCount = 1;
+			timelineInfos[i].pSignalSemaphoreValues = &ticket;
+			submitInfos[i] = vks::initializers::submitInfo();
+			submitInfos[i].pNext = &timelineInfos[i];
+			submitInfos[i].commandBufferCount = 1;
+			submitInfos[i].signalSemaphoreCount = 1;
+		}
+		// Upload
+		submitInfos[0].pCommandBuffers = &batch->uploadCmdBuffer;
+		submitInfos[0].pSignalSemaphores = &semaphores.upload;
+		// Compute waits for the upload
+		submitInfos[1].pCommandBuffers = &batch->computeCmdBuffer;
+		submitInfos[1].pSignalSemaphores = &semaphores.compute;
+		submitInfos[1].waitSemaphoreCount = 1;
+		submitInfos[1].pWaitSemaphores = &semaphores.upload;
+		submitInfos[1].pWaitDstStageMask = &computeWaitStage;
+		timelineInfos[1].waitSemaphoreValueCount = 1;
+		timelineInfos[1].pWaitSemaphoreValues = &ticket;
+		// Download waits for the dispatches
+		submitInfos[2].pCommandBuffers = &batch->downloadCmdBuffer;
+		submitInfos[2].pSignalSemaphores = &semaphores.download;
+		submitInfos[2].waitSemaphoreCount = 1;
+		submitInfos[2].pWaitSemaphores = &semaphores.compute;
+		submitInfos[2].pWaitDstStageMask = &downloadWaitStage;
+		timelineInfos[2].waitSemaphoreValueCount = 1;
+		timelineInfos[2].pWaitSemaphoreValues = &ticket;
+
+		if (computeQueue == transferQueue) {
+			VK_CHECK_RESULT(vkQueueSubmit(computeQueue, 3, submitInfos, VK_NULL_HANDLE));
+		} else {
+			VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfos[0], VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueSubmit(computeQueue, 1, &submitInfos[1], VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfos[2], VK_NULL_HANDLE));
+		}
+
+		lastSubmittedTicket = ticket;
+		stats.batches++;
+		stats.dispatches += dispatches.size();
+		stats.bytesUploaded += inputSize;
+		stats.bytesDownloaded += outputSize;
+		return ticket;
+	}
+
+	/** @brief Returns true if the batch with the given ticket has been read back, does not block */
+	bool ComputeContext::isComplete(uint64_t ticket)
+	{
+		uint64_t value = 0;
+		VK_CHECK_RESULT(vkGetSemaphoreCounterValueKHR(device, semaphores.download, &value));
+		return value >= ticket;
+	}
+
+	/**
+	* Wait for a batch to be read back
+	*
+	* @param ticket Ticket returned by submitBatch
+	*
+	* @return Pointer to the read back output, stays valid until the batch's ring slot is acquired again
+	*/
+	void* ComputeContext::wait(uint64_t ticket)
+	{
+		assert(ticket <= lastSubmittedTicket);
+		assert(ticket + settings.ringSize >= nextTicket);
+		waitTimeline(semaphores.download, ticket);
+		Batch& batch = batches[(ticket - 1) % settings.ringSize];
+		if (!readbackCoherent) {
+			VK_CHECK_RESULT(buffers.readback.invalidate(outputSlotSize, batch.outputOffset));
+		}
+		return batch.output;
+	}
+
+	/** @brief Wait until all submitted batches have been read back */
+	void ComputeContext::waitIdle()
+	{
+		if (lastSubmittedTicket > 0) {
+			waitTimeline(semaphores.download, lastSubmittedTicket);
+		}
+	}
+}
@@ -0,0 +1,146 @@
+/*
+* Headless compute context
+*
+* Runs batches of compute work without a window or swap chain
+* Uploads, dispatches and readbacks of consecutive batches overlap through a ring of persistently mapped buffers
+* Synchronization between the stages is done with timeline semaphores (VK_KHR_timeline_semaphore)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class ComputeContext
+	{
+	public:
+		struct Settings
+		{
+			/** @brief Enable the Khronos validation layer */
+			bool validation = false;
+			/** @brief Index of the physical device to run on */
+			uint32_t deviceIndex = 0;
+			/** @brief Number of batches that can be in flight at the same time */
+			uint32_t ringSize = 3;
+			/** @brief Maximum size of the input data of a single batch in bytes */
+			VkDeviceSize inputSize = 0;
+			/** @brief Maximum size of the output data of a single batch in bytes */
+			VkDeviceSize outputSize = 0;
+			/** @brief If true, shaders work on the input buffer (binding 0) in place and that buffer is read back */
+			bool inPlace = false;
+		};
+
+		/** @brief Compute pipeline using the context's shared pipeline layout */
+		struct Pipeline
+		{
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkShaderModule shaderModule = VK_NULL_HANDLE;
+		};
+
+		/** @brief A single dispatch recorded into a batch */
+		struct Dispatch
+		{
+			Pipeline* pipeline = nullptr;
+			uint32_t groupCountX = 1;
+			uint32_t groupCountY = 1;
+			uint32_t groupCountZ = 1;
+			/** @brief Passed to the shader as a push constant block of four uints (e.g. element offset and count) */
+			uint32_t pushConstants[4] = { 0, 0, 0, 0 };
+		};
+
+		/** @brief One slot of the batch ring */
+		struct Batch
+		{
+			/** @brief Timeline value the batch signals on all stage semaphores once that stage is done */
+			uint64_t ticket = 0;
+			/** @brief Persistently mapped host memory the input data for this batch is written to */
+			void* input = nullptr;
+			/** @brief Persistently mapped host memory the results are read back into, valid after wait() */
+			void* output = nullptr;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkCommandBuffer uploadCmdBuffer = VK_NULL_HANDLE;
+			VkCommandBuffer computeCmdBuffer = VK_NULL_HANDLE;
+			VkCommandBuffer downloadCmdBuffer = VK_NULL_HANDLE;
+			VkDeviceSize inputOffset = 0;
+			VkDeviceSize outputOffset = 0;
+		};
+
+		struct Statistics
+		{
+			uint64_t batches = 0;
+			uint64_t dispatches = 0;
+			uint64_t pipelinesCreated = 0;
+			uint64_t pipelinesReused = 0;
+			VkDeviceSize bytesUploaded = 0;
+			VkDeviceSize bytesDownloaded = 0;
+		} stats;
+
+		Settings settings;
+
+		VkInstance instance = VK_NULL_HANDLE;
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue computeQueue = VK_NULL_HANDLE;
+		VkQueue transferQueue = VK_NULL_HANDLE;
+
+		PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr;
+		PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR = nullptr;
+
+		void create(const Settings& settings);
+		void destroy();
+
+		Pipeline* getPipeline(const std::string& fileName, const std::vector<uint32_t>& specializationConstants = {});
+		Batch* acquireBatch();
+		uint64_t submitBatch(Batch* batch, const std::vector<Dispatch>& dispatches, VkDeviceSize inputSize, VkDeviceSize outputSize);
+		bool isComplete(uint64_t ticket);
+		void* wait(uint64_t ticket);
+		void waitIdle();
+
+	private:
+		VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+		VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		std::unordered_map<std::string, Pipeline> pipelines;
+
+		// Timeline semaphores for the three stages of a batch, all use the batch ticket as their value
+		struct {
+			VkSemaphore upload = VK_NULL_HANDLE;
+			VkSemaphore compute = VK_NULL_HANDLE;
+			VkSemaphore download = VK_NULL_HANDLE;
+		} semaphores;
+
+		struct {
+			vks::Buffer staging;
+			vks::Buffer input;
+			vks::Buffer output;
+			vks::Buffer readback;
+		} buffers;
+
+		std::vector<Batch> batches;
+		uint64_t nextTicket = 1;
+		uint64_t lastSubmittedTicket = 0;
+		VkDeviceSize inputSlotSize = 0;
+		VkDeviceSize outputSlotSize = 0;
+		bool readbackCoherent = true;
+
+		void createInstance();
+		void createDevice();
+		uint32_t createBuffer(vks::Buffer& buffer, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size);
+		void waitTimeline(VkSemaphore semaphore, uint64_t value);
+	};
+}
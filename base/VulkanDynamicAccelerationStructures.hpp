@@ -0,0 +1,451 @@
+/*
+* Ray tracing acceleration structures for animated scenes
+*
+* Bottom and top level acceleration structures for a single glTF scene instance that are updated each frame
+* The instance transform can be animated (top level refit) and the scene geometry can be deformed by a compute shader (bottom level refit)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+#include "vulkan/vulkan.h"
+#include "VulkanAccelerationStructureBuilder.hpp"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanglTFModel.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTimestampQuery.hpp"
+#include "VulkanTools.h"
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	/**
+	* @brief Updatable acceleration structures for a glTF scene that can be animated at runtime
+	* @note The structures are built with ALLOW_UPDATE and can't be compacted, so they are not built with the AccelerationStructureBuilder
+	* @note The scene needs to be loaded with PreTransformVertices and its vertex and index buffers need to be usable as acceleration structure build input
+	*/
+	class DynamicAccelerationStructures
+	{
+	public:
+		AccelerationStructure bottomLevel{};
+		AccelerationStructure topLevel{};
+
+		/** @brief Rotate the scene instance, which requires a top level refit */
+		bool animateInstance = false;
+		/** @brief Deform the scene geometry, which requires a bottom level refit (and a top level refit for the changed bounds) */
+		bool deformScene = false;
+		float deformAmplitude = 0.05f;
+		/** @brief Number of bottom level refits after which the structure is fully rebuilt */
+		int32_t bottomLevelRebuildInterval = 60;
+		uint32_t bottomLevelRefitCount = 0;
+
+		/** @brief Per-frame updates recorded by update(), needs to be submitted ahead of the command buffers that trace rays */
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+		/**
+		* Create and build the acceleration structures and the resources required for updating them
+		*
+		* @param vulkanDevice Device to create the structures on
+		* @param queue Queue for the initial builds
+		* @param commandPool Pool to allocate the per-frame update command buffer from
+		* @param scene Scene to build the acceleration structures for, needs to stay valid until destroy() has been called
+		* @param shaderFile Path to the SPIR-V of the deformation compute shader (<example>/deform.comp.spv)
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, VkQueue queue, VkCommandPool commandPool, vkglTF::Model* scene, const std::string& shaderFile)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->scene = scene;
+			device = vulkanDevice->logicalDevice;
+
+			vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device, "vkGetBufferDeviceAddressKHR"));
+			vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR"));
+			vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR"));
+			vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device, "vkGetAccelerationStructureBuildSizesKHR"));
+			vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(device, "vkGetAccelerationStructureDeviceAddressKHR"));
+			vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR"));
+
+			createDeformPipeline(shaderFile);
+			createBottomLevel(queue);
+			createTopLevel(queue);
+
+			commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, false);
+			timestampQuery.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, TS_COUNT);
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			destroyAccelerationStructure(bottomLevel);
+			destroyAccelerationStructure(topLevel);
+			bottomLevelScratchBuffer.destroy();
+			topLevelScratchBuffer.destroy();
+			instancesBuffer.destroy();
+			deform.positions.destroy();
+			vkDestroyPipeline(device, deform.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, deform.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, deform.descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, deform.descriptorPool, nullptr);
+			vkDestroyShaderModule(device, deform.shaderModule, nullptr);
+			timestampQuery.destroy();
+			vulkanDevice = nullptr;
+		}
+
+		/**
+		* Record the acceleration structure updates for the current frame into the update command buffer
+		*
+		* @param time Animation time (0.0 .. 1.0)
+		* @param animate Apply the enabled animations, the structures are left untouched if false (e.g. if the example is paused)
+		*/
+		void update(float time, bool animate)
+		{
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+			timestampQuery.reset(commandBuffer);
+
+			timestampQuery.write(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TS_BLAS_START);
+			if (deformScene && animate) {
+				deformGeometry(commandBuffer, time, deformAmplitude);
+				// Each refit lowers the quality of the structure as it was optimized for the geometry it was built for, so it's rebuilt after a number of refits
+				const bool rebuild = bottomLevelRefitCount >= static_cast<uint32_t>(bottomLevelRebuildInterval);
+				buildAccelerationStructure(commandBuffer, bottomLevel, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, bottomLevelGeometry, bottomLevelPrimitiveCount, bottomLevelScratchBuffer, !rebuild);
+				bottomLevelRefitCount = rebuild ? 0 : bottomLevelRefitCount + 1;
+			}
+			timestampQuery.write(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, TS_BLAS_END);
+
+			// The top level structure needs to be refit if the instance moved or the bounds of the bottom level structure changed
+			timestampQuery.write(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TS_TLAS_START);
+			if ((animateInstance || deformScene) && animate) {
+				updateInstance(time);
+				buildAccelerationStructure(commandBuffer, topLevel, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, topLevelGeometry, 1, topLevelScratchBuffer, true);
+			}
+			timestampQuery.write(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, TS_TLAS_END);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		}
+
+		/** @brief Read back the GPU timings of the last submitted update */
+		void fetchTimings()
+		{
+			timestampQuery.fetch();
+		}
+
+		/** @brief Add the animation settings and the update timings to the UI overlay */
+		void OnUpdateUIOverlay(vks::UIOverlay* overlay)
+		{
+			if (overlay->header("Animation")) {
+				overlay->checkBox("Animate instance (TLAS refit)", &animateInstance);
+				overlay->checkBox("Deform geometry (BLAS refit)", &deformScene);
+				overlay->sliderFloat("Amplitude", &deformAmplitude, 0.0f, 0.25f);
+				overlay->sliderInt("BLAS rebuild interval", &bottomLevelRebuildInterval, 1, 240);
+				overlay->text("BLAS refits since rebuild: %d", bottomLevelRefitCount);
+			}
+			if (timestampQuery.supported() && overlay->header("GPU timings")) {
+				overlay->text("BLAS deform + update: %.3f ms", timestampQuery.duration(TS_BLAS_START, TS_BLAS_END));
+				overlay->text("TLAS refit: %.3f ms", timestampQuery.duration(TS_TLAS_START, TS_TLAS_END));
+			}
+		}
+
+	private:
+		// Compute shader based deformation of the scene geometry
+		struct DeformPushConstants {
+			float time;
+			float amplitude;
+			uint32_t vertexCount;
+			uint32_t vertexStride;
+		};
+		struct Deform {
+			vks::Buffer positions;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkShaderModule shaderModule = VK_NULL_HANDLE;
+		} deform;
+
+		// GPU timings of the acceleration structure updates
+		vks::TimestampQuery timestampQuery;
+		enum {
+			TS_BLAS_START,
+			TS_BLAS_END,
+			TS_TLAS_START,
+			TS_TLAS_END,
+			TS_COUNT
+		};
+
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkDevice device = VK_NULL_HANDLE;
+		vkglTF::Model* scene = nullptr;
+
+		// Data kept for the per-frame acceleration structure updates
+		VkAccelerationStructureGeometryKHR bottomLevelGeometry{};
+		VkAccelerationStructureGeometryKHR topLevelGeometry{};
+		uint32_t bottomLevelPrimitiveCount = 0;
+		vks::Buffer bottomLevelScratchBuffer;
+		vks::Buffer topLevelScratchBuffer;
+		vks::Buffer instancesBuffer;
+
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
+		PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR;
+		PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR;
+		PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR;
+		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
+		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
+
+		VkDeviceAddress getBufferDeviceAddress(VkBuffer buffer)
+		{
+			VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
+			bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+			bufferDeviceAddressInfo.buffer = buffer;
+			return vkGetBufferDeviceAddressKHR(device, &bufferDeviceAddressInfo);
+		}
+
+		/** @brief Create an acceleration structure with its own buffer and the scratch buffer used for building and updating it */
+		void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, const VkAccelerationStructureGeometryKHR& geometry, uint32_t primitiveCount, vks::Buffer& scratchBuffer)
+		{
+			VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			accelerationStructureBuildGeometryInfo.type = type;
+			accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+			accelerationStructureBuildGeometryInfo.geometryCount = 1;
+			accelerationStructureBuildGeometryInfo.pGeometries = &geometry;
+
+			VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+			vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &accelerationStructureBuildGeometryInfo, &primitiveCount, &accelerationStructureBuildSizesInfo);
+
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				accelerationStructureBuildSizesInfo.accelerationStructureSize,
+				&accelerationStructure.buffer,
+				&accelerationStructure.memory));
+			VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
+			accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+			accelerationStructureCreateInfo.buffer = accelerationStructure.buffer;
+			accelerationStructureCreateInfo.size = accelerationStructureBuildSizesInfo.accelerationStructureSize;
+			accelerationStructureCreateInfo.type = type;
+			VK_CHECK_RESULT(vkCreateAccelerationStructureKHR(device, &accelerationStructureCreateInfo, nullptr, &accelerationStructure.handle));
+			VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
+			accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+			accelerationDeviceAddressInfo.accelerationStructure = accelerationStructure.handle;
+			accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
+
+			// The scratch buffer is kept for the per-frame updates and rebuilds, so it needs to be large enough for both
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&scratchBuffer,
+				std::max(accelerationStructureBuildSizesInfo.buildScratchSize, accelerationStructureBuildSizesInfo.updateScratchSize)));
+		}
+
+		void destroyAccelerationStructure(AccelerationStructure& accelerationStructure)
+		{
+			vkDestroyAccelerationStructureKHR(device, accelerationStructure.handle, nullptr);
+			vkDestroyBuffer(device, accelerationStructure.buffer, nullptr);
+			vkFreeMemory(device, accelerationStructure.memory, nullptr);
+			accelerationStructure = {};
+		}
+
+		/*
+			Create the compute pipeline that deforms the scene geometry
+			The deformed positions are used as input for the bottom level acceleration structure, while shading still uses the scene's vertex buffer
+		*/
+		void createDeformPipeline(const std::string& shaderFile)
+		{
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&deform.positions,
+				scene->vertices.count * sizeof(glm::vec4)));
+
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2)
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &deform.descriptorPool));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				// Binding 0: Scene vertex buffer
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				// Binding 1: Deformed positions
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &deform.descriptorSetLayout));
+
+			VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(deform.descriptorPool, &deform.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &deform.descriptorSet));
+			VkDescriptorBufferInfo vertexBufferDescriptor{ scene->vertices.buffer, 0, VK_WHOLE_SIZE };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(deform.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &vertexBufferDescriptor),
+				vks::initializers::writeDescriptorSet(deform.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &deform.positions.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(DeformPushConstants), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&deform.descriptorSetLayout, 1);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &deform.pipelineLayout));
+
+#if defined(__ANDROID__)
+			deform.shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device);
+#else
+			deform.shaderModule = vks::tools::loadShader(shaderFile.c_str(), device);
+#endif
+			VkPipelineShaderStageCreateInfo shaderStage = {};
+			shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			shaderStage.module = deform.shaderModule;
+			shaderStage.pName = "main";
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(deform.pipelineLayout, 0);
+			computePipelineCI.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCI, nullptr, &deform.pipeline));
+		}
+
+		/*
+			Deform the scene geometry and make the results visible to the acceleration structure build
+		*/
+		void deformGeometry(VkCommandBuffer commandBuffer, float time, float amplitude)
+		{
+			DeformPushConstants pushConstants{};
+			pushConstants.time = time;
+			pushConstants.amplitude = amplitude;
+			pushConstants.vertexCount = scene->vertices.count;
+			pushConstants.vertexStride = sizeof(vkglTF::Vertex) / sizeof(glm::vec4);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, deform.pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, deform.pipelineLayout, 0, 1, &deform.descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, deform.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DeformPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (scene->vertices.count + 255) / 256, 1, 1);
+
+			// Acceleration structure builds read their geometry input as shader reads
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		/*
+			Record a build or update of an acceleration structure
+			Updates (refits) only move the existing nodes of the structure, which is a lot cheaper than a full build but requires the topology to stay the same
+		*/
+		void buildAccelerationStructure(VkCommandBuffer commandBuffer, AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureGeometryKHR& geometry, uint32_t primitiveCount, vks::Buffer& scratchBuffer, bool update)
+		{
+			VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			accelerationBuildGeometryInfo.type = type;
+			accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+			accelerationBuildGeometryInfo.mode = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			accelerationBuildGeometryInfo.srcAccelerationStructure = update ? accelerationStructure.handle : VK_NULL_HANDLE;
+			accelerationBuildGeometryInfo.dstAccelerationStructure = accelerationStructure.handle;
+			accelerationBuildGeometryInfo.geometryCount = 1;
+			accelerationBuildGeometryInfo.pGeometries = &geometry;
+			accelerationBuildGeometryInfo.scratchData.deviceAddress = getBufferDeviceAddress(scratchBuffer.buffer);
+
+			VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
+			accelerationStructureBuildRangeInfo.primitiveCount = primitiveCount;
+			const VkAccelerationStructureBuildRangeInfoKHR* accelerationBuildStructureRangeInfo = &accelerationStructureBuildRangeInfo;
+			vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &accelerationBuildGeometryInfo, &accelerationBuildStructureRangeInfo);
+
+			// Make the result visible to following builds and the ray tracing shaders
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+			memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		/*
+			The bottom level acceleration structure contains the scene's actual geometry (vertices, triangles)
+			As the geometry can be deformed at runtime, its vertices are taken from the deformed positions
+		*/
+		void createBottomLevel(VkQueue queue)
+		{
+			VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
+			VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
+			vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(deform.positions.buffer);
+			indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(scene->indices.buffer);
+
+			bottomLevelPrimitiveCount = static_cast<uint32_t>(scene->indices.count) / 3;
+
+			bottomLevelGeometry = vks::initializers::accelerationStructureGeometryKHR();
+			bottomLevelGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+			bottomLevelGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+			bottomLevelGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+			bottomLevelGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+			bottomLevelGeometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
+			bottomLevelGeometry.geometry.triangles.maxVertex = scene->vertices.count;
+			bottomLevelGeometry.geometry.triangles.vertexStride = sizeof(glm::vec4);
+			bottomLevelGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+			bottomLevelGeometry.geometry.triangles.indexData = indexBufferDeviceAddress;
+
+			createAccelerationStructure(bottomLevel, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, bottomLevelGeometry, bottomLevelPrimitiveCount, bottomLevelScratchBuffer);
+
+			// Initialize the positions with the undeformed geometry and build the acceleration structure
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			deformGeometry(commandBuffer, 0.0f, 0.0f);
+			buildAccelerationStructure(commandBuffer, bottomLevel, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, bottomLevelGeometry, bottomLevelPrimitiveCount, bottomLevelScratchBuffer, false);
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		}
+
+		/*
+			Write the scene instance with its current transform to the (persistently mapped) instance buffer
+		*/
+		void updateInstance(float time)
+		{
+			glm::mat4 transform = glm::mat4(1.0f);
+			if (animateInstance) {
+				transform = glm::rotate(transform, glm::radians(sin(glm::radians(time * 360.0f)) * 20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			}
+			// VkTransformMatrixKHR is a row-major 3x4 matrix, so the first three rows of the (column-major) transposed matrix are copied
+			glm::mat4 transposed = glm::transpose(transform);
+
+			VkAccelerationStructureInstanceKHR instance{};
+			memcpy(&instance.transform, &transposed, sizeof(VkTransformMatrixKHR));
+			instance.instanceCustomIndex = 0;
+			instance.mask = 0xFF;
+			instance.instanceShaderBindingTableRecordOffset = 0;
+			instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.accelerationStructureReference = bottomLevel.deviceAddress;
+			memcpy(instancesBuffer.mapped, &instance, sizeof(VkAccelerationStructureInstanceKHR));
+		}
+
+		/*
+			The top level acceleration structure contains the scene's object instance
+			It's refit each frame when the instance moves or the bottom level structure changes
+		*/
+		void createTopLevel(VkQueue queue)
+		{
+			// Buffer for instance data, host visible so it can be updated each frame
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&instancesBuffer,
+				sizeof(VkAccelerationStructureInstanceKHR)));
+			VK_CHECK_RESULT(instancesBuffer.map());
+			updateInstance(0.0f);
+
+			VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
+			instanceDataDeviceAddress.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
+
+			topLevelGeometry = vks::initializers::accelerationStructureGeometryKHR();
+			topLevelGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+			topLevelGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+			topLevelGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+			topLevelGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+			topLevelGeometry.geometry.instances.data = instanceDataDeviceAddress;
+
+			createAccelerationStructure(topLevel, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, topLevelGeometry, 1, topLevelScratchBuffer);
+
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			buildAccelerationStructure(commandBuffer, topLevel, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, topLevelGeometry, 1, topLevelScratchBuffer, false);
+			vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		}
+	};
+}
@@ -6,7 +6,8 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
-#include <glm/glm.hpp>
+#pragma once
+
 #include <glm/glm.hpp>
 
 #include "vulkan/vulkan.h"
@@ -20,12 +21,25 @@ namespace vks
 	class HeightMap
 	{
 	private:
-		uint16_t *heightdata;
-		uint32_t dim;
-		uint32_t scale;
+		uint16_t *heightdata = nullptr;
+		uint32_t dim = 0;
+		uint32_t scale = 1;
 
 		vks::VulkanDevice *device = nullptr;
 		VkQueue copyQueue = VK_NULL_HANDLE;
+
+		// Raw height value with mirrored addressing
+		float getTexelMirrored(int32_t x, int32_t y) const
+		{
+			const int32_t period = (int32_t)dim * 2;
+			x %= period;
+			y %= period;
+			if (x < 0) x += period;
+			if (y < 0) y += period;
+			if (x >= (int32_t)dim) x = period - 1 - x;
+			if (y >= (int32_t)dim) y = period - 1 - y;
+			return (float)heightdata[x + y * dim];
+		}
 	public:
 		enum Topology { topologyTriangles, topologyQuads };
 
@@ -67,27 +81,56 @@ namespace vks
 			return *(heightdata + (rpos.x + rpos.y * dim) * scale) / 65535.0f * heightScale;
 		}
 
+		uint32_t getDimension() const
+		{
+			return dim;
+		}
+
+		/**
+		* Bilinearly filtered height at the given normalized coordinates
+		*
+		* @note Coordinates outside of [0..1] are mirrored, matching a sampler with VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT
+		* @note Only reads the height data, so it's safe to call from multiple threads
+		*/
+		float sample(float u, float v) const
+		{
+			// Texel centers are at half texel offsets, same as on the GPU
+			const float tx = u * (float)dim - 0.5f;
+			const float ty = v * (float)dim - 0.5f;
+			const float fx = std::floor(tx);
+			const float fy = std::floor(ty);
+			const int32_t x = (int32_t)fx;
+			const int32_t y = (int32_t)fy;
+			const float wx = tx - fx;
+			const float wy = ty - fy;
+			const float h00 = getTexelMirrored(x, y);
+			const float h10 = getTexelMirrored(x + 1, y);
+			const float h01 = getTexelMirrored(x, y + 1);
+			const float h11 = getTexelMirrored(x + 1, y + 1);
+			const float h0 = h00 + (h10 - h00) * wx;
+			const float h1 = h01 + (h11 - h01) * wx;
+			return (h0 + (h1 - h0) * wy) / 65535.0f * heightScale;
+		}
+
+		/** @brief Load the 16 bit height data from a single channel KTX file without generating any geometry */
 #if defined(__ANDROID__)
-		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology, AAssetManager* assetManager)
+		void loadHeightData(const std::string filename, AAssetManager* assetManager)
 #else
-		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology)
+		void loadHeightData(const std::string filename)
 #endif
 		{
-			assert(device);
-			assert(copyQueue != VK_NULL_HANDLE);
-
 			ktxResult result;
 			ktxTexture* ktxTexture;
 #if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+			AAsset* asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_STREAMING);
 			assert(asset);
 			size_t size = AAsset_getLength(asset);
 			assert(size > 0);
-			void *textureData = malloc(size);
+			ktx_uint8_t *textureData = new ktx_uint8_t[size];
 			AAsset_read(asset, textureData, size);
 			AAsset_close(asset);
-			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-			free(textureData);
+			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+			delete[] textureData;
 #else
 			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
 #endif
@@ -95,10 +138,27 @@ namespace vks
 			ktx_size_t ktxSize = ktxTexture_GetImageSize(ktxTexture, 0);
 			ktx_uint8_t* ktxImage = ktxTexture_GetData(ktxTexture);
 			dim = ktxTexture->baseWidth;
+			delete[] heightdata;
 			heightdata = new uint16_t[dim * dim];
 			memcpy(heightdata, ktxImage, ktxSize);
-			this->scale = dim / patchsize;
 			ktxTexture_Destroy(ktxTexture);
+		}
+
+#if defined(__ANDROID__)
+		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology, AAssetManager* assetManager)
+#else
+		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology)
+#endif
+		{
+			assert(device);
+			assert(copyQueue != VK_NULL_HANDLE);
+
+#if defined(__ANDROID__)
+			loadHeightData(filename, assetManager);
+#else
+			loadHeightData(filename);
+#endif
+			this->scale = dim / patchsize;
 
 			// Generate vertices
 			Vertex * vertices = new Vertex[patchsize * patchsize * 4];
@@ -0,0 +1,264 @@
+/*
+* KTX2 texture file reader
+*
+* Reads KTX2 container files with native Vulkan formats, including Zstd and zlib supercompressed mip levels
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanKTX2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// zlib streams are inflated with stb_image's decoder (implementation is part of the glTF loader)
+#include "stb_image.h"
+
+#if defined(VKS_ENABLE_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace vks
+{
+	const uint8_t KTX2File::identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	static uint64_t gcd(uint64_t a, uint64_t b)
+	{
+		while (b != 0) {
+			const uint64_t t = a % b;
+			a = b;
+			b = t;
+		}
+		return a;
+	}
+
+	bool KTX2File::isKTX2File(const std::string& filename)
+	{
+		if (filename.size() > 5 && filename.substr(filename.size() - 5) == ".ktx2") {
+			return true;
+		}
+#if !defined(__ANDROID__)
+		uint8_t fileIdentifier[12] = {};
+		std::ifstream is(filename, std::ios::binary);
+		if (is.is_open() && is.read((char*)fileIdentifier, sizeof(fileIdentifier))) {
+			return memcmp(fileIdentifier, identifier, sizeof(identifier)) == 0;
+		}
+#endif
+		return false;
+	}
+
+	bool KTX2File::hasNativeFormat(const std::string& filename)
+	{
+		Header header{};
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			return false;
+		}
+		const bool headerRead = (AAsset_read(asset, &header, sizeof(Header)) == sizeof(Header));
+		AAsset_close(asset);
+#else
+		std::ifstream is(filename, std::ios::binary);
+		const bool headerRead = is.is_open() && (bool)is.read((char*)&header, sizeof(Header));
+#endif
+		return headerRead && (memcmp(header.identifier, identifier, sizeof(identifier)) == 0) && (header.vkFormat != VK_FORMAT_UNDEFINED) && (header.supercompressionScheme != SUPERCOMPRESSION_BASISLZ);
+	}
+
+	/**
+	* Open a KTX2 file and read its header and level index
+	*
+	* @param filename File to open
+	*
+	* @return True if the file is a valid KTX2 file that can be uploaded without transcoding
+	*/
+	bool KTX2File::open(const std::string& filename)
+	{
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			return false;
+		}
+		fileData.resize(AAsset_getLength(asset));
+		AAsset_read(asset, fileData.data(), fileData.size());
+		AAsset_close(asset);
+#else
+		file.open(filename, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+#endif
+		Header header{};
+		if (!read(0, sizeof(Header), &header) || (memcmp(header.identifier, identifier, sizeof(identifier)) != 0)) {
+			std::cerr << "Error: " << filename << " is not a valid KTX2 file" << "\n";
+			return false;
+		}
+
+		// Formats that need transcoding (e.g. Basis Universal) are stored with an undefined format
+		if ((header.vkFormat == VK_FORMAT_UNDEFINED) || (header.supercompressionScheme == SUPERCOMPRESSION_BASISLZ)) {
+			std::cerr << "Error: " << filename << " requires Basis Universal transcoding, which is not supported" << "\n";
+			return false;
+		}
+
+		format = (VkFormat)header.vkFormat;
+		width = header.pixelWidth;
+		height = std::max(header.pixelHeight, 1u);
+		depth = std::max(header.pixelDepth, 1u);
+		layerCount = std::max(header.layerCount, 1u);
+		faceCount = header.faceCount;
+		levelCount = std::max(header.levelCount, 1u);
+		supercompressionScheme = header.supercompressionScheme;
+
+		// The level index directly follows the header
+		levels.resize(levelCount);
+		for (uint32_t i = 0; i < levelCount; i++) {
+			uint64_t levelIndex[3];
+			if (!read(sizeof(Header) + i * sizeof(levelIndex), sizeof(levelIndex), levelIndex)) {
+				return false;
+			}
+			levels[i].byteOffset = levelIndex[0];
+			levels[i].byteLength = levelIndex[1];
+			levels[i].uncompressedByteLength = (supercompressionScheme == SUPERCOMPRESSION_NONE) ? levelIndex[1] : levelIndex[2];
+		}
+
+		// Buffer to image copies require offsets that are a multiple of both the texel block size and four
+		// The block size is stored in the first plane of the data format descriptor, which is zero for supercompressed files
+		// Each level's size is a multiple of the block size, so their greatest common divisor can be used instead
+		uint64_t texelBlockSize = 0;
+		if (header.dfdByteLength >= 24) {
+			uint8_t bytesPlane0 = 0;
+			if (!read(header.dfdByteOffset + 20, sizeof(bytesPlane0), &bytesPlane0)) {
+				return false;
+			}
+			texelBlockSize = bytesPlane0;
+		}
+		if (texelBlockSize == 0) {
+			for (const Level& level : levels) {
+				texelBlockSize = gcd(texelBlockSize, level.uncompressedByteLength);
+			}
+		}
+		const uint64_t alignment = std::max<uint64_t>(texelBlockSize, 1) / gcd(std::max<uint64_t>(texelBlockSize, 1), 4) * 4;
+
+		// Levels are placed in the target buffer from largest to smallest, with offsets that are valid for buffer to image copies
+		VkDeviceSize targetOffset = 0;
+		for (Level& level : levels) {
+			level.targetOffset = targetOffset;
+			targetOffset += (level.uncompressedByteLength + alignment - 1) / alignment * alignment;
+		}
+		return true;
+	}
+
+	void KTX2File::close()
+	{
+#if defined(__ANDROID__)
+		fileData.clear();
+		fileData.shrink_to_fit();
+#else
+		file.close();
+#endif
+	}
+
+	/** @brief Returns the size required for the uncompressed image data of all levels */
+	VkDeviceSize KTX2File::getDataSize() const
+	{
+		return levels.empty() ? 0 : levels.back().targetOffset + levels.back().uncompressedByteLength;
+	}
+
+	/** @brief Returns the offset of an image in the target buffer */
+	VkDeviceSize KTX2File::getImageOffset(uint32_t level, uint32_t layer, uint32_t face) const
+	{
+		// Level data is stored layer by layer, with all faces of a layer stored consecutively
+		const VkDeviceSize imageSize = levels[level].uncompressedByteLength / (layerCount * faceCount);
+		return levels[level].targetOffset + (layer * faceCount + face) * imageSize;
+	}
+
+	bool KTX2File::read(uint64_t offset, uint64_t size, void* target)
+	{
+#if defined(__ANDROID__)
+		if (offset + size > fileData.size()) {
+			return false;
+		}
+		memcpy(target, fileData.data() + offset, size);
+		return true;
+#else
+		std::lock_guard<std::mutex> lock(fileMutex);
+		file.seekg(offset);
+		return (bool)file.read((char*)target, size);
+#endif
+	}
+
+	bool KTX2File::decompressLevel(uint32_t level, uint8_t* target)
+	{
+		const Level& levelInfo = levels[level];
+		std::vector<uint8_t> compressedData(levelInfo.byteLength);
+		if (!read(levelInfo.byteOffset, levelInfo.byteLength, compressedData.data())) {
+			return false;
+		}
+		switch (supercompressionScheme) {
+		case SUPERCOMPRESSION_ZSTD:
+		{
+#if defined(VKS_ENABLE_ZSTD)
+			size_t result = ZSTD_decompress(target, levelInfo.uncompressedByteLength, compressedData.data(), compressedData.size());
+			return !ZSTD_isError(result) && (result == levelInfo.uncompressedByteLength);
+#else
+			std::cerr << "Error: Zstd supercompressed KTX2 files require building with USE_ZSTD" << "\n";
+			return false;
+#endif
+		}
+		case SUPERCOMPRESSION_ZLIB:
+		{
+			int result = stbi_zlib_decode_buffer((char*)target, (int)levelInfo.uncompressedByteLength, (const char*)compressedData.data(), (int)compressedData.size());
+			return result == (int)levelInfo.uncompressedByteLength;
+		}
+		default:
+			return false;
+		}
+	}
+
+	/**
+	* Read the image data of all levels into the target memory (e.g. a mapped staging buffer)
+	*
+	* @param target Pointer to the memory the image data is read into, image offsets match getImageOffset
+	* @param targetSize Size of the target memory, needs to be at least getDataSize
+	*
+	* @return True if all levels have been read and decompressed
+	*/
+	bool KTX2File::loadImageData(uint8_t* target, VkDeviceSize targetSize)
+	{
+		assert(targetSize >= getDataSize());
+
+		if (supercompressionScheme == SUPERCOMPRESSION_NONE) {
+			for (uint32_t i = 0; i < levelCount; i++) {
+				if (!read(levels[i].byteOffset, levels[i].byteLength, target + levels[i].targetOffset)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Each level is compressed separately, so levels are decompressed in parallel
+		// Workers pick the next level from a shared counter, starting with the largest ones
+		std::atomic<uint32_t> nextLevel(0);
+		std::atomic<bool> success(true);
+		auto worker = [&]() {
+			uint32_t level;
+			while ((level = nextLevel++) < levelCount) {
+				if (!decompressLevel(level, target + levels[level].targetOffset)) {
+					success = false;
+				}
+			}
+		};
+		const uint32_t workerCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), levelCount);
+		std::vector<std::thread> workers;
+		for (uint32_t i = 1; i < workerCount; i++) {
+			workers.push_back(std::thread(worker));
+		}
+		worker();
+		for (auto& thread : workers) {
+			thread.join();
+		}
+		return success;
+	}
+}
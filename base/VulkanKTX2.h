@@ -0,0 +1,105 @@
+/*
+* KTX2 texture file reader
+*
+* Reads KTX2 container files with native Vulkan formats, including Zstd and zlib supercompressed mip levels
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+#if defined(__ANDROID__)
+#	include <android/asset_manager.h>
+#endif
+
+namespace vks
+{
+	/**
+	* @brief Reads the header and level index of a KTX2 file and decompresses its mip levels into a target buffer
+	* @note Supercompressed levels are decompressed in parallel on worker threads, straight into the target memory
+	*/
+	class KTX2File
+	{
+	public:
+		enum SupercompressionScheme
+		{
+			SUPERCOMPRESSION_NONE = 0,
+			SUPERCOMPRESSION_BASISLZ = 1,
+			SUPERCOMPRESSION_ZSTD = 2,
+			SUPERCOMPRESSION_ZLIB = 3
+		};
+
+		struct Level
+		{
+			/** @brief Location of the (possibly supercompressed) level data in the file */
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+			/** @brief Offset of the uncompressed level data in the target buffer */
+			VkDeviceSize targetOffset;
+		};
+
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t depth = 0;
+		uint32_t layerCount = 0;
+		uint32_t faceCount = 0;
+		uint32_t levelCount = 0;
+		uint32_t supercompressionScheme = SUPERCOMPRESSION_NONE;
+		std::vector<Level> levels;
+
+		/** @brief Returns true if the file starts with the KTX2 identifier */
+		static bool isKTX2File(const std::string& filename);
+		/** @brief Returns true if the file is a KTX2 file with a native Vulkan format that can be loaded without transcoding */
+		static bool hasNativeFormat(const std::string& filename);
+
+		bool open(const std::string& filename);
+		void close();
+		VkDeviceSize getDataSize() const;
+		VkDeviceSize getImageOffset(uint32_t level, uint32_t layer, uint32_t face) const;
+		bool loadImageData(uint8_t* target, VkDeviceSize targetSize);
+
+	private:
+		struct Header
+		{
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static const uint8_t identifier[12];
+
+#if defined(__ANDROID__)
+		std::vector<uint8_t> fileData;
+#else
+		std::ifstream file;
+#endif
+		std::mutex fileMutex;
+
+		bool read(uint64_t offset, uint64_t size, void* target);
+		bool decompressLevel(uint32_t level, uint8_t* target);
+	};
+}
@@ -0,0 +1,317 @@
+/*
+* Single pass compute mip chain generator
+*
+* Generates up to 12 mip levels of a 2D image in a single compute dispatch instead of one blit per level
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Generates the mip chain of an image with a single compute dispatch (shaders/base/mipgen.comp)
+	* @note Images need to be created with VK_IMAGE_USAGE_STORAGE_BIT (see getImageUsage) and sRGB images with VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT (see getImageCreateFlags)
+	* @note Requires the shaderStorageImageWriteWithoutFormat feature to be enabled
+	*/
+	class MipGenerator
+	{
+	public:
+		enum Flags {
+			None = 0x0,
+			/** @brief Image contains normals encoded to [0..1], normals are renormalized after filtering */
+			NormalMap = 0x2
+		};
+
+		/** @brief Max. number of levels (including the base level), limits the base level to 4096x4096 */
+		static const uint32_t maxMipLevels = 13;
+
+	private:
+		// Enum constants are never odr-used, so unlike static const members they need no out-of-class definition
+		enum : uint32_t {
+			flagSRGB = 0x1,
+			maxGeneratedLevels = maxMipLevels - 1,
+			// Number of images that can be processed before releaseResources needs to be called
+			maxImages = 64
+		};
+
+		struct PushConstants {
+			int32_t width;
+			int32_t height;
+			uint32_t mipCount;
+			uint32_t groupCountX;
+			uint32_t groupCount;
+			uint32_t flags;
+		};
+
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		vks::Buffer mip6Buffer;
+		vks::Buffer counterBuffer;
+		bool counterCleared = false;
+		uint32_t imageCount = 0;
+		// Image views for the images processed since the last call to releaseResources
+		std::vector<VkImageView> imageViews;
+
+		static VkFormat getStorageFormat(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				return VK_FORMAT_R8G8B8A8_UNORM;
+			case VK_FORMAT_B8G8R8A8_SRGB:
+				return VK_FORMAT_B8G8R8A8_UNORM;
+			case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+				return VK_FORMAT_A8B8G8R8_UNORM_PACK32;
+			default:
+				return format;
+			}
+		}
+
+		static bool isSRGB(VkFormat format)
+		{
+			return getStorageFormat(format) != format;
+		}
+
+		VkImageView createView(VkImage image, VkFormat format, uint32_t baseMipLevel)
+		{
+			VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+			viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCreateInfo.format = format;
+			viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, 1, 0, 1 };
+			viewCreateInfo.image = image;
+			VkImageView view;
+			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &viewCreateInfo, nullptr, &view));
+			imageViews.push_back(view);
+			return view;
+		}
+
+	public:
+		/** @brief Image usage flags required by the generator */
+		static VkImageUsageFlags getImageUsage()
+		{
+			return VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+		}
+
+		/** @brief Image create flags required by the generator for the given format (sRGB images are written through a UNORM view) */
+		static VkImageCreateFlags getImageCreateFlags(VkFormat format)
+		{
+			return isSRGB(format) ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0;
+		}
+
+		/**
+		* Create the compute pipeline and the buffers used for the single pass generation
+		*
+		* @param vulkanDevice Device to create the resources on
+		* @param shaderFile Path to the SPIR-V of the mip generation compute shader (base/mipgen.comp.spv)
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, const std::string& shaderFile)
+		{
+			this->vulkanDevice = vulkanDevice;
+			VkDevice device = vulkanDevice->logicalDevice;
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, maxGeneratedLevels),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxImages),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxImages * maxGeneratedLevels),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxImages * 2),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxImages);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+#if defined(__ANDROID__)
+			shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device);
+#else
+			shaderModule = vks::tools::loadShader(shaderFile.c_str(), device);
+#endif
+			VkPipelineShaderStageCreateInfo shaderStage = {};
+			shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			shaderStage.module = shaderModule;
+			shaderStage.pName = "main";
+			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			computePipelineCreateInfo.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+
+			// The base level is read with texel fetches, so filtering settings don't matter
+			VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+			samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+			samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+			samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler));
+
+			// One level 6 texel per work group, a 4096x4096 base level results in 64x64 work groups
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mip6Buffer, 64 * 64 * sizeof(float) * 4));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &counterBuffer, sizeof(uint32_t)));
+		}
+
+		/** @brief Returns true if the mip chain of an image with the given format and size can be generated */
+		bool isSupported(VkFormat format, uint32_t width, uint32_t height)
+		{
+			if (!vulkanDevice->enabledFeatures.shaderStorageImageWriteWithoutFormat) {
+				return false;
+			}
+			if ((width > (1u << (maxMipLevels - 1))) || (height > (1u << (maxMipLevels - 1)))) {
+				return false;
+			}
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(vulkanDevice->physicalDevice, getStorageFormat(format), &formatProperties);
+			return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+		}
+
+		/**
+		* Record the generation of all mip levels of an image from its base level
+		*
+		* @param commandBuffer Command buffer to record to
+		* @param image Image with the base level filled
+		* @param format Format of the image, sRGB formats are filtered in linear space
+		* @param width Width of the base level
+		* @param height Height of the base level
+		* @param mipLevels Number of mip levels of the image
+		* @param oldLayout Layout of the base level, the remaining levels' contents are discarded
+		* @param newLayout Layout all mip levels will be transitioned to
+		* @param (Optional) flags Filtering flags (e.g. NormalMap)
+		*
+		* @note Resources used for the dispatch need to be freed with releaseResources once the command buffer has finished executing
+		*/
+		void generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t flags = None)
+		{
+			assert(isSupported(format, width, height));
+			assert(imageCount < maxImages);
+			imageCount++;
+			if (mipLevels < 2) {
+				return;
+			}
+			const uint32_t mipCount = std::min(mipLevels - 1, static_cast<uint32_t>(maxGeneratedLevels));
+
+			// Descriptors for the base level (sampled) and all generated levels (storage, UNORM for sRGB images)
+			VkDescriptorSet descriptorSet;
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &descriptorSet));
+			VkDescriptorImageInfo sourceDescriptor = vks::initializers::descriptorImageInfo(sampler, createView(image, format, 0), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			std::array<VkDescriptorImageInfo, maxGeneratedLevels> mipDescriptors;
+			for (uint32_t i = 0; i < maxGeneratedLevels; i++) {
+				// Unused array elements point to the last level, they are never written
+				if (i < mipCount) {
+					mipDescriptors[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, createView(image, getStorageFormat(format), i + 1), VK_IMAGE_LAYOUT_GENERAL);
+				} else {
+					mipDescriptors[i] = mipDescriptors[mipCount - 1];
+				}
+			}
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sourceDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, mipDescriptors.data(), maxGeneratedLevels),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &mip6Buffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &counterBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			// The atomic counter is reset by the shader after each dispatch, so it only needs to be cleared once
+			if (!counterCleared) {
+				vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+				counterCleared = true;
+			}
+			// Previous dispatches use the same counter and level 6 buffers
+			std::array<VkBufferMemoryBarrier, 2> bufferBarriers;
+			bufferBarriers[0] = vks::initializers::bufferMemoryBarrier();
+			bufferBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarriers[0].buffer = counterBuffer.buffer;
+			bufferBarriers[0].size = VK_WHOLE_SIZE;
+			bufferBarriers[1] = bufferBarriers[0];
+			bufferBarriers[1].buffer = mip6Buffer.buffer;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+
+			// Base level is sampled, all other levels are written as storage images
+			// Compared to the blit path, this requires only one set of barriers for the whole mip chain
+			VkImageSubresourceRange baseRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			VkImageSubresourceRange mipRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, 1 };
+			if (oldLayout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+				vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, oldLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, baseRange);
+			}
+			vks::tools::insertImageMemoryBarrier(commandBuffer, image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, mipRange);
+
+			PushConstants pushConstants{};
+			pushConstants.width = (int32_t)width;
+			pushConstants.height = (int32_t)height;
+			pushConstants.mipCount = mipCount;
+			pushConstants.groupCountX = (width + 63) / 64;
+			pushConstants.groupCount = pushConstants.groupCountX * ((height + 63) / 64);
+			pushConstants.flags = flags | (isSRGB(format) ? static_cast<uint32_t>(flagSRGB) : 0u);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, pushConstants.groupCountX, (height + 63) / 64, 1);
+
+			if (newLayout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+				vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, newLayout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, baseRange);
+			}
+			vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, newLayout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, mipRange);
+		}
+
+		/** @brief Free the image views and descriptor sets used by previous calls to generate (command buffers using them must have finished executing) */
+		void releaseResources()
+		{
+			for (auto view : imageViews) {
+				vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
+			}
+			imageViews.clear();
+			if (descriptorPool != VK_NULL_HANDLE) {
+				VK_CHECK_RESULT(vkResetDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, 0));
+			}
+			imageCount = 0;
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			releaseResources();
+			VkDevice device = vulkanDevice->logicalDevice;
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vkDestroyShaderModule(device, shaderModule, nullptr);
+			vkDestroySampler(device, sampler, nullptr);
+			mip6Buffer.destroy();
+			counterBuffer.destroy();
+			vulkanDevice = nullptr;
+		}
+	};
+}
@@ -12,6 +12,7 @@
 #include "vulkanexamplebase.h"
 #include "VulkanTools.h"
 #include "VulkanDevice.h"
+#include "VulkanAccelerationStructureBuilder.hpp"
 
 class VulkanRaytracingSample : public VulkanExampleBase
 {
@@ -49,12 +50,10 @@ public:
 	};
 
 	// Holds information for a ray tracing acceleration structure
-	struct AccelerationStructure {
-		VkAccelerationStructureKHR handle;
-		uint64_t deviceAddress = 0;
-		VkDeviceMemory memory;
-		VkBuffer buffer;
-	};
+	using AccelerationStructure = vks::AccelerationStructure;
+
+	// Batches bottom level acceleration structure builds and compacts them, structures built with it are owned (and released) by the builder
+	vks::AccelerationStructureBuilder accelerationStructureBuilder;
 
 	// Holds information for a storage image that the ray tracing shaders output to
 	struct StorageImage {
@@ -73,6 +72,8 @@ public:
 	// Set to true, to denote that the sample only uses ray queries (changes extension and render pass handling)
 	bool rayQueryOnly = false;
 
+	~VulkanRaytracingSample();
+
 	void enableExtensions();
 	ScratchBuffer createScratchBuffer(VkDeviceSize size);
 	void deleteScratchBuffer(ScratchBuffer& scratchBuffer);
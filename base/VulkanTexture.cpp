@@ -28,7 +28,108 @@ namespace vks
 		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
 	}
 
-	ktxResult Texture::loadKTXFile(std::string filename, ktxTexture **target)
+	Texture::LoadStatistics Texture::loadStatistics;
+
+	namespace
+	{
+		/*
+			Texture file opened by the loaders, either a KTX file read with libktx or a KTX2 file
+			Only the header and level index are read on open, image data is read into the staging buffer later on
+		*/
+		class TextureFile
+		{
+		private:
+			vks::Texture *texture;
+			ktxTexture *ktx = nullptr;
+			KTX2File ktx2File;
+		public:
+			uint32_t width, height;
+			uint32_t levelCount, layerCount;
+
+			TextureFile(vks::Texture *texture, std::string filename, VkFormat format) : texture(texture)
+			{
+				if (KTX2File::isKTX2File(filename))
+				{
+					if (!ktx2File.open(filename))
+					{
+						vks::tools::exitFatal("Could not load texture from " + filename, -1);
+					}
+					// KTX2 files store their Vulkan format, the image data can't be uploaded as a different format
+					if (ktx2File.format != format)
+					{
+						vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file's format (" + std::to_string(ktx2File.format) + ") does not match the requested format (" + std::to_string(format) + ").", -1);
+					}
+					width = ktx2File.width;
+					height = ktx2File.height;
+					levelCount = ktx2File.levelCount;
+					layerCount = ktx2File.layerCount;
+				}
+				else
+				{
+					ktxResult result = texture->loadKTXFile(filename, &ktx, false);
+					assert(result == KTX_SUCCESS);
+					width = ktx->baseWidth;
+					height = ktx->baseHeight;
+					levelCount = ktx->numLevels;
+					layerCount = ktx->numLayers;
+				}
+			}
+
+			~TextureFile()
+			{
+				if (ktx)
+				{
+					ktxTexture_Destroy(ktx);
+				}
+			}
+
+			VkDeviceSize getDataSize()
+			{
+				return ktx ? ktxTexture_GetSize(ktx) : ktx2File.getDataSize();
+			}
+
+			VkDeviceSize getImageOffset(uint32_t level, uint32_t layer, uint32_t face)
+			{
+				if (ktx)
+				{
+					ktx_size_t offset;
+					KTX_error_code result = ktxTexture_GetImageOffset(ktx, level, layer, face, &offset);
+					assert(result == KTX_SUCCESS);
+					return offset;
+				}
+				return ktx2File.getImageOffset(level, layer, face);
+			}
+
+			void loadImageData(uint8_t *target, VkDeviceSize targetSize)
+			{
+				if (ktx)
+				{
+					ktxResult result = texture->loadKTXImageData(ktx, target, targetSize);
+					assert(result == KTX_SUCCESS);
+				}
+				else
+				{
+					if (!ktx2File.loadImageData(target, targetSize))
+					{
+						vks::tools::exitFatal("Could not read KTX2 image data", -1);
+					}
+					Texture::loadStatistics.textureCount++;
+					Texture::loadStatistics.bytes += ktx2File.getDataSize();
+				}
+			}
+		};
+	}
+
+	/**
+	* Open a KTX file
+	*
+	* @param filename File to load
+	* @param target Pointer to the ktxTexture object to create
+	* @param (Optional) loadImageData If false, only the header and the level index are read and the image data needs to be read with loadKTXImageData (defaults to true)
+	*
+	* @note On Android the image data is always loaded, as assets are read into memory as a whole
+	*/
+	ktxResult Texture::loadKTXFile(std::string filename, ktxTexture **target, bool loadImageData)
 	{
 		ktxResult result = KTX_SUCCESS;
 #if defined(__ANDROID__)
@@ -47,11 +148,72 @@ namespace vks
 		if (!vks::tools::fileExists(filename)) {
 			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
 		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);			
+		result = ktxTexture_CreateFromNamedFile(filename.c_str(), loadImageData ? KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT : KTX_TEXTURE_CREATE_NO_FLAGS, target);
 #endif		
 		return result;
 	}
 
+	/**
+	* Read the image data of a KTX file opened with loadKTXFile directly into the target memory (e.g. a mapped staging buffer)
+	*
+	* @param ktxTexture Texture opened with loadKTXFile
+	* @param target Pointer to the memory the image data is read into, image offsets match ktxTexture_GetImageOffset
+	* @param targetSize Size of the target memory, needs to be at least ktxTexture_GetSize
+	*/
+	ktxResult Texture::loadKTXImageData(ktxTexture *ktxTexture, uint8_t *target, VkDeviceSize targetSize)
+	{
+		const ktx_size_t textureSize = ktxTexture_GetSize(ktxTexture);
+		assert(targetSize >= textureSize);
+		ktxResult result = KTX_SUCCESS;
+		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
+		if (ktxTextureData)
+		{
+			// Image data has already been loaded (e.g. from an Android asset)
+			memcpy(target, ktxTextureData, textureSize);
+		}
+		else
+		{
+			// Each mip level is read from the file straight to its final offset, without an intermediate copy
+			result = ktxTexture_LoadImageData(ktxTexture, target, (ktx_size_t)targetSize);
+		}
+		if (result == KTX_SUCCESS)
+		{
+			loadStatistics.textureCount++;
+			loadStatistics.bytes += textureSize;
+		}
+		return result;
+	}
+
+	/**
+	* Create a host visible staging buffer used as the source for texture image copies
+	*
+	* @param size Size of the staging buffer
+	* @param buffer Pointer to the buffer handle to create
+	* @param memory Pointer to the memory handle to allocate
+	* @param mapped Pointer that receives the mapped staging memory (unmapped when the memory is freed)
+	*/
+	void Texture::createStagingBuffer(VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, uint8_t **mapped)
+	{
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
+		bufferCreateInfo.size = size;
+		// This buffer is used as a transfer source for the buffer copy
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, buffer));
+
+		// Get memory requirements for the staging buffer (alignment, memory type bits)
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device->logicalDevice, *buffer, &memReqs);
+
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		// Get memory type index for a host visible buffer
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, memory));
+		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, *buffer, *memory, 0));
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, *memory, 0, VK_WHOLE_SIZE, 0, (void **)mapped));
+	}
+
 	/**
 	* Load a 2D texture including all mip levels
 	*
@@ -66,17 +228,17 @@ namespace vks
 	*/
 	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, bool forceLinear)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// Only the header and level index are read here, image data is read into the staging buffer later on
+		TextureFile textureFile(this, filename, format);
 
 		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
+		width = textureFile.width;
+		height = textureFile.height;
+		mipLevels = textureFile.levelCount;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		VkDeviceSize textureSize = textureFile.getDataSize();
 
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
@@ -97,50 +259,27 @@ namespace vks
 
 		if (useStaging)
 		{
-			// Create a host-visible staging buffer that contains the raw image data
+			// Create a host-visible staging buffer and read the image data from the file straight into it
 			VkBuffer stagingBuffer;
 			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = ktxTextureSize;
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-			// Copy texture data into staging buffer
 			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, ktxTextureData, ktxTextureSize);
-			vkUnmapMemory(device->logicalDevice, stagingMemory);
+			createStagingBuffer(textureSize, &stagingBuffer, &stagingMemory, &data);
+			textureFile.loadImageData(data, textureSize);
 
 			// Setup buffer copy regions for each mip level
 			std::vector<VkBufferImageCopy> bufferCopyRegions;
 
 			for (uint32_t i = 0; i < mipLevels; i++)
 			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-				assert(result == KTX_SUCCESS);
+				VkDeviceSize offset = textureFile.getImageOffset(i, 0, 0);
 
 				VkBufferImageCopy bufferCopyRegion = {};
 				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 				bufferCopyRegion.imageSubresource.mipLevel = i;
 				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-				bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
+				bufferCopyRegion.imageExtent.width = std::max(1u, textureFile.width >> i);
+				bufferCopyRegion.imageExtent.height = std::max(1u, textureFile.height >> i);
 				bufferCopyRegion.imageExtent.depth = 1;
 				bufferCopyRegion.bufferOffset = offset;
 
@@ -245,7 +384,8 @@ namespace vks
 			// like size and alignment
 			vkGetImageMemoryRequirements(device->logicalDevice, mappableImage, &memReqs);
 			// Set memory allocation size to required memory size
-			memAllocInfo.allocationSize = memReqs.size;
+			// The image data of all mip levels is read into the mapped memory, so the allocation needs to be large enough to hold it
+			memAllocInfo.allocationSize = std::max(memReqs.size, textureSize);
 
 			// Get memory type that can be mapped to host memory
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
@@ -270,10 +410,11 @@ namespace vks
 			vkGetImageSubresourceLayout(device->logicalDevice, mappableImage, &subRes, &subResLayout);
 
 			// Map image memory
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memAllocInfo.allocationSize, 0, &data));
 
-			// Copy image data into memory
-			memcpy(data, ktxTextureData, memReqs.size);
+			// Read the image data from the file straight into the mapped image memory
+			// Only the first mip level is used, as linear tiled images usually don't support mip maps
+			textureFile.loadImageData(static_cast<uint8_t*>(data), memAllocInfo.allocationSize);
 
 			vkUnmapMemory(device->logicalDevice, mappableMemory);
 
@@ -289,7 +430,7 @@ namespace vks
 			device->flushCommandBuffer(copyCmd, copyQueue);
 		}
 
-		ktxTexture_Destroy(ktxTexture);
+		loadStatistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 
 		// Create a default sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
@@ -510,49 +651,28 @@ namespace vks
 	*/
 	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// Only the header and level index are read here, image data is read into the staging buffer later on
+		TextureFile textureFile(this, filename, format);
 
 		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		layerCount = ktxTexture->numLayers;
-		mipLevels = ktxTexture->numLevels;
+		width = textureFile.width;
+		height = textureFile.height;
+		layerCount = textureFile.layerCount;
+		mipLevels = textureFile.levelCount;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		VkDeviceSize textureSize = textureFile.getDataSize();
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
-		// Create a host-visible staging buffer that contains the raw image data
+		// Create a host-visible staging buffer and read the image data from the file straight into it
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		// Copy texture data into staging buffer
 		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		createStagingBuffer(textureSize, &stagingBuffer, &stagingMemory, &data);
+		textureFile.loadImageData(data, textureSize);
 
 		// Setup buffer copy regions for each layer including all of its miplevels
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
@@ -561,17 +681,15 @@ namespace vks
 		{
 			for (uint32_t level = 0; level < mipLevels; level++)
 			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, layer, 0, &offset);
-				assert(result == KTX_SUCCESS);
+				VkDeviceSize offset = textureFile.getImageOffset(level, layer, 0);
 
 				VkBufferImageCopy bufferCopyRegion = {};
 				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 				bufferCopyRegion.imageSubresource.mipLevel = level;
 				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
 				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> level;
-				bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> level;
+				bufferCopyRegion.imageExtent.width = textureFile.width >> level;
+				bufferCopyRegion.imageExtent.height = textureFile.height >> level;
 				bufferCopyRegion.imageExtent.depth = 1;
 				bufferCopyRegion.bufferOffset = offset;
 
@@ -674,10 +792,11 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
 		// Clean up staging resources
-		ktxTexture_Destroy(ktxTexture);
 		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
+		loadStatistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
 	}
@@ -695,48 +814,27 @@ namespace vks
 	*/
 	void TextureCubeMap::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// Only the header and level index are read here, image data is read into the staging buffer later on
+		TextureFile textureFile(this, filename, format);
 
 		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
+		width = textureFile.width;
+		height = textureFile.height;
+		mipLevels = textureFile.levelCount;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		VkDeviceSize textureSize = textureFile.getDataSize();
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
-		// Create a host-visible staging buffer that contains the raw image data
+		// Create a host-visible staging buffer and read the image data from the file straight into it
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		// Copy texture data into staging buffer
 		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		createStagingBuffer(textureSize, &stagingBuffer, &stagingMemory, &data);
+		textureFile.loadImageData(data, textureSize);
 
 		// Setup buffer copy regions for each face including all of its mip levels
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
@@ -745,17 +843,15 @@ namespace vks
 		{
 			for (uint32_t level = 0; level < mipLevels; level++)
 			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, 0, face, &offset);
-				assert(result == KTX_SUCCESS);
+				VkDeviceSize offset = textureFile.getImageOffset(level, 0, face);
 
 				VkBufferImageCopy bufferCopyRegion = {};
 				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 				bufferCopyRegion.imageSubresource.mipLevel = level;
 				bufferCopyRegion.imageSubresource.baseArrayLayer = face;
 				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> level;
-				bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> level;
+				bufferCopyRegion.imageExtent.width = textureFile.width >> level;
+				bufferCopyRegion.imageExtent.height = textureFile.height >> level;
 				bufferCopyRegion.imageExtent.depth = 1;
 				bufferCopyRegion.bufferOffset = offset;
 
@@ -862,10 +958,11 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
 		// Clean up staging resources
-		ktxTexture_Destroy(ktxTexture);
 		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
+		loadStatistics.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
 	}
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <stdlib.h>
 #include <string>
@@ -20,6 +22,7 @@
 
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanKTX2.h"
 #include "VulkanTools.h"
 
 #if defined(__ANDROID__)
@@ -42,9 +45,25 @@ class Texture
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
 
+	/** @brief Accumulated statistics for all textures loaded from files, timings include reading the file and uploading it to the GPU */
+	struct LoadStatistics
+	{
+		uint32_t textureCount = 0;
+		uint64_t bytes        = 0;
+		double   milliseconds = 0.0;
+		/** @brief Returns the load throughput (file read and upload) in MB/s */
+		double throughput() const
+		{
+			return (milliseconds > 0.0) ? ((double)bytes / (1024.0 * 1024.0)) / (milliseconds / 1000.0) : 0.0;
+		}
+	};
+	static LoadStatistics loadStatistics;
+
 	void      updateDescriptor();
 	void      destroy();
-	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+	ktxResult loadKTXFile(std::string filename, ktxTexture **target, bool loadImageData = true);
+	ktxResult loadKTXImageData(ktxTexture *ktxTexture, uint8_t *target, VkDeviceSize targetSize);
+	void      createStagingBuffer(VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, uint8_t **mapped);
 };
 
 class Texture2D : public Texture
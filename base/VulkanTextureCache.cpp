@@ -0,0 +1,310 @@
+/*
+* On-disk cache for textures generated at runtime
+*
+* Stores the contents of generated images (e.g. pre-filtered environment maps) as KTX files and uploads them on subsequent runs
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace vks
+{
+	// FNV-1a offset basis
+	const uint64_t TextureCache::hashSeed = 0xcbf29ce484222325ull;
+
+	/** @brief Hashes a block of memory (FNV-1a), pass the result of a previous call as the seed to combine hashes */
+	uint64_t TextureCache::hash(const void* data, size_t size, uint64_t seed)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		uint64_t result = seed;
+		for (size_t i = 0; i < size; i++) {
+			result ^= bytes[i];
+			result *= 0x100000001b3ull;
+		}
+		return result;
+	}
+
+	/** @brief Hashes the contents of a file, e.g. the source image or the shaders used for generating a texture */
+	uint64_t TextureCache::hashFile(const std::string& filename, uint64_t seed)
+	{
+		std::ifstream is(filename, std::ios::binary | std::ios::in);
+		if (!is.is_open()) {
+			// Still hash the name, so a missing file doesn't collide with an empty one
+			return hash(filename.data(), filename.size(), seed);
+		}
+		uint64_t result = seed;
+		std::vector<char> buffer(64 * 1024);
+		while (is.read(buffer.data(), buffer.size()) || is.gcount() > 0) {
+			result = hash(buffer.data(), static_cast<size_t>(is.gcount()), result);
+		}
+		return result;
+	}
+
+	/**
+	* Prepare the cache for use
+	*
+	* @param device Device used for uploading and reading back cached images
+	* @param queue Queue used for uploading and reading back cached images
+	* @param directory Directory the cached files are stored in, created on the first store
+	*/
+	void TextureCache::create(vks::VulkanDevice* device, VkQueue queue, const std::string& directory)
+	{
+		this->device = device;
+		this->queue = queue;
+		this->directory = directory;
+		if (!this->directory.empty() && (this->directory.back() != '/')) {
+			this->directory += '/';
+		}
+#if defined(__ANDROID__)
+		enabled = false;
+#endif
+	}
+
+	std::string TextureCache::getFilename(const std::string& name, uint64_t key) const
+	{
+		std::stringstream ss;
+		ss << directory << name << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".ktx";
+		return ss.str();
+	}
+
+	bool TextureCache::getFormatInfo(VkFormat format, uint32_t* glInternalFormat, uint32_t* texelSize)
+	{
+		// KTX 1 files store OpenGL format enums
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			*glInternalFormat = 0x8058; // GL_RGBA8
+			*texelSize = 4;
+			return true;
+		case VK_FORMAT_R16_SFLOAT:
+			*glInternalFormat = 0x822D; // GL_R16F
+			*texelSize = 2;
+			return true;
+		case VK_FORMAT_R16G16_SFLOAT:
+			*glInternalFormat = 0x822F; // GL_RG16F
+			*texelSize = 4;
+			return true;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			*glInternalFormat = 0x881A; // GL_RGBA16F
+			*texelSize = 8;
+			return true;
+		case VK_FORMAT_R32_SFLOAT:
+			*glInternalFormat = 0x822E; // GL_R32F
+			*texelSize = 4;
+			return true;
+		case VK_FORMAT_R32G32_SFLOAT:
+			*glInternalFormat = 0x8230; // GL_RG32F
+			*texelSize = 8;
+			return true;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			*glInternalFormat = 0x8814; // GL_RGBA32F
+			*texelSize = 16;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	/**
+	* Upload a cached image into an existing image if there is a matching cache entry
+	*
+	* @param name Name of the cache entry
+	* @param key Hash of all inputs used to generate the image
+	* @param image Image to upload to, needs to have been created with transfer destination usage
+	* @param format Format of the image
+	* @param width Width of the first mip level
+	* @param height Height of the first mip level
+	* @param mipLevels Number of mip levels to upload
+	* @param faceCount Number of array layers (6 for cube maps)
+	* @param imageLayout Layout the whole image is transitioned to after the upload
+	*
+	* @return True on a cache hit, false if the image needs to be generated
+	*/
+	bool TextureCache::load(const std::string& name, uint64_t key, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, VkImageLayout imageLayout)
+	{
+		uint32_t glInternalFormat, texelSize;
+		if (!enabled || !getFormatInfo(format, &glInternalFormat, &texelSize)) {
+			misses++;
+			return false;
+		}
+
+		const std::string filename = getFilename(name, key);
+		if (!vks::tools::fileExists(filename)) {
+			misses++;
+			return false;
+		}
+
+		ktxTexture* ktxTexture = nullptr;
+		if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS) {
+			misses++;
+			return false;
+		}
+
+		// Discard entries that don't match the image, e.g. from an interrupted write
+		if ((ktxTexture->glInternalformat != glInternalFormat) || (ktxTexture->baseWidth != width) || (ktxTexture->baseHeight != height) || (ktxTexture->numLevels != mipLevels) || (ktxTexture->numFaces != faceCount)) {
+			std::cerr << "Discarding mismatching cache entry " << filename << "\n";
+			ktxTexture_Destroy(ktxTexture);
+			misses++;
+			return false;
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, ktxTexture_GetSize(ktxTexture), ktxTexture_GetData(ktxTexture)));
+
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t face = 0; face < faceCount; face++) {
+			for (uint32_t level = 0; level < mipLevels; level++) {
+				ktx_size_t offset;
+				ktxTexture_GetImageOffset(ktxTexture, level, 0, face, &offset);
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = level;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = face;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = std::max(width >> level, 1u);
+				bufferCopyRegion.imageExtent.height = std::max(height >> level, 1u);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = offset;
+				bufferCopyRegions.push_back(bufferCopyRegion);
+			}
+		}
+		ktxTexture_Destroy(ktxTexture);
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = faceCount;
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, subresourceRange);
+		device->flushCommandBuffer(copyCmd, queue, true);
+
+		stagingBuffer.destroy();
+
+		hits++;
+		return true;
+	}
+
+	/**
+	* Read back a generated image and store it in the cache
+	*
+	* @param name Name of the cache entry
+	* @param key Hash of all inputs used to generate the image
+	* @param image Image to read back, needs to have been created with transfer source usage
+	* @param format Format of the image
+	* @param width Width of the first mip level
+	* @param height Height of the first mip level
+	* @param mipLevels Number of mip levels to store
+	* @param faceCount Number of array layers (6 for cube maps)
+	* @param imageLayout Current layout of the whole image, which is also restored after the read back
+	*
+	* @return True if the image has been written to the cache
+	*/
+	bool TextureCache::store(const std::string& name, uint64_t key, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, VkImageLayout imageLayout)
+	{
+		uint32_t glInternalFormat, texelSize;
+		if (!enabled || !getFormatInfo(format, &glInternalFormat, &texelSize)) {
+			return false;
+		}
+
+		// Read back all levels and faces, faces of a level are stored consecutively
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		std::vector<VkDeviceSize> levelOffsets;
+		VkDeviceSize bufferSize = 0;
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const uint32_t levelWidth = std::max(width >> level, 1u);
+			const uint32_t levelHeight = std::max(height >> level, 1u);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = level;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = faceCount;
+			bufferCopyRegion.imageExtent = { levelWidth, levelHeight, 1 };
+			bufferCopyRegion.bufferOffset = bufferSize;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			levelOffsets.push_back(bufferSize);
+			bufferSize += (VkDeviceSize)levelWidth * levelHeight * texelSize * faceCount;
+		}
+
+		vks::Buffer readbackBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readbackBuffer, bufferSize));
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = faceCount;
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, image, imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+		vkCmdCopyImageToBuffer(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageLayout, subresourceRange);
+		device->flushCommandBuffer(copyCmd, queue, true);
+
+		ktxTextureCreateInfo createInfo = {};
+		createInfo.glInternalformat = glInternalFormat;
+		createInfo.baseWidth = width;
+		createInfo.baseHeight = height;
+		createInfo.baseDepth = 1;
+		createInfo.numDimensions = 2;
+		createInfo.numLevels = mipLevels;
+		createInfo.numLayers = 1;
+		createInfo.numFaces = faceCount;
+		createInfo.isArray = KTX_FALSE;
+		createInfo.generateMipmaps = KTX_FALSE;
+
+		ktxTexture* ktxTexture = nullptr;
+		bool result = (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &ktxTexture) == KTX_SUCCESS);
+		if (result) {
+			VK_CHECK_RESULT(readbackBuffer.map());
+			const uint8_t* data = static_cast<const uint8_t*>(readbackBuffer.mapped);
+			for (uint32_t level = 0; level < mipLevels && result; level++) {
+				const ktx_size_t faceSize = ktxTexture_GetImageSize(ktxTexture, level);
+				for (uint32_t face = 0; face < faceCount && result; face++) {
+					result = (ktxTexture_SetImageFromMemory(ktxTexture, level, 0, face, data + levelOffsets[level] + face * faceSize, faceSize) == KTX_SUCCESS);
+				}
+			}
+			readbackBuffer.unmap();
+		}
+
+		if (result) {
+#if defined(_WIN32)
+			_mkdir(directory.c_str());
+#else
+			mkdir(directory.c_str(), 0755);
+#endif
+			// Write to a temporary file first, so an interrupted write never leaves a truncated cache entry behind
+			const std::string filename = getFilename(name, key);
+			const std::string tempFilename = filename + ".tmp";
+			result = (ktxTexture_WriteToNamedFile(ktxTexture, tempFilename.c_str()) == KTX_SUCCESS);
+			if (result) {
+				std::remove(filename.c_str());
+				result = (std::rename(tempFilename.c_str(), filename.c_str()) == 0);
+			}
+			if (!result) {
+				std::cerr << "Could not write cache entry " << filename << "\n";
+				std::remove(tempFilename.c_str());
+			}
+		}
+
+		if (ktxTexture) {
+			ktxTexture_Destroy(ktxTexture);
+		}
+		readbackBuffer.destroy();
+		return result;
+	}
+}
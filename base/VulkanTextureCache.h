@@ -0,0 +1,55 @@
+/*
+* On-disk cache for textures generated at runtime
+*
+* Stores the contents of generated images (e.g. pre-filtered environment maps) as KTX files and uploads them on subsequent runs
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include <ktx.h>
+
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Caches generated images as KTX files, keyed by a hash of everything that went into generating them
+	* @note The cache is disabled on Android, where the asset directory is read-only
+	*/
+	class TextureCache
+	{
+	public:
+		/** @brief Initial value for hashes, changing it invalidates all existing cache entries */
+		static const uint64_t hashSeed;
+
+		bool enabled = true;
+		std::string directory;
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+
+		static uint64_t hash(const void* data, size_t size, uint64_t seed = hashSeed);
+		static uint64_t hashFile(const std::string& filename, uint64_t seed = hashSeed);
+
+		void create(vks::VulkanDevice* device, VkQueue queue, const std::string& directory);
+		std::string getFilename(const std::string& name, uint64_t key) const;
+		bool load(const std::string& name, uint64_t key, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, VkImageLayout imageLayout);
+		bool store(const std::string& name, uint64_t key, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, VkImageLayout imageLayout);
+
+	private:
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+
+		static bool getFormatInfo(VkFormat format, uint32_t* glInternalFormat, uint32_t* texelSize);
+	};
+}
@@ -0,0 +1,114 @@
+/*
+* GPU timestamp query helper
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/** @brief Query pool of timestamps used to measure the GPU time between pairs of them */
+	class TimestampQuery
+	{
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		uint64_t validBitsMask = 0;
+		std::vector<uint64_t> fetched;
+	public:
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		uint32_t count = 0;
+		/** @brief Nanoseconds per timestamp tick */
+		float timestampPeriod = 1.0f;
+		/** @brief Last complete set of timestamps read back from the pool */
+		std::vector<uint64_t> results;
+
+		/**
+		* Create the query pool (does nothing if the queue family does not support timestamps)
+		*
+		* @param vulkanDevice Device to create the pool on
+		* @param queueFamilyIndex Family of the queue the timestamps will be written on
+		* @param count Number of timestamps in the pool
+		*/
+		void create(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, uint32_t count)
+		{
+			device = vulkanDevice->logicalDevice;
+			this->count = count;
+			const uint32_t validBits = vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+			if ((validBits == 0) || (vulkanDevice->properties.limits.timestampPeriod == 0.0f)) {
+				return;
+			}
+			validBitsMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+			timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = count;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+			results.assign(count, 0);
+			fetched.assign(count, 0);
+		}
+
+		void destroy()
+		{
+			if (queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, queryPool, nullptr);
+				queryPool = VK_NULL_HANDLE;
+			}
+		}
+
+		bool supported() const
+		{
+			return queryPool != VK_NULL_HANDLE;
+		}
+
+		/** @brief Reset all timestamps of the pool, needs to be recorded outside of a render pass before the first write */
+		void reset(VkCommandBuffer commandBuffer)
+		{
+			if (supported()) {
+				vkCmdResetQueryPool(commandBuffer, queryPool, 0, count);
+			}
+		}
+
+		void write(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t index)
+		{
+			if (supported()) {
+				vkCmdWriteTimestamp(commandBuffer, stage, queryPool, index);
+			}
+		}
+
+		/**
+		* Read back the timestamps without waiting for them
+		*
+		* @return True if all timestamps were available and results has been updated, false if the previous results were kept
+		*/
+		bool fetch()
+		{
+			if (!supported()) {
+				return false;
+			}
+			if (vkGetQueryPoolResults(device, queryPool, 0, count, count * sizeof(uint64_t), fetched.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+				return false;
+			}
+			results = fetched;
+			return true;
+		}
+
+		/** @brief GPU time between two timestamps of the last fetched results in milliseconds */
+		double duration(uint32_t first, uint32_t second) const
+		{
+			if (!supported()) {
+				return 0.0;
+			}
+			return (double)((results[second] - results[first]) & validBitsMask) * timestampPeriod / 1000000.0;
+		}
+	};
+}
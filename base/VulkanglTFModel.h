@@ -15,6 +15,8 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanKTX2.h"
+#include "VulkanMipGenerator.hpp"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -46,6 +48,8 @@ namespace vkglTF
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	// If set, mip chains for images without mip levels (e.g. png or jpg) are generated in a single compute dispatch instead of one blit per level
+	extern vks::MipGenerator* mipGenerator;
 
 	struct Node;
 
@@ -0,0 +1,223 @@
+/*
+* Minimal portable four wide SIMD wrapper
+*
+* Maps to SSE2 on x86/x64, NEON on ARM and falls back to plain scalar code on other platforms
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VKS_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VKS_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace vks
+{
+	namespace simd
+	{
+		/** @brief Number of lanes */
+		static const uint32_t width = 4;
+
+		struct float4
+		{
+#if defined(VKS_SIMD_SSE2)
+			__m128 v;
+#elif defined(VKS_SIMD_NEON)
+			float32x4_t v;
+#else
+			float v[4];
+#endif
+		};
+
+		/**
+		* @brief Four unsigned integers, also used as the result of comparisons (all bits of a lane set if true)
+		* @note Integer comparisons and conversions are only portable for values below 2^31 (SSE2 compares as signed integers)
+		*/
+		struct uint4
+		{
+#if defined(VKS_SIMD_SSE2)
+			__m128i v;
+#elif defined(VKS_SIMD_NEON)
+			uint32x4_t v;
+#else
+			uint32_t v[4];
+#endif
+		};
+
+#if defined(VKS_SIMD_SSE2)
+		inline float4 load(const float* p) { float4 r; r.v = _mm_loadu_ps(p); return r; }
+		inline void store(float* p, float4 a) { _mm_storeu_ps(p, a.v); }
+		inline float4 set1(float s) { float4 r; r.v = _mm_set1_ps(s); return r; }
+		inline float4 set(float a, float b, float c, float d) { float4 r; r.v = _mm_setr_ps(a, b, c, d); return r; }
+		inline float4 operator+(float4 a, float4 b) { float4 r; r.v = _mm_add_ps(a.v, b.v); return r; }
+		inline float4 operator-(float4 a, float4 b) { float4 r; r.v = _mm_sub_ps(a.v, b.v); return r; }
+		inline float4 operator*(float4 a, float4 b) { float4 r; r.v = _mm_mul_ps(a.v, b.v); return r; }
+		inline float4 min(float4 a, float4 b) { float4 r; r.v = _mm_min_ps(a.v, b.v); return r; }
+		inline float4 max(float4 a, float4 b) { float4 r; r.v = _mm_max_ps(a.v, b.v); return r; }
+		inline uint4 operator>(float4 a, float4 b) { uint4 r; r.v = _mm_castps_si128(_mm_cmpgt_ps(a.v, b.v)); return r; }
+		inline uint4 operator<(float4 a, float4 b) { uint4 r; r.v = _mm_castps_si128(_mm_cmplt_ps(a.v, b.v)); return r; }
+
+		inline uint4 load(const uint32_t* p) { uint4 r; r.v = _mm_loadu_si128((const __m128i*)p); return r; }
+		inline void store(uint32_t* p, uint4 a) { _mm_storeu_si128((__m128i*)p, a.v); }
+		inline uint4 set1(uint32_t s) { uint4 r; r.v = _mm_set1_epi32((int)s); return r; }
+		inline uint4 operator&(uint4 a, uint4 b) { uint4 r; r.v = _mm_and_si128(a.v, b.v); return r; }
+		inline uint4 operator|(uint4 a, uint4 b) { uint4 r; r.v = _mm_or_si128(a.v, b.v); return r; }
+		inline uint4 operator^(uint4 a, uint4 b) { uint4 r; r.v = _mm_xor_si128(a.v, b.v); return r; }
+		/** @brief a & ~b */
+		inline uint4 andNot(uint4 a, uint4 b) { uint4 r; r.v = _mm_andnot_si128(b.v, a.v); return r; }
+		template<int N> inline uint4 shiftLeft(uint4 a) { uint4 r; r.v = _mm_slli_epi32(a.v, N); return r; }
+		template<int N> inline uint4 shiftRight(uint4 a) { uint4 r; r.v = _mm_srli_epi32(a.v, N); return r; }
+		inline uint4 operator+(uint4 a, uint4 b) { uint4 r; r.v = _mm_add_epi32(a.v, b.v); return r; }
+		inline uint4 operator==(uint4 a, uint4 b) { uint4 r; r.v = _mm_cmpeq_epi32(a.v, b.v); return r; }
+		inline uint4 operator<(uint4 a, uint4 b) { uint4 r; r.v = _mm_cmplt_epi32(a.v, b.v); return r; }
+
+		inline uint4 toInt(float4 a) { uint4 r; r.v = _mm_cvttps_epi32(a.v); return r; }
+		inline float4 toFloat(uint4 a) { float4 r; r.v = _mm_cvtepi32_ps(a.v); return r; }
+		inline float4 asFloat(uint4 a) { float4 r; r.v = _mm_castsi128_ps(a.v); return r; }
+		inline uint4 asUint(float4 a) { uint4 r; r.v = _mm_castps_si128(a.v); return r; }
+		/** @brief Per lane mask ? a : b */
+		inline float4 select(uint4 mask, float4 a, float4 b) { float4 r; __m128 m = _mm_castsi128_ps(mask.v); r.v = _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)); return r; }
+		/** @brief One bit per lane that is set in the mask */
+		inline uint32_t bitmask(uint4 mask) { return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(mask.v)); }
+#elif defined(VKS_SIMD_NEON)
+		inline float4 load(const float* p) { float4 r; r.v = vld1q_f32(p); return r; }
+		inline void store(float* p, float4 a) { vst1q_f32(p, a.v); }
+		inline float4 set1(float s) { float4 r; r.v = vdupq_n_f32(s); return r; }
+		inline float4 set(float a, float b, float c, float d) { const float values[4] = { a, b, c, d }; return load(values); }
+		inline float4 operator+(float4 a, float4 b) { float4 r; r.v = vaddq_f32(a.v, b.v); return r; }
+		inline float4 operator-(float4 a, float4 b) { float4 r; r.v = vsubq_f32(a.v, b.v); return r; }
+		inline float4 operator*(float4 a, float4 b) { float4 r; r.v = vmulq_f32(a.v, b.v); return r; }
+		inline float4 min(float4 a, float4 b) { float4 r; r.v = vminq_f32(a.v, b.v); return r; }
+		inline float4 max(float4 a, float4 b) { float4 r; r.v = vmaxq_f32(a.v, b.v); return r; }
+		inline uint4 operator>(float4 a, float4 b) { uint4 r; r.v = vcgtq_f32(a.v, b.v); return r; }
+		inline uint4 operator<(float4 a, float4 b) { uint4 r; r.v = vcltq_f32(a.v, b.v); return r; }
+
+		inline uint4 load(const uint32_t* p) { uint4 r; r.v = vld1q_u32(p); return r; }
+		inline void store(uint32_t* p, uint4 a) { vst1q_u32(p, a.v); }
+		inline uint4 set1(uint32_t s) { uint4 r; r.v = vdupq_n_u32(s); return r; }
+		inline uint4 operator&(uint4 a, uint4 b) { uint4 r; r.v = vandq_u32(a.v, b.v); return r; }
+		inline uint4 operator|(uint4 a, uint4 b) { uint4 r; r.v = vorrq_u32(a.v, b.v); return r; }
+		inline uint4 operator^(uint4 a, uint4 b) { uint4 r; r.v = veorq_u32(a.v, b.v); return r; }
+		inline uint4 andNot(uint4 a, uint4 b) { uint4 r; r.v = vbicq_u32(a.v, b.v); return r; }
+		template<int N> inline uint4 shiftLeft(uint4 a) { uint4 r; r.v = vshlq_n_u32(a.v, N); return r; }
+		template<int N> inline uint4 shiftRight(uint4 a) { uint4 r; r.v = vshrq_n_u32(a.v, N); return r; }
+		inline uint4 operator+(uint4 a, uint4 b) { uint4 r; r.v = vaddq_u32(a.v, b.v); return r; }
+		inline uint4 operator==(uint4 a, uint4 b) { uint4 r; r.v = vceqq_u32(a.v, b.v); return r; }
+		inline uint4 operator<(uint4 a, uint4 b) { uint4 r; r.v = vcltq_u32(a.v, b.v); return r; }
+
+		inline uint4 toInt(float4 a) { uint4 r; r.v = vreinterpretq_u32_s32(vcvtq_s32_f32(a.v)); return r; }
+		inline float4 toFloat(uint4 a) { float4 r; r.v = vcvtq_f32_s32(vreinterpretq_s32_u32(a.v)); return r; }
+		inline float4 asFloat(uint4 a) { float4 r; r.v = vreinterpretq_f32_u32(a.v); return r; }
+		inline uint4 asUint(float4 a) { uint4 r; r.v = vreinterpretq_u32_f32(a.v); return r; }
+		inline float4 select(uint4 mask, float4 a, float4 b) { float4 r; r.v = vbslq_f32(mask.v, a.v, b.v); return r; }
+		inline uint32_t bitmask(uint4 mask)
+		{
+			uint32_t lanes[4];
+			vst1q_u32(lanes, mask.v);
+			return (lanes[0] >> 31) | ((lanes[1] >> 31) << 1) | ((lanes[2] >> 31) << 2) | ((lanes[3] >> 31) << 3);
+		}
+#else
+		inline float4 load(const float* p) { float4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+		inline void store(float* p, float4 a) { memcpy(p, a.v, sizeof(a.v)); }
+		inline float4 set1(float s) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = s; return r; }
+		inline float4 set(float a, float b, float c, float d) { float4 r; r.v[0] = a; r.v[1] = b; r.v[2] = c; r.v[3] = d; return r; }
+		inline float4 operator+(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+		inline float4 operator-(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+		inline float4 operator*(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+		inline float4 min(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = (b.v[i] < a.v[i]) ? b.v[i] : a.v[i]; return a; }
+		inline float4 max(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = (b.v[i] > a.v[i]) ? b.v[i] : a.v[i]; return a; }
+		inline uint4 operator>(float4 a, float4 b) { uint4 r; for (int i = 0; i < 4; i++) r.v[i] = (a.v[i] > b.v[i]) ? ~0u : 0u; return r; }
+		inline uint4 operator<(float4 a, float4 b) { uint4 r; for (int i = 0; i < 4; i++) r.v[i] = (a.v[i] < b.v[i]) ? ~0u : 0u; return r; }
+
+		inline uint4 load(const uint32_t* p) { uint4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+		inline void store(uint32_t* p, uint4 a) { memcpy(p, a.v, sizeof(a.v)); }
+		inline uint4 set1(uint32_t s) { uint4 r; for (int i = 0; i < 4; i++) r.v[i] = s; return r; }
+		inline uint4 operator&(uint4 a, uint4 b) { for (int i = 0; i < 4; i++) a.v[i] &= b.v[i]; return a; }
+		inline uint4 operator|(uint4 a, uint4 b) { for (int i = 0; i < 4; i++) a.v[i] |= b.v[i]; return a; }
+		inline uint4 operator^(uint4 a, uint4 b) { for (int i = 0; i < 4; i++) a.v[i] ^= b.v[i]; return a; }
+		inline uint4 andNot(uint4 a, uint4 b) { for (int i = 0; i < 4; i++) a.v[i] &= ~b.v[i]; return a; }
+		template<int N> inline uint4 shiftLeft(uint4 a) { for (int i = 0; i < 4; i++) a.v[i] <<= N; return a; }
+		template<int N> inline uint4 shiftRight(uint4 a) { for (int i = 0; i < 4; i++) a.v[i] >>= N; return a; }
+		inline uint4 operator+(uint4 a, uint4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+		inline uint4 operator==(uint4 a, uint4 b) { uint4 r; for (int i = 0; i < 4; i++) r.v[i] = (a.v[i] == b.v[i]) ? ~0u : 0u; return r; }
+		inline uint4 operator<(uint4 a, uint4 b) { uint4 r; for (int i = 0; i < 4; i++) r.v[i] = (a.v[i] < b.v[i]) ? ~0u : 0u; return r; }
+
+		inline uint4 toInt(float4 a) { uint4 r; for (int i = 0; i < 4; i++) r.v[i] = (uint32_t)(int32_t)a.v[i]; return r; }
+		inline float4 toFloat(uint4 a) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = (float)(int32_t)a.v[i]; return r; }
+		inline float4 asFloat(uint4 a) { float4 r; memcpy(r.v, a.v, sizeof(r.v)); return r; }
+		inline uint4 asUint(float4 a) { uint4 r; memcpy(r.v, a.v, sizeof(r.v)); return r; }
+		inline float4 select(uint4 mask, float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] = mask.v[i] ? a.v[i] : b.v[i]; return a; }
+		inline uint32_t bitmask(uint4 mask) { return (mask.v[0] >> 31) | ((mask.v[1] >> 31) << 1) | ((mask.v[2] >> 31) << 2) | ((mask.v[3] >> 31) << 3); }
+#endif
+
+		inline float4 operator+(float4 a, float s) { return a + set1(s); }
+		inline float4 operator-(float4 a, float s) { return a - set1(s); }
+		inline float4 operator*(float4 a, float s) { return a * set1(s); }
+		inline float4 operator*(float s, float4 a) { return set1(s) * a; }
+		inline float4 abs(float4 a) { return asFloat(andNot(asUint(a), set1(0x80000000u))); }
+		/** @brief Rounds down, only valid for values that fit into a 32 bit integer */
+		inline float4 floor(float4 a)
+		{
+			float4 t = toFloat(toInt(a));
+			return t - select(t > a, set1(1.0f), set1(0.0f));
+		}
+		/** @brief Four lookups into a table of unsigned integers */
+		inline uint4 gather(const uint32_t* table, uint4 indices)
+		{
+			uint32_t i[4], r[4];
+			store(i, indices);
+			r[0] = table[i[0]];
+			r[1] = table[i[1]];
+			r[2] = table[i[2]];
+			r[3] = table[i[3]];
+			return load(r);
+		}
+
+		/**
+		* Per lane xorshift32 random number generator
+		*/
+		struct Random
+		{
+			uint4 state;
+
+			/** @brief Seeds the four lanes with different (non zero) values derived from the seed */
+			void seed(uint32_t seed)
+			{
+				uint32_t lanes[4];
+				for (uint32_t i = 0; i < 4; i++) {
+					// Spread the seed with a multiplicative hash so neighbouring seeds don't produce correlated sequences
+					lanes[i] = (seed * 4 + i + 1) * 0x9E3779B9u;
+					if (lanes[i] == 0) {
+						lanes[i] = 0x6C078965u;
+					}
+				}
+				state = load(lanes);
+			}
+
+			uint4 nextUint()
+			{
+				state = state ^ shiftLeft<13>(state);
+				state = state ^ shiftRight<17>(state);
+				state = state ^ shiftLeft<5>(state);
+				return state;
+			}
+
+			/** @brief Uniformly distributed floats in [0, 1) */
+			float4 next()
+			{
+				// Use the upper 23 bits as mantissa of a float in [1, 2)
+				return asFloat(shiftRight<9>(nextUint()) | set1(0x3F800000u)) - 1.0f;
+			}
+		};
+	}
+}
@@ -275,6 +275,11 @@ void VulkanExampleBase::renderLoop()
 		return;
 	}
 
+	if (settings.textureStatistics && (vks::Texture::loadStatistics.textureCount > 0)) {
+		const vks::Texture::LoadStatistics& textureStats = vks::Texture::loadStatistics;
+		std::cout << "Loaded " << textureStats.textureCount << " textures (" << (double)textureStats.bytes / (1024.0 * 1024.0) << " MB) in " << textureStats.milliseconds << " ms, " << textureStats.throughput() << " MB/s (file read and GPU upload)" << "\n";
+	}
+
 	destWidth = width;
 	destHeight = height;
 	lastTimestamp = std::chrono::high_resolution_clock::now();
@@ -772,6 +777,9 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 			shaderDir = value;
 		}
 	}
+	if (commandLineParser.isSet("texturestats")) {
+		settings.textureStatistics = true;
+	}
 	if (commandLineParser.isSet("benchmark")) {
 		benchmark.active = true;
 		vks::tools::errorModeSilent = true;
@@ -2773,6 +2781,7 @@ CommandLineParser::CommandLineParser()
 	add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
 	add("gpuselection", { "-g", "--gpu" }, 1, "Select GPU to run on");
 	add("gpulist", { "-gl", "--listgpus" }, 0, "Display a list of available Vulkan devices");
+	add("texturestats", { "-ts", "--texturestats" }, 0, "Display texture loading statistics");
 	add("benchmark", { "-b", "--benchmark" }, 0, "Run example in benchmark mode");
 	add("benchmarkwarmup", { "-bw", "--benchwarmup" }, 1, "Set warmup time for benchmark mode in seconds");
 	add("benchmarkruntime", { "-br", "--benchruntime" }, 1, "Set duration time for benchmark mode in seconds");
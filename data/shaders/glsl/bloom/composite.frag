@@ -0,0 +1,23 @@
+#version 450
+
+layout (binding = 1) uniform sampler2D samplerColor;
+
+layout (binding = 0) uniform UBO 
+{
+	float blurScale;
+	float blurStrength;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	// Tent filtered upsample of the first level of the bloom mip chain to the output resolution
+	vec2 texelSize = 1.0 / vec2(textureSize(samplerColor, 0)) * ubo.blurScale;
+	vec3 result = texture(samplerColor, inUV).rgb * 4.0;
+	result += (texture(samplerColor, inUV + vec2(-texelSize.x, 0.0)).rgb + texture(samplerColor, inUV + vec2(texelSize.x, 0.0)).rgb + texture(samplerColor, inUV + vec2(0.0, -texelSize.y)).rgb + texture(samplerColor, inUV + vec2(0.0, texelSize.y)).rgb) * 2.0;
+	result += texture(samplerColor, inUV - texelSize).rgb + texture(samplerColor, inUV + texelSize).rgb + texture(samplerColor, inUV + vec2(-texelSize.x, texelSize.y)).rgb + texture(samplerColor, inUV + vec2(texelSize.x, -texelSize.y)).rgb;
+	outFragColor = vec4(result / 16.0 * ubo.blurStrength, 1.0);
+}
@@ -11,5 +11,8 @@ layout (location = 0) out vec4 outFragColor;
 void main () 
 {
 	vec3 color = texture(samplerGradientRamp, vec2(inGradientPos, 0.0)).rgb;
-	outFragColor.rgb = texture(samplerColorMap, gl_PointCoord).rgb * color;
+	vec4 particle = texture(samplerColorMap, gl_PointCoord);
+	outFragColor.rgb = particle.rgb * color * inColor.rgb;
+	// Coverage for alpha blending, the particle texture is black outside of the sprite
+	outFragColor.a = particle.a * max(particle.r, max(particle.g, particle.b)) * inColor.a;
 }
@@ -1,7 +1,22 @@
 #version 450
 
-layout (location = 0) in vec2 inPos;
-layout (location = 1) in vec4 inGradientPos;
+struct Particle
+{
+	vec2 pos;
+	vec2 vel;
+	vec4 gradientPos;
+};
+
+// Particles and the indices of the live particles (sorted back to front if enabled) written by the compute shaders
+layout (std140, binding = 2) readonly buffer Particles 
+{
+	Particle particles[ ];
+};
+
+layout (std430, binding = 3) readonly buffer Values 
+{
+	uint values[ ];
+};
 
 layout (location = 0) out vec4 outColor;
 layout (location = 1) out float outGradientPos;
@@ -14,8 +29,11 @@ out gl_PerVertex
 
 void main () 
 {
-  gl_PointSize = 8.0;
-  outColor = vec4(0.035);
-  outGradientPos = inGradientPos.x;
-  gl_Position = vec4(inPos.xy, 1.0, 1.0);
-}
\ No newline at end of file
+  Particle particle = particles[values[gl_VertexIndex]];
+  // Particles further away are smaller and darker
+  float depth = particle.gradientPos.z;
+  gl_PointSize = mix(8.0, 4.0, depth);
+  outColor = vec4(vec3(1.0 - 0.5 * depth), 1.0);
+  outGradientPos = particle.gradientPos.x;
+  gl_Position = vec4(particle.pos.xy, 1.0, 1.0);
+}
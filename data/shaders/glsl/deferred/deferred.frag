@@ -16,11 +16,71 @@ struct Light {
 
 layout (binding = 4) uniform UBO 
 {
-	Light lights[6];
+	mat4 view;
+	mat4 invProjection;
 	vec4 viewPos;
 	int displayDebugTarget;
+	int lightCount;
+	int clustered;
+	float zNear;
+	float zFar;
 } ubo;
 
+layout (std430, binding = 5) readonly buffer Lights {
+	Light lights[];
+};
+
+// Light lists of the view space clusters written by the light culling compute shader
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+layout (std430, binding = 6) readonly buffer LightGrid {
+	uint lightGrid[];
+};
+
+layout (std430, binding = 7) readonly buffer LightIndices {
+	uint lightIndices[];
+};
+
+#define ambient 0.0
+
+vec3 shadeLight(Light light, vec3 fragPos, vec3 N, vec3 V, vec4 albedo)
+{
+	// Vector to light
+	vec3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, windowed so that the light has no influence beyond its radius
+	float window = clamp(1.0 - pow(dist / light.radius, 4.0), 0.0, 1.0);
+	float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	vec3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	vec3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	vec3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
+uint getClusterIndex(vec3 fragPos)
+{
+	float depth = -(ubo.view * vec4(fragPos, 1.0)).z;
+	uint slice = uint(clamp(log(depth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+	uvec2 tile = min(uvec2(inUV * vec2(CLUSTER_X, CLUSTER_Y)), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+	return tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+}
+
 void main() 
 {
 	// Get G-Buffer values
@@ -43,6 +103,12 @@ void main()
 			case 4: 
 				outFragcolor.rgb = albedo.aaa;
 				break;
+			case 5: {
+				// Number of lights in the fragment's cluster (green to red)
+				float heat = float(lightGrid[getClusterIndex(fragPos)]) / float(MAX_LIGHTS_PER_CLUSTER);
+				outFragcolor.rgb = mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), heat);
+				break;
+			}
 		}		
 		outFragcolor.a = 1.0;
 		return;
@@ -50,45 +116,25 @@ void main()
 
 	// Render-target composition
 
-	#define lightCount 6
-	#define ambient 0.0
-	
 	// Ambient part
 	vec3 fragcolor  = albedo.rgb * ambient;
-	
-	for(int i = 0; i < lightCount; ++i)
-	{
-		// Vector to light
-		vec3 L = ubo.lights[i].position.xyz - fragPos;
-		// Distance from light to fragment position
-		float dist = length(L);
-
-		// Viewer to fragment
-		vec3 V = ubo.viewPos.xyz - fragPos;
-		V = normalize(V);
-		
-		//if(dist < ubo.lights[i].radius)
-		{
-			// Light to fragment
-			L = normalize(L);
-
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
-
-			// Diffuse part
-			vec3 N = normalize(normal);
-			float NdotL = max(0.0, dot(N, L));
-			vec3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
-
-			// Specular part
-			// Specular map values are stored in alpha of albedo mrt
-			vec3 R = reflect(-L, N);
-			float NdotR = max(0.0, dot(R, V));
-			vec3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
-
-			fragcolor += diff + spec;	
-		}	
-	}    	
+
+	vec3 N = normalize(normal);
+	// Viewer to fragment
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	if (ubo.clustered == 1) {
+		// Only visit the lights that have been assigned to the fragment's cluster
+		uint clusterIndex = getClusterIndex(fragPos);
+		uint count = lightGrid[clusterIndex];
+		for (uint i = 0; i < count; ++i) {
+			fragcolor += shadeLight(lights[lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]], fragPos, N, V, albedo);
+		}
+	} else {
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			fragcolor += shadeLight(lights[i], fragPos, N, V, albedo);
+		}
+	}
    
-  outFragcolor = vec4(fragcolor, 1.0);	
-}
\ No newline at end of file
+	outFragcolor = vec4(fragcolor, 1.0);	
+}
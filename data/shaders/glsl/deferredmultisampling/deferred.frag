@@ -16,14 +16,35 @@ struct Light {
 
 layout (binding = 4) uniform UBO 
 {
-	Light lights[6];
+	mat4 view;
+	mat4 invProjection;
 	vec4 viewPos;
 	int debugDisplayTarget;
+	int lightCount;
+	int clustered;
+	float zNear;
+	float zFar;
 } ubo;
 
-layout (constant_id = 0) const int NUM_SAMPLES = 8;
+layout (std430, binding = 5) readonly buffer Lights {
+	Light lights[];
+};
+
+// Light lists of the view space clusters written by the light culling compute shader
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
 
-#define NUM_LIGHTS 6
+layout (std430, binding = 6) readonly buffer LightGrid {
+	uint lightGrid[];
+};
+
+layout (std430, binding = 7) readonly buffer LightIndices {
+	uint lightIndices[];
+};
+
+layout (constant_id = 0) const int NUM_SAMPLES = 8;
 
 // Manual resolve for MSAA samples 
 vec4 resolve(sampler2DMS tex, ivec2 uv)
@@ -38,38 +59,60 @@ vec4 resolve(sampler2DMS tex, ivec2 uv)
 	return result / float(NUM_SAMPLES);
 }
 
+vec3 shadeLight(Light light, vec3 pos, vec3 N, vec3 V, vec4 albedo)
+{
+	// Vector to light
+	vec3 L = light.position.xyz - pos;
+	// Distance from light to fragment position
+	float dist = length(L);
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, windowed so that the light has no influence beyond its radius
+	float window = clamp(1.0 - pow(dist / light.radius, 4.0), 0.0, 1.0);
+	float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	vec3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	vec3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	vec3 spec = light.color * albedo.a * pow(NdotR, 8.0) * atten;
+
+	return diff + spec;
+}
+
+// Samples of a pixel can have different depths, so the cluster is looked up for each sample
+uint getClusterIndex(vec3 pos)
+{
+	float depth = -(ubo.view * vec4(pos, 1.0)).z;
+	uint slice = uint(clamp(log(depth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+	uvec2 tile = min(uvec2(inUV * vec2(CLUSTER_X, CLUSTER_Y)), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+	return tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+}
+
 vec3 calculateLighting(vec3 pos, vec3 normal, vec4 albedo)
 {
 	vec3 result = vec3(0.0);
 
-	for(int i = 0; i < NUM_LIGHTS; ++i)
-	{
-		// Vector to light
-		vec3 L = ubo.lights[i].position.xyz - pos;
-		// Distance from light to fragment position
-		float dist = length(L);
-
-		// Viewer to fragment
-		vec3 V = ubo.viewPos.xyz - pos;
-		V = normalize(V);
-		
-		// Light to fragment
-		L = normalize(L);
-
-		// Attenuation
-		float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
-
-		// Diffuse part
-		vec3 N = normalize(normal);
-		float NdotL = max(0.0, dot(N, L));
-		vec3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
-
-		// Specular part
-		vec3 R = reflect(-L, N);
-		float NdotR = max(0.0, dot(R, V));
-		vec3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 8.0) * atten;
-
-		result += diff + spec;	
+	vec3 N = normalize(normal);
+	// Viewer to fragment
+	vec3 V = normalize(ubo.viewPos.xyz - pos);
+
+	if (ubo.clustered == 1) {
+		// Only visit the lights that have been assigned to the sample's cluster
+		uint clusterIndex = getClusterIndex(pos);
+		uint count = lightGrid[clusterIndex];
+		for (uint i = 0; i < count; ++i) {
+			result += shadeLight(lights[lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]], pos, N, V, albedo);
+		}
+	} else {
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			result += shadeLight(lights[i], pos, N, V, albedo);
+		}
 	}
 	return result;
 }
@@ -94,6 +137,12 @@ void main()
 			case 4: 
 				outFragcolor.rgb = texelFetch(samplerAlbedo, UV, 0).aaa;
 				break;
+			case 5: {
+				// Number of lights in the cluster of the first sample (green to red)
+				float heat = float(lightGrid[getClusterIndex(texelFetch(samplerPosition, UV, 0).rgb)]) / float(MAX_LIGHTS_PER_CLUSTER);
+				outFragcolor.rgb = mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), heat);
+				break;
+			}
 		}		
 		outFragcolor.a = 1.0;
 		return;
@@ -117,4 +166,4 @@ void main()
 	fragColor = (alb.rgb * ambient) + fragColor / float(NUM_SAMPLES);
    
 	outFragcolor = vec4(fragColor, 1.0);	
-}
\ No newline at end of file
+}
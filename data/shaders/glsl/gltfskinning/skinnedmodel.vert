@@ -1,11 +1,7 @@
 #version 450
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inUV;
 layout (location = 3) in vec3 inColor;
-layout (location = 4) in vec4 inJointIndices;
-layout (location = 5) in vec4 inJointWeights;
 
 layout (set = 0, binding = 0) uniform UBOScene
 {
@@ -14,14 +10,20 @@ layout (set = 0, binding = 0) uniform UBOScene
 	vec4 lightPos;
 } uboScene;
 
-layout(push_constant) uniform PushConsts {
-	mat4 model;
-} primitive;
+// Vertices skinned by the compute shader, one block of vertices per instance
+struct SkinnedVertex {
+	vec4 pos;
+	vec4 normal;
+};
 
-layout(std430, set = 1, binding = 0) readonly buffer JointMatrices {
-	mat4 jointMatrices[];
+layout(std430, set = 1, binding = 0) readonly buffer SkinnedVertices {
+	SkinnedVertex skinnedVertices[];
 };
 
+layout(push_constant) uniform PushConsts {
+	uint vertexCount;
+} push;
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec2 outUV;
@@ -30,23 +32,18 @@ layout (location = 4) out vec3 outLightVec;
 
 void main() 
 {
-	outNormal = inNormal;
 	outColor = inColor;
 	outUV = inUV;
 
-	// Calculate skinned matrix from weights and joint indices of the current vertex
-	mat4 skinMat = 
-		inJointWeights.x * jointMatrices[int(inJointIndices.x)] +
-		inJointWeights.y * jointMatrices[int(inJointIndices.y)] +
-		inJointWeights.z * jointMatrices[int(inJointIndices.z)] +
-		inJointWeights.w * jointMatrices[int(inJointIndices.w)];
+	// Fetch the already skinned vertex of the current instance
+	SkinnedVertex skinnedVertex = skinnedVertices[gl_InstanceIndex * push.vertexCount + gl_VertexIndex];
 
-	gl_Position = uboScene.projection * uboScene.view * primitive.model * skinMat * vec4(inPos.xyz, 1.0);
+	gl_Position = uboScene.projection * uboScene.view * skinnedVertex.pos;
 	
-	outNormal = normalize(transpose(inverse(mat3(uboScene.view * primitive.model * skinMat))) * inNormal);
+	outNormal = mat3(uboScene.view) * skinnedVertex.normal.xyz;
 
-	vec4 pos = uboScene.view * vec4(inPos, 1.0);
+	vec4 pos = uboScene.view * skinnedVertex.pos;
 	vec3 lPos = mat3(uboScene.view) * uboScene.lightPos.xyz;
 	outLightVec = lPos - pos.xyz;
 	outViewVec = -pos.xyz;
-}
\ No newline at end of file
+}
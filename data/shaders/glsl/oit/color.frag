@@ -18,6 +18,14 @@ layout (set = 0, binding = 1) buffer LinkedListSBO
     Node nodes[];
 };
 
+// Statistics read back by the application to size the node pool
+layout (set = 0, binding = 2) buffer GeometrySBO
+{
+    uint nodeCount;
+    uint maxNodeCount;
+    uint peakFragmentCount;
+};
+
 void main()
 {
     Node fragments[MAX_FRAGMENT_COUNT];
@@ -31,6 +39,12 @@ void main()
         nodeIdx = fragments[count].next;
         ++count;
     }
+
+    // Longest list of this frame, the non-atomic check avoids most of the atomic operations
+    if (uint(count) > peakFragmentCount)
+    {
+        atomicMax(peakFragmentCount, uint(count));
+    }
     
     // Do the insertion sort
     for (uint i = 1; i < count; ++i)
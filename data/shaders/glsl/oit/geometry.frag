@@ -13,6 +13,7 @@ layout (set = 0, binding = 1) buffer GeometrySBO
 {
     uint count;
     uint maxNodeCount;
+    uint peakFragmentCount;
 };
 
 layout (set = 0, binding = 2, r32ui) uniform uimage2D headIndexImage;
@@ -0,0 +1,34 @@
+#version 450
+
+// Weighted blended order independent transparency (McGuire and Bavoil)
+// Accumulates weighted premultiplied colors and the total coverage without per-pixel lists or sorting
+
+layout (location = 0) out vec4 outAccum;
+layout (location = 1) out float outRevealage;
+
+layout (set = 0, binding = 0) uniform RenderPassUBO
+{
+    mat4 projection;
+    mat4 view;
+} renderPassUBO;
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+void main()
+{
+    vec4 color = pushConsts.color;
+
+    // Linear view space depth reconstructed from the projection
+    float depth = renderPassUBO.projection[3][2] / (gl_FragCoord.z + renderPassUBO.projection[2][2]);
+
+    // Closer and more opaque fragments get higher weights
+    float weight = color.a * clamp(10.0 / (1e-5 + pow(depth / 5.0, 2.0) + pow(depth / 200.0, 6.0)), 1e-2, 3e3);
+
+    // Blended additively
+    outAccum = vec4(color.rgb * color.a, color.a) * weight;
+    // Blended with (zero, one minus source color), so the attachment stores the product of all (1 - alpha)
+    outRevealage = color.a;
+}
@@ -0,0 +1,18 @@
+#version 450
+
+layout (set = 0, binding = 0) uniform sampler2D samplerAccum;
+layout (set = 0, binding = 1) uniform sampler2D samplerRevealage;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(samplerAccum, coord, 0);
+    float revealage = texelFetch(samplerRevealage, coord, 0).r;
+
+    // Weighted average color of all transparent fragments, blended over the background by their total coverage
+    vec3 color = accum.rgb / max(accum.a, 1e-5);
+    vec3 background = vec3(0.025);
+    outFragColor = vec4(mix(color, background, revealage), 1.0);
+}
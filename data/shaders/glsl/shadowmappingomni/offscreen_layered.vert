@@ -0,0 +1,34 @@
+#version 450
+
+#extension GL_ARB_shader_viewport_layer_array : enable
+
+layout (location = 0) in vec3 inPos;
+
+layout (location = 0) out vec4 outPos;
+layout (location = 1) out vec3 outLightPos;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view; 
+	mat4 model;
+	vec4 lightPos;
+	mat4 faceViewProjection[6];
+} ubo;
+
+layout(push_constant) uniform PushConsts 
+{
+	// Indices of the cube map faces this draw is visible in, three bits per face
+	uint faces;
+} pushConsts;
+ 
+void main()
+{
+	// Each instance renders to one of the cube map faces
+	uint face = (pushConsts.faces >> (3 * gl_InstanceIndex)) & 7;
+	gl_Layer = int(face);
+	gl_Position = ubo.faceViewProjection[face] * ubo.model * vec4(inPos, 1.0);
+
+	outPos = vec4(inPos, 1.0);	
+	outLightPos = ubo.lightPos.xyz; 
+}
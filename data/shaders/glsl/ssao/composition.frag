@@ -5,6 +5,7 @@ layout (binding = 1) uniform sampler2D samplerNormal;
 layout (binding = 2) uniform sampler2D samplerAlbedo;
 layout (binding = 3) uniform sampler2D samplerSSAO;
 layout (binding = 4) uniform sampler2D samplerSSAOBlur;
+layout (binding = 6) uniform sampler2D samplerSSAODepth;
 layout (binding = 5) uniform UBO 
 {
 	mat4 _dummy;
@@ -17,13 +18,36 @@ layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
+// Depth-aware (bilateral) upsampling of SSAO rendered at a lower resolution
+// Bilinear weights of the four closest SSAO texels are scaled down for texels with a different depth, so occlusion doesn't bleed across edges
+float upsampleSSAO(sampler2D samplerAO, vec2 uv, float depth)
+{
+	ivec2 texDim = textureSize(samplerAO, 0);
+	vec2 texelPos = uv * vec2(texDim) - 0.5;
+	ivec2 baseCoord = ivec2(floor(texelPos));
+	vec2 f = fract(texelPos);
+	float result = 0.0;
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 coord = clamp(baseCoord + offset, ivec2(0), texDim - 1);
+		float bilinearWeight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		float sampleDepth = texelFetch(samplerSSAODepth, coord, 0).w;
+		float weight = bilinearWeight / (abs(depth - sampleDepth) / max(depth, 0.0001) + 0.001);
+		result += texelFetch(samplerAO, coord, 0).r * weight;
+		weightSum += weight;
+	}
+	return (weightSum > 0.0) ? result / weightSum : texture(samplerAO, uv).r;
+}
+
 void main() 
 {
-	vec3 fragPos = texture(samplerposition, inUV).rgb;
+	vec4 positionDepth = texture(samplerposition, inUV);
+	vec3 fragPos = positionDepth.rgb;
 	vec3 normal = normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0);
 	vec4 albedo = texture(samplerAlbedo, inUV);
 	 
-	float ssao = (uboParams.ssaoBlur == 1) ? texture(samplerSSAOBlur, inUV).r : texture(samplerSSAO, inUV).r;
+	float ssao = (uboParams.ssaoBlur == 1) ? upsampleSSAO(samplerSSAOBlur, inUV, positionDepth.w) : upsampleSSAO(samplerSSAO, inUV, positionDepth.w);
 
 	vec3 lightPos = vec3(0.0);
 	vec3 L = normalize(lightPos - fragPos);
@@ -0,0 +1,34 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;
+
+layout (push_constant) uniform PushConsts {
+	int divisor;
+} pushConsts;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+
+void main() 
+{
+	// Select the closest sample of the footprint instead of averaging, so positions and normals stay consistent across depth discontinuities
+	ivec2 srcCoord = ivec2(gl_FragCoord.xy) * pushConsts.divisor;
+	ivec2 srcMax = textureSize(samplerPositionDepth, 0) - 1;
+	ivec2 selected = min(srcCoord, srcMax);
+	float minDepth = texelFetch(samplerPositionDepth, selected, 0).w;
+	for (int y = 0; y < pushConsts.divisor; y++) {
+		for (int x = 0; x < pushConsts.divisor; x++) {
+			ivec2 coord = min(srcCoord + ivec2(x, y), srcMax);
+			float depth = texelFetch(samplerPositionDepth, coord, 0).w;
+			if (depth < minDepth) {
+				minDepth = depth;
+				selected = coord;
+			}
+		}
+	}
+	outPosition = texelFetch(samplerPositionDepth, selected, 0);
+	outNormal = texelFetch(samplerNormal, selected, 0);
+}
@@ -15,6 +15,13 @@ layout (binding = 3) uniform UBOSSAOKernel
 layout (binding = 4) uniform UBO 
 {
 	mat4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	// With temporal accumulation only every kernelStride-th sample of the kernel is taken per frame
+	int kernelOffset;
+	int kernelStride;
+	int frameIndex;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
@@ -31,7 +38,9 @@ void main()
 	ivec2 texDim = textureSize(samplerPositionDepth, 0); 
 	ivec2 noiseDim = textureSize(ssaoNoise, 0);
 	const vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
-	vec3 randomVec = texture(ssaoNoise, noiseUV).xyz * 2.0 - 1.0;
+	// Rotate the noise pattern between frames, so temporal accumulation sees different sample directions
+	const vec2 noiseOffset = vec2(ubo.frameIndex % noiseDim.x, (ubo.frameIndex / noiseDim.x) % noiseDim.y) / vec2(noiseDim);
+	vec3 randomVec = texture(ssaoNoise, noiseUV + noiseOffset).xyz * 2.0 - 1.0;
 	
 	// Create TBN matrix
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -42,7 +51,8 @@ void main()
 	float occlusion = 0.0f;
 	// remove banding
 	const float bias = 0.025f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	int sampleCount = 0;
+	for(int i = ubo.kernelOffset; i < SSAO_KERNEL_SIZE; i += ubo.kernelStride)
 	{		
 		vec3 samplePos = TBN * uboSSAOKernel.samples[i].xyz; 
 		samplePos = fragPos + samplePos * SSAO_RADIUS; 
@@ -57,8 +67,9 @@ void main()
 
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z + bias ? 1.0f : 0.0f) * rangeCheck;           
+		sampleCount++;
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(max(sampleCount, 1)));
 	
 	outFragColor = occlusion;
 }
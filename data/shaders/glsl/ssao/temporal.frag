@@ -0,0 +1,46 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerSSAO;
+layout (binding = 1) uniform sampler2D samplerHistory;
+layout (binding = 2) uniform sampler2D samplerPositionDepth;
+layout (binding = 3) uniform UBO 
+{
+	mat4 _dummy;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int kernelOffset;
+	int kernelStride;
+	int frameIndex;
+	int historyValid;
+	mat4 reprojection;
+} uboParams;
+
+// Number of frames the kernel is spread across
+layout (constant_id = 0) const int TEMPORAL_FRAMES = 4;
+
+layout (location = 0) in vec2 inUV;
+
+// Accumulated occlusion and linear depth used for rejecting the history in the next frame
+layout (location = 0) out vec2 outFragColor;
+
+void main() 
+{
+	vec4 positionDepth = texture(samplerPositionDepth, inUV);
+	float occlusion = texture(samplerSSAO, inUV).r;
+
+	// Reproject into the previous frame, w is the linear depth the fragment had in that frame
+	vec4 prevPos = uboParams.reprojection * vec4(positionDepth.xyz, 1.0);
+	vec2 prevUV = (prevPos.xy / prevPos.w) * 0.5 + 0.5;
+
+	if ((uboParams.historyValid == 1) && all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0)))) {
+		vec2 history = texture(samplerHistory, prevUV).rg;
+		// Discard the history if it belongs to a different surface (disocclusion)
+		if (abs(history.g - prevPos.w) < 0.05 * prevPos.w) {
+			float historyWeight = 1.0 - 1.0 / float(TEMPORAL_FRAMES);
+			occlusion = mix(occlusion, history.r, historyWeight);
+		}
+	}
+
+	outFragColor = vec2(occlusion, positionDepth.w);
+}
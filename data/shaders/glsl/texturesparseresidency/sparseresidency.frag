@@ -5,6 +5,21 @@
 
 layout (binding = 1) uniform sampler2D samplerColor;
 
+// Page requests read back by the application, one entry per page
+layout (binding = 2) buffer Feedback
+{
+	uint requests[];
+};
+
+layout (binding = 3) uniform PageTable
+{
+	// xy = texture size, zw = page size
+	uvec4 dimensions;
+	// x = pages horizontally, y = pages vertically, z = index of the first page
+	uvec4 mipLevels[16];
+	uint mipTailStart;
+} pageTable;
+
 layout (location = 0) in vec2 inUV;
 layout (location = 1) in float inLodBias;
 
@@ -14,26 +29,34 @@ void main()
 {
 	vec4 color = vec4(0.0);
 
-	// Get residency code for current texel
-	int residencyCode = sparseTextureARB(samplerColor, inUV, color, inLodBias);
+	float lod = max(textureQueryLod(samplerColor, inUV).y + inLodBias, 0.0);
+	uint mipLevel = uint(lod);
 
-	// Fetch sparse until we get a valid texel
-	/*
-	float minLod = 1.0;
-	while (!sparseTexelsResidentARB(residencyCode)) 
+	// Request the page covering this texel (pages in the mip tail are always resident)
+	if (mipLevel < pageTable.mipTailStart)
 	{
-		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color);
-		minLod += 1.0f;
+		uvec4 pages = pageTable.mipLevels[mipLevel];
+		uvec2 mipSize = max(pageTable.dimensions.xy >> mipLevel, uvec2(1));
+		uvec2 page = min(uvec2(clamp(inUV, 0.0, 1.0) * vec2(mipSize)) / pageTable.dimensions.zw, pages.xy - 1);
+		requests[pages.z + page.y * pages.x + page.x] = 1;
 	}
-	*/
-
-	// Check if texel is resident
-	bool texelResident = sparseTexelsResidentARB(residencyCode);
 
+	// Fall back to coarser mip levels until a resident texel is found
+	// Explicit lods are used, as the loop makes derivatives undefined
+	bool texelResident = false;
+	for (uint level = mipLevel; level < pageTable.mipTailStart; level++)
+	{
+		int residencyCode = sparseTextureLodARB(samplerColor, inUV, max(lod, float(level)), color);
+		if (sparseTexelsResidentARB(residencyCode))
+		{
+			texelResident = true;
+			break;
+		}
+	}
 	if (!texelResident)
 	{
-		color = vec4(0.0, 0.0, 0.0, 0.0);
+		color = textureLod(samplerColor, inUV, max(lod, float(pageTable.mipTailStart)));
 	}
 
 	outFragColor = color;
-}
\ No newline at end of file
+}
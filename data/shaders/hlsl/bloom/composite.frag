@@ -0,0 +1,22 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureColor : register(t1);
+SamplerState samplerColor : register(s1);
+
+cbuffer UBO : register(b0)
+{
+	float blurScale;
+	float blurStrength;
+};
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Tent filtered upsample of the first level of the bloom mip chain to the output resolution
+	float2 textureSize;
+	textureColor.GetDimensions(textureSize.x, textureSize.y);
+	float2 texelSize = 1.0 / textureSize * blurScale;
+	float3 result = textureColor.Sample(samplerColor, inUV).rgb * 4.0;
+	result += (textureColor.Sample(samplerColor, inUV + float2(-texelSize.x, 0.0)).rgb + textureColor.Sample(samplerColor, inUV + float2(texelSize.x, 0.0)).rgb + textureColor.Sample(samplerColor, inUV + float2(0.0, -texelSize.y)).rgb + textureColor.Sample(samplerColor, inUV + float2(0.0, texelSize.y)).rgb) * 2.0;
+	result += textureColor.Sample(samplerColor, inUV - texelSize).rgb + textureColor.Sample(samplerColor, inUV + texelSize).rgb + textureColor.Sample(samplerColor, inUV + float2(-texelSize.x, texelSize.y)).rgb + textureColor.Sample(samplerColor, inUV + float2(texelSize.x, -texelSize.y)).rgb;
+	return float4(result / 16.0 * blurStrength, 1.0);
+}
@@ -18,5 +18,7 @@ float4 main (VSOutput input) : SV_TARGET
 {
 	float3 color = textureGradientRamp.Sample(samplerGradientRamp, float2(input.GradientPos, 0.0)).rgb;
 	float2 PointCoord = (input.Pos.xy - input.CenterPos.xy) / input.PointSize + 0.5;
-	return float4(textureColorMap.Sample(samplerColorMap, PointCoord).rgb * color, 1.0);
+	float4 particle = textureColorMap.Sample(samplerColorMap, PointCoord);
+	// Coverage for alpha blending, the particle texture is black outside of the sprite
+	return float4(particle.rgb * color * input.Color.rgb, particle.a * max(particle.r, max(particle.g, particle.b)) * input.Color.a);
 }
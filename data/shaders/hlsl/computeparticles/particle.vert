@@ -1,11 +1,16 @@
 // Copyright 2020 Google LLC
 
-struct VSInput
+struct Particle
 {
-[[vk::location(0)]] float2 Pos : POSITION0;
-[[vk::location(1)]] float4 GradientPos : POSITION1;
+	float2 pos;
+	float2 vel;
+	float4 gradientPos;
 };
 
+// Particles and the indices of the live particles (sorted back to front if enabled) written by the compute shaders
+StructuredBuffer<Particle> particles : register(t2);
+StructuredBuffer<uint> values : register(t3);
+
 struct VSOutput
 {
   float4 Pos : SV_POSITION;
@@ -23,13 +28,16 @@ struct PushConsts
 
 [[vk::push_constant]] PushConsts pushConstants;
 
-VSOutput main (VSInput input)
+VSOutput main (uint VertexIndex : SV_VertexID)
 {
   VSOutput output = (VSOutput)0;
-  output.PSize = output.PointSize = 8.0;
-  output.Color = float4(0.035, 0.035, 0.035, 0.035);
-  output.GradientPos = input.GradientPos.x;
-  output.Pos = float4(input.Pos.xy, 1.0, 1.0);
+  Particle particle = particles[values[VertexIndex]];
+  // Particles further away are smaller and darker
+  float depth = particle.gradientPos.z;
+  output.PSize = output.PointSize = lerp(8.0, 4.0, depth);
+  output.Color = float4((1.0 - 0.5 * depth).xxx, 1.0);
+  output.GradientPos = particle.gradientPos.x;
+  output.Pos = float4(particle.pos.xy, 1.0, 1.0);
 	output.CenterPos = ((output.Pos.xy / output.Pos.w) + 1.0) * 0.5 * pushConstants.screendim;
   return output;
-}
\ No newline at end of file
+}
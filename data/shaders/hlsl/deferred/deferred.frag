@@ -15,13 +15,65 @@ struct Light {
 
 struct UBO
 {
-	Light lights[6];
+	float4x4 view;
+	float4x4 invProjection;
 	float4 viewPos;
 	int displayDebugTarget;
+	int lightCount;
+	int clustered;
+	float zNear;
+	float zFar;
 };
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
+StructuredBuffer<Light> lights : register(t5);
+
+// Light lists of the view space clusters written by the light culling compute shader
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+StructuredBuffer<uint> lightGrid : register(t6);
+StructuredBuffer<uint> lightIndices : register(t7);
+
+#define ambient 0.0
+
+float3 shadeLight(Light light, float3 fragPos, float3 N, float3 V, float4 albedo)
+{
+	// Vector to light
+	float3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, windowed so that the light has no influence beyond its radius
+	float window = saturate(1.0 - pow(dist / light.radius, 4.0));
+	float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	float3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	float3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	float3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
+uint getClusterIndex(float3 fragPos, float2 uv)
+{
+	float depth = -mul(ubo.view, float4(fragPos, 1.0)).z;
+	uint slice = uint(clamp(log(depth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+	uint2 tile = min(uint2(uv * float2(CLUSTER_X, CLUSTER_Y)), uint2(CLUSTER_X - 1, CLUSTER_Y - 1));
+	return tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+}
 
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
@@ -35,61 +87,47 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	// Debug display
 	if (ubo.displayDebugTarget > 0) {
 		switch (ubo.displayDebugTarget) {
-			case 1: 
+			case 1:
 				fragcolor.rgb = fragPos;
 				break;
-			case 2: 
+			case 2:
 				fragcolor.rgb = normal;
 				break;
-			case 3: 
+			case 3:
 				fragcolor.rgb = albedo.rgb;
 				break;
-			case 4: 
+			case 4:
 				fragcolor.rgb = albedo.aaa;
 				break;
-		}		
+			case 5: {
+				// Number of lights in the fragment's cluster (green to red)
+				float heat = float(lightGrid[getClusterIndex(fragPos, inUV)]) / float(MAX_LIGHTS_PER_CLUSTER);
+				fragcolor.rgb = lerp(float3(0.0, 1.0, 0.0), float3(1.0, 0.0, 0.0), heat);
+				break;
+			}
+		}
 		return float4(fragcolor, 1.0);
 	}
 
-	#define lightCount 6
-	#define ambient 0.0
-
 	// Ambient part
 	fragcolor = albedo.rgb * ambient;
 
-	for(int i = 0; i < lightCount; ++i)
-	{
-		// Vector to light
-		float3 L = ubo.lights[i].position.xyz - fragPos;
-		// Distance from light to fragment position
-		float dist = length(L);
-
-		// Viewer to fragment
-		float3 V = ubo.viewPos.xyz - fragPos;
-		V = normalize(V);
-
-		//if(dist < ubo.lights[i].radius)
-		{
-			// Light to fragment
-			L = normalize(L);
-
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
-
-			// Diffuse part
-			float3 N = normalize(normal);
-			float NdotL = max(0.0, dot(N, L));
-			float3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
-
-			// Specular part
-			// Specular map values are stored in alpha of albedo mrt
-			float3 R = reflect(-L, N);
-			float NdotR = max(0.0, dot(R, V));
-			float3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
-
-			fragcolor += diff + spec;
+	float3 N = normalize(normal);
+	// Viewer to fragment
+	float3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	if (ubo.clustered == 1) {
+		// Only visit the lights that have been assigned to the fragment's cluster
+		uint clusterIndex = getClusterIndex(fragPos, inUV);
+		uint count = lightGrid[clusterIndex];
+		for (uint i = 0; i < count; ++i) {
+			fragcolor += shadeLight(lights[lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]], fragPos, N, V, albedo);
+		}
+	} else {
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			fragcolor += shadeLight(lights[i], fragPos, N, V, albedo);
 		}
 	}
 
   return float4(fragcolor, 1.0);
-}
\ No newline at end of file
+}
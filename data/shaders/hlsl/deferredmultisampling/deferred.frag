@@ -15,16 +15,30 @@ struct Light {
 
 struct UBO
 {
-	Light lights[6];
+	float4x4 view;
+	float4x4 invProjection;
 	float4 viewPos;
 	int debugDisplayTarget;
+	int lightCount;
+	int clustered;
+	float zNear;
+	float zFar;
 };
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
-[[vk::constant_id(0)]] const int NUM_SAMPLES = 8;
+StructuredBuffer<Light> lights : register(t5);
+
+// Light lists of the view space clusters written by the light culling compute shader
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
 
-#define NUM_LIGHTS 6
+StructuredBuffer<uint> lightGrid : register(t6);
+StructuredBuffer<uint> lightIndices : register(t7);
+
+[[vk::constant_id(0)]] const int NUM_SAMPLES = 8;
 
 // Manual resolve for MSAA samples
 float4 resolve(Texture2DMS<float4> tex, int2 uv)
@@ -40,38 +54,60 @@ float4 resolve(Texture2DMS<float4> tex, int2 uv)
 	return result / float(NUM_SAMPLES);
 }
 
-float3 calculateLighting(float3 pos, float3 normal, float4 albedo)
+float3 shadeLight(Light light, float3 pos, float3 N, float3 V, float4 albedo)
 {
-	float3 result = float3(0.0, 0.0, 0.0);
+	// Vector to light
+	float3 L = light.position.xyz - pos;
+	// Distance from light to fragment position
+	float dist = length(L);
 
-	for(int i = 0; i < NUM_LIGHTS; ++i)
-	{
-		// Vector to light
-		float3 L = ubo.lights[i].position.xyz - pos;
-		// Distance from light to fragment position
-		float dist = length(L);
+	// Light to fragment
+	L = normalize(L);
 
-		// Viewer to fragment
-		float3 V = ubo.viewPos.xyz - pos;
-		V = normalize(V);
+	// Attenuation, windowed so that the light has no influence beyond its radius
+	float window = saturate(1.0 - pow(dist / light.radius, 4.0));
+	float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
 
-		// Light to fragment
-		L = normalize(L);
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	float3 diff = light.color * albedo.rgb * NdotL * atten;
 
-		// Attenuation
-		float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
+	// Specular part
+	float3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	float3 spec = light.color * albedo.a * pow(NdotR, 8.0) * atten;
 
-		// Diffuse part
-		float3 N = normalize(normal);
-		float NdotL = max(0.0, dot(N, L));
-		float3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
+	return diff + spec;
+}
 
-		// Specular part
-		float3 R = reflect(-L, N);
-		float NdotR = max(0.0, dot(R, V));
-		float3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 8.0) * atten;
+// Samples of a pixel can have different depths, so the cluster is looked up for each sample
+uint getClusterIndex(float3 pos, float2 uv)
+{
+	float depth = -mul(ubo.view, float4(pos, 1.0)).z;
+	uint slice = uint(clamp(log(depth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+	uint2 tile = min(uint2(uv * float2(CLUSTER_X, CLUSTER_Y)), uint2(CLUSTER_X - 1, CLUSTER_Y - 1));
+	return tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+}
+
+float3 calculateLighting(float3 pos, float3 normal, float4 albedo, float2 uv)
+{
+	float3 result = float3(0.0, 0.0, 0.0);
 
-		result += diff + spec;
+	float3 N = normalize(normal);
+	// Viewer to fragment
+	float3 V = normalize(ubo.viewPos.xyz - pos);
+
+	if (ubo.clustered == 1) {
+		// Only visit the lights that have been assigned to the sample's cluster
+		uint clusterIndex = getClusterIndex(pos, uv);
+		uint count = lightGrid[clusterIndex];
+		for (uint i = 0; i < count; ++i) {
+			result += shadeLight(lights[lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]], pos, N, V, albedo);
+		}
+	} else {
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			result += shadeLight(lights[i], pos, N, V, albedo);
+		}
 	}
 	return result;
 }
@@ -100,6 +136,12 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 			case 4: 
 				fragColor.rgb = textureAlbedo.Load(UV, 0, int2(0, 0), status).aaa;
 				break;
+			case 5: {
+				// Number of lights in the cluster of the first sample (green to red)
+				float heat = float(lightGrid[getClusterIndex(texturePosition.Load(UV, 0, int2(0, 0), status).rgb, inUV)]) / float(MAX_LIGHTS_PER_CLUSTER);
+				fragColor.rgb = lerp(float3(0.0, 1.0, 0.0), float3(1.0, 0.0, 0.0), heat);
+				break;
+			}
 		}		
 		return float4(fragColor, 1.0);
 	}
@@ -116,7 +158,7 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		float3 pos = texturePosition.Load(UV, i, int2(0, 0), status).rgb;
 		float3 normal = textureNormal.Load(UV, i, int2(0, 0), status).rgb;
 		float4 albedo = textureAlbedo.Load(UV, i, int2(0, 0), status);
-		fragColor += calculateLighting(pos, normal, albedo);
+		fragColor += calculateLighting(pos, normal, albedo, inUV);
 	}
 
 	fragColor = (alb.rgb * ambient) + fragColor / float(NUM_SAMPLES);
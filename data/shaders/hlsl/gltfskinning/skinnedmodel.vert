@@ -0,0 +1,59 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 Color : COLOR0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4 lightPos;
+};
+cbuffer ubo : register(b0, space0) { UBO ubo; }
+
+// Vertices skinned by the compute shader, one block of vertices per instance
+struct SkinnedVertex
+{
+	float4 pos;
+	float4 normal;
+};
+StructuredBuffer<SkinnedVertex> skinnedVertices : register(t0, space1);
+
+struct PushConsts
+{
+	uint vertexCount;
+};
+[[vk::push_constant]] PushConsts push;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+};
+
+VSOutput main(VSInput input, uint VertexIndex : SV_VertexID, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	output.Color = input.Color;
+	output.UV = input.UV;
+
+	// Fetch the already skinned vertex of the current instance
+	SkinnedVertex skinnedVertex = skinnedVertices[InstanceIndex * push.vertexCount + VertexIndex];
+
+	output.Pos = mul(ubo.projection, mul(ubo.view, skinnedVertex.pos));
+
+	output.Normal = mul((float3x3)ubo.view, skinnedVertex.normal.xyz);
+
+	float4 pos = mul(ubo.view, skinnedVertex.pos);
+	float3 lPos = mul((float3x3)ubo.view, ubo.lightPos.xyz);
+	output.LightVec = lPos - pos.xyz;
+	output.ViewVec = -pos.xyz;
+	return output;
+}
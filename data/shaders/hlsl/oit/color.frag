@@ -26,6 +26,15 @@ struct Particle
 // Binding 0 : Position storage buffer
 RWStructuredBuffer<Node> nodes : register(u1);
 
+// Statistics read back by the application to size the node pool
+struct GeometrySBO
+{
+    uint nodeCount;
+    uint maxNodeCount;
+    uint peakFragmentCount;
+};
+RWStructuredBuffer<GeometrySBO> geometrySBO : register(u2);
+
 float4 main(VSOutput input) : SV_TARGET
 {
     Node fragments[MAX_FRAGMENT_COUNT];
@@ -39,6 +48,12 @@ float4 main(VSOutput input) : SV_TARGET
         nodeIdx = fragments[count].next;
         ++count;
     }
+
+    // Longest list of this frame, the non-atomic check avoids most of the atomic operations
+    if (uint(count) > geometrySBO[0].peakFragmentCount)
+    {
+        InterlockedMax(geometrySBO[0].peakFragmentCount, uint(count));
+    }
     
     // Do the insertion sort
     for (uint i = 1; i < count; ++i)
@@ -16,6 +16,7 @@ struct GeometrySBO
 {
     uint count;
     uint maxNodeCount;
+    uint peakFragmentCount;
 };
 // Binding 0 : Position storage buffer
 RWStructuredBuffer<GeometrySBO> geometrySBO : register(u1);
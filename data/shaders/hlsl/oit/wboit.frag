@@ -0,0 +1,47 @@
+// Copyright 2020 Google LLC
+
+// Weighted blended order independent transparency (McGuire and Bavoil)
+// Accumulates weighted premultiplied colors and the total coverage without per-pixel lists or sorting
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+struct RenderPassUBO
+{
+    float4x4 projection;
+    float4x4 view;
+};
+
+cbuffer renderPassUBO : register(b0) { RenderPassUBO renderPassUBO; }
+
+struct PushConsts {
+	float4x4 model;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct FSOutput
+{
+	float4 Accum : SV_TARGET0;
+	float Revealage : SV_TARGET1;
+};
+
+FSOutput main(VSOutput input)
+{
+    FSOutput output;
+    float4 color = pushConsts.color;
+
+    // Linear view space depth reconstructed from the projection
+    float depth = renderPassUBO.projection[2][3] / (input.Pos.z + renderPassUBO.projection[2][2]);
+
+    // Closer and more opaque fragments get higher weights
+    float weight = color.a * clamp(10.0 / (1e-5 + pow(depth / 5.0, 2.0) + pow(depth / 200.0, 6.0)), 1e-2, 3e3);
+
+    // Blended additively
+    output.Accum = float4(color.rgb * color.a, color.a) * weight;
+    // Blended with (zero, one minus source color), so the attachment stores the product of all (1 - alpha)
+    output.Revealage = color.a;
+    return output;
+}
@@ -0,0 +1,23 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+Texture2D textureAccum : register(t0);
+SamplerState samplerAccum : register(s0);
+Texture2D textureRevealage : register(t1);
+SamplerState samplerRevealage : register(s1);
+
+float4 main(VSOutput input) : SV_TARGET
+{
+    int3 coord = int3(input.Pos.xy, 0);
+    float4 accum = textureAccum.Load(coord);
+    float revealage = textureRevealage.Load(coord).r;
+
+    // Weighted average color of all transparent fragments, blended over the background by their total coverage
+    float3 color = accum.rgb / max(accum.a, 1e-5);
+    float3 background = float3(0.025, 0.025, 0.025);
+    return float4(lerp(color, background, revealage), 1.0);
+}
@@ -0,0 +1,40 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+	uint Layer : SV_RenderTargetArrayIndex;
+[[vk::location(0)]] float4 WorldPos : POSITION0;
+[[vk::location(1)]] float3 LightPos : POSITION1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 model;
+	float4 lightPos;
+	float4x4 faceViewProjection[6];
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct PushConsts
+{
+	// Indices of the cube map faces this draw is visible in, three bits per face
+	uint faces;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+VSOutput main([[vk::location(0)]] float3 Pos : POSITION0, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// Each instance renders to one of the cube map faces
+	uint face = (pushConsts.faces >> (3 * InstanceIndex)) & 7;
+	output.Layer = face;
+	output.Pos = mul(ubo.faceViewProjection[face], mul(ubo.model, float4(Pos, 1.0)));
+
+	output.WorldPos = float4(Pos, 1.0);
+	output.LightPos = ubo.lightPos.xyz;
+	return output;
+}
@@ -10,6 +10,8 @@ Texture2D textureSSAO : register(t3);
 SamplerState samplerSSAO : register(s3);
 Texture2D textureSSAOBlur : register(t4);
 SamplerState samplerSSAOBlur : register(s4);
+Texture2D textureSSAODepth : register(t6);
+SamplerState samplerSSAODepth : register(s6);
 struct UBO
 {
 	float4x4 _dummy;
@@ -19,13 +21,37 @@ struct UBO
 };
 cbuffer uboParams : register(b5) { UBO uboParams; };
 
+// Depth-aware (bilateral) upsampling of SSAO rendered at a lower resolution
+// Bilinear weights of the four closest SSAO texels are scaled down for texels with a different depth, so occlusion doesn't bleed across edges
+float upsampleSSAO(Texture2D textureAO, SamplerState samplerAO, float2 uv, float depth)
+{
+	int2 texDim;
+	textureAO.GetDimensions(texDim.x, texDim.y);
+	float2 texelPos = uv * float2(texDim) - 0.5;
+	int2 baseCoord = int2(floor(texelPos));
+	float2 f = frac(texelPos);
+	float result = 0.0;
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++) {
+		int2 offset = int2(i & 1, i >> 1);
+		int2 coord = clamp(baseCoord + offset, int2(0, 0), texDim - 1);
+		float bilinearWeight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		float sampleDepth = textureSSAODepth.Load(int3(coord, 0)).w;
+		float weight = bilinearWeight / (abs(depth - sampleDepth) / max(depth, 0.0001) + 0.001);
+		result += textureAO.Load(int3(coord, 0)).r * weight;
+		weightSum += weight;
+	}
+	return (weightSum > 0.0) ? result / weightSum : textureAO.Sample(samplerAO, uv).r;
+}
+
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
-	float3 fragPos = textureposition.Sample(samplerposition, inUV).rgb;
+	float4 positionDepth = textureposition.Sample(samplerposition, inUV);
+	float3 fragPos = positionDepth.rgb;
 	float3 normal = normalize(textureNormal.Sample(samplerNormal, inUV).rgb * 2.0 - 1.0);
 	float4 albedo = textureAlbedo.Sample(samplerAlbedo, inUV);
 
-	float ssao = (uboParams.ssaoBlur == 1) ? textureSSAOBlur.Sample(samplerSSAOBlur, inUV).r : textureSSAO.Sample(samplerSSAO, inUV).r;
+	float ssao = (uboParams.ssaoBlur == 1) ? upsampleSSAO(textureSSAOBlur, samplerSSAOBlur, inUV, positionDepth.w) : upsampleSSAO(textureSSAO, samplerSSAO, inUV, positionDepth.w);
 
 	float3 lightPos = float3(0.0, 0.0, 0.0);
 	float3 L = normalize(lightPos - fragPos);
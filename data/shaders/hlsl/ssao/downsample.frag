@@ -0,0 +1,42 @@
+// Copyright 2020 Google LLC
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureNormal : register(t1);
+SamplerState samplerNormal : register(s1);
+
+struct PushConsts {
+	int divisor;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct FSOutput
+{
+	float4 Position : SV_TARGET0;
+	float4 Normal : SV_TARGET1;
+};
+
+FSOutput main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_Position)
+{
+	// Select the closest sample of the footprint instead of averaging, so positions and normals stay consistent across depth discontinuities
+	int2 srcCoord = int2(fragCoord.xy) * pushConsts.divisor;
+	int2 srcSize;
+	texturePositionDepth.GetDimensions(srcSize.x, srcSize.y);
+	int2 srcMax = srcSize - 1;
+	int2 selected = min(srcCoord, srcMax);
+	float minDepth = texturePositionDepth.Load(int3(selected, 0)).w;
+	for (int y = 0; y < pushConsts.divisor; y++) {
+		for (int x = 0; x < pushConsts.divisor; x++) {
+			int2 coord = min(srcCoord + int2(x, y), srcMax);
+			float depth = texturePositionDepth.Load(int3(coord, 0)).w;
+			if (depth < minDepth) {
+				minDepth = depth;
+				selected = coord;
+			}
+		}
+	}
+	FSOutput output;
+	output.Position = texturePositionDepth.Load(int3(selected, 0));
+	output.Normal = textureNormal.Load(int3(selected, 0));
+	return output;
+}
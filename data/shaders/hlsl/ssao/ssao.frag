@@ -20,6 +20,13 @@ cbuffer uboSSAOKernel : register(b3) { UBOSSAOKernel uboSSAOKernel; };
 struct UBO
 {
 	float4x4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	// With temporal accumulation only every kernelStride-th sample of the kernel is taken per frame
+	int kernelOffset;
+	int kernelStride;
+	int frameIndex;
 };
 cbuffer ubo : register(b4) { UBO ubo; };
 
@@ -35,7 +42,9 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	int2 noiseDim;
 	ssaoNoiseTexture.GetDimensions(noiseDim.x, noiseDim.y);
 	const float2 noiseUV = float2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;
-	float3 randomVec = ssaoNoiseTexture.Sample(ssaoNoiseSampler, noiseUV).xyz * 2.0 - 1.0;
+	// Rotate the noise pattern between frames, so temporal accumulation sees different sample directions
+	const float2 noiseOffset = float2(ubo.frameIndex % noiseDim.x, (ubo.frameIndex / noiseDim.x) % noiseDim.y) / float2(noiseDim);
+	float3 randomVec = ssaoNoiseTexture.Sample(ssaoNoiseSampler, noiseUV + noiseOffset).xyz * 2.0 - 1.0;
 
 	// Create TBN matrix
 	float3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -44,7 +53,8 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 
 	// Calculate occlusion value
 	float occlusion = 0.0f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	int sampleCount = 0;
+	for(int i = ubo.kernelOffset; i < SSAO_KERNEL_SIZE; i += ubo.kernelStride)
 	{
 		float3 samplePos = mul(TBN, uboSSAOKernel.samples[i].xyz);
 		samplePos = fragPos + samplePos * SSAO_RADIUS;
@@ -59,8 +69,9 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z ? 1.0f : 0.0f) * rangeCheck;
+		sampleCount++;
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(max(sampleCount, 1)));
 
 	return occlusion;
 }
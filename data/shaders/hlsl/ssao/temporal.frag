@@ -0,0 +1,47 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureSSAO : register(t0);
+SamplerState samplerSSAO : register(s0);
+Texture2D textureHistory : register(t1);
+SamplerState samplerHistory : register(s1);
+Texture2D texturePositionDepth : register(t2);
+SamplerState samplerPositionDepth : register(s2);
+
+struct UBO
+{
+	float4x4 _dummy;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int kernelOffset;
+	int kernelStride;
+	int frameIndex;
+	int historyValid;
+	float4x4 reprojection;
+};
+cbuffer uboParams : register(b3) { UBO uboParams; };
+
+// Number of frames the kernel is spread across
+[[vk::constant_id(0)]] const int TEMPORAL_FRAMES = 4;
+
+// Returns the accumulated occlusion and linear depth used for rejecting the history in the next frame
+float2 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float4 positionDepth = texturePositionDepth.Sample(samplerPositionDepth, inUV);
+	float occlusion = textureSSAO.Sample(samplerSSAO, inUV).r;
+
+	// Reproject into the previous frame, w is the linear depth the fragment had in that frame
+	float4 prevPos = mul(uboParams.reprojection, float4(positionDepth.xyz, 1.0));
+	float2 prevUV = (prevPos.xy / prevPos.w) * 0.5 + 0.5;
+
+	if ((uboParams.historyValid == 1) && all(prevUV >= 0.0) && all(prevUV <= 1.0)) {
+		float2 history = textureHistory.Sample(samplerHistory, prevUV).rg;
+		// Discard the history if it belongs to a different surface (disocclusion)
+		if (abs(history.g - prevPos.w) < 0.05 * prevPos.w) {
+			float historyWeight = 1.0 - 1.0 / float(TEMPORAL_FRAMES);
+			occlusion = lerp(occlusion, history.r, historyWeight);
+		}
+	}
+
+	return float2(occlusion, positionDepth.w);
+}
@@ -3,6 +3,20 @@
 Texture2D textureColor : register(t1);
 SamplerState samplerColor : register(s1);
 
+// Page requests read back by the application, one entry per page
+RWStructuredBuffer<uint> requests : register(u2);
+
+struct PageTable
+{
+	// xy = texture size, zw = page size
+	uint4 dimensions;
+	// x = pages horizontally, y = pages vertically, z = index of the first page
+	uint4 mipLevels[16];
+	uint mipTailStart;
+};
+
+cbuffer pageTable : register(b3) { PageTable pageTable; }
+
 struct VSOutput
 {
 [[vk::location(0)]] float2 UV : TEXCOORD0;
@@ -16,14 +30,35 @@ float4 main(VSOutput input) : SV_TARGET
 {
 	float4 color = float4(0.0, 0.0, 0.0, 0.0);
 
-	// Fetch sparse until we get a valid texel
-	uint status;
-	float minLod = input.LodBias;
-	do
+	float lod = max(textureColor.CalculateLevelOfDetailUnclamped(samplerColor, input.UV) + input.LodBias, 0.0);
+	uint mipLevel = uint(lod);
+
+	// Request the page covering this texel (pages in the mip tail are always resident)
+	if (mipLevel < pageTable.mipTailStart)
+	{
+		uint4 pages = pageTable.mipLevels[mipLevel];
+		uint2 mipSize = max(pageTable.dimensions.xy >> mipLevel, uint2(1, 1));
+		uint2 page = min(uint2(saturate(input.UV) * float2(mipSize)) / pageTable.dimensions.zw, pages.xy - 1);
+		requests[pages.z + page.y * pages.x + page.x] = 1;
+	}
+
+	// Fall back to coarser mip levels until a resident texel is found
+	// Explicit lods are used, as the loop makes derivatives undefined
+	bool texelResident = false;
+	for (uint level = mipLevel; level < pageTable.mipTailStart; level++)
+	{
+		uint status;
+		color = textureColor.SampleLevel(samplerColor, input.UV, max(lod, float(level)), 0, status);
+		if (CheckAccessFullyMapped(status))
+		{
+			texelResident = true;
+			break;
+		}
+	}
+	if (!texelResident)
 	{
-		color = textureColor.SampleLevel(samplerColor, input.UV, minLod, 0, status);
-		minLod += 1.0f;
-	} while(!CheckAccessFullyMapped(status));
+		color = textureColor.SampleLevel(samplerColor, input.UV, max(lod, float(pageTable.mipTailStart)));
+	}
 
 	float3 N = normalize(input.Normal);
 
@@ -33,4 +68,4 @@ float4 main(VSOutput input) : SV_TARGET
 	float3 R = reflect(-L, N);
 	float3 diffuse = max(dot(N, L), 0.25) * color.rgb;
 	return float4(diffuse, 1.0);
-}
\ No newline at end of file
+}
@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -15,11 +16,28 @@
 #define FB_DIM 256
 #define FB_COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM
 
+// Work group size of the mip chain compute shaders
+#define MIPCHAIN_GROUP_SIZE 8
+#define MIPCHAIN_MAX_LEVELS 16u
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool bloom = true;
 
+	/*
+		Gaussian: Separable blur of the glow pass in a fixed size (FB_DIM) offscreen target
+		Mip chain: Glow pass at output resolution, progressively downsampled and tent filtered upsampled through a mip chain in compute shaders
+	*/
+	enum BloomMode { BLOOM_GAUSSIAN = 0, BLOOM_MIPCHAIN = 1 };
+	int32_t bloomMode = BLOOM_GAUSSIAN;
+	bool mipChainSupported = false;
+	// Store the mip chain in a half float format instead of 8 bit unorm
+	bool halfFloatMipChain = true;
+
+	// Timestamps before and after the bloom passes
+	vks::TimestampQuery timestampQuery;
+
 	vks::TextureCubeMap cubemap;
 
 	struct {
@@ -93,6 +111,28 @@ public:
 		std::array<FrameBuffer, 2> framebuffers;
 	} offscreenPass;
 
+	// Image with one view per mip level, written by the mip chain compute shaders
+	struct MipChainImage {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		std::vector<VkImageView> levelViews;
+	};
+	struct MipChain {
+		uint32_t width, height;
+		uint32_t levelCount = 0;
+		VkFormat format;
+		// Glow pass at output resolution, uses the offscreen render pass
+		FrameBuffer glow;
+		// Level 0 of both chains is half the output resolution
+		MipChainImage down, up;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		std::vector<VkDescriptorSet> downsampleSets, upsampleSets;
+		VkDescriptorSet compositeSet;
+		VkPipeline downsample, upsample, composite;
+	} mipChain;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Bloom (offscreen rendering)";
@@ -113,18 +153,22 @@ public:
 		// Frame buffer
 		for (auto& framebuffer : offscreenPass.framebuffers)
 		{
-			// Attachments
-			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkDestroyImage(device, framebuffer.color.image, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
-			vkDestroyImageView(device, framebuffer.depth.view, nullptr);
-			vkDestroyImage(device, framebuffer.depth.image, nullptr);
-			vkFreeMemory(device, framebuffer.depth.mem, nullptr);
-
-			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
+			destroyOffscreenFramebuffer(&framebuffer);
 		}
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
+		// Mip chain
+		if (mipChainSupported) {
+			destroyMipChain();
+			vkDestroyPipeline(device, mipChain.downsample, nullptr);
+			vkDestroyPipeline(device, mipChain.upsample, nullptr);
+			vkDestroyPipeline(device, mipChain.composite, nullptr);
+			vkDestroyPipelineLayout(device, mipChain.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, mipChain.descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, mipChain.descriptorPool, nullptr);
+		}
+		timestampQuery.destroy();
+
 		vkDestroyPipeline(device, pipelines.blurHorz, nullptr);
 		vkDestroyPipeline(device, pipelines.blurVert, nullptr);
 		vkDestroyPipeline(device, pipelines.phongPass, nullptr);
@@ -145,16 +189,24 @@ public:
 		cubemap.destroy();
 	}
 
+	void getEnabledFeatures()
+	{
+		// The mip chain compute shaders write to storage images without a format qualifier, so the chain's format can be changed at runtime
+		if (deviceFeatures.shaderStorageImageWriteWithoutFormat) {
+			enabledFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+		}
+	}
+
 	// Setup the offscreen framebuffer for rendering the mirrored scene
 	// The color attachment of this framebuffer will then be sampled from
-	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat)
+	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat, uint32_t width, uint32_t height)
 	{
 		// Color attachment
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 		image.imageType = VK_IMAGE_TYPE_2D;
 		image.format = colorFormat;
-		image.extent.width = FB_DIM;
-		image.extent.height = FB_DIM;
+		image.extent.width = width;
+		image.extent.height = height;
 		image.extent.depth = 1;
 		image.mipLevels = 1;
 		image.arrayLayers = 1;
@@ -220,8 +272,8 @@ public:
 		fbufCreateInfo.renderPass = offscreenPass.renderPass;
 		fbufCreateInfo.attachmentCount = 2;
 		fbufCreateInfo.pAttachments = attachments;
-		fbufCreateInfo.width = FB_DIM;
-		fbufCreateInfo.height = FB_DIM;
+		fbufCreateInfo.width = width;
+		fbufCreateInfo.height = height;
 		fbufCreateInfo.layers = 1;
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuf->framebuffer));
@@ -232,6 +284,17 @@ public:
 		frameBuf->descriptor.sampler = offscreenPass.sampler;
 	}
 
+	void destroyOffscreenFramebuffer(FrameBuffer* frameBuf)
+	{
+		vkDestroyImageView(device, frameBuf->color.view, nullptr);
+		vkDestroyImage(device, frameBuf->color.image, nullptr);
+		vkFreeMemory(device, frameBuf->color.mem, nullptr);
+		vkDestroyImageView(device, frameBuf->depth.view, nullptr);
+		vkDestroyImage(device, frameBuf->depth.image, nullptr);
+		vkFreeMemory(device, frameBuf->depth.mem, nullptr);
+		vkDestroyFramebuffer(device, frameBuf->framebuffer, nullptr);
+	}
+
 	// Prepare the offscreen framebuffers used for the vertical- and horizontal blur
 	void prepareOffscreen()
 	{
@@ -321,8 +384,172 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenPass.sampler));
 
 		// Create two frame buffers
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[0], FB_COLOR_FORMAT, fbDepthFormat);
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[1], FB_COLOR_FORMAT, fbDepthFormat);
+		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[0], FB_COLOR_FORMAT, fbDepthFormat, FB_DIM, FB_DIM);
+		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[1], FB_COLOR_FORMAT, fbDepthFormat, FB_DIM, FB_DIM);
+	}
+
+	void createMipChainImage(MipChainImage* chainImage, uint32_t levelCount)
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = mipChain.format;
+		imageCI.extent = { mipChain.width, mipChain.height, 1 };
+		imageCI.mipLevels = levelCount;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &chainImage->image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, chainImage->image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &chainImage->mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, chainImage->image, chainImage->mem, 0));
+
+		// Each level is read and written through its own view
+		chainImage->levelViews.resize(levelCount);
+		for (uint32_t i = 0; i < levelCount; i++) {
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = mipChain.format;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+			viewCI.image = chainImage->image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &chainImage->levelViews[i]));
+		}
+	}
+
+	void destroyMipChainImage(MipChainImage* chainImage)
+	{
+		for (auto& view : chainImage->levelViews) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		chainImage->levelViews.clear();
+		vkDestroyImage(device, chainImage->image, nullptr);
+		vkFreeMemory(device, chainImage->mem, nullptr);
+	}
+
+	// (Re)create the output resolution dependent resources of the mip chain bloom
+	void prepareMipChain()
+	{
+		VkFormat fbDepthFormat;
+		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
+		assert(validDepthFormat);
+
+		prepareOffscreenFramebuffer(&mipChain.glow, FB_COLOR_FORMAT, fbDepthFormat, width, height);
+
+		// The number of levels grows with the output resolution, so the bloom radius stays the same relative to the screen size
+		// The smallest level is 8 to 15 texels high (or wide)
+		mipChain.width = std::max(width / 2, 2u);
+		mipChain.height = std::max(height / 2, 2u);
+		const int32_t levelCount = (int32_t)std::floor(std::log2((float)std::min(mipChain.width, mipChain.height))) - 2;
+		mipChain.levelCount = std::min((uint32_t)std::max(levelCount, 2), MIPCHAIN_MAX_LEVELS);
+		mipChain.format = halfFloatMipChain ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+
+		// The upsampled chain doesn't need the smallest level, the upsampling starts from the smallest downsampled level
+		createMipChainImage(&mipChain.down, mipChain.levelCount);
+		createMipChainImage(&mipChain.up, mipChain.levelCount - 1);
+
+		// Chain images stay in general layout, they're both written (storage) and read (sampled)
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(layoutCmd, mipChain.down.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipChain.levelCount, 0, 1 });
+		vks::tools::setImageLayout(layoutCmd, mipChain.up.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipChain.levelCount - 1, 0, 1 });
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
+		// Descriptor sets for every downsample and upsample step
+		VK_CHECK_RESULT(vkResetDescriptorPool(device, mipChain.descriptorPool, 0));
+		std::vector<VkDescriptorSetLayout> setLayouts(mipChain.levelCount, mipChain.descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(mipChain.descriptorPool, setLayouts.data(), mipChain.levelCount);
+		mipChain.downsampleSets.resize(mipChain.levelCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, mipChain.downsampleSets.data()));
+		allocInfo.descriptorSetCount = mipChain.levelCount - 1;
+		mipChain.upsampleSets.resize(mipChain.levelCount - 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, mipChain.upsampleSets.data()));
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(mipChain.descriptorPool, &descriptorSetLayouts.blur, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &mipChain.compositeSet));
+
+		for (uint32_t i = 0; i < mipChain.levelCount; i++) {
+			// Level 0 is downsampled from the glow pass, all others from the previous level
+			VkDescriptorImageInfo sourceDescriptor = (i == 0) ? mipChain.glow.descriptor : vks::initializers::descriptorImageInfo(offscreenPass.sampler, mipChain.down.levelViews[i - 1], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo destDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, mipChain.down.levelViews[i], VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(mipChain.downsampleSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sourceDescriptor),
+				vks::initializers::writeDescriptorSet(mipChain.downsampleSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &sourceDescriptor),
+				vks::initializers::writeDescriptorSet(mipChain.downsampleSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &destDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+		for (uint32_t i = 0; i < mipChain.levelCount - 1; i++) {
+			// The smallest upsampled level is generated from the smallest downsampled level
+			VkImageView lowerView = (i == mipChain.levelCount - 2) ? mipChain.down.levelViews[i + 1] : mipChain.up.levelViews[i + 1];
+			VkDescriptorImageInfo currentDescriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, mipChain.down.levelViews[i], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo lowerDescriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, lowerView, VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo destDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, mipChain.up.levelViews[i], VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(mipChain.upsampleSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &currentDescriptor),
+				vks::initializers::writeDescriptorSet(mipChain.upsampleSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &lowerDescriptor),
+				vks::initializers::writeDescriptorSet(mipChain.upsampleSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &destDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+		VkDescriptorImageInfo compositeDescriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, mipChain.up.levelViews[0], VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(mipChain.compositeSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),
+			vks::initializers::writeDescriptorSet(mipChain.compositeSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &compositeDescriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void destroyMipChain()
+	{
+		destroyOffscreenFramebuffer(&mipChain.glow);
+		destroyMipChainImage(&mipChain.down);
+		destroyMipChainImage(&mipChain.up);
+	}
+
+	void recreateMipChain()
+	{
+		vkDeviceWaitIdle(device);
+		destroyMipChain();
+		prepareMipChain();
+		buildCommandBuffers();
+	}
+
+	// Record the compute passes that generate the bloom from the glow pass
+	void recordMipChain(VkCommandBuffer commandBuffer)
+	{
+		// Downsample, each level is read by the next dispatch
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mipChain.downsample);
+		for (uint32_t i = 0; i < mipChain.levelCount; i++) {
+			const uint32_t levelWidth = std::max(mipChain.width >> i, 1u);
+			const uint32_t levelHeight = std::max(mipChain.height >> i, 1u);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mipChain.pipelineLayout, 0, 1, &mipChain.downsampleSets[i], 0, nullptr);
+			vkCmdDispatch(commandBuffer, (levelWidth + MIPCHAIN_GROUP_SIZE - 1) / MIPCHAIN_GROUP_SIZE, (levelHeight + MIPCHAIN_GROUP_SIZE - 1) / MIPCHAIN_GROUP_SIZE, 1);
+			vks::tools::insertImageMemoryBarrier(commandBuffer, mipChain.down.image,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 });
+		}
+
+		// Upsample from the smallest level back up to level 0, which is then composited on top of the scene
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mipChain.upsample);
+		for (int32_t i = mipChain.levelCount - 2; i >= 0; i--) {
+			const uint32_t levelWidth = std::max(mipChain.width >> i, 1u);
+			const uint32_t levelHeight = std::max(mipChain.height >> i, 1u);
+			// Normalize the sum of all levels in the last step
+			const float scale = (i == 0) ? 1.0f / (float)mipChain.levelCount : 1.0f;
+			vkCmdPushConstants(commandBuffer, mipChain.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float), &scale);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mipChain.pipelineLayout, 0, 1, &mipChain.upsampleSets[i], 0, nullptr);
+			vkCmdDispatch(commandBuffer, (levelWidth + MIPCHAIN_GROUP_SIZE - 1) / MIPCHAIN_GROUP_SIZE, (levelHeight + MIPCHAIN_GROUP_SIZE - 1) / MIPCHAIN_GROUP_SIZE, 1);
+			vks::tools::insertImageMemoryBarrier(commandBuffer, mipChain.up.image,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, (i == 0) ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, (uint32_t)i, 1, 0, 1 });
+		}
 	}
 
 	void buildCommandBuffers()
@@ -342,7 +569,52 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			if (bloom) {
+			timestampQuery.reset(drawCmdBuffers[i]);
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
+			if (bloom && (bloomMode == BLOOM_MIPCHAIN)) {
+				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+				clearValues[1].depthStencil = { 1.0f, 0 };
+
+				/*
+					First render pass: Render glow parts of the model at output resolution
+				*/
+
+				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+				renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+				renderPassBeginInfo.framebuffer = mipChain.glow.framebuffer;
+				renderPassBeginInfo.renderArea.extent.width = width;
+				renderPassBeginInfo.renderArea.extent.height = height;
+				renderPassBeginInfo.clearValueCount = 2;
+				renderPassBeginInfo.pClearValues = clearValues;
+
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+				viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+				scissor = vks::initializers::rect2D(width, height, 0, 0);
+				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
+				models.ufoGlow.draw(drawCmdBuffers[i]);
+
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+				// The render pass only synchronizes with fragment shader reads, so the glow pass needs to be made visible to the compute shaders
+				vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], mipChain.glow.color.image,
+					VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+
+				/*
+					Compute passes: Progressive downsample and upsample through the mip chain
+				*/
+				recordMipChain(drawCmdBuffers[i]);
+			}
+
+			if (bloom && (bloomMode == BLOOM_GAUSSIAN)) {
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
 
@@ -391,6 +663,8 @@ public:
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+
 			/*
 				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
 			*/
@@ -434,13 +708,20 @@ public:
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
 				models.ufo.draw(drawCmdBuffers[i]);
 
-				if (bloom)
+				if (bloom && (bloomMode == BLOOM_GAUSSIAN))
 				{
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 				}
 
+				if (bloom && (bloomMode == BLOOM_MIPCHAIN))
+				{
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &mipChain.compositeSet, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, mipChain.composite);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				}
+
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -468,6 +749,17 @@ public:
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		// The mip chain's descriptor sets depend on the number of levels, so they're allocated from a separate pool that is reset when the chain is recreated
+		if (mipChainSupported) {
+			poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MIPCHAIN_MAX_LEVELS * 4 + 1),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MIPCHAIN_MAX_LEVELS * 2)
+			};
+			descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, MIPCHAIN_MAX_LEVELS * 2 + 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &mipChain.descriptorPool));
+		}
 	}
 
 	void setupDescriptorSetLayout()
@@ -497,6 +789,22 @@ public:
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.scene));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.scene, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
+
+		// Mip chain downsample and upsample
+		if (mipChainSupported) {
+			setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),		// Binding 0: Source (downsample) or current level (upsample)
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),		// Binding 1: Lower level (upsample)
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),				// Binding 2: Destination level
+			};
+			descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &mipChain.descriptorSetLayout));
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(float), 0);
+			pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&mipChain.descriptorSetLayout, 1);
+			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &mipChain.pipelineLayout));
+		}
 	}
 
 	void setupDescriptorSet()
@@ -617,6 +925,24 @@ public:
 		rasterizationStateCI.cullMode = VK_CULL_MODE_FRONT_BIT;
 		pipelineCI.renderPass = renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skyBox));
+
+		if (mipChainSupported) {
+			// Mip chain composition, added on top of the scene like the horizontal blur
+			shaderStages[0] = loadShader(getShadersPath() + "bloom/gaussblur.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "bloom/composite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			pipelineCI.pVertexInputState = &emptyInputState;
+			pipelineCI.layout = pipelineLayouts.blur;
+			blendAttachmentState.blendEnable = VK_TRUE;
+			rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &mipChain.composite));
+
+			// Mip chain downsample and upsample compute pipelines
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(mipChain.pipelineLayout, 0);
+			computePipelineCI.stage = loadShader(getShadersPath() + "bloom/downsample.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &mipChain.downsample));
+			computePipelineCI.stage = loadShader(getShadersPath() + "bloom/upsample.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &mipChain.upsample));
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -692,6 +1018,7 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		mipChainSupported = enabledFeatures.shaderStorageImageWriteWithoutFormat;
 		loadAssets();
 		prepareUniformBuffers();
 		prepareOffscreen();
@@ -699,15 +1026,27 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		if (mipChainSupported) {
+			prepareMipChain();
+		}
+		timestampQuery.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 2);
 		buildCommandBuffers();
 		prepared = true;
 	}
 
+	virtual void windowResized()
+	{
+		if (prepared && mipChainSupported) {
+			recreateMipChain();
+		}
+	}
+
 	virtual void render()
 	{
 		if (!prepared)
 			return;
 		draw();
+		timestampQuery.fetch();
 		if (!paused || camera.updated)
 		{
 			updateUniformBuffersScene();
@@ -720,10 +1059,24 @@ public:
 			if (overlay->checkBox("Bloom", &bloom)) {
 				buildCommandBuffers();
 			}
+			if (mipChainSupported) {
+				if (overlay->comboBox("Mode", &bloomMode, { "Gaussian (fixed size)", "Mip chain (compute)" })) {
+					buildCommandBuffers();
+				}
+				if ((bloomMode == BLOOM_MIPCHAIN) && overlay->checkBox("Half float mip chain", &halfFloatMipChain)) {
+					recreateMipChain();
+				}
+			}
 			if (overlay->inputFloat("Scale", &ubos.blurParams.blurScale, 0.1f, 2)) {
 				updateUniformBuffersBlur();
 			}
 		}
+		if (timestampQuery.supported() && overlay->header("GPU timings")) {
+			overlay->text("Bloom passes: %.3f ms", timestampQuery.duration(0, 1));
+			if (bloomMode == BLOOM_MIPCHAIN) {
+				overlay->text("Mip chain levels: %d", mipChain.levelCount);
+			}
+		}
 	}
 };
 
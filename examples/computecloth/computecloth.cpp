@@ -8,9 +8,13 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define ENABLE_VALIDATION false
 
+// Work group size (in both dimensions) of the shared memory solver, needs to match the compute shader
+#define TILE_SIZE 16
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -20,6 +24,21 @@ public:
 	bool simulateWind = false;
 	bool specializedComputeQueue = false;
 
+	// The per-iteration solver records one dispatch and barrier per solver iteration
+	// The tiled solver keeps tiles of the cloth in shared memory and runs several iterations per dispatch
+	enum Solver { solverPerIteration = 0, solverTiled = 1 };
+	int32_t solver = solverTiled;
+	bool tiledSolverSupported = true;
+	// Solver iterations per frame
+	const uint32_t iterations = 64;
+	// Iterations per dispatch for the tiled solver, also the width of the halo around each tile
+	const std::vector<uint32_t> tiledIterations = { 2, 4 };
+	int32_t tiledIterationsIndex = 1;
+	const std::vector<uint32_t> gridSizes = { 32, 60, 128, 256, 512, 1024 };
+	int32_t gridSizeIndex = 1;
+	uint32_t dispatchCount = 0;
+	double computeTime = 0.0;
+
 	vks::Texture2D textureCloth;
 	vkglTF::Model modelSphere;
 
@@ -59,6 +78,8 @@ public:
 		std::array<VkDescriptorSet,2> descriptorSets;
 		VkPipelineLayout pipelineLayout;
 		VkPipeline pipeline;
+		VkPipeline pipelineTiled{ VK_NULL_HANDLE };
+		vks::TimestampQuery timestamps;
 		struct computeUBO {
 			float deltaT = 0.0f;
 			float particleMass = 0.1f;
@@ -102,6 +123,7 @@ public:
 	{
 		// Graphics
 		graphics.uniformBuffer.destroy();
+		graphics.indices.destroy();
 		vkDestroyPipeline(device, graphics.pipelines.cloth, nullptr);
 		vkDestroyPipeline(device, graphics.pipelines.sphere, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
@@ -115,6 +137,8 @@ public:
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
+		vkDestroyPipeline(device, compute.pipelineTiled, nullptr);
+		compute.timestamps.destroy();
 		vkDestroySemaphore(device, compute.semaphores.ready, nullptr);
 		vkDestroySemaphore(device, compute.semaphores.complete, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
@@ -279,38 +303,58 @@ public:
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 
+		// Both solvers run the same number of iterations per frame, the tiled solver just needs fewer dispatches for them
+		const bool tiled = (solver == solverTiled) && tiledSolverSupported;
+		const uint32_t iterationsPerDispatch = tiled ? tiledIterations[tiledIterationsIndex] : 1;
+		dispatchCount = iterations / iterationsPerDispatch;
+
 		for (uint32_t i = 0; i < 2; i++) {
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffers[i], &cmdBufInfo));
 
+			compute.timestamps.reset(compute.commandBuffers[i]);
+
 			// Acquire the storage buffers from the graphics queue
 			addGraphicsToComputeBarriers(compute.commandBuffers[i]);
 
-			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+			compute.timestamps.write(compute.commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
+			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, tiled ? compute.pipelineTiled : compute.pipeline);
 
-			uint32_t calculateNormals = 0;
-			vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
+			struct PushConstants {
+				uint32_t calculateNormals;
+				uint32_t iterations;
+				uint32_t halo;
+			} pushConstants = { 0, iterationsPerDispatch, iterationsPerDispatch };
+			vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+			// Tiles of the tiled solver overlap by their halo
+			const uint32_t groupSize = tiled ? TILE_SIZE - 2 * iterationsPerDispatch : 10;
+			const uint32_t groupCountX = (cloth.gridsize.x + groupSize - 1) / groupSize;
+			const uint32_t groupCountY = (cloth.gridsize.y + groupSize - 1) / groupSize;
 
 			// Dispatch the compute job
-			const uint32_t iterations = 64;
-			for (uint32_t j = 0; j < iterations; j++) {
+			// The number of dispatches is always even, so the last one writes to the output buffer that's used for rendering
+			for (uint32_t j = 0; j < dispatchCount; j++) {
 				readSet = 1 - readSet;
 				vkCmdBindDescriptorSets(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[readSet], 0, 0);
 
-				if (j == iterations - 1) {
-					calculateNormals = 1;
-					vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
+				if (j == dispatchCount - 1) {
+					pushConstants.calculateNormals = 1;
+					vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
 				}
 
-				vkCmdDispatch(compute.commandBuffers[i], cloth.gridsize.x / 10, cloth.gridsize.y / 10, 1);
+				vkCmdDispatch(compute.commandBuffers[i], groupCountX, groupCountY, 1);
 
 				// Don't add a barrier on the last iteration of the loop, since we'll have an explicit release to the graphics queue
-				if (j != iterations - 1) {
+				if (j != dispatchCount - 1) {
 					addComputeToComputeBarriers(compute.commandBuffers[i]);
 				}
 
 			}
 
+			compute.timestamps.write(compute.commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1);
+
 			// release the storage buffers back to the graphics queue
 			addComputeToGraphicsBarriers(compute.commandBuffers[i]);
 			vkEndCommandBuffer(compute.commandBuffers[i]);
@@ -560,6 +604,22 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelines.sphere));
 	}
 
+	// Point the compute descriptor sets at the current storage buffers
+	void updateComputeDescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.input.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.output.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor),
+
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.output.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.input.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor)
+		};
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+	}
+
 	void prepareCompute()
 	{
 		// Create a compute capable device queue
@@ -580,9 +640,9 @@ public:
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
 
-		// Push constants used to pass some parameters
+		// Push constants used to pass some parameters (normal calculation, iterations per dispatch and halo width)
 		VkPushConstantRange pushConstantRange =
-			vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+			vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 3 * sizeof(uint32_t), 0);
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -595,23 +655,23 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[0]));
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[1]));
 
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor),
-
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor)
-		};
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+		updateComputeDescriptorSets();
 
 		// Create pipeline
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 
+		// The tiled solver uses a TILE_SIZE x TILE_SIZE work group, which is more than the guaranteed minimum of invocations per work group
+		tiledSolverSupported = vulkanDevice->properties.limits.maxComputeWorkGroupInvocations >= TILE_SIZE * TILE_SIZE;
+		if (tiledSolverSupported) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth_tiled.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineTiled));
+		}
+
+		// Timestamps at the start and end of the simulation
+		compute.timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.compute, 2);
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -646,14 +706,7 @@ public:
 		VK_CHECK_RESULT(compute.uniformBuffer.map());
 
 		// Initial values
-		float dx = cloth.size.x / (cloth.gridsize.x - 1);
-		float dy = cloth.size.y / (cloth.gridsize.y - 1);
-
-		compute.ubo.restDistH = dx;
-		compute.ubo.restDistV = dy;
-		compute.ubo.restDistD = sqrtf(dx * dx + dy * dy);
-		compute.ubo.particleCount = cloth.gridsize;
-
+		updateClothParameters();
 		updateComputeUBO();
 
 		// Vertex shader uniform buffer block
@@ -667,6 +720,33 @@ public:
 		updateGraphicsUBO();
 	}
 
+	// Spring rest distances depend on the number of particles
+	void updateClothParameters()
+	{
+		float dx = cloth.size.x / (cloth.gridsize.x - 1);
+		float dy = cloth.size.y / (cloth.gridsize.y - 1);
+
+		compute.ubo.restDistH = dx;
+		compute.ubo.restDistV = dy;
+		compute.ubo.restDistD = sqrtf(dx * dx + dy * dy);
+		compute.ubo.particleCount = cloth.gridsize;
+	}
+
+	void changeGridSize()
+	{
+		vkDeviceWaitIdle(device);
+		cloth.gridsize = glm::uvec2(gridSizes[gridSizeIndex]);
+		compute.storageBuffers.input.destroy();
+		compute.storageBuffers.output.destroy();
+		graphics.indices.destroy();
+		prepareStorageBuffers();
+		updateClothParameters();
+		updateComputeUBO();
+		updateComputeDescriptorSets();
+		buildComputeCommandBuffer();
+		buildCommandBuffers();
+	}
+
 	void updateComputeUBO()
 	{
 		if (!paused) {
@@ -741,6 +821,11 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
+
+		// The graphics submission waits for the compute work, so it has finished once the frame has been submitted
+		if (compute.timestamps.fetch()) {
+			computeTime = compute.timestamps.duration(0, 1);
+		}
 	}
 
 	void prepare()
@@ -781,6 +866,29 @@ public:
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Simulate wind", &simulateWind);
+			std::vector<std::string> gridSizeNames;
+			for (auto gridSize : gridSizes) {
+				gridSizeNames.push_back(std::to_string(gridSize) + " x " + std::to_string(gridSize));
+			}
+			if (overlay->comboBox("Grid size", &gridSizeIndex, gridSizeNames)) {
+				changeGridSize();
+			}
+			if (tiledSolverSupported) {
+				bool rebuild = overlay->comboBox("Solver", &solver, { "Dispatch per iteration", "Shared memory tiles" });
+				if (solver == solverTiled) {
+					rebuild |= overlay->comboBox("Iterations per dispatch", &tiledIterationsIndex, { "2", "4" });
+				}
+				if (rebuild) {
+					VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+					buildComputeCommandBuffer();
+				}
+			}
+		}
+		if (overlay->header("Performance")) {
+			overlay->text("Dispatches per frame: %d", dispatchCount);
+			if (compute.timestamps.supported()) {
+				overlay->text("GPU compute: %.3f ms", computeTime);
+			}
 		}
 	}
 };
@@ -1,13 +1,13 @@
 /*
-* Vulkan Example - Minimal headless compute example
+* Vulkan Example - Headless compute example
+*
+* Streams a large number of elements through a compute shader in batches using vks::ComputeContext
 *
 * Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
-// TODO: separate transfer queue (if not supported by compute queue) including buffer ownership transfer
-
 #if defined(_WIN32)
 #pragma comment(linker, "/subsystem:console")
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -25,17 +25,17 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
-
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-android_app* androidapp;
-#endif
+#include "VulkanComputeContext.h"
 
 #define DEBUG (!NDEBUG)
 
-#define BUFFER_ELEMENTS 32
+// Default number of elements to process and maximum number of elements per batch
+#define DEFAULT_ELEMENT_COUNT (16 * 1024 * 1024)
+#define DEFAULT_BATCH_ELEMENTS (64 * 1024)
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 #define LOG(...) ((void)__android_log_print(ANDROID_LOG_INFO, "vulkanExample", __VA_ARGS__))
@@ -43,520 +43,166 @@ android_app* androidapp;
 #define LOG(...) printf(__VA_ARGS__)
 #endif
 
-static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageCallback(
-	VkDebugReportFlagsEXT flags,
-	VkDebugReportObjectTypeEXT objectType,
-	uint64_t object,
-	size_t location,
-	int32_t messageCode,
-	const char* pLayerPrefix,
-	const char* pMessage,
-	void* pUserData)
-{
-	LOG("[VALIDATION]: %s - %s\n", pLayerPrefix, pMessage);
-	return VK_FALSE;
-}
-
 class VulkanExample
 {
 public:
-	VkInstance instance;
-	VkPhysicalDevice physicalDevice;
-	VkDevice device;
-	uint32_t queueFamilyIndex;
-	VkPipelineCache pipelineCache;
-	VkQueue queue;
-	VkCommandPool commandPool;
-	VkCommandBuffer commandBuffer;
-	VkFence fence;
-	VkDescriptorPool descriptorPool;
-	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSet descriptorSet;
-	VkPipelineLayout pipelineLayout;
-	VkPipeline pipeline;
-	VkShaderModule shaderModule;
-
-	VkDebugReportCallbackEXT debugReportCallback{};
+	// The compute context creates its own instance and device, does all buffer management and keeps several batches in flight
+	vks::ComputeContext context;
 
-	VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkBuffer *buffer, VkDeviceMemory *memory, VkDeviceSize size, void *data = nullptr)
+	uint32_t fibonacci(uint32_t n)
 	{
-		// Create the buffer handle
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer));
-
-		// Create the memory backing up the buffer handle
-		VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		vkGetBufferMemoryRequirements(device, *buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		bool memTypeFound = false;
-		for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
-			if ((memReqs.memoryTypeBits & 1) == 1) {
-				if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & memoryPropertyFlags) == memoryPropertyFlags) {
-					memAlloc.memoryTypeIndex = i;
-					memTypeFound = true;
-				}
-			}
-			memReqs.memoryTypeBits >>= 1;
+		if (n <= 1) {
+			return n;
 		}
-		assert(memTypeFound);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, memory));
-
-		if (data != nullptr) {
-			void *mapped;
-			VK_CHECK_RESULT(vkMapMemory(device, *memory, 0, size, 0, &mapped));
-			memcpy(mapped, data, size);
-			vkUnmapMemory(device, *memory);
+		uint32_t curr = 1;
+		uint32_t prev = 1;
+		for (uint32_t i = 2; i < n; ++i) {
+			uint32_t temp = curr;
+			curr += prev;
+			prev = temp;
 		}
-
-		VK_CHECK_RESULT(vkBindBufferMemory(device, *buffer, *memory, 0));
-
-		return VK_SUCCESS;
+		return curr;
 	}
 
-	VulkanExample()
+	VulkanExample(uint32_t elementCount, uint32_t batchElements)
 	{
 		LOG("Running headless compute example\n");
 
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-		LOG("loading vulkan lib");
-		vks::android::loadVulkanLibrary();
-#endif
-
-		VkApplicationInfo appInfo = {};
-		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-		appInfo.pApplicationName = "Vulkan headless example";
-		appInfo.pEngineName = "VulkanExample";
-		appInfo.apiVersion = VK_API_VERSION_1_0;
-
-		/*
-			Vulkan instance creation (without surface extensions)
-		*/
-		VkInstanceCreateInfo instanceCreateInfo = {};
-		instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-		instanceCreateInfo.pApplicationInfo = &appInfo;
-
-		uint32_t layerCount = 0;
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-		const char* validationLayers[] = { "VK_LAYER_GOOGLE_threading",	"VK_LAYER_LUNARG_parameter_validation",	"VK_LAYER_LUNARG_object_tracker","VK_LAYER_LUNARG_core_validation",	"VK_LAYER_LUNARG_swapchain", "VK_LAYER_GOOGLE_unique_objects" };
-		layerCount = 6;
-#else
-		const char* validationLayers[] = { "VK_LAYER_LUNARG_standard_validation" };
-		layerCount = 1;
-#endif
+		vks::ComputeContext::Settings settings{};
 #if DEBUG
-		// Check if layers are available
-		uint32_t instanceLayerCount;
-		vkEnumerateInstanceLayerProperties(&instanceLayerCount, nullptr);
-		std::vector<VkLayerProperties> instanceLayers(instanceLayerCount);
-		vkEnumerateInstanceLayerProperties(&instanceLayerCount, instanceLayers.data());
-
-		bool layersAvailable = true;
-		for (auto layerName : validationLayers) {
-			bool layerAvailable = false;
-			for (auto instanceLayer : instanceLayers) {
-				if (strcmp(instanceLayer.layerName, layerName) == 0) {
-					layerAvailable = true;
-					break;
-				}
-			}
-			if (!layerAvailable) {
-				layersAvailable = false;
-				break;
-			}
-		}
-
-		const char *validationExt = VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
-		if (layersAvailable) {
-			instanceCreateInfo.ppEnabledLayerNames = validationLayers;
-			instanceCreateInfo.enabledLayerCount = layerCount;
-			instanceCreateInfo.enabledExtensionCount = 1;
-			instanceCreateInfo.ppEnabledExtensionNames = &validationExt;
-		}
+		settings.validation = true;
 #endif
-		VK_CHECK_RESULT(vkCreateInstance(&instanceCreateInfo, nullptr, &instance));
+		settings.ringSize = 3;
+		settings.inputSize = batchElements * sizeof(uint32_t);
+		// The shader computes its results in place, so the input buffer is read back
+		settings.inPlace = true;
+		context.create(settings);
 
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-		vks::android::loadVulkanFunctions(instance);
-#endif
-#if DEBUG
-		if (layersAvailable) {
-			VkDebugReportCallbackCreateInfoEXT debugReportCreateInfo = {};
-			debugReportCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
-			debugReportCreateInfo.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT;
-			debugReportCreateInfo.pfnCallback = (PFN_vkDebugReportCallbackEXT)debugMessageCallback;
-
-			// We have to explicitly load this function.
-			PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallbackEXT = reinterpret_cast<PFN_vkCreateDebugReportCallbackEXT>(vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT"));
-			assert(vkCreateDebugReportCallbackEXT);
-			VK_CHECK_RESULT(vkCreateDebugReportCallbackEXT(instance, &debugReportCreateInfo, nullptr, &debugReportCallback));
-		}
-#endif
+		// The shader uses a work group size of one, so a batch can't exceed the max. dispatch size
+		batchElements = std::min(batchElements, context.vulkanDevice->properties.limits.maxComputeWorkGroupCount[0]);
+		const uint32_t batchCount = (elementCount + batchElements - 1) / batchElements;
 
 		/*
-			Vulkan device creation
+			Prepare input data
 		*/
-		// Physical device (always use first)
-		uint32_t deviceCount = 0;
-		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr));
-		std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
-		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()));
-		physicalDevice = physicalDevices[0];
-
-		VkPhysicalDeviceProperties deviceProperties;
-		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
-		LOG("GPU: %s\n", deviceProperties.deviceName);
-
-		// Request a single compute queue
-		const float defaultQueuePriority(0.0f);
-		VkDeviceQueueCreateInfo queueCreateInfo = {};
-		uint32_t queueFamilyCount;
-		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
-		std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
-		for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++) {
-			if (queueFamilyProperties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
-				queueFamilyIndex = i;
-				queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-				queueCreateInfo.queueFamilyIndex = i;
-				queueCreateInfo.queueCount = 1;
-				queueCreateInfo.pQueuePriorities = &defaultQueuePriority;
-				break;
-			}
+		std::vector<uint32_t> computeInput(elementCount);
+		std::vector<uint32_t> computeOutput(elementCount);
+		for (uint32_t i = 0; i < elementCount; i++) {
+			computeInput[i] = i % 32;
 		}
-		// Create logical device
-		VkDeviceCreateInfo deviceCreateInfo = {};
-		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		deviceCreateInfo.queueCreateInfoCount = 1;
-		deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
-		VK_CHECK_RESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device));
 
-		// Get a compute queue
-		vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
-
-		// Compute command pool
-		VkCommandPoolCreateInfo cmdPoolInfo = {};
-		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
-		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+		// TODO: There is no command line arguments parsing (nor Android settings) for this
+		// example, so we have no way of picking between GLSL or HLSL shaders.
+		// Hard-code to glsl for now.
+		const std::string shadersPath = getAssetPath() + "shaders/glsl/computeheadless/";
 
 		/*
-			Prepare storage buffers
+			Stream all elements through the context
+			While the host fills the input of batch n, the device uploads, computes and reads back the batches before it
 		*/
-		std::vector<uint32_t> computeInput(BUFFER_ELEMENTS);
-		std::vector<uint32_t> computeOutput(BUFFER_ELEMENTS);
-
-		// Fill input data
-		uint32_t n = 0;
-		std::generate(computeInput.begin(), computeInput.end(), [&n] { return n++; });
-
-		const VkDeviceSize bufferSize = BUFFER_ELEMENTS * sizeof(uint32_t);
-
-		VkBuffer deviceBuffer, hostBuffer;
-		VkDeviceMemory deviceMemory, hostMemory;
-
-		// Copy input data to VRAM using a staging buffer
-		{
-			createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&hostBuffer,
-				&hostMemory,
-				bufferSize,
-				computeInput.data());
-
-			// Flush writes to host visible buffer
-			void* mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkFlushMappedMemoryRanges(device, 1, &mappedRange);
-			vkUnmapMemory(device, hostMemory);
-
-			createBuffer(
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&deviceBuffer,
-				&deviceMemory,
-				bufferSize);
-
-			// Copy to staging buffer
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VkCommandBuffer copyCmd;
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &copyCmd));
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-			VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(copyCmd, hostBuffer, deviceBuffer, 1, &copyRegion);
-			VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-			submitInfo.commandBufferCount = 1;
-			submitInfo.pCommandBuffers = &copyCmd;
-			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VkFence fence;
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-
-			// Submit to the queue
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			vkDestroyFence(device, fence, nullptr);
-			vkFreeCommandBuffers(device, commandPool, 1, &copyCmd);
+		std::vector<uint64_t> tickets(batchCount);
+		auto consumeBatch = [&](uint32_t batchIndex) {
+			const uint32_t first = batchIndex * batchElements;
+			const uint32_t count = std::min(batchElements, elementCount - first);
+			const void* output = context.wait(tickets[batchIndex]);
+			memcpy(&computeOutput[first], output, count * sizeof(uint32_t));
+		};
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t batchIndex = 0; batchIndex < batchCount; batchIndex++) {
+			// Results of the batch that last used the ring slot need to be consumed before the slot is reused
+			if (batchIndex >= settings.ringSize) {
+				consumeBatch(batchIndex - settings.ringSize);
+			}
+			const uint32_t first = batchIndex * batchElements;
+			const uint32_t count = std::min(batchElements, elementCount - first);
+			const VkDeviceSize size = count * sizeof(uint32_t);
+
+			vks::ComputeContext::Batch* batch = context.acquireBatch();
+			memcpy(batch->input, &computeInput[first], size);
+
+			// Pass the element count via specialization constant, pipelines are only created for new counts and reused afterwards
+			vks::ComputeContext::Dispatch dispatch{};
+			dispatch.pipeline = context.getPipeline(shadersPath + "headless.comp.spv", { count });
+			dispatch.groupCountX = count;
+			tickets[batchIndex] = context.submitBatch(batch, { dispatch }, size, size);
 		}
-
-		/*
-			Prepare compute pipeline
-		*/
-		{
-			std::vector<VkDescriptorPoolSize> poolSizes = {
-				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
-			};
-
-			VkDescriptorPoolCreateInfo descriptorPoolInfo =
-				vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
-			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
-
-			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
-			};
-			VkDescriptorSetLayoutCreateInfo descriptorLayout =
-				vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
-
-			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
-				vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
-
-			VkDescriptorSetAllocateInfo allocInfo =
-				vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
-			VkDescriptorBufferInfo bufferDescriptor = { deviceBuffer, 0, VK_WHOLE_SIZE };
-			std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor),
-			};
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
-
-			VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-			pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-			VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
-
-			// Create pipeline
-			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
-
-			// Pass SSBO size via specialization constant
-			struct SpecializationData {
-				uint32_t BUFFER_ELEMENT_COUNT = BUFFER_ELEMENTS;
-			} specializationData;
-			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(SpecializationData), &specializationData);
-
-			// TODO: There is no command line arguments parsing (nor Android settings) for this
-			// example, so we have no way of picking between GLSL or HLSL shaders.
-			// Hard-code to glsl for now.
-			const std::string shadersPath = getAssetPath() + "shaders/glsl/computeheadless/";
-
-			VkPipelineShaderStageCreateInfo shaderStage = {};
-			shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-			shaderStage.module = vks::tools::loadShader(androidapp->activity->assetManager, (shadersPath + "headless.comp.spv").c_str(), device);
-#else
-			shaderStage.module = vks::tools::loadShader((shadersPath + "headless.comp.spv").c_str(), device);
-#endif
-			shaderStage.pName = "main";
-			shaderStage.pSpecializationInfo = &specializationInfo;
-			shaderModule = shaderStage.module;
-
-			assert(shaderStage.module != VK_NULL_HANDLE);
-			computePipelineCreateInfo.stage = shaderStage;
-			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
-
-			// Create a command buffer for compute operations
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
-
-			// Fence for compute CB sync
-			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+		for (uint32_t batchIndex = (batchCount > settings.ringSize) ? batchCount - settings.ringSize : 0; batchIndex < batchCount; batchIndex++) {
+			consumeBatch(batchIndex);
 		}
-
-		/*
-			Command buffer creation (for compute work submission)
-		*/
-		{
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
-
-			// Barrier to ensure that input buffer transfer is finished before compute shader reads from it
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
-
-			vkCmdDispatch(commandBuffer, BUFFER_ELEMENTS, 1, 1);
-
-			// Barrier to ensure that shader writes are finished before buffer is read back from GPU
-			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			// Read back to host visible buffer
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(commandBuffer, deviceBuffer, hostBuffer, 1, &copyRegion);
-
-			// Barrier to ensure that buffer copy is finished before host reading from it
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-			bufferBarrier.buffer = hostBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
-
-			// Submit compute work
-			vkResetFences(device, 1, &fence);
-			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-			computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
-			computeSubmitInfo.commandBufferCount = 1;
-			computeSubmitInfo.pCommandBuffers = &commandBuffer;
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &computeSubmitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			// Make device writes visible to the host
-			void *mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
-
-			// Copy to output
-			memcpy(computeOutput.data(), mapped, bufferSize);
-			vkUnmapMemory(device, hostMemory);
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		const double seconds = std::chrono::duration<double, std::milli>(tEnd - tStart).count() / 1000.0;
+
+		// Validate against a CPU implementation
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < elementCount; i++) {
+			if (computeOutput[i] != fibonacci(computeInput[i])) {
+				mismatches++;
+			}
 		}
 
-		vkQueueWaitIdle(queue);
-
 		// Output buffer contents
+		const uint32_t printCount = std::min(elementCount, 32u);
 		LOG("Compute input:\n");
-		for (auto v : computeInput) {
-			LOG("%d \t", v);
+		for (uint32_t i = 0; i < printCount; i++) {
+			LOG("%d \t", computeInput[i]);
 		}
 		std::cout << std::endl;
 
 		LOG("Compute output:\n");
-		for (auto v : computeOutput) {
-			LOG("%d \t", v);
+		for (uint32_t i = 0; i < printCount; i++) {
+			LOG("%d \t", computeOutput[i]);
 		}
 		std::cout << std::endl;
 
-		// Clean up
-		vkDestroyBuffer(device, deviceBuffer, nullptr);
-		vkFreeMemory(device, deviceMemory, nullptr);
-		vkDestroyBuffer(device, hostBuffer, nullptr);
-		vkFreeMemory(device, hostMemory, nullptr);
+		const double megabytes = (context.stats.bytesUploaded + context.stats.bytesDownloaded) / (1024.0 * 1024.0);
+		LOG("Processed %u elements in %u batches (%u elements per batch) in %.3f s\n", elementCount, batchCount, batchElements, seconds);
+		LOG("Throughput: %.2f Melements/s, %.2f MB/s transferred\n", elementCount / seconds / 1.0e6, megabytes / seconds);
+		LOG("Pipelines created: %llu, reused: %llu\n", (unsigned long long)context.stats.pipelinesCreated, (unsigned long long)context.stats.pipelinesReused);
+		LOG("Validation: %u mismatches\n", mismatches);
 	}
 
 	~VulkanExample()
 	{
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineCache(device, pipelineCache, nullptr);
-		vkDestroyFence(device, fence, nullptr);
-		vkDestroyCommandPool(device, commandPool, nullptr);
-		vkDestroyShaderModule(device, shaderModule, nullptr);
-		vkDestroyDevice(device, nullptr);
-#if DEBUG
-		if (debugReportCallback) {
-			PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallback = reinterpret_cast<PFN_vkDestroyDebugReportCallbackEXT>(vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT"));
-			assert(vkDestroyDebugReportCallback);
-			vkDestroyDebugReportCallback(instance, debugReportCallback, nullptr);
-		}
-#endif
-		vkDestroyInstance(instance, nullptr);
+		context.destroy();
 	}
 };
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 void handleAppCommand(android_app * app, int32_t cmd) {
 	if (cmd == APP_CMD_INIT_WINDOW) {
-		VulkanExample *vulkanExample = new VulkanExample();
+		VulkanExample *vulkanExample = new VulkanExample(DEFAULT_ELEMENT_COUNT, DEFAULT_BATCH_ELEMENTS);
 		delete(vulkanExample);
 		ANativeActivity_finish(app->activity);
 	}
 }
 void android_main(android_app* state) {
-	androidapp = state;
-	androidapp->onAppCmd = handleAppCommand;
+	androidApp = state;
+	androidApp->onAppCmd = handleAppCommand;
 	int ident, events;
 	struct android_poll_source* source;
 	while ((ident = ALooper_pollAll(-1, NULL, &events, (void**)&source)) >= 0) {
 		if (source != NULL)	{
-			source->process(androidapp, source);
+			source->process(androidApp, source);
 		}
-		if (androidapp->destroyRequested != 0) {
+		if (androidApp->destroyRequested != 0) {
 			break;
 		}
 	}
 }
 #else
-int main() {
-	VulkanExample *vulkanExample = new VulkanExample();
+int main(int argc, char* argv[]) {
+	uint32_t elementCount = DEFAULT_ELEMENT_COUNT;
+	uint32_t batchElements = DEFAULT_BATCH_ELEMENTS;
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "--elements") == 0) {
+			elementCount = std::max(1, atoi(argv[i + 1]));
+		}
+		if (strcmp(argv[i], "--batch") == 0) {
+			batchElements = std::max(1, atoi(argv[i + 1]));
+		}
+	}
+	VulkanExample *vulkanExample = new VulkanExample(elementCount, batchElements);
 	std::cout << "Finished. Press enter to terminate...";
 	getchar();
 	delete(vulkanExample);
@@ -1,26 +1,225 @@
 /*
 * Vulkan Example - Compute shader N-body simulation using two passes and shared compute shader memory
 *
+* For large particle counts the all pairs O(N^2) solver can be replaced by a Barnes-Hut solver
+* The tree is rebuilt on the GPU every frame as a binary radix tree over morton sorted particles (Karras 2012)
+* A multithreaded CPU octree implementation is used as a reference for validating accuracy and comparing throughput
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <map>
+#include <thread>
 #include "vulkanexamplebase.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 #if defined(__ANDROID__)
 // Lower particle count on Android for performance reasons
-#define PARTICLES_PER_ATTRACTOR 3 * 1024
+#define DEFAULT_PARTICLES_PER_ATTRACTOR 3 * 1024
 #else
-#define PARTICLES_PER_ATTRACTOR 4 * 1024
+#define DEFAULT_PARTICLES_PER_ATTRACTOR 4 * 1024
 #endif
+#define ATTRACTOR_COUNT 6
+// Compute shaders work on groups of 256 particles
+#define PARTICLE_GROUP_SIZE 256
+
+// Simulation constants, passed to the compute shaders as specialization constants and also used by the CPU reference
+#define NBODY_GRAVITY 0.002f
+#define NBODY_POWER 0.75f
+#define NBODY_SOFTEN 0.05f
+
+/*
+	CPU Barnes-Hut reference
+	Particles are sorted into an octree with up to 8 particles per leaf, force evaluation is split across all hardware threads
+*/
+class CpuBarnesHut
+{
+public:
+	struct Node {
+		glm::vec3 center;
+		float halfSize;
+		glm::vec3 centerOfMass;
+		float mass;
+		float weight;
+		// Index of the first of eight consecutive children, -1 for leaves
+		int32_t firstChild;
+		// Range of particles in the sorted index array
+		uint32_t first;
+		uint32_t count;
+	};
+	std::vector<Node> nodes;
+	std::vector<uint32_t> indices;
+	const std::vector<glm::vec4>* positions = nullptr;
+
+	static glm::vec3 interaction(const glm::vec3& position, const glm::vec3& other, float mass)
+	{
+		glm::vec3 len = other - position;
+		return NBODY_GRAVITY * len * mass / powf(glm::dot(len, len) + NBODY_SOFTEN, NBODY_POWER);
+	}
+
+	// Splits [0, count) into one range per hardware thread
+	template<typename F>
+	static void parallelFor(uint32_t count, F func)
+	{
+		const uint32_t threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), count));
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < threadCount; t++) {
+			const uint32_t begin = (uint32_t)((uint64_t)count * t / threadCount);
+			const uint32_t end = (uint32_t)((uint64_t)count * (t + 1) / threadCount);
+			threads.push_back(std::thread([=]() {
+				for (uint32_t i = begin; i < end; i++) {
+					func(i);
+				}
+			}));
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	void build(const std::vector<glm::vec4>& positions)
+	{
+		this->positions = &positions;
+		const uint32_t count = static_cast<uint32_t>(positions.size());
+		indices.resize(count);
+		std::iota(indices.begin(), indices.end(), 0);
+		glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+		for (auto& pos : positions) {
+			minPos = glm::min(minPos, glm::vec3(pos));
+			maxPos = glm::max(maxPos, glm::vec3(pos));
+		}
+		glm::vec3 extent = maxPos - minPos;
+		nodes.clear();
+		nodes.push_back(Node());
+		buildNode(0, (minPos + maxPos) * 0.5f, std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-4f)) * 0.5f, 0, count, 0);
+	}
+
+	glm::vec3 acceleration(uint32_t index, float theta) const
+	{
+		const glm::vec3 position = glm::vec3((*positions)[index]);
+		const float theta2 = theta * theta;
+		glm::vec3 acceleration(0.0f);
+		uint32_t stack[8 * maxDepth + 1];
+		uint32_t stackPtr = 0;
+		stack[stackPtr++] = 0;
+		while (stackPtr > 0) {
+			const Node& node = nodes[stack[--stackPtr]];
+			glm::vec3 len = node.centerOfMass - position;
+			float size = node.halfSize * 2.0f;
+			if (node.firstChild < 0) {
+				for (uint32_t i = node.first; i < node.first + node.count; i++) {
+					if (indices[i] != index) {
+						acceleration += interaction(position, glm::vec3((*positions)[indices[i]]), (*positions)[indices[i]].w);
+					}
+				}
+			} else if (size * size < theta2 * glm::dot(len, len)) {
+				acceleration += interaction(position, node.centerOfMass, node.mass);
+			} else {
+				for (uint32_t i = 0; i < 8; i++) {
+					if (nodes[node.firstChild + i].count > 0) {
+						stack[stackPtr++] = node.firstChild + i;
+					}
+				}
+			}
+		}
+		return acceleration;
+	}
+
+	static glm::vec3 directSum(const std::vector<glm::vec4>& positions, uint32_t index)
+	{
+		const glm::vec3 position = glm::vec3(positions[index]);
+		glm::vec3 acceleration(0.0f);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(positions.size()); i++) {
+			if (i != index) {
+				acceleration += interaction(position, glm::vec3(positions[i]), positions[i].w);
+			}
+		}
+		return acceleration;
+	}
+
+private:
+	static const uint32_t maxDepth = 24;
+	static const uint32_t leafSize = 8;
+
+	void buildNode(uint32_t nodeIndex, glm::vec3 center, float halfSize, uint32_t first, uint32_t count, uint32_t depth)
+	{
+		const std::vector<glm::vec4>& pos = *positions;
+		Node node{};
+		node.center = center;
+		node.halfSize = halfSize;
+		node.first = first;
+		node.count = count;
+		node.firstChild = -1;
+		if ((count > leafSize) && (depth < maxDepth)) {
+			// Sort the particles of this node into the octants
+			auto octant = [&](uint32_t i) {
+				return (pos[i].x > center.x ? 1 : 0) | (pos[i].y > center.y ? 2 : 0) | (pos[i].z > center.z ? 4 : 0);
+			};
+			uint32_t offsets[9] = {};
+			for (uint32_t i = first; i < first + count; i++) {
+				offsets[octant(indices[i]) + 1]++;
+			}
+			for (uint32_t i = 1; i < 9; i++) {
+				offsets[i] += offsets[i - 1];
+			}
+			std::vector<uint32_t> sorted(count);
+			uint32_t cursor[8];
+			std::copy(offsets, offsets + 8, cursor);
+			for (uint32_t i = first; i < first + count; i++) {
+				sorted[cursor[octant(indices[i])]++] = indices[i];
+			}
+			std::copy(sorted.begin(), sorted.end(), indices.begin() + first);
+			node.firstChild = static_cast<int32_t>(nodes.size());
+			nodes.resize(nodes.size() + 8);
+			for (uint32_t i = 0; i < 8; i++) {
+				glm::vec3 offset((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+				buildNode(node.firstChild + i, center + offset * halfSize, halfSize * 0.5f, first + offsets[i], offsets[i + 1] - offsets[i], depth + 1);
+			}
+		}
+		// Same mass weighting as the GPU tree (see bh_summarize.comp)
+		glm::vec3 weightedCenter(0.0f);
+		for (uint32_t i = first; i < first + count; i++) {
+			const glm::vec4& p = pos[indices[i]];
+			node.mass += p.w;
+			node.weight += fabsf(p.w);
+			weightedCenter += glm::vec3(p) * fabsf(p.w);
+		}
+		node.centerOfMass = (node.weight > 0.0f) ? weightedCenter / node.weight : center;
+		nodes[nodeIndex] = node;
+	}
+};
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	uint32_t numParticles;
+	uint32_t particlesPerAttractor = DEFAULT_PARTICLES_PER_ATTRACTOR;
+
+	// Selectable particle counts (per attractor)
+	std::vector<uint32_t> particleCounts = { 1024, 4096, 16384, 65536, 262144 };
+	int32_t particleCountIndex = 0;
+
+	enum Solver { solverAllPairs = 0, solverBarnesHut = 1 };
+	int32_t solver = solverAllPairs;
+
+	// GPU and CPU timings and accuracy per particle count
+	struct Measurement {
+		double gpuMs[2] = { 0.0, 0.0 };
+		bool validated = false;
+		double cpuBuildMs = 0.0;
+		double cpuBarnesHutMs = 0.0;
+		// Extrapolated from the sampled direct sums
+		double cpuDirectMs = 0.0;
+		// Relative RMS error of the accelerations against a direct sum
+		double gpuError = 0.0;
+		double cpuError = 0.0;
+	};
+	std::map<uint32_t, Measurement> measurements;
+	bool validationRequested = false;
 
 	struct {
 		vks::Texture2D particle;
@@ -67,12 +266,56 @@ public:
 		VkPipelineLayout pipelineLayoutBlur;
 		VkDescriptorSetLayout descriptorSetLayoutBlur;
 		VkDescriptorSet descriptorSetBlur;
+		// Barnes-Hut solver
+		struct {
+			vks::Buffer bounds;						// Bounding cube of all particles
+			vks::Buffer keys;						// Morton codes, padded to a power of two for sorting
+			vks::Buffer values;						// Particle indices sorted along with the morton codes
+			vks::Buffer nodes;						// Internal nodes followed by the leaves
+			vks::Buffer parents;					// Parent index of every node
+			vks::Buffer counters;					// Visit counters for the bottom-up pass over the internal nodes
+			vks::Buffer accelerations;				// Per particle accelerations of the force pass
+		} tree;
+		struct {
+			VkPipeline bounds;
+			VkPipeline morton;
+			VkPipeline sort;
+			VkPipeline tree;
+			VkPipeline summarize;
+			VkPipeline force;
+			VkPipeline integrate;
+		} pipelinesBarnesHut;
+		VkCommandBuffer validationCommandBuffer;	// Same as the compute command buffer, but also reads back positions and accelerations
+		struct {
+			vks::Buffer particles;
+			vks::Buffer accelerations;
+		} readback;
+		vks::TimestampQuery timestamps;
 		struct computeUBO {							// Compute shader uniform block object
 			float deltaT;							//		Frame delta time
 			int32_t particleCount;
+			float theta = 0.5f;						//		Barnes-Hut opening angle
+			uint32_t sortCount;						//		Number of morton codes to sort (power of two)
 		} ubo;
 	} compute;
 
+	// Size of the nodes in the Barnes-Hut tree buffer, needs to match the shaders
+	struct TreeNode {
+		glm::vec4 centerOfMass;
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+		uint32_t left;
+		uint32_t right;
+		float weight;
+		uint32_t pad;
+	};
+
+	struct SortPushConstants {
+		uint32_t k;
+		uint32_t j;
+		uint32_t mode;
+	};
+
 	// SSBO particle declaration
 	struct Particle {
 		glm::vec4 pos;								// xyz = position, w = mass
@@ -87,6 +330,23 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+
+		commandLineParser.add("particles", { "--particles" }, 1, "Total number of particles (rounded up to a multiple of 1536)");
+		commandLineParser.add("barneshut", { "--barneshut" }, 0, "Start with the Barnes-Hut solver");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("particles")) {
+			uint32_t total = std::max(commandLineParser.getValueAsInt("particles", 0), 1);
+			particlesPerAttractor = (total + ATTRACTOR_COUNT - 1) / ATTRACTOR_COUNT;
+			particlesPerAttractor = (particlesPerAttractor + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE * PARTICLE_GROUP_SIZE;
+		}
+		if (commandLineParser.isSet("barneshut")) {
+			solver = solverBarnesHut;
+		}
+		if (std::find(particleCounts.begin(), particleCounts.end(), particlesPerAttractor) == particleCounts.end()) {
+			particleCounts.push_back(particlesPerAttractor);
+			std::sort(particleCounts.begin(), particleCounts.end());
+		}
+		particleCountIndex = static_cast<int32_t>(std::find(particleCounts.begin(), particleCounts.end(), particlesPerAttractor) - particleCounts.begin());
 	}
 
 	~VulkanExample()
@@ -99,12 +359,20 @@ public:
 		vkDestroySemaphore(device, graphics.semaphore, nullptr);
 
 		// Compute
-		compute.storageBuffer.destroy();
+		destroyStorageBuffers();
 		compute.uniformBuffer.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipelineCalculate, nullptr);
 		vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
+		vkDestroyPipeline(device, compute.pipelinesBarnesHut.bounds, nullptr);
+		vkDestroyPipeline(device, compute.pipelinesBarnesHut.morton, nullptr);
+		vkDestroyPipeline(device, compute.pipelinesBarnesHut.sort, nullptr);
+		vkDestroyPipeline(device, compute.pipelinesBarnesHut.tree, nullptr);
+		vkDestroyPipeline(device, compute.pipelinesBarnesHut.summarize, nullptr);
+		vkDestroyPipeline(device, compute.pipelinesBarnesHut.force, nullptr);
+		vkDestroyPipeline(device, compute.pipelinesBarnesHut.integrate, nullptr);
+		compute.timestamps.destroy();
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 
@@ -219,11 +487,97 @@ public:
 
 	}
 
-	void buildComputeCommandBuffer()
+	// Execution and memory dependency between two compute passes
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = (srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT) ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Bitonic sort of the morton codes, local passes in shared memory handle all steps that fit into blocks of 512 elements
+	void recordSort(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t count = compute.ubo.sortCount;
+		const uint32_t blockSize = 2 * PARTICLE_GROUP_SIZE;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelinesBarnesHut.sort);
+		SortPushConstants pushConstants = { 0, 0, 1 };
+		vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SortPushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, count / blockSize, 1, 1);
+		computeBarrier(commandBuffer);
+		for (uint32_t k = blockSize * 2; k <= count; k <<= 1) {
+			// Steps with a distance larger than a block need to go through global memory
+			for (uint32_t j = k >> 1; j >= blockSize; j >>= 1) {
+				pushConstants = { k, j, 0 };
+				vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SortPushConstants), &pushConstants);
+				vkCmdDispatch(commandBuffer, count / 2 / PARTICLE_GROUP_SIZE, 1, 1);
+				computeBarrier(commandBuffer);
+			}
+			pushConstants = { k, blockSize / 2, 2 };
+			vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SortPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, count / blockSize, 1, 1);
+			computeBarrier(commandBuffer);
+		}
+	}
+
+	// Barnes-Hut solver: Build the tree from scratch, traverse it for every particle and integrate
+	void recordBarnesHut(VkCommandBuffer commandBuffer, bool readback)
+	{
+		const uint32_t groupCount = numParticles / PARTICLE_GROUP_SIZE;
+
+		vkCmdFillBuffer(commandBuffer, compute.tree.counters.buffer, 0, VK_WHOLE_SIZE, 0);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelinesBarnesHut.bounds);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+		computeBarrier(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelinesBarnesHut.morton);
+		vkCmdDispatch(commandBuffer, compute.ubo.sortCount / PARTICLE_GROUP_SIZE, 1, 1);
+		computeBarrier(commandBuffer);
+
+		recordSort(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelinesBarnesHut.tree);
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+		computeBarrier(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelinesBarnesHut.summarize);
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+		computeBarrier(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelinesBarnesHut.force);
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+		computeBarrier(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelinesBarnesHut.integrate);
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+		if (readback) {
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VkBufferCopy copyRegion = { 0, 0, compute.readback.accelerations.size };
+			vkCmdCopyBuffer(commandBuffer, compute.tree.accelerations.buffer, compute.readback.accelerations.buffer, 1, &copyRegion);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	void buildComputeCommandBuffer(VkCommandBuffer commandBuffer, bool readback)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		if (!readback) {
+			compute.timestamps.reset(commandBuffer);
+		}
 
 		// Acquire barrier
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
@@ -242,7 +596,7 @@ public:
 			};
 
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
+				commandBuffer,
 				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				0,
@@ -251,35 +605,61 @@ public:
 				0, nullptr);
 		}
 
-		// First pass: Calculate particle movement
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		// Read back the particle positions the forces are calculated from
+		if (readback) {
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VkBufferCopy copyRegion = { 0, 0, compute.readback.particles.size };
+			vkCmdCopyBuffer(commandBuffer, compute.storageBuffer.buffer, compute.readback.particles.buffer, 1, &copyRegion);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
 
-		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
-		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-		bufferBarrier.buffer = compute.storageBuffer.buffer;
-		bufferBarrier.size = compute.storageBuffer.descriptor.range;
-		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		// Transfer ownership if compute and graphics queue family indices differ
-		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		if (!readback) {
+			compute.timestamps.write(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+		}
 
-		vkCmdPipelineBarrier(
-			compute.commandBuffer,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_FLAGS_NONE,
-			0, nullptr,
-			1, &bufferBarrier,
-			0, nullptr);
+		// Validation always uses the Barnes-Hut solver as it's the only one that writes out the accelerations
+		if ((solver == solverBarnesHut) || readback) {
+			recordBarnesHut(commandBuffer, readback);
+		} else {
+			// First pass: Calculate particle movement
+			// -------------------------------------------------------------------------------------------------------
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+			vkCmdDispatch(commandBuffer, numParticles / PARTICLE_GROUP_SIZE, 1, 1);
+
+			// Add memory barrier to ensure that the computer shader has finished writing to the buffer
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.buffer = compute.storageBuffer.buffer;
+			bufferBarrier.size = compute.storageBuffer.descriptor.range;
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			// Transfer ownership if compute and graphics queue family indices differ
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &bufferBarrier,
+				0, nullptr);
+
+			// Second pass: Integrate particles
+			// -------------------------------------------------------------------------------------------------------
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+			vkCmdDispatch(commandBuffer, numParticles / PARTICLE_GROUP_SIZE, 1, 1);
+		}
 
-		// Second pass: Integrate particles
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		if (!readback) {
+			compute.timestamps.write(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1);
+		}
 
 		// Release barrier
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
@@ -298,7 +678,7 @@ public:
 			};
 
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
+				commandBuffer,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
 				0,
@@ -307,7 +687,7 @@ public:
 				0, nullptr);
 		}
 
-		vkEndCommandBuffer(compute.commandBuffer);
+		vkEndCommandBuffer(commandBuffer);
 	}
 
 	// Setup and fill the compute shader storage buffers containing the particles
@@ -329,7 +709,8 @@ public:
 		};
 #endif
 
-		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
+		assert(attractors.size() == ATTRACTOR_COUNT);
+		numParticles = static_cast<uint32_t>(attractors.size()) * particlesPerAttractor;
 
 		// Initial particle positions
 		std::vector<Particle> particleBuffer(numParticles);
@@ -339,9 +720,9 @@ public:
 
 		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
 		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
+			for (uint32_t j = 0; j < particlesPerAttractor; j++)
 			{
-				Particle &particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
+				Particle &particle = particleBuffer[i * particlesPerAttractor + j];
 
 				// First particle in group as heavy center of gravity
 				if (j == 0)
@@ -371,6 +752,11 @@ public:
 		}
 
 		compute.ubo.particleCount = numParticles;
+		// Morton codes are padded to a power of two for the bitonic sort, and need to fill at least one local sort block
+		compute.ubo.sortCount = 2 * PARTICLE_GROUP_SIZE;
+		while (compute.ubo.sortCount < numParticles) {
+			compute.ubo.sortCount <<= 1;
+		}
 
 		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
 
@@ -427,6 +813,17 @@ public:
 
 		stagingBuffer.destroy();
 
+		// Barnes-Hut tree buffers are only accessed by the compute queue
+		const VkBufferUsageFlags treeUsageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		const uint32_t nodeCount = 2 * numParticles - 1;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(treeUsageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.tree.bounds, 2 * sizeof(glm::vec4)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(treeUsageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.tree.keys, compute.ubo.sortCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(treeUsageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.tree.values, compute.ubo.sortCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(treeUsageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.tree.nodes, nodeCount * sizeof(TreeNode)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(treeUsageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.tree.parents, nodeCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(treeUsageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.tree.counters, (numParticles - 1) * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(treeUsageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.tree.accelerations, numParticles * sizeof(glm::vec4)));
+
 		// Binding description
 		vertices.bindingDescriptions.resize(1);
 		vertices.bindingDescriptions[0] =
@@ -461,12 +858,29 @@ public:
 		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
 	}
 
+	void destroyStorageBuffers()
+	{
+		compute.storageBuffer.destroy();
+		compute.tree.bounds.destroy();
+		compute.tree.keys.destroy();
+		compute.tree.values.destroy();
+		compute.tree.nodes.destroy();
+		compute.tree.parents.destroy();
+		compute.tree.counters.destroy();
+		compute.tree.accelerations.destroy();
+		compute.readback.particles.destroy();
+		compute.readback.accelerations.destroy();
+		// Readback buffers are created on demand, so reset their handles
+		compute.readback.particles = vks::Buffer();
+		compute.readback.accelerations = vks::Buffer();
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
@@ -622,6 +1036,91 @@ public:
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
 	}
 
+	void updateComputeDescriptorSet()
+	{
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
+		{
+			// Binding 0 : Particle position storage buffer
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				0,
+				&compute.storageBuffer.descriptor),
+			// Binding 1 : Uniform buffer
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				1,
+				&compute.uniformBuffer.descriptor),
+			// Binding 2 - 8 : Barnes-Hut tree buffers
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compute.tree.bounds.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.tree.keys.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.tree.values.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &compute.tree.nodes.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &compute.tree.parents.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &compute.tree.counters.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &compute.tree.accelerations.descriptor),
+		};
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
+	}
+
+	// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
+	void initStorageBufferOwnership()
+	{
+		if (graphics.queueFamilyIndex == compute.queueFamilyIndex)
+		{
+			return;
+		}
+
+		// Create a transient command buffer for setting up the initial buffer transfer state
+		VkCommandBuffer transferCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+
+		VkBufferMemoryBarrier acquire_buffer_barrier =
+		{
+			VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			nullptr,
+			0,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			graphics.queueFamilyIndex,
+			compute.queueFamilyIndex,
+			compute.storageBuffer.buffer,
+			0,
+			compute.storageBuffer.size
+		};
+		vkCmdPipelineBarrier(
+			transferCmd,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			1, &acquire_buffer_barrier,
+			0, nullptr);
+
+		VkBufferMemoryBarrier release_buffer_barrier =
+		{
+			VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			nullptr,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			0,
+			compute.queueFamilyIndex,
+			graphics.queueFamilyIndex,
+			compute.storageBuffer.buffer,
+			0,
+			compute.storageBuffer.size
+		};
+		vkCmdPipelineBarrier(
+			transferCmd,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			0, nullptr,
+			1, &release_buffer_barrier,
+			0, nullptr);
+
+		vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
+	}
+
 	void prepareCompute()
 	{
 		// Create a compute capable device queue
@@ -633,6 +1132,7 @@ public:
 		// Create compute pipeline
 		// Compute pipelines are created separate from graphics pipelines even if they use the same queue (family index)
 
+		// All compute pipelines share one layout, the all pairs solver only uses the first two bindings
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			// Binding 0 : Particle position storage buffer
 			vks::initializers::descriptorSetLayoutBinding(
@@ -645,6 +1145,10 @@ public:
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				1),
 		};
+		// Binding 2 - 8 : Barnes-Hut tree buffers
+		for (uint32_t binding = 2; binding <= 8; binding++) {
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, binding));
+		}
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(
@@ -657,6 +1161,10 @@ public:
 			vks::initializers::pipelineLayoutCreateInfo(
 				&compute.descriptorSetLayout,
 				1);
+		// Bitonic sort step parameters
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SortPushConstants), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
 
@@ -668,23 +1176,7 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
 
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
-		{
-			// Binding 0 : Particle position storage buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				0,
-				&compute.storageBuffer.descriptor),
-			// Binding 1 : Uniform buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				1,
-				&compute.uniformBuffer.descriptor)
-		};
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
+		updateComputeDescriptorSet();
 
 		// Create pipelines
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
@@ -706,11 +1198,12 @@ public:
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, power), sizeof(float)));
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(3, offsetof(SpecializationData, soften), sizeof(float)));
 
-		specializationData.sharedDataSize = std::min((uint32_t)1024, (uint32_t)(vulkanDevice->properties.limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
+		// The shader fills one element of shared memory per invocation but advances by the shared data size, so both need to match for all particles to be taken into account
+		specializationData.sharedDataSize = PARTICLE_GROUP_SIZE;
 
-		specializationData.gravity = 0.002f;
-		specializationData.power = 0.75f;
-		specializationData.soften = 0.05f;
+		specializationData.gravity = NBODY_GRAVITY;
+		specializationData.power = NBODY_POWER;
+		specializationData.soften = NBODY_SOFTEN;
 
 		VkSpecializationInfo specializationInfo =
 			vks::initializers::specializationInfo(static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(specializationData), &specializationData);
@@ -722,6 +1215,28 @@ public:
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_integrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
 
+		// Barnes-Hut passes
+		// The force pass uses the same simulation parameters as the all pairs solver
+		struct {
+			std::string name;
+			VkPipeline* pipeline;
+		} passes[] = {
+			{ "bh_bounds", &compute.pipelinesBarnesHut.bounds },
+			{ "bh_morton", &compute.pipelinesBarnesHut.morton },
+			{ "bh_sort", &compute.pipelinesBarnesHut.sort },
+			{ "bh_tree", &compute.pipelinesBarnesHut.tree },
+			{ "bh_summarize", &compute.pipelinesBarnesHut.summarize },
+			{ "bh_force", &compute.pipelinesBarnesHut.force },
+			{ "bh_integrate", &compute.pipelinesBarnesHut.integrate },
+		};
+		for (auto& pass : passes) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/" + pass.name + ".comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			if (pass.pipeline == &compute.pipelinesBarnesHut.force) {
+				computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			}
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, pass.pipeline));
+		}
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -731,6 +1246,10 @@ public:
 
 		// Create a command buffer for compute operations
 		compute.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
+		compute.validationCommandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
+
+		// Timestamps at the start and end of the compute work
+		compute.timestamps.create(vulkanDevice, compute.queueFamilyIndex, 2);
 
 		// Semaphore for compute & graphics sync
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
@@ -744,58 +1263,23 @@ public:
 		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 
 		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
-
-		// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			// Create a transient command buffer for setting up the initial buffer transfer state
-			VkCommandBuffer transferCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+		buildComputeCommandBuffer(compute.commandBuffer, false);
 
-			VkBufferMemoryBarrier acquire_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &acquire_buffer_barrier,
-				0, nullptr);
-
-			VkBufferMemoryBarrier release_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &release_buffer_barrier,
-				0, nullptr);
+		initStorageBufferOwnership();
+	}
 
-			vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
-		}
+	// Recreate all particle dependent resources with a new particle count
+	void changeParticleCount()
+	{
+		vkDeviceWaitIdle(device);
+		particlesPerAttractor = particleCounts[particleCountIndex];
+		destroyStorageBuffers();
+		prepareStorageBuffers();
+		updateComputeUniformBuffers();
+		updateComputeDescriptorSet();
+		buildComputeCommandBuffer(compute.commandBuffer, false);
+		initStorageBufferOwnership();
+		buildCommandBuffers();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -839,6 +1323,69 @@ public:
 		memcpy(graphics.uniformBuffer.mapped, &graphics.ubo, sizeof(graphics.ubo));
 	}
 
+	// Compare the accelerations of the GPU Barnes-Hut solver and the CPU reference against a direct sum for a subset of the particles
+	void validate()
+	{
+		std::vector<glm::vec4> positions(numParticles);
+		std::vector<glm::vec4> gpuAccelerations(numParticles);
+		const Particle* particles = static_cast<const Particle*>(compute.readback.particles.mapped);
+		for (uint32_t i = 0; i < numParticles; i++) {
+			positions[i] = particles[i].pos;
+		}
+		memcpy(gpuAccelerations.data(), compute.readback.accelerations.mapped, numParticles * sizeof(glm::vec4));
+
+		Measurement& measurement = measurements[numParticles];
+		const float theta = compute.ubo.theta;
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+		CpuBarnesHut tree;
+		tree.build(positions);
+		auto tBuild = std::chrono::high_resolution_clock::now();
+		std::vector<glm::vec3> cpuAccelerations(numParticles);
+		CpuBarnesHut::parallelFor(numParticles, [&](uint32_t i) { cpuAccelerations[i] = tree.acceleration(i, theta); });
+		auto tForce = std::chrono::high_resolution_clock::now();
+
+		const uint32_t sampleCount = std::min(numParticles, 1024u);
+		std::vector<glm::vec3> reference(sampleCount);
+		CpuBarnesHut::parallelFor(sampleCount, [&](uint32_t i) { reference[i] = CpuBarnesHut::directSum(positions, (uint32_t)((uint64_t)i * numParticles / sampleCount)); });
+		auto tDirect = std::chrono::high_resolution_clock::now();
+
+		double gpuError = 0.0, cpuError = 0.0;
+		for (uint32_t i = 0; i < sampleCount; i++) {
+			const uint32_t index = (uint32_t)((uint64_t)i * numParticles / sampleCount);
+			const float len = std::max(glm::length(reference[i]), 1e-12f);
+			const double gpuDiff = glm::length(glm::vec3(gpuAccelerations[index]) - reference[i]) / len;
+			const double cpuDiff = glm::length(cpuAccelerations[index] - reference[i]) / len;
+			gpuError += gpuDiff * gpuDiff;
+			cpuError += cpuDiff * cpuDiff;
+		}
+
+		measurement.validated = true;
+		measurement.cpuBuildMs = std::chrono::duration<double, std::milli>(tBuild - tStart).count();
+		measurement.cpuBarnesHutMs = std::chrono::duration<double, std::milli>(tForce - tBuild).count();
+		measurement.cpuDirectMs = std::chrono::duration<double, std::milli>(tDirect - tForce).count() * numParticles / sampleCount;
+		measurement.gpuError = sqrt(gpuError / sampleCount);
+		measurement.cpuError = sqrt(cpuError / sampleCount);
+
+		std::cout << "N-body validation with " << numParticles << " particles (theta " << theta << ", " << sampleCount << " samples)" << std::endl;
+		std::cout << "  GPU Barnes-Hut relative RMS error: " << measurement.gpuError << std::endl;
+		std::cout << "  CPU Barnes-Hut relative RMS error: " << measurement.cpuError << std::endl;
+		std::cout << "  CPU Barnes-Hut: " << measurement.cpuBuildMs << " ms build + " << measurement.cpuBarnesHutMs << " ms force, direct sum (extrapolated): " << measurement.cpuDirectMs << " ms" << std::endl;
+		std::cout << "  GPU all pairs: " << measurement.gpuMs[solverAllPairs] << " ms, GPU Barnes-Hut: " << measurement.gpuMs[solverBarnesHut] << " ms (0 = not measured yet)" << std::endl;
+	}
+
+	void submitValidation()
+	{
+		// Host visible copies of the particles and accelerations are only created once a validation is requested
+		if (compute.readback.particles.buffer == VK_NULL_HANDLE) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &compute.readback.particles, numParticles * sizeof(Particle)));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &compute.readback.accelerations, numParticles * sizeof(glm::vec4)));
+			VK_CHECK_RESULT(compute.readback.particles.map());
+			VK_CHECK_RESULT(compute.readback.accelerations.map());
+		}
+		buildComputeCommandBuffer(compute.validationCommandBuffer, true);
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
@@ -862,16 +1409,29 @@ public:
 		// Wait for rendering finished
 		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
+		// Replace the regular compute commands with a Barnes-Hut step that also reads back the data for validation
+		if (validationRequested) {
+			submitValidation();
+		}
+
 		// Submit compute commands
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
+		computeSubmitInfo.pCommandBuffers = validationRequested ? &compute.validationCommandBuffer : &compute.commandBuffer;
 		computeSubmitInfo.waitSemaphoreCount = 1;
 		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
 		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+
+		if (validationRequested) {
+			VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+			validate();
+			validationRequested = false;
+		} else if (compute.timestamps.fetch()) {
+			measurements[numParticles].gpuMs[solver] = compute.timestamps.duration(0, 1);
+		}
 	}
 
 	void prepare()
@@ -899,6 +1459,46 @@ public:
 			updateGraphicsUniformBuffers();
 		}
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			std::vector<std::string> particleCountNames;
+			for (auto count : particleCounts) {
+				particleCountNames.push_back(std::to_string(count * ATTRACTOR_COUNT));
+			}
+			if (overlay->comboBox("Particles", &particleCountIndex, particleCountNames)) {
+				changeParticleCount();
+			}
+			if (overlay->comboBox("Solver", &solver, { "All pairs", "Barnes-Hut" })) {
+				VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+				buildComputeCommandBuffer(compute.commandBuffer, false);
+			}
+			if (solver == solverBarnesHut) {
+				overlay->sliderFloat("Theta", &compute.ubo.theta, 0.1f, 1.5f);
+			} else if (numParticles > 100000) {
+				overlay->text("All pairs is O(N^2), switch to Barnes-Hut");
+			}
+		}
+		if (overlay->header("Performance")) {
+			const Measurement& current = measurements[numParticles];
+			if (compute.timestamps.supported()) {
+				overlay->text("GPU compute: %.3f ms", current.gpuMs[solver]);
+			}
+			if (overlay->button("Validate against CPU")) {
+				validationRequested = true;
+			}
+			// Comparison for all particle counts that have been measured so far
+			for (auto& measurement : measurements) {
+				overlay->text("N = %u", measurement.first);
+				overlay->text(" GPU pairs %.2f ms, BH %.2f ms", measurement.second.gpuMs[solverAllPairs], measurement.second.gpuMs[solverBarnesHut]);
+				if (measurement.second.validated) {
+					overlay->text(" CPU BH %.1f ms, direct %.0f ms", measurement.second.cpuBuildMs + measurement.second.cpuBarnesHutMs, measurement.second.cpuDirectMs);
+					overlay->text(" Error GPU %.2e, CPU %.2e", measurement.second.gpuError, measurement.second.cpuError);
+				}
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
@@ -9,8 +9,8 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanTimestampQuery.hpp"
 
-#define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 #if defined(__ANDROID__)
 // Lower particle count on Android for performance reasons
@@ -18,6 +18,8 @@
 #else
 #define PARTICLE_COUNT 256 * 1024
 #endif
+// Work group size of the compute shaders, the sort works on blocks of twice this size
+#define PARTICLE_GROUP_SIZE 256
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -26,24 +28,38 @@ public:
 	float animStart = 20.0f;
 	bool attachToCursor = false;
 
+	// Particle counts that can be selected at runtime, counts that exceed the device's storage buffer range are removed at startup
+	std::vector<uint32_t> particleCounts = { 64 * 1024, 128 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024, 32 * 1024 * 1024 };
+	int32_t particleCountIndex = 0;
+	// Number of elements in the sort buffers (particle count rounded up to the next power of two)
+	uint32_t sortCount = 0;
+	// Particles die after their lifetime and are emitted again at the attractor, only live particles are drawn
+	bool emitAndKill = false;
+	float lifetime = 8.0f;
+	// Share of all particles that's emitted again within one lifetime
+	float emissionRate = 0.75f;
+	// Sort the live particles back to front and draw them with alpha blending instead of additive blending
+	bool depthSort = false;
+
+	struct {
+		uint32_t liveParticles = 0;
+		double updateTime = 0.0;
+		double sortTime = 0.0;
+	} stats;
+
 	struct {
 		vks::Texture2D particle;
 		vks::Texture2D gradient;
 	} textures;
 
-	struct {
-		VkPipelineVertexInputStateCreateInfo inputState;
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
-	} vertices;
-
 	// Resources for the graphics part of the example
 	struct {
 		uint32_t queueFamilyIndex;					// Used to check if compute and graphics queue families differ and require additional barriers
 		VkDescriptorSetLayout descriptorSetLayout;	// Particle system rendering shader binding layout
 		VkDescriptorSet descriptorSet;				// Particle system rendering shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
-		VkPipeline pipeline;						// Particle rendering pipeline
+		VkPipeline pipeline;						// Particle rendering pipeline (additive blending)
+		VkPipeline pipelineSorted;					// Particle rendering pipeline for depth sorted particles (alpha blending)
 		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
 	} graphics;
 
@@ -51,6 +67,10 @@ public:
 	struct {
 		uint32_t queueFamilyIndex;					// Used to check if compute and graphics queue families differ and require additional barriers
 		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles
+		vks::Buffer sortKeys;						// Sort keys (depth) of the live particles
+		vks::Buffer sortValues;						// Indices of the live particles, these are drawn and sorted by their keys if enabled
+		vks::Buffer drawBuffer;						// Indirect draw command for the live particles and the number of particles emitted in the current frame
+		vks::Buffer readbackBuffer;					// Host visible copy of the draw command for displaying the number of live particles
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing particle system parameters
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
 		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
@@ -58,21 +78,35 @@ public:
 		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
-		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
-		VkPipeline pipeline;						// Compute pipeline for updating particle positions
+		VkPipelineLayout pipelineLayout;			// Layout of the compute pipelines
+		VkPipeline pipeline;						// Compute pipeline for updating particle positions, emitting and killing particles
+		VkPipeline pipelineSort;					// Compute pipeline for sorting the live particles by depth
+		vks::TimestampQuery timestamps;				// GPU times of the update and sort passes
 		struct computeUBO {							// Compute shader uniform block object
 			float deltaT;							//		Frame delta time
 			float destX;							//		x position of the attractor
 			float destY;							//		y position of the attractor
 			int32_t particleCount = PARTICLE_COUNT;
+			uint32_t emitCount;						//		Max. number of particles emitted in this frame
+			float lifetime;							//		Lifetime of emitted particles, 0 = particles live forever
+			uint32_t seed;							//		Random seed for the current frame
 		} ubo;
 	} compute;
 
+	// Push constants shared by all compute pipelines
+	struct ComputePushConstants {
+		uint32_t k;
+		uint32_t j;
+		uint32_t mode;
+		uint32_t count;
+		uint32_t groupCount;
+	};
+
 	// SSBO particle declaration
 	struct Particle {
 		glm::vec2 pos;								// Particle position
 		glm::vec2 vel;								// Particle velocity
-		glm::vec4 gradientPos;						// Texture coordinates for the gradient ramp map
+		glm::vec4 gradientPos;						// x = Texture coordinate for the gradient ramp map, y = Remaining lifetime, z = Depth
 	};
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -84,17 +118,20 @@ public:
 	{
 		// Graphics
 		vkDestroyPipeline(device, graphics.pipeline, nullptr);
+		vkDestroyPipeline(device, graphics.pipelineSorted, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, graphics.descriptorSetLayout, nullptr);
 
 		// Compute
-		compute.storageBuffer.destroy();
+		destroyStorageBuffers();
 		compute.uniformBuffer.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
+		vkDestroyPipeline(device, compute.pipelineSort, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		compute.timestamps.destroy();
 
 		textures.particle.destroy();
 		textures.gradient.destroy();
@@ -106,6 +143,36 @@ public:
 		textures.gradient.loadFromFile(getAssetPath() + "textures/particle_gradient_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
+	// Transfer the ownership of the buffers that are accessed by both compute and graphics, if the queue family indices differ
+	void addOwnershipBarriers(VkCommandBuffer commandBuffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+	{
+		if (graphics.queueFamilyIndex == compute.queueFamilyIndex)
+		{
+			return;
+		}
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		for (vks::Buffer* buffer : { &compute.storageBuffer, &compute.sortValues, &compute.drawBuffer })
+		{
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = srcAccessMask;
+			bufferBarrier.dstAccessMask = dstAccessMask;
+			bufferBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+			bufferBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+			bufferBarrier.buffer = buffer->buffer;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = buffer->size;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			srcStageMask,
+			dstStageMask,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			0, nullptr);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -131,30 +198,14 @@ public:
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
 			// Acquire barrier
-			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					0,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					compute.queueFamilyIndex,
-					graphics.queueFamilyIndex,
-					compute.storageBuffer.buffer,
-					0,
-					compute.storageBuffer.size
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+			addOwnershipBarriers(
+				drawCmdBuffers[i],
+				compute.queueFamilyIndex,
+				graphics.queueFamilyIndex,
+				0,
+				VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
 
 			// Draw the particle system using the update vertex buffer
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -165,218 +216,242 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthSort ? graphics.pipelineSorted : graphics.pipeline);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
 
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &compute.storageBuffer.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
+			// The number of live particles is written by the compute shader, so the draw is sourced from the indirect draw buffer
+			// Particles are fetched from the storage buffers in the vertex shader
+			vkCmdDrawIndirect(drawCmdBuffers[i], compute.drawBuffer.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			// Release barrier
-			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					0,
-					graphics.queueFamilyIndex,
-					compute.queueFamilyIndex,
-					compute.storageBuffer.buffer,
-					0,
-					compute.storageBuffer.size
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+			addOwnershipBarriers(
+				drawCmdBuffers[i],
+				graphics.queueFamilyIndex,
+				compute.queueFamilyIndex,
+				VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+				0,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 
 	}
 
+	// Execution and memory dependency between two compute passes
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = (srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT) ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// The number of work groups per dispatch is limited, so the shaders loop over the remaining work if required
+	uint32_t getGroupCount(uint32_t invocations)
+	{
+		return std::min((invocations + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, vulkanDevice->properties.limits.maxComputeWorkGroupCount[0]);
+	}
+
+	void dispatch(VkCommandBuffer commandBuffer, ComputePushConstants pushConstants, uint32_t invocations)
+	{
+		pushConstants.groupCount = getGroupCount(invocations);
+		vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, pushConstants.groupCount, 1, 1);
+	}
+
+	// Reset the indirect draw command and run the update pass, which simulates, emits and kills particles and appends the live ones to the draw list
+	// Mode 0 = Simulate, 1 = Initialize all particles
+	void recordUpdate(VkCommandBuffer commandBuffer, uint32_t mode)
+	{
+		const uint32_t drawReset[5] = { 0, 1, 0, 0, 0 };
+		vkCmdUpdateBuffer(commandBuffer, compute.drawBuffer.buffer, 0, sizeof(drawReset), drawReset);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+		dispatch(commandBuffer, { 0, 0, mode, sortCount, 0 }, compute.ubo.particleCount);
+	}
+
+	// Bitonic sort of the live particles by depth, local passes in shared memory handle all steps that fit into blocks of 512 elements
+	void recordSort(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t blockSize = 2 * PARTICLE_GROUP_SIZE;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineSort);
+		dispatch(commandBuffer, { 0, 0, 1, sortCount, 0 }, sortCount / 2);
+		computeBarrier(commandBuffer);
+		for (uint32_t k = blockSize * 2; k <= sortCount; k <<= 1) {
+			// Steps with a distance larger than a block need to go through global memory
+			for (uint32_t j = k >> 1; j >= blockSize; j >>= 1) {
+				dispatch(commandBuffer, { k, j, 0, sortCount, 0 }, sortCount / 2);
+				computeBarrier(commandBuffer);
+			}
+			dispatch(commandBuffer, { k, blockSize / 2, 2, sortCount, 0 }, sortCount / 2);
+			computeBarrier(commandBuffer);
+		}
+	}
+
 	void buildComputeCommandBuffer()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
 
+		compute.timestamps.reset(compute.commandBuffer);
+
 		// Compute particle movement
 
-		// Add memory barrier to ensure that the (graphics) vertex shader has fetched attributes before compute starts to write to the buffer
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+		// Add memory barrier to ensure that the (graphics) vertex shader has fetched the particles before compute starts to write to the buffers
+		addOwnershipBarriers(
+			compute.commandBuffer,
+			graphics.queueFamilyIndex,
+			compute.queueFamilyIndex,
+			0,
+			VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
+		compute.timestamps.write(compute.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
 
-		// Dispatch the compute job
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, PARTICLE_COUNT / 256, 1, 1);
+		recordUpdate(compute.commandBuffer, 0);
+		compute.timestamps.write(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1);
 
-		// Add barrier to ensure that compute shader has finished writing to the buffer
-		// Without this the (rendering) vertex shader may display incomplete results (partial data from last frame)
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
+		if (depthSort) {
+			computeBarrier(compute.commandBuffer);
+			recordSort(compute.commandBuffer);
 		}
+		compute.timestamps.write(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 2);
+
+		// Copy the draw command to host visible memory for displaying the number of live particles
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VkBufferCopy copyRegion = { 0, 0, sizeof(VkDrawIndirectCommand) };
+		vkCmdCopyBuffer(compute.commandBuffer, compute.drawBuffer.buffer, compute.readbackBuffer.buffer, 1, &copyRegion);
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Add barrier to ensure that compute shader has finished writing to the buffers
+		// Without this the (rendering) vertex shader may display incomplete results (partial data from last frame)
+		addOwnershipBarriers(
+			compute.commandBuffer,
+			compute.queueFamilyIndex,
+			graphics.queueFamilyIndex,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
 
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
-	// Setup and fill the compute shader storage buffers containing the particles
+	// Setup the compute shader storage buffers containing the particles and the draw list
+	// Particles are initialized on the GPU (see initParticles), so no staging is required even for large particle counts
 	void prepareStorageBuffers()
 	{
-		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
-		std::uniform_real_distribution<float> rndDist(-1.0f, 1.0f);
-
-		// Initial particle positions
-		std::vector<Particle> particleBuffer(PARTICLE_COUNT);
-		for (auto& particle : particleBuffer) {
-			particle.pos = glm::vec2(rndDist(rndEngine), rndDist(rndEngine));
-			particle.vel = glm::vec2(0.0f);
-			particle.gradientPos.x = particle.pos.x / 2.0f;
+		const uint32_t particleCount = static_cast<uint32_t>(compute.ubo.particleCount);
+		sortCount = 2 * PARTICLE_GROUP_SIZE;
+		while (sortCount < particleCount) {
+			sortCount <<= 1;
 		}
 
-		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
-
-		// Staging
-		// SSBO won't be changed on the host after upload so copy to device local memory
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.storageBuffer,
+			particleCount * sizeof(Particle));
 
-		vks::Buffer stagingBuffer;
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.sortKeys,
+			sortCount * sizeof(uint32_t));
 
 		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			storageBufferSize,
-			particleBuffer.data());
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.sortValues,
+			sortCount * sizeof(uint32_t));
 
+		// Indirect draw command followed by the emission counter
 		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffer,
-			storageBufferSize);
-
-		// Copy from staging buffer to storage buffer
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffer.buffer, 1, &copyRegion);
-		// Execute a transfer barrier to the compute queue, if necessary
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-				0,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+			&compute.drawBuffer,
+			sizeof(VkDrawIndirectCommand) + sizeof(uint32_t));
 
-			vkCmdPipelineBarrier(
-				copyCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
-
-		// Binding description
-		vertices.bindingDescriptions.resize(1);
-		vertices.bindingDescriptions[0] =
-			vks::initializers::vertexInputBindingDescription(
-				VERTEX_BUFFER_BIND_ID,
-				sizeof(Particle),
-				VK_VERTEX_INPUT_RATE_VERTEX);
-
-		// Attribute descriptions
-		// Describes memory layout and shader positions
-		vertices.attributeDescriptions.resize(2);
-		// Location 0 : Position
-		vertices.attributeDescriptions[0] =
-			vks::initializers::vertexInputAttributeDescription(
-				VERTEX_BUFFER_BIND_ID,
-				0,
-				VK_FORMAT_R32G32_SFLOAT,
-				offsetof(Particle, pos));
-		// Location 1 : Gradient position
-		vertices.attributeDescriptions[1] =
-			vks::initializers::vertexInputAttributeDescription(
-				VERTEX_BUFFER_BIND_ID,
-				1,
-				VK_FORMAT_R32G32B32A32_SFLOAT,
-				offsetof(Particle, gradientPos));
-
-		// Assign to vertex buffer
-		vertices.inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
-		vertices.inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertices.bindingDescriptions.size());
-		vertices.inputState.pVertexBindingDescriptions = vertices.bindingDescriptions.data();
-		vertices.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertices.attributeDescriptions.size());
-		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&compute.readbackBuffer,
+			sizeof(VkDrawIndirectCommand));
+		VK_CHECK_RESULT(compute.readbackBuffer.map());
+		memset(compute.readbackBuffer.mapped, 0, sizeof(VkDrawIndirectCommand));
+	}
+
+	void destroyStorageBuffers()
+	{
+		compute.storageBuffer.destroy();
+		compute.sortKeys.destroy();
+		compute.sortValues.destroy();
+		compute.drawBuffer.destroy();
+		compute.readbackBuffer.destroy();
+	}
+
+	// Point the storage buffer bindings of the graphics and compute descriptor sets to the current buffers
+	void updateStorageBufferDescriptors()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Graphics binding 2 : Particle storage buffer
+			vks::initializers::writeDescriptorSet(graphics.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compute.storageBuffer.descriptor),
+			// Graphics binding 3 : Indices of the live particles
+			vks::initializers::writeDescriptorSet(graphics.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.sortValues.descriptor),
+			// Compute binding 0 : Particle storage buffer
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffer.descriptor),
+			// Compute binding 2 : Sort keys
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compute.sortKeys.descriptor),
+			// Compute binding 3 : Indices of the live particles
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.sortValues.descriptor),
+			// Compute binding 4 : Indirect draw command
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.drawBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	}
+
+	// Initialize all particles on the GPU and fill the draw list
+	void initParticles()
+	{
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+		recordUpdate(commandBuffer, 1);
+		// Release the buffers to the graphics queue, so that the initial acquire from the graphics command buffers is matched up properly
+		addOwnershipBarriers(
+			commandBuffer,
+			compute.queueFamilyIndex,
+			graphics.queueFamilyIndex,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+		vulkanDevice->flushCommandBuffer(commandBuffer, compute.queue, compute.commandPool);
+	}
+
+	void changeParticleCount()
+	{
+		vkDeviceWaitIdle(device);
+		compute.ubo.particleCount = particleCounts[particleCountIndex];
+		destroyStorageBuffers();
+		prepareStorageBuffers();
+		updateStorageBufferDescriptors();
+		updateUniformBuffers();
+		initParticles();
+		buildComputeCommandBuffer();
+		buildCommandBuffers();
 	}
 
 	void setupDescriptorPool()
@@ -384,7 +459,7 @@ public:
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
@@ -410,6 +485,16 @@ public:
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			VK_SHADER_STAGE_FRAGMENT_BIT,
 			1));
+		// Binding 2 : Particle storage buffer
+		setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_SHADER_STAGE_VERTEX_BIT,
+			2));
+		// Binding 3 : Indices of the live particles
+		setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_SHADER_STAGE_VERTEX_BIT,
+			3));
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(
@@ -436,6 +521,7 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &graphics.descriptorSet));
 
+		// The storage buffer bindings are written in updateStorageBufferDescriptors
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 		// Binding 0 : Particle color map
 		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(
@@ -515,7 +601,10 @@ public:
 				renderPass,
 				0);
 
-		pipelineCreateInfo.pVertexInputState = &vertices.inputState;
+		// Particles are fetched from the storage buffer in the vertex shader
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+
+		pipelineCreateInfo.pVertexInputState = &emptyInputState;
 		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
 		pipelineCreateInfo.pRasterizationState = &rasterizationState;
 		pipelineCreateInfo.pColorBlendState = &colorBlendState;
@@ -538,6 +627,14 @@ public:
 		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
+
+		// Alpha blending for depth sorted particles
+		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelineSorted));
 	}
 
 	void prepareGraphics()
@@ -575,6 +672,21 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				1),
+			// Binding 2 : Sort keys
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				2),
+			// Binding 3 : Indices of the live particles
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				3),
+			// Binding 4 : Indirect draw command
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				4),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -589,6 +701,10 @@ public:
 				&compute.descriptorSetLayout,
 				1);
 
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ComputePushConstants), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
@@ -599,28 +715,17 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
 
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
-		{
-			// Binding 0 : Particle position storage buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				0,
-				&compute.storageBuffer.descriptor),
-			// Binding 1 : Uniform buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				1,
-				&compute.uniformBuffer.descriptor)
-		};
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+		// Binding 1 : Uniform buffer
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &compute.uniformBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
+		updateStorageBufferDescriptors();
 
 		// Create pipeline
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeparticles/particle.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeparticles/particle_sort.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineSort));
 
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -632,6 +737,9 @@ public:
 		// Create a command buffer for compute operations
 		compute.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
 
+		// Timestamps at the start of the compute work, after the update and after the sort
+		compute.timestamps.create(vulkanDevice, compute.queueFamilyIndex, 3);
+
 		// Semaphore for compute & graphics sync
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
@@ -646,56 +754,8 @@ public:
 		// Build a single command buffer containing the compute dispatch commands
 		buildComputeCommandBuffer();
 
-		// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			// Create a transient command buffer for setting up the initial buffer transfer state
-			VkCommandBuffer transferCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
-
-			VkBufferMemoryBarrier acquire_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &acquire_buffer_barrier,
-				0, nullptr);
-
-			VkBufferMemoryBarrier release_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &release_buffer_barrier,
-				0, nullptr);
-
-			vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
-		}
+		// Initial particle distribution, this also matches up the initial acquire from the graphics command buffers if graphics and compute queue family indices differ
+		initParticles();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -729,6 +789,10 @@ public:
 			compute.ubo.destX = normalizedMx;
 			compute.ubo.destY = normalizedMy;
 		}
+		// Dead particles are emitted again at a rate that keeps the given share of all particles alive
+		compute.ubo.lifetime = emitAndKill ? lifetime : 0.0f;
+		compute.ubo.emitCount = emitAndKill ? static_cast<uint32_t>(compute.ubo.particleCount * emissionRate * compute.ubo.deltaT / lifetime) : static_cast<uint32_t>(compute.ubo.particleCount);
+		compute.ubo.seed++;
 
 		memcpy(compute.uniformBuffer.mapped, &compute.ubo, sizeof(compute.ubo));
 	}
@@ -737,7 +801,7 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
-		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		VkSemaphore graphicsWaitSemaphores[] = { compute.semaphore, semaphores.presentComplete };
 		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphore, semaphores.renderComplete };
 
@@ -753,8 +817,16 @@ public:
 
 		VulkanExampleBase::submitFrame();
 
+		// Results of the previous compute submission, these don't wait, so they may lag behind a frame
+		if (compute.timestamps.fetch()) {
+			stats.updateTime = compute.timestamps.duration(0, 1);
+			stats.sortTime = compute.timestamps.duration(1, 2);
+		}
+		stats.liveParticles = static_cast<VkDrawIndirectCommand*>(compute.readbackBuffer.mapped)->vertexCount;
+
 		// Wait for rendering finished
-		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		// The compute command buffer starts with a transfer that resets the indirect draw command
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 
 		// Submit compute commands
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
@@ -776,6 +848,10 @@ public:
 		// If that's the case, we need additional barriers for acquiring and releasing resources
 		graphics.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
 		compute.queueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
+		// Only offer particle counts that fit into a single storage buffer binding
+		const VkDeviceSize maxStorageBufferRange = vulkanDevice->properties.limits.maxStorageBufferRange;
+		particleCounts.erase(std::remove_if(particleCounts.begin(), particleCounts.end(), [maxStorageBufferRange](uint32_t count) { return count * sizeof(Particle) > maxStorageBufferRange; }), particleCounts.end());
+		particleCountIndex = static_cast<int32_t>(std::find(particleCounts.begin(), particleCounts.end(), static_cast<uint32_t>(compute.ubo.particleCount)) - particleCounts.begin());
 		loadAssets();
 		setupDescriptorPool();
 		prepareGraphics();
@@ -811,6 +887,39 @@ public:
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Attach attractor to cursor", &attachToCursor);
+			std::vector<std::string> particleCountNames;
+			for (auto count : particleCounts) {
+				particleCountNames.push_back(std::to_string(count));
+			}
+			if (overlay->comboBox("Particles", &particleCountIndex, particleCountNames)) {
+				changeParticleCount();
+			}
+			if (overlay->checkBox("Emit / kill", &emitAndKill)) {
+				// Restart with a distribution that matches the new mode
+				changeParticleCount();
+			}
+			if (emitAndKill) {
+				overlay->sliderFloat("Lifetime", &lifetime, 1.0f, 20.0f);
+				overlay->sliderFloat("Emission", &emissionRate, 0.1f, 1.0f);
+			}
+			if (overlay->checkBox("Depth sort (alpha blending)", &depthSort)) {
+				vkDeviceWaitIdle(device);
+				buildComputeCommandBuffer();
+				buildCommandBuffers();
+			}
+		}
+		if (overlay->header("Performance")) {
+			overlay->text("Live particles: %u", stats.liveParticles);
+			if (compute.timestamps.supported()) {
+				overlay->text("Update: %.3f ms", stats.updateTime);
+				if (depthSort) {
+					overlay->text("Sort: %.3f ms", stats.sortTime);
+				}
+				// Particles updated per second
+				if (stats.updateTime > 0.0) {
+					overlay->text("Throughput: %.0f M/s", compute.ubo.particleCount / (stats.updateTime * 1000.0));
+				}
+			}
 		}
 	}
 };
@@ -6,11 +6,23 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <random>
+#include <glm/gtc/packing.hpp>
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
+// Primitive count of a leaf is stored in four bits of the node (see BVHNode)
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_BIN_COUNT 16
+// Testing every primitive for every ray is only feasible for small scenes, above this the BVH is always used
+#define BRUTE_FORCE_LIMIT 10000
+// Primary ray, reflections (RAYBOUNCES in raytracing.comp) and a shadow ray for each of them
+#define RAYS_PER_PIXEL 6
+
 #if defined(__ANDROID__)
 #define TEX_DIM 1024
 #else
@@ -31,11 +43,24 @@ public:
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
 	} graphics;
 
+	enum Scene { SceneSpheres10 = 0, SceneSpheres1K = 1, SceneSpheres100K = 2, SceneMesh = 3 };
+	const std::vector<std::string> sceneNames = { "10 spheres", "1K spheres", "100K spheres", "glTF mesh" };
+	int32_t sceneIndex = SceneSpheres10;
+	bool useBVH = true;
+
+	struct {
+		float bvhBuildTime = 0.0f;
+		double traceTime = 0.0;
+	} stats;
+
 	// Resources for the compute part of the example
 	struct {
 		struct {
 			vks::Buffer spheres;						// (Shader) storage buffer object with scene spheres
 			vks::Buffer planes;						// (Shader) storage buffer object with scene planes
+			vks::Buffer triangles;					// (Shader) storage buffer object with scene triangles
+			vks::Buffer nodes;						// (Shader) storage buffer object with the BVH nodes
+			vks::Buffer primitiveIndices;			// (Shader) storage buffer object with the primitives referenced by the BVH leaves
 		} storageBuffers;
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing scene data
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
@@ -46,26 +71,31 @@ public:
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
 		VkPipeline pipeline;						// Compute raytracing pipeline
+		vks::TimestampQuery timestamps;				// GPU time of the ray tracing dispatch
 		struct UBOCompute {							// Compute shader uniform block object
 			glm::vec3 lightPos;
 			float aspectRatio;						// Aspect ratio of the viewport
 			glm::vec4 fogColor = glm::vec4(0.0f);
 			struct {
 				glm::vec3 pos = glm::vec3(0.0f, 0.0f, 4.0f);
+				float _pad;							// std140 aligns the vec3 that follows to 16 bytes
 				glm::vec3 lookat = glm::vec3(0.0f, 0.5f, 0.0f);
 				float fov = 10.0f;
 			} camera;
+			int32_t sphereCount;
+			int32_t triangleCount;
+			int32_t planeCount;
+			int32_t nodeCount;
+			int32_t useBVH;
 		} ubo;
 	} compute;
 
-	// SSBO sphere declaration
-	struct Sphere {									// Shader uses std140 layout (so we only use vec4 instead of vec3)
+	// SSBO sphere declaration (std430)
+	struct Sphere {
 		glm::vec3 pos;
 		float radius;
 		glm::vec3 diffuse;
 		float specular;
-		uint32_t id;								// Id used to identify sphere for raytracing
-		glm::ivec3 _pad;
 	};
 
 	// SSBO plane declaration
@@ -74,10 +104,42 @@ public:
 		float distance;
 		glm::vec3 diffuse;
 		float specular;
-		uint32_t id;
-		glm::ivec3 _pad;
 	};
 
+	// SSBO triangle declaration, stored as the first vertex and two edges
+	struct Triangle {
+		glm::vec4 v0;								// w = Diffuse color packed to 8 bits per channel
+		glm::vec4 e1;								// w = Specular factor
+		glm::vec4 e2;
+	};
+
+	// SSBO BVH node declaration
+	// Nodes are stored in depth first order, so the first child of an inner node directly follows it
+	// The miss index points to the node after the node's subtree, which allows for a stackless traversal in the shader
+	struct BVHNode {
+		glm::vec3 aabbMin;
+		int32_t missIndex;
+		glm::vec3 aabbMax;
+		uint32_t primitives;						// Leaves: First primitive reference << 4 | Primitive count, 0 for inner nodes
+	};
+
+	// Primitive reference used while building the BVH
+	struct BVHPrimitive {
+		glm::vec3 aabbMin;
+		glm::vec3 aabbMax;
+		glm::vec3 centroid;
+		uint32_t index;
+	};
+
+	// CPU side copy of the current scene
+	struct {
+		std::vector<Sphere> spheres;
+		std::vector<Triangle> triangles;
+		std::vector<Plane> planes;
+		std::vector<BVHNode> nodes;
+		std::vector<uint32_t> primitiveIndices;
+	} scene;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader ray tracing";
@@ -105,9 +167,9 @@ public:
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyFence(device, compute.fence, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		compute.timestamps.destroy();
 		compute.uniformBuffer.destroy();
-		compute.storageBuffers.spheres.destroy();
-		compute.storageBuffers.planes.destroy();
+		destroyStorageBuffers();
 
 		textureComputeTarget.destroy();
 	}
@@ -263,20 +325,22 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
 
+		compute.timestamps.reset(compute.commandBuffer);
+		compute.timestamps.write(compute.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
 		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
 		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 
 		vkCmdDispatch(compute.commandBuffer, textureComputeTarget.width / 16, textureComputeTarget.height / 16, 1);
 
+		compute.timestamps.write(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1);
+
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
-	uint32_t currentId = 0;	// Id used to identify objects by the ray tracing shader
-
 	Sphere newSphere(glm::vec3 pos, float radius, glm::vec3 diffuse, float specular)
 	{
 		Sphere sphere;
-		sphere.id = currentId++;
 		sphere.pos = pos;
 		sphere.radius = radius;
 		sphere.diffuse = diffuse;
@@ -287,7 +351,6 @@ public:
 	Plane newPlane(glm::vec3 normal, float distance, glm::vec3 diffuse, float specular)
 	{
 		Plane plane;
-		plane.id = currentId++;
 		plane.normal = normal;
 		plane.distance = distance;
 		plane.diffuse = diffuse;
@@ -295,77 +358,350 @@ public:
 		return plane;
 	}
 
-	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
-	void prepareStorageBuffers()
+	Triangle newTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 diffuse, float specular)
 	{
-		// Spheres
-		std::vector<Sphere> spheres;
-		spheres.push_back(newSphere(glm::vec3(1.75f, -0.5f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(0.0f, 1.0f, -0.5f), 1.0f, glm::vec3(0.65f, 0.77f, 0.97f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(-1.75f, -0.75f, -0.5f), 1.25f, glm::vec3(0.9f, 0.76f, 0.46f), 32.0f));
-		VkDeviceSize storageBufferSize = spheres.size() * sizeof(Sphere);
+		Triangle triangle;
+		const uint32_t packedDiffuse = glm::packUnorm4x8(glm::vec4(diffuse, 1.0f));
+		float diffuseBits;
+		memcpy(&diffuseBits, &packedDiffuse, sizeof(float));
+		triangle.v0 = glm::vec4(v0, diffuseBits);
+		triangle.e1 = glm::vec4(v1 - v0, specular);
+		triangle.e2 = glm::vec4(v2 - v0, 0.0f);
+		return triangle;
+	}
 
-		// Stage
-		vks::Buffer stagingBuffer;
+	// Randomly distribute spheres inside the room, the more spheres the smaller they get
+	void addRandomSpheres(uint32_t count)
+	{
+		std::default_random_engine rndEngine(count);
+		std::uniform_real_distribution<float> rndPos(-3.5f, 3.5f);
+		std::uniform_real_distribution<float> rndDepth(-3.5f, 2.5f);
+		std::uniform_real_distribution<float> rndScale(0.75f, 1.25f);
+		std::uniform_real_distribution<float> rndColor(0.1f, 1.0f);
+		const float radius = 0.6f * std::cbrt(10.0f / (float)count);
+		for (uint32_t i = 0; i < count; i++) {
+			glm::vec3 pos(rndPos(rndEngine), rndPos(rndEngine), rndDepth(rndEngine));
+			glm::vec3 color(rndColor(rndEngine), rndColor(rndEngine), rndColor(rndEngine));
+			scene.spheres.push_back(newSphere(pos, radius * rndScale(rndEngine), color, 32.0f));
+		}
+	}
 
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	// Copy the contents of a device local buffer to host memory
+	void readBuffer(VkBuffer buffer, VkDeviceSize size, void* dst)
+	{
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
-			storageBufferSize,
-			spheres.data());
-
-		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.spheres,
-			storageBufferSize);
+			size));
 
-		// Copy to staging buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.spheres.buffer, 1, &copyRegion);
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, buffer, stagingBuffer.buffer, 1, &copyRegion);
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
+		VK_CHECK_RESULT(stagingBuffer.map());
+		memcpy(dst, stagingBuffer.mapped, size);
 		stagingBuffer.destroy();
+	}
+
+	// Load the triangles of a glTF model into the scene
+	// The model loader only keeps the vertex and index data on the device, so it's read back to build the BVH on the host
+	void addMesh(const std::string& filename)
+	{
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		vkglTF::Model model;
+		model.loadFromFile(filename, vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::DontLoadImages);
+		vkglTF::memoryPropertyFlags = 0;
+
+		std::vector<vkglTF::Vertex> vertices(model.vertices.count);
+		std::vector<uint32_t> indices(model.indices.count);
+		readBuffer(model.vertices.buffer, vertices.size() * sizeof(vkglTF::Vertex), vertices.data());
+		readBuffer(model.indices.buffer, indices.size() * sizeof(uint32_t), indices.data());
+
+		// Fit the model into the room
+		glm::vec3 aabbMin(FLT_MAX), aabbMax(-FLT_MAX);
+		for (auto& vertex : vertices) {
+			aabbMin = glm::min(aabbMin, vertex.pos);
+			aabbMax = glm::max(aabbMax, vertex.pos);
+		}
+		const glm::vec3 center = (aabbMin + aabbMax) * 0.5f;
+		const float scale = 2.5f / (glm::length(aabbMax - aabbMin) * 0.5f);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const vkglTF::Vertex& v0 = vertices[indices[i]];
+			const vkglTF::Vertex& v1 = vertices[indices[i + 1]];
+			const vkglTF::Vertex& v2 = vertices[indices[i + 2]];
+			const glm::vec3 color = glm::vec3(v0.color + v1.color + v2.color) / 3.0f;
+			scene.triangles.push_back(newTriangle((v0.pos - center) * scale, (v1.pos - center) * scale, (v2.pos - center) * scale, color, 32.0f));
+		}
+	}
+
+	// Generate the primitives of the selected scene
+	void generateScene()
+	{
+		scene.spheres.clear();
+		scene.triangles.clear();
+		scene.planes.clear();
+
+		switch (sceneIndex) {
+		case SceneSpheres10:
+			scene.spheres.push_back(newSphere(glm::vec3(1.75f, -0.5f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
+			scene.spheres.push_back(newSphere(glm::vec3(0.0f, 1.0f, -0.5f), 1.0f, glm::vec3(0.65f, 0.77f, 0.97f), 32.0f));
+			scene.spheres.push_back(newSphere(glm::vec3(-1.75f, -0.75f, -0.5f), 1.25f, glm::vec3(0.9f, 0.76f, 0.46f), 32.0f));
+			addRandomSpheres(7);
+			break;
+		case SceneSpheres1K:
+			addRandomSpheres(1000);
+			break;
+		case SceneSpheres100K:
+			addRandomSpheres(100000);
+			break;
+		case SceneMesh:
+			addMesh(getAssetPath() + "models/chinesedragon.gltf");
+			break;
+		}
 
 		// Planes
-		std::vector<Plane> planes;
 		const float roomDim = 4.0f;
-		planes.push_back(newPlane(glm::vec3(0.0f, 1.0f, 0.0f), roomDim, glm::vec3(1.0f), 32.0f));
-		planes.push_back(newPlane(glm::vec3(0.0f, -1.0f, 0.0f), roomDim, glm::vec3(1.0f), 32.0f));
-		planes.push_back(newPlane(glm::vec3(0.0f, 0.0f, 1.0f), roomDim, glm::vec3(1.0f), 32.0f));
-		planes.push_back(newPlane(glm::vec3(0.0f, 0.0f, -1.0f), roomDim, glm::vec3(0.0f), 32.0f));
-		planes.push_back(newPlane(glm::vec3(-1.0f, 0.0f, 0.0f), roomDim, glm::vec3(1.0f, 0.0f, 0.0f), 32.0f));
-		planes.push_back(newPlane(glm::vec3(1.0f, 0.0f, 0.0f), roomDim, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		storageBufferSize = planes.size() * sizeof(Plane);
+		scene.planes.push_back(newPlane(glm::vec3(0.0f, 1.0f, 0.0f), roomDim, glm::vec3(1.0f), 32.0f));
+		scene.planes.push_back(newPlane(glm::vec3(0.0f, -1.0f, 0.0f), roomDim, glm::vec3(1.0f), 32.0f));
+		scene.planes.push_back(newPlane(glm::vec3(0.0f, 0.0f, 1.0f), roomDim, glm::vec3(1.0f), 32.0f));
+		scene.planes.push_back(newPlane(glm::vec3(0.0f, 0.0f, -1.0f), roomDim, glm::vec3(0.0f), 32.0f));
+		scene.planes.push_back(newPlane(glm::vec3(-1.0f, 0.0f, 0.0f), roomDim, glm::vec3(1.0f, 0.0f, 0.0f), 32.0f));
+		scene.planes.push_back(newPlane(glm::vec3(1.0f, 0.0f, 0.0f), roomDim, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
+	}
+
+	float surfaceArea(const glm::vec3& aabbMin, const glm::vec3& aabbMax)
+	{
+		const glm::vec3 extent = aabbMax - aabbMin;
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	// Find the best split of a node's primitives along the axis with the largest centroid extent using the binned surface area heuristic
+	// Returns the index of the first primitive of the second child after partitioning, or first if no valid split was found
+	uint32_t findSplit(std::vector<BVHPrimitive>& primitives, uint32_t first, uint32_t count, const glm::vec3& centroidMin, const glm::vec3& centroidMax, uint32_t axis)
+	{
+		const float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f) {
+			return first;
+		}
+
+		struct Bin {
+			glm::vec3 aabbMin = glm::vec3(FLT_MAX);
+			glm::vec3 aabbMax = glm::vec3(-FLT_MAX);
+			uint32_t count = 0;
+		};
+		std::array<Bin, BVH_BIN_COUNT> bins;
+		const float binScale = (float)BVH_BIN_COUNT / extent;
+		auto binIndex = [&](const BVHPrimitive& primitive) {
+			return std::min((uint32_t)((primitive.centroid[axis] - centroidMin[axis]) * binScale), (uint32_t)BVH_BIN_COUNT - 1);
+		};
+		for (uint32_t i = first; i < first + count; i++) {
+			Bin& bin = bins[binIndex(primitives[i])];
+			bin.aabbMin = glm::min(bin.aabbMin, primitives[i].aabbMin);
+			bin.aabbMax = glm::max(bin.aabbMax, primitives[i].aabbMax);
+			bin.count++;
+		}
+
+		// Sweep from the right to get the cost of all primitives right of each split plane
+		std::array<float, BVH_BIN_COUNT> rightCost{};
+		glm::vec3 aabbMin(FLT_MAX), aabbMax(-FLT_MAX);
+		uint32_t rightCount = 0;
+		for (uint32_t i = BVH_BIN_COUNT - 1; i > 0; i--) {
+			aabbMin = glm::min(aabbMin, bins[i].aabbMin);
+			aabbMax = glm::max(aabbMax, bins[i].aabbMax);
+			rightCount += bins[i].count;
+			rightCost[i] = (rightCount > 0) ? surfaceArea(aabbMin, aabbMax) * rightCount : 0.0f;
+		}
+
+		// Sweep from the left and pick the split with the lowest combined cost
+		float bestCost = FLT_MAX;
+		uint32_t bestSplit = 0;
+		aabbMin = glm::vec3(FLT_MAX);
+		aabbMax = glm::vec3(-FLT_MAX);
+		uint32_t leftCount = 0;
+		for (uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++) {
+			aabbMin = glm::min(aabbMin, bins[i].aabbMin);
+			aabbMax = glm::max(aabbMax, bins[i].aabbMax);
+			leftCount += bins[i].count;
+			if ((leftCount == 0) || (leftCount == count)) {
+				continue;
+			}
+			const float cost = surfaceArea(aabbMin, aabbMax) * leftCount + rightCost[i + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+		if (bestCost == FLT_MAX) {
+			return first;
+		}
+
+		auto middle = std::partition(primitives.begin() + first, primitives.begin() + first + count, [&](const BVHPrimitive& primitive) { return binIndex(primitive) <= bestSplit; });
+		return (uint32_t)(middle - primitives.begin());
+	}
+
+	// Recursively build the subtree for the primitives [first, first + count)
+	void buildBVHNode(std::vector<BVHPrimitive>& primitives, uint32_t first, uint32_t count)
+	{
+		const size_t nodeIndex = scene.nodes.size();
+		scene.nodes.push_back({});
+
+		BVHNode node{};
+		node.aabbMin = glm::vec3(FLT_MAX);
+		node.aabbMax = glm::vec3(-FLT_MAX);
+		glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+		for (uint32_t i = first; i < first + count; i++) {
+			node.aabbMin = glm::min(node.aabbMin, primitives[i].aabbMin);
+			node.aabbMax = glm::max(node.aabbMax, primitives[i].aabbMax);
+			centroidMin = glm::min(centroidMin, primitives[i].centroid);
+			centroidMax = glm::max(centroidMax, primitives[i].centroid);
+		}
+
+		if (count <= BVH_MAX_LEAF_SIZE) {
+			// Primitives are referenced in the order they end up in after partitioning
+			node.primitives = (first << 4) | count;
+		} else {
+			const glm::vec3 centroidExtent = centroidMax - centroidMin;
+			const uint32_t axis = (centroidExtent.x > centroidExtent.y) ? ((centroidExtent.x > centroidExtent.z) ? 0 : 2) : ((centroidExtent.y > centroidExtent.z) ? 1 : 2);
+			uint32_t split = findSplit(primitives, first, count, centroidMin, centroidMax, axis);
+			if ((split == first) || (split == first + count)) {
+				// Fall back to a median split if the primitives can't be separated by their centroids (e.g. all of them share a bin)
+				split = first + count / 2;
+				std::nth_element(primitives.begin() + first, primitives.begin() + split, primitives.begin() + first + count, [axis](const BVHPrimitive& a, const BVHPrimitive& b) { return a.centroid[axis] < b.centroid[axis]; });
+			}
+			node.primitives = 0;
+			buildBVHNode(primitives, first, split - first);
+			buildBVHNode(primitives, split, first + count - split);
+		}
+
+		node.missIndex = (int32_t)scene.nodes.size();
+		scene.nodes[nodeIndex] = node;
+	}
+
+	// Build a bounding volume hierarchy over the spheres and triangles of the scene
+	// Planes are unbounded and are always tested by the shader
+	void buildBVH()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// Sphere primitives come first, followed by the triangles (see primitiveIntersect in raytracing.comp)
+		std::vector<BVHPrimitive> primitives;
+		primitives.reserve(scene.spheres.size() + scene.triangles.size());
+		for (auto& sphere : scene.spheres) {
+			BVHPrimitive primitive;
+			primitive.aabbMin = sphere.pos - glm::vec3(sphere.radius);
+			primitive.aabbMax = sphere.pos + glm::vec3(sphere.radius);
+			primitive.centroid = sphere.pos;
+			primitive.index = (uint32_t)primitives.size();
+			primitives.push_back(primitive);
+		}
+		for (auto& triangle : scene.triangles) {
+			const glm::vec3 v0 = glm::vec3(triangle.v0);
+			const glm::vec3 v1 = v0 + glm::vec3(triangle.e1);
+			const glm::vec3 v2 = v0 + glm::vec3(triangle.e2);
+			BVHPrimitive primitive;
+			primitive.aabbMin = glm::min(v0, glm::min(v1, v2));
+			primitive.aabbMax = glm::max(v0, glm::max(v1, v2));
+			primitive.centroid = (v0 + v1 + v2) / 3.0f;
+			primitive.index = (uint32_t)primitives.size();
+			primitives.push_back(primitive);
+		}
+
+		scene.nodes.clear();
+		scene.primitiveIndices.clear();
+		if (!primitives.empty()) {
+			buildBVHNode(primitives, 0, (uint32_t)primitives.size());
+		}
+		scene.primitiveIndices.reserve(primitives.size());
+		for (auto& primitive : primitives) {
+			scene.primitiveIndices.push_back(primitive.index);
+		}
+
+		stats.bvhBuildTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	// Upload the contents of an array into a device local storage buffer
+	template<typename T>
+	void createStorageBuffer(vks::Buffer& buffer, const std::vector<T>& data)
+	{
+		// Zero sized buffers are not allowed, empty arrays are backed by a single unused element (the shader only uses the counts from the uniform buffer)
+		VkDeviceSize storageBufferSize = std::max(data.size(), (size_t)1) * sizeof(T);
 
 		// Stage
+		vks::Buffer stagingBuffer;
+
 		vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
 			storageBufferSize,
-			planes.data());
+			data.empty() ? nullptr : (void*)data.data());
 
 		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.planes,
+			&buffer,
 			storageBufferSize);
 
 		// Copy to staging buffer
-		copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion = {};
 		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.planes.buffer, 1, &copyRegion);
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer.buffer, 1, &copyRegion);
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
 	}
 
+	// Setup and fill the compute shader storage buffers containing primitives and the BVH for the raytraced scene
+	void prepareStorageBuffers()
+	{
+		generateScene();
+		buildBVH();
+
+		createStorageBuffer(compute.storageBuffers.spheres, scene.spheres);
+		createStorageBuffer(compute.storageBuffers.planes, scene.planes);
+		createStorageBuffer(compute.storageBuffers.triangles, scene.triangles);
+		createStorageBuffer(compute.storageBuffers.nodes, scene.nodes);
+		createStorageBuffer(compute.storageBuffers.primitiveIndices, scene.primitiveIndices);
+
+		compute.ubo.sphereCount = (int32_t)scene.spheres.size();
+		compute.ubo.triangleCount = (int32_t)scene.triangles.size();
+		compute.ubo.planeCount = (int32_t)scene.planes.size();
+		compute.ubo.nodeCount = (int32_t)scene.nodes.size();
+		compute.ubo.useBVH = (useBVH || !bruteForceAllowed()) ? 1 : 0;
+	}
+
+	void destroyStorageBuffers()
+	{
+		compute.storageBuffers.spheres.destroy();
+		compute.storageBuffers.planes.destroy();
+		compute.storageBuffers.triangles.destroy();
+		compute.storageBuffers.nodes.destroy();
+		compute.storageBuffers.primitiveIndices.destroy();
+	}
+
+	bool bruteForceAllowed()
+	{
+		return scene.spheres.size() + scene.triangles.size() <= BRUTE_FORCE_LIMIT;
+	}
+
+	// Switch to the selected scene, rebuilding its BVH and the storage buffers
+	void changeScene()
+	{
+		// Make sure the compute queue no longer uses the current buffers
+		vkQueueWaitIdle(compute.queue);
+		destroyStorageBuffers();
+		prepareStorageBuffers();
+		updateComputeDescriptorSet();
+		buildComputeCommandBuffer();
+		updateUniformBuffers();
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
@@ -373,7 +709,7 @@ public:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),			// Compute UBO
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),	// Graphics image samplers
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),				// Storage image for ray traced image output
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),			// Storage buffer for the scene primitives
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),			// Storage buffers for the scene primitives and the BVH
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -517,6 +853,58 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
 	}
 
+	// The storage buffers are recreated if the scene changes, so the descriptors need to be updated too
+	void updateComputeDescriptorSet()
+	{
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
+		{
+			// Binding 0: Output storage image
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				0,
+				&textureComputeTarget.descriptor),
+			// Binding 1: Uniform buffer block
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				1,
+				&compute.uniformBuffer.descriptor),
+			// Binding 2: Shader storage buffer for the spheres
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				2,
+				&compute.storageBuffers.spheres.descriptor),
+			// Binding 3: Shader storage buffer for the planes
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				3,
+				&compute.storageBuffers.planes.descriptor),
+			// Binding 4: Shader storage buffer for the triangles
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				4,
+				&compute.storageBuffers.triangles.descriptor),
+			// Binding 5: Shader storage buffer for the BVH nodes
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				5,
+				&compute.storageBuffers.nodes.descriptor),
+			// Binding 6: Shader storage buffer for the primitives referenced by the BVH leaves
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				6,
+				&compute.storageBuffers.primitiveIndices.descriptor)
+		};
+
+		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
+	}
+
 	// Prepare the compute pipeline that generates the ray traced image
 	void prepareCompute()
 	{
@@ -542,16 +930,31 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				1),
-			// Binding 1: Shader storage buffer for the spheres
+			// Binding 2: Shader storage buffer for the spheres
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				2),
-			// Binding 1: Shader storage buffer for the planes
+			// Binding 3: Shader storage buffer for the planes
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				3),
+			// Binding 4: Shader storage buffer for the triangles
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				4),
+			// Binding 5: Shader storage buffer for the BVH nodes
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				5),
+			// Binding 6: Shader storage buffer for the primitives referenced by the BVH leaves
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
-				3)
+				6)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -576,35 +979,7 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
 
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
-		{
-			// Binding 0: Output storage image
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-				0,
-				&textureComputeTarget.descriptor),
-			// Binding 1: Uniform buffer block
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				1,
-				&compute.uniformBuffer.descriptor),
-			// Binding 2: Shader storage buffer for the spheres
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				2,
-				&compute.storageBuffers.spheres.descriptor),
-			// Binding 2: Shader storage buffer for the planes
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				3,
-				&compute.storageBuffers.planes.descriptor)
-		};
-
-		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
+		updateComputeDescriptorSet();
 
 		// Create compute shader pipelines
 		VkComputePipelineCreateInfo computePipelineCreateInfo =
@@ -635,6 +1010,9 @@ public:
 		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &compute.fence));
 
+		// Timestamps at the start and end of the ray tracing dispatch
+		compute.timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.compute, 2);
+
 		// Build a single command buffer containing the compute dispatch commands
 		buildComputeCommandBuffer();
 	}
@@ -683,7 +1061,11 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
-		VulkanExampleBase::submitFrame();		
+		VulkanExampleBase::submitFrame();
+
+		if (compute.timestamps.fetch()) {
+			stats.traceTime = compute.timestamps.duration(0, 1);
+		}
 	}
 
 	void prepare()
@@ -717,6 +1099,35 @@ public:
 		compute.ubo.aspectRatio = (float)width / (float)height;
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->comboBox("Scene", &sceneIndex, sceneNames)) {
+				changeScene();
+			}
+			if (bruteForceAllowed()) {
+				if (overlay->checkBox("Use BVH", &useBVH)) {
+					compute.ubo.useBVH = useBVH ? 1 : 0;
+					updateUniformBuffers();
+				}
+			} else {
+				overlay->text("BVH always used above %d primitives", BRUTE_FORCE_LIMIT);
+			}
+		}
+		if (overlay->header("Performance")) {
+			overlay->text("%d primitives, %d planes", compute.ubo.sphereCount + compute.ubo.triangleCount, compute.ubo.planeCount);
+			overlay->text("BVH: %d nodes built in %.2f ms", compute.ubo.nodeCount, stats.bvhBuildTime);
+			if (compute.timestamps.supported()) {
+				overlay->text("%ux%u: %.3f ms", textureComputeTarget.width, textureComputeTarget.height, stats.traceTime);
+				if (stats.traceTime > 0.0) {
+					// All rays hit the room, so every ray also casts a shadow ray
+					const double megaRays = (double)textureComputeTarget.width * textureComputeTarget.height * RAYS_PER_PIXEL / 1000000.0;
+					overlay->text("%.0f Mrays/s", megaRays / (stats.traceTime / 1000.0));
+				}
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
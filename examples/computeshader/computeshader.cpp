@@ -6,11 +6,20 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <map>
 #include "vulkanexamplebase.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
+// Limits of the generic filter shader (see filter.comp)
+#define FILTER_TILE_SIZE 16
+#define FILTER_MAX_APRON 8
+#define FILTER_MAX_STAGES 4
+#define FILTER_MAX_CHAIN 8
+#define FILTER_MAX_WEIGHTS 256
+
 // Vertex layout for this example
 struct Vertex {
 	float pos[3];
@@ -21,8 +30,58 @@ class VulkanExample : public VulkanExampleBase
 {
 private:
 	vks::Texture2D textureColorMap;
+	vks::Texture2D textureLarge;
 	vks::Texture2D textureComputeTarget;
+	vks::Texture2D textureIntermediate;
 public:
+	// Image filter made up of one 2D or two 1D (separable) convolution stages
+	struct Filter {
+		std::string name;
+		int32_t radius;
+		bool separable;
+		bool grayscale;
+		float scale;
+		float offset;
+		// (2 * radius + 1)^2 weights for 2D filters, 2 * radius + 1 weights used for both directions for separable filters
+		std::vector<float> weights;
+	};
+	std::vector<Filter> filters;
+	std::vector<std::string> filterNames;
+	int32_t blurRadius = 4;
+
+	// Filters applied in order, -1 = none
+	std::array<int32_t, 3> chain = { 3, 1, -1 };
+	// Apply as many stages as fit into the shared memory apron within a single dispatch
+	bool fuseStages = true;
+	// Run the filters on an upscaled 8K copy of the input image
+	bool largeInput = false;
+
+	// A single convolution stage of the filter chain
+	struct FilterStage {
+		int32_t radius;
+		int32_t direction;							// 0 = 2D, 1 = Horizontal, 2 = Vertical
+		int32_t weightOffset;
+		bool grayscale;
+		float scale;
+		float offset;
+	};
+	std::vector<FilterStage> filterStages;
+
+	// Stages that are applied by a single dispatch, specialization constants of the filter pipeline
+	struct FilterPass {
+		int32_t stageCount;
+		int32_t radius[FILTER_MAX_STAGES];
+		int32_t direction[FILTER_MAX_STAGES];
+		int32_t apronX;
+		int32_t apronY;
+		int32_t firstStage;							// Passed as a push constant, not part of the pipeline
+	};
+	std::vector<FilterPass> filterPasses;
+
+	struct {
+		double filterTime = 0.0;
+	} stats;
+
 	struct {
 		VkPipelineVertexInputStateCreateInfo inputState;
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
@@ -46,10 +105,12 @@ public:
 		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
 		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
-		VkDescriptorSet descriptorSet;				// Compute shader bindings
+		std::array<VkDescriptorSet, 4> descriptorSets;	// Compute shader bindings for all input and output image combinations of a filter chain (see getPassDescriptorSet)
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
-		std::vector<VkPipeline> pipelines;			// Compute pipelines for image filters
-		int32_t pipelineIndex = 0;					// Current image filtering compute pipeline index
+		VkPipelineShaderStageCreateInfo shaderStage;	// Filter shader, specialized for the stages of each pass
+		std::map<std::vector<int32_t>, VkPipeline> pipelines;	// Compute pipelines for image filter passes, keyed by their specialization constants
+		vks::Buffer uniformBuffer;					// Weights and scaling of all filter stages
+		vks::TimestampQuery timestamps;				// GPU time of the filter chain
 	} compute;
 
 	vks::Buffer vertexBuffer;
@@ -65,8 +126,6 @@ public:
 
 	int vertexBufferSize;
 
-	std::vector<std::string> shaderNames;
-
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader image load/store";
@@ -87,19 +146,21 @@ public:
 		// Compute
 		for (auto& pipeline : compute.pipelines)
 		{
-			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipeline(device, pipeline.second, nullptr);
 		}
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		compute.uniformBuffer.destroy();
+		compute.timestamps.destroy();
 
 		vertexBuffer.destroy();
 		indexBuffer.destroy();
 		uniformBufferVS.destroy();
 
 		textureColorMap.destroy();
-		textureComputeTarget.destroy();
+		destroyTextureTargets(largeInput);
 	}
 
 	// Prepare a texture target that is used to store compute shader calculations
@@ -115,6 +176,7 @@ public:
 		// Prepare blit target texture
 		tex->width = width;
 		tex->height = height;
+		tex->mipLevels = 1;
 
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
 		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -125,7 +187,8 @@ public:
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		// Image will be sampled in the fragment shader and used as storage target in the compute shader
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+		// It may also be used as a blit target for the upscaled input image
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		imageCreateInfo.flags = 0;
 		// If compute and graphics queue family indices differ, we create an image that can be shared between them
 		// This can result in worse performance than exclusive sharing mode, but save some synchronization to keep the sample simple
@@ -197,7 +260,200 @@ public:
 
 	void loadAssets()
 	{
-		textureColorMap.loadFromFile(getAssetPath() + "textures/vulkan_11_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		textureColorMap.loadFromFile(getAssetPath() + "textures/vulkan_11_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	}
+
+	// Image the filter chain reads from
+	vks::Texture2D& getSourceTexture()
+	{
+		return largeInput ? textureLarge : textureColorMap;
+	}
+
+	// Create the filter output image, the intermediate image for chains that need more than one pass and (if enabled) the upscaled input image
+	void prepareTextureTargets()
+	{
+		if (largeInput) {
+			prepareTextureTarget(&textureLarge, 7680, 4320, VK_FORMAT_R8G8B8A8_UNORM);
+			// Upscale the input image with a blit
+			VkCommandBuffer blitCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkImageBlit blit{};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.srcOffsets[1] = { (int32_t)textureColorMap.width, (int32_t)textureColorMap.height, 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.dstOffsets[1] = { (int32_t)textureLarge.width, (int32_t)textureLarge.height, 1 };
+			vkCmdBlitImage(blitCmd, textureColorMap.image, VK_IMAGE_LAYOUT_GENERAL, textureLarge.image, VK_IMAGE_LAYOUT_GENERAL, 1, &blit, VK_FILTER_LINEAR);
+			vulkanDevice->flushCommandBuffer(blitCmd, queue, true);
+		}
+		vks::Texture2D& source = getSourceTexture();
+		prepareTextureTarget(&textureComputeTarget, source.width, source.height, VK_FORMAT_R8G8B8A8_UNORM);
+		prepareTextureTarget(&textureIntermediate, source.width, source.height, VK_FORMAT_R8G8B8A8_UNORM);
+	}
+
+	void destroyTextureTargets(bool includeLargeInput)
+	{
+		if (includeLargeInput) {
+			textureLarge.destroy();
+		}
+		textureComputeTarget.destroy();
+		textureIntermediate.destroy();
+	}
+
+	// Setup the filters that can be chained
+	void prepareFilters()
+	{
+		filters = {
+			{ "Emboss", 1, false, true, 1.0f, 0.5f, {
+				-1.0f, 0.0f, 0.0f,
+				0.0f, -1.0f, 0.0f,
+				0.0f, 0.0f, 2.0f } },
+			{ "Edge detect", 1, false, true, 10.0f, 0.0f, {
+				-1.0f / 8.0f, -1.0f / 8.0f, -1.0f / 8.0f,
+				-1.0f / 8.0f, 1.0f, -1.0f / 8.0f,
+				-1.0f / 8.0f, -1.0f / 8.0f, -1.0f / 8.0f } },
+			{ "Sharpen", 1, false, false, 1.0f, 0.0f, {
+				-1.0f, -1.0f, -1.0f,
+				-1.0f, 9.0f, -1.0f,
+				-1.0f, -1.0f, -1.0f } },
+			{ "Gaussian blur", blurRadius, true, false, 1.0f, 0.0f, {} },
+			{ "Box blur", blurRadius, true, false, 1.0f, 0.0f, {} },
+			{ "Unsharp mask 5x5", 2, false, false, 1.0f, 0.0f, {} },
+		};
+		updateBlurWeights();
+		// Unsharp masking: 2 * identity - gaussian
+		std::vector<float> gauss = { 1.0f, 4.0f, 6.0f, 4.0f, 1.0f };
+		for (int32_t y = 0; y < 5; y++) {
+			for (int32_t x = 0; x < 5; x++) {
+				filters[5].weights.push_back(((x == 2 && y == 2) ? 2.0f : 0.0f) - gauss[x] * gauss[y] / 256.0f);
+			}
+		}
+		filterNames = { "None" };
+		for (auto& filter : filters) {
+			filterNames.push_back(filter.name);
+		}
+	}
+
+	// Generate the weights of the separable blur filters for the current radius
+	void updateBlurWeights()
+	{
+		Filter& gaussian = filters[3];
+		Filter& box = filters[4];
+		gaussian.radius = box.radius = blurRadius;
+		gaussian.weights.resize(2 * blurRadius + 1);
+		box.weights.assign(2 * blurRadius + 1, 1.0f / (2 * blurRadius + 1));
+		const float sigma = blurRadius / 2.0f;
+		float sum = 0.0f;
+		for (int32_t i = -blurRadius; i <= blurRadius; i++) {
+			gaussian.weights[i + blurRadius] = exp(-(i * i) / (2.0f * sigma * sigma));
+			sum += gaussian.weights[i + blurRadius];
+		}
+		for (auto& weight : gaussian.weights) {
+			weight /= sum;
+		}
+	}
+
+	// Split the chain into convolution stages and group them into passes, uploads the stage parameters to the uniform buffer
+	void updateFilterPasses()
+	{
+		filterStages.clear();
+		struct {
+			glm::ivec4 stageInfo[FILTER_MAX_CHAIN];
+			glm::vec4 stageScale[FILTER_MAX_CHAIN];
+			float weights[FILTER_MAX_WEIGHTS];
+		} uboFilter{};
+		int32_t weightCount = 0;
+		for (int32_t filterIndex : chain) {
+			if (filterIndex < 0) {
+				continue;
+			}
+			const Filter& filter = filters[filterIndex];
+			const int32_t weightOffset = weightCount;
+			memcpy(&uboFilter.weights[weightCount], filter.weights.data(), filter.weights.size() * sizeof(float));
+			weightCount += static_cast<int32_t>(filter.weights.size());
+			if (filter.separable) {
+				// Separable filters are applied as two passes, scale and bias are applied with the second one
+				filterStages.push_back({ filter.radius, 1, weightOffset, filter.grayscale, 1.0f, 0.0f });
+				filterStages.push_back({ filter.radius, 2, weightOffset, false, filter.scale, filter.offset });
+			} else {
+				filterStages.push_back({ filter.radius, 0, weightOffset, filter.grayscale, filter.scale, filter.offset });
+			}
+		}
+		// Passing the image through unchanged
+		if (filterStages.empty()) {
+			uboFilter.weights[0] = 1.0f;
+			filterStages.push_back({ 0, 0, 0, false, 1.0f, 0.0f });
+		}
+		assert(filterStages.size() <= FILTER_MAX_CHAIN);
+		assert(weightCount <= FILTER_MAX_WEIGHTS);
+
+		for (size_t i = 0; i < filterStages.size(); i++) {
+			uboFilter.stageInfo[i] = glm::ivec4(filterStages[i].weightOffset, filterStages[i].grayscale ? 1 : 0, 0, 0);
+			uboFilter.stageScale[i] = glm::vec4(filterStages[i].scale, filterStages[i].offset, 0.0f, 0.0f);
+		}
+		memcpy(compute.uniformBuffer.mapped, &uboFilter, sizeof(uboFilter));
+
+		// Add stages to a pass as long as their radii fit into the apron that's loaded to shared memory
+		filterPasses.clear();
+		for (size_t i = 0; i < filterStages.size(); i++) {
+			const FilterStage& stage = filterStages[i];
+			const int32_t radiusX = (stage.direction == 2) ? 0 : stage.radius;
+			const int32_t radiusY = (stage.direction == 1) ? 0 : stage.radius;
+			bool newPass = filterPasses.empty() || !fuseStages;
+			if (!newPass) {
+				const FilterPass& pass = filterPasses.back();
+				newPass = (pass.stageCount == FILTER_MAX_STAGES) || (pass.apronX + radiusX > FILTER_MAX_APRON) || (pass.apronY + radiusY > FILTER_MAX_APRON);
+			}
+			if (newPass) {
+				FilterPass pass{};
+				pass.firstStage = static_cast<int32_t>(i);
+				filterPasses.push_back(pass);
+			}
+			FilterPass& pass = filterPasses.back();
+			pass.radius[pass.stageCount] = stage.radius;
+			pass.direction[pass.stageCount] = stage.direction;
+			pass.stageCount++;
+			pass.apronX += radiusX;
+			pass.apronY += radiusY;
+		}
+	}
+
+	// Get the pipeline for a filter pass, pipelines are created on demand as the stage configuration is baked into the shader
+	VkPipeline getPassPipeline(const FilterPass& pass)
+	{
+		// Specialization constants in the order of their constant ids
+		std::vector<int32_t> specializationData = { pass.stageCount };
+		specializationData.insert(specializationData.end(), pass.radius, pass.radius + FILTER_MAX_STAGES);
+		specializationData.insert(specializationData.end(), pass.direction, pass.direction + FILTER_MAX_STAGES);
+		specializationData.push_back(pass.apronX);
+		specializationData.push_back(pass.apronY);
+
+		auto it = compute.pipelines.find(specializationData);
+		if (it != compute.pipelines.end()) {
+			return it->second;
+		}
+
+		std::vector<VkSpecializationMapEntry> specializationMapEntries;
+		for (uint32_t i = 0; i < specializationData.size(); i++) {
+			specializationMapEntries.push_back(vks::initializers::specializationMapEntry(i, i * sizeof(int32_t), sizeof(int32_t)));
+		}
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, specializationData.size() * sizeof(int32_t), specializationData.data());
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = compute.shaderStage;
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VkPipeline pipeline;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+		compute.pipelines[specializationData] = pipeline;
+		return pipeline;
+	}
+
+	// Passes alternate between the output and the intermediate image, so that the last one always writes to the output image
+	VkDescriptorSet getPassDescriptorSet(uint32_t passIndex)
+	{
+		const bool writesTarget = ((filterPasses.size() - 1 - passIndex) % 2) == 0;
+		if (passIndex == 0) {
+			return writesTarget ? compute.descriptorSets[0] : compute.descriptorSets[1];
+		}
+		return writesTarget ? compute.descriptorSets[2] : compute.descriptorSets[3];
 	}
 
 	void buildCommandBuffers()
@@ -286,12 +542,30 @@ public:
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
+		// The filter parameters are only read by this command buffer, so they can be updated once the queue is idle
+		updateFilterPasses();
+
 		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
 
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines[compute.pipelineIndex]);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+		compute.timestamps.reset(compute.commandBuffer);
+		compute.timestamps.write(compute.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
 
-		vkCmdDispatch(compute.commandBuffer, textureComputeTarget.width / 16, textureComputeTarget.height / 16, 1);
+		for (uint32_t i = 0; i < filterPasses.size(); i++) {
+			if (i > 0) {
+				// Make the output of the previous pass visible to the next one
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+			VkDescriptorSet descriptorSet = getPassDescriptorSet(i);
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, getPassPipeline(filterPasses[i]));
+			vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+			vkCmdPushConstants(compute.commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(int32_t), &filterPasses[i].firstStage);
+			vkCmdDispatch(compute.commandBuffer, (textureComputeTarget.width + FILTER_TILE_SIZE - 1) / FILTER_TILE_SIZE, (textureComputeTarget.height + FILTER_TILE_SIZE - 1) / FILTER_TILE_SIZE, 1);
+		}
+
+		compute.timestamps.write(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1);
 
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
@@ -361,10 +635,12 @@ public:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
 			// Graphics pipelines image samplers for displaying compute output image
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
-			// Compute pipelines uses a storage image for image reads and writes
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			// Compute pipelines uses storage images for image reads and writes
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 8),
+			// Compute pipelines uniform buffer with the filter parameters
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 6);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -399,12 +675,48 @@ public:
 
 		// Final image (after compute shader processing)
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &graphics.descriptorSetPostCompute));
+		updateImageDescriptors();
+	}
+
+	// Update all descriptors that refer to the images recreated when changing the input size
+	void updateImageDescriptors()
+	{
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(graphics.descriptorSetPostCompute, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBufferVS.descriptor),
 			vks::initializers::writeDescriptorSet(graphics.descriptorSetPostCompute, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textureComputeTarget.descriptor)
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+	}
 
+	// Input and output images of the compute descriptor sets: source -> output, source -> intermediate, intermediate -> output, output -> intermediate
+	void updateComputeDescriptorSets()
+	{
+		const std::array<std::pair<VkDescriptorImageInfo*, VkDescriptorImageInfo*>, 4> images = { {
+			{ &getSourceTexture().descriptor, &textureComputeTarget.descriptor },
+			{ &getSourceTexture().descriptor, &textureIntermediate.descriptor },
+			{ &textureIntermediate.descriptor, &textureComputeTarget.descriptor },
+			{ &textureComputeTarget.descriptor, &textureIntermediate.descriptor },
+		} };
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets;
+		for (size_t i = 0; i < images.size(); i++) {
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, images[i].first));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, images[i].second));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor));
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+	}
+
+	// Recreate the image targets after switching between the original and the upscaled input image
+	void changeInputSize()
+	{
+		vkDeviceWaitIdle(device);
+		// The upscaled input image only exists if it was enabled before the change
+		destroyTextureTargets(!largeInput);
+		prepareTextureTargets();
+		updateImageDescriptors();
+		updateComputeDescriptorSets();
+		buildComputeCommandBuffer();
+		buildCommandBuffers();
 	}
 
 	void preparePipelines()
@@ -511,6 +823,8 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 			// Binding 1: Output image (write)
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Filter stage parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -518,32 +832,30 @@ public:
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		// Index of the first stage of a pass
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
+		// Uniform buffer with the parameters of all filter stages
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&compute.uniformBuffer,
+			FILTER_MAX_CHAIN * 2 * sizeof(glm::vec4) + FILTER_MAX_WEIGHTS * sizeof(float)));
+		VK_CHECK_RESULT(compute.uniformBuffer.map());
+
+		std::vector<VkDescriptorSetLayout> setLayouts(compute.descriptorSets.size(), compute.descriptorSetLayout);
 		VkDescriptorSetAllocateInfo allocInfo =
-			vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+			vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
 
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &textureColorMap.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &textureComputeTarget.descriptor)
-		};
-		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
-
-		// Create compute shader pipelines
-		VkComputePipelineCreateInfo computePipelineCreateInfo =
-			vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
-
-		// One pipeline for each effect
-		shaderNames = { "emboss", "edgedetect", "sharpen" };
-		for (auto& shaderName : shaderNames) {
-			std::string fileName = getShadersPath() + "computeshader/" + shaderName + ".comp.spv";
-			computePipelineCreateInfo.stage = loadShader(fileName, VK_SHADER_STAGE_COMPUTE_BIT);
-			VkPipeline pipeline;
-			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
-			compute.pipelines.push_back(pipeline);
-		}
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, compute.descriptorSets.data()));
+		updateComputeDescriptorSets();
+
+		// A single shader is used for all filters, pipelines for the different filter passes are created on demand with specialization constants (see getPassPipeline)
+		compute.shaderStage = loadShader(getShadersPath() + "computeshader/filter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -561,6 +873,9 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &compute.commandBuffer));
 
+		// Timestamps at the start and end of the filter chain
+		compute.timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.compute, 2);
+
 		// Semaphore for compute & graphics sync
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
@@ -624,16 +939,21 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
+
+		if (compute.timestamps.fetch()) {
+			stats.filterTime = compute.timestamps.duration(0, 1);
+		}
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		prepareFilters();
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
-		prepareTextureTarget(&textureComputeTarget, textureColorMap.width, textureColorMap.height, VK_FORMAT_R8G8B8A8_UNORM);
+		prepareTextureTargets();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -657,9 +977,37 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->comboBox("Shader", &compute.pipelineIndex, shaderNames)) {
+			bool rebuild = false;
+			for (size_t i = 0; i < chain.size(); i++) {
+				int32_t selection = chain[i] + 1;
+				if (overlay->comboBox(("Filter " + std::to_string(i + 1)).c_str(), &selection, filterNames)) {
+					chain[i] = selection - 1;
+					rebuild = true;
+				}
+			}
+			if (overlay->sliderInt("Blur radius", &blurRadius, 1, FILTER_MAX_APRON)) {
+				updateBlurWeights();
+				rebuild = true;
+			}
+			if (overlay->checkBox("Fuse stages", &fuseStages)) {
+				rebuild = true;
+			}
+			if (rebuild) {
 				buildComputeCommandBuffer();
 			}
+			if (overlay->checkBox("8K input", &largeInput)) {
+				changeInputSize();
+			}
+		}
+		if (overlay->header("Performance")) {
+			overlay->text("%d stages in %d passes", (int32_t)filterStages.size(), (int32_t)filterPasses.size());
+			if (compute.timestamps.supported()) {
+				const double megaPixels = (double)textureComputeTarget.width * textureComputeTarget.height / 1000000.0;
+				overlay->text("%ux%u: %.3f ms", textureComputeTarget.width, textureComputeTarget.height, stats.filterTime);
+				if (stats.filterTime > 0.0) {
+					overlay->text("%.0f Mpixel/s", megaPixels / (stats.filterTime / 1000.0));
+				}
+			}
 		}
 	}
 };
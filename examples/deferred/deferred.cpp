@@ -6,8 +6,11 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <random>
+
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -18,10 +21,20 @@
 // Offscreen frame buffer properties
 #define FB_DIM TEX_DIM
 
+// Light clusters (need to match the light culling and composition shaders)
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+#define MAX_LIGHT_COUNT 4096
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	int32_t debugDisplayTarget = 0;
+	int32_t lightCount = 256;
+	bool clusteredShading = true;
 
 	struct {
 		struct {
@@ -52,10 +65,25 @@ public:
 		float radius;
 	};
 
+	// Lights beyond the six main lights are placed randomly and orbit around their start position
+	struct LightMotion {
+		glm::vec3 center;
+		float orbitRadius;
+		float speed;
+		float phase;
+	};
+	std::vector<Light> lights;
+	std::vector<LightMotion> lightMotions;
+
 	struct {
-		Light lights[6];
+		glm::mat4 view;
+		glm::mat4 invProjection;
 		glm::vec4 viewPos;
 		int debugDisplayTarget = 0;
+		int lightCount;
+		int clustered;
+		float zNear;
+		float zFar;
 	} uboComposition;
 
 	struct {
@@ -63,6 +91,27 @@ public:
 		vks::Buffer composition;
 	} uniformBuffers;
 
+	struct {
+		// Light data for all lights, updated by the host each frame
+		vks::Buffer lights;
+		// Number of lights per cluster
+		vks::Buffer lightGrid;
+		// Indices of the lights per cluster, each cluster has a fixed range of MAX_LIGHTS_PER_CLUSTER entries
+		vks::Buffer lightIndices;
+	} storageBuffers;
+
+	// Compute pass that assigns the lights to the view space clusters
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} lightCulling;
+
+	// Timestamps written around the passes to measure their GPU times
+	enum Timestamps { TS_CULLING_START, TS_CULLING_END, TS_COMPOSITION_START, TS_COMPOSITION_END, TS_COUNT };
+	vks::TimestampQuery timestampQuery;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
@@ -149,10 +198,22 @@ public:
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		// Light culling
+		vkDestroyPipeline(device, lightCulling.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, lightCulling.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, lightCulling.descriptorSetLayout, nullptr);
+
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.composition.destroy();
 
+		// Storage buffers
+		storageBuffers.lights.destroy();
+		storageBuffers.lightGrid.destroy();
+		storageBuffers.lightIndices.destroy();
+
+		timestampQuery.destroy();
+
 		vkDestroyRenderPass(device, offScreenFrameBuf.renderPass, nullptr);
 
 		textures.model.colorMap.destroy();
@@ -385,8 +446,11 @@ public:
 		}
 
 		// Create a semaphore used to synchronize offscreen rendering and usage
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		if (offscreenSemaphore == VK_NULL_HANDLE)
+		{
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		}
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -407,6 +471,37 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(offScreenCmdBuffer, &cmdBufInfo));
 
+		timestampQuery.reset(offScreenCmdBuffer);
+
+		// Assign the lights to the clusters, the light lists are only required for clustered shading
+		timestampQuery.write(offScreenCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TS_CULLING_START);
+		if (clusteredShading)
+		{
+			vkCmdBindPipeline(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipeline);
+			vkCmdBindDescriptorSets(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipelineLayout, 0, 1, &lightCulling.descriptorSet, 0, nullptr);
+			// One work group per depth slice, one invocation per cluster
+			vkCmdDispatch(offScreenCmdBuffer, 1, 1, CLUSTER_Z);
+
+			// The composition pass (submitted later on the same queue) reads the light lists in the fragment shader
+			std::array<VkBufferMemoryBarrier, 2> bufferBarriers;
+			bufferBarriers[0] = vks::initializers::bufferMemoryBarrier();
+			bufferBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			bufferBarriers[0].buffer = storageBuffers.lightGrid.buffer;
+			bufferBarriers[0].size = VK_WHOLE_SIZE;
+			bufferBarriers[1] = bufferBarriers[0];
+			bufferBarriers[1].buffer = storageBuffers.lightIndices.buffer;
+			vkCmdPipelineBarrier(
+				offScreenCmdBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				0, nullptr);
+		}
+		timestampQuery.write(offScreenCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TS_CULLING_END);
+
 		vkCmdBeginRenderPass(offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport = vks::initializers::viewport((float)offScreenFrameBuf.width, (float)offScreenFrameBuf.height, 0.0f, 1.0f);
@@ -478,7 +573,9 @@ public:
    			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 			// Final composition as full screen quad
 			// Note: Also used for debug display if debugDisplayTarget > 0
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TS_COMPOSITION_START);
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TS_COMPOSITION_END);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -491,11 +588,12 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6)
 		};
 
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 4);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -513,6 +611,12 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+			// Binding 5 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+			// Binding 6 : Light counts per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
+			// Binding 7 : Light indices per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -521,6 +625,22 @@ public:
 		// Shared pipeline layout used by all pipelines
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Light culling layout
+		setLayoutBindings = {
+			// Binding 0 : Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Light counts per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Light indices per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &lightCulling.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &lightCulling.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -558,9 +678,31 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			// Binding 5 : Lights
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &storageBuffers.lights.descriptor),
+			// Binding 6 : Light counts per cluster
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &storageBuffers.lightGrid.descriptor),
+			// Binding 7 : Light indices per cluster
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &storageBuffers.lightIndices.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
+		// Light culling
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &lightCulling.descriptorSet));
+		writeDescriptorSets = {
+			// Binding 0 : Uniform buffer
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.composition.descriptor),
+			// Binding 1 : Lights
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &storageBuffers.lights.descriptor),
+			// Binding 2 : Light counts per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &storageBuffers.lightGrid.descriptor),
+			// Binding 3 : Light indices per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &storageBuffers.lightIndices.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+
 		// Offscreen (scene)
 
 		// Model
@@ -645,6 +787,11 @@ public:
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+
+		// Light culling compute pipeline
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(lightCulling.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferred/lightculling.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &lightCulling.pipeline));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -668,16 +815,81 @@ public:
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.composition.map());
 
+		// Lights are animated on the host, so the buffer is host visible and stays mapped
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&storageBuffers.lights,
+			MAX_LIGHT_COUNT * sizeof(Light)));
+		VK_CHECK_RESULT(storageBuffers.lights.map());
+
+		// Light lists are only written and read on the GPU
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.lightGrid,
+			CLUSTER_X * CLUSTER_Y * CLUSTER_Z * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.lightIndices,
+			CLUSTER_X * CLUSTER_Y * CLUSTER_Z * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t)));
+
 		// Setup instanced model positions
 		uboOffscreenVS.instancePos[0] = glm::vec4(0.0f);
 		uboOffscreenVS.instancePos[1] = glm::vec4(-4.0f, 0.0, -4.0f, 0.0f);
 		uboOffscreenVS.instancePos[2] = glm::vec4(4.0f, 0.0, -4.0f, 0.0f);
 
+		prepareLights();
+
 		// Update
 		updateUniformBufferOffscreen();
 		updateUniformBufferComposition();
 	}
 
+	// Setup the six main lights and randomly distributed additional lights up to the max. light count
+	void prepareLights()
+	{
+		lights.resize(MAX_LIGHT_COUNT);
+		lightMotions.resize(MAX_LIGHT_COUNT);
+
+		// White
+		lights[0].color = glm::vec3(1.5f);
+		lights[0].radius = 15.0f * 0.25f;
+		// Red
+		lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
+		lights[1].radius = 15.0f;
+		// Blue
+		lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
+		lights[2].radius = 5.0f;
+		// Yellow
+		lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
+		lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
+		lights[3].radius = 2.0f;
+		// Green
+		lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
+		lights[4].radius = 5.0f;
+		// Yellow
+		lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
+		lights[5].radius = 25.0f;
+
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndPos(-12.0f, 12.0f);
+		std::uniform_real_distribution<float> rndHeight(-2.0f, -0.2f);
+		std::uniform_real_distribution<float> rndRadius(1.0f, 3.0f);
+		std::uniform_real_distribution<float> rndColor(0.1f, 1.0f);
+		std::uniform_real_distribution<float> rndSpeed(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> rndPhase(0.0f, 360.0f);
+		for (uint32_t i = 6; i < MAX_LIGHT_COUNT; i++) {
+			lightMotions[i].center = glm::vec3(rndPos(rndEngine), rndHeight(rndEngine), rndPos(rndEngine));
+			lightMotions[i].orbitRadius = rndRadius(rndEngine);
+			lightMotions[i].speed = rndSpeed(rndEngine);
+			lightMotions[i].phase = rndPhase(rndEngine);
+			lights[i].color = glm::vec3(rndColor(rndEngine), rndColor(rndEngine), rndColor(rndEngine));
+			lights[i].radius = rndRadius(rndEngine);
+		}
+	}
+
 	// Update matrices used for the offscreen rendering of the scene
 	void updateUniformBufferOffscreen()
 	{
@@ -690,50 +902,46 @@ public:
 	// Update lights and parameters passed to the composition shaders
 	void updateUniformBufferComposition()
 	{
-		// White
-		uboComposition.lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
-		uboComposition.lights[0].color = glm::vec3(1.5f);
-		uboComposition.lights[0].radius = 15.0f * 0.25f;
-		// Red
-		uboComposition.lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].radius = 15.0f;
-		// Blue
-		uboComposition.lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
-		uboComposition.lights[2].radius = 5.0f;
-		// Yellow
-		uboComposition.lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
-		uboComposition.lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
-		uboComposition.lights[3].radius = 2.0f;
-		// Green
-		uboComposition.lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
-		uboComposition.lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
-		uboComposition.lights[4].radius = 5.0f;
-		// Yellow
-		uboComposition.lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
-		uboComposition.lights[5].radius = 25.0f;
+		lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
+		lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
+		lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
+		lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+
+		lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
+		lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
 
-		uboComposition.lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
-		uboComposition.lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
+		lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+		lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
 
-		uboComposition.lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-		uboComposition.lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+		lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
+		lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
 
-		uboComposition.lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
-		uboComposition.lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
+		lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
+		lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
 
-		uboComposition.lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
-		uboComposition.lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
+		lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
+		lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
+
+		for (int32_t i = 6; i < lightCount; i++) {
+			const LightMotion& motion = lightMotions[i];
+			const float angle = glm::radians(360.0f * timer * motion.speed + motion.phase);
+			lights[i].position = glm::vec4(motion.center + glm::vec3(sin(angle), 0.0f, cos(angle)) * motion.orbitRadius, 0.0f);
+		}
+		memcpy(storageBuffers.lights.mapped, lights.data(), lightCount * sizeof(Light));
 
-		uboComposition.lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
-		uboComposition.lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
+		// Matrices and depth range used to build and look up the light clusters
+		uboComposition.view = camera.matrices.view;
+		uboComposition.invProjection = glm::inverse(camera.matrices.perspective);
+		uboComposition.zNear = camera.getNearClip();
+		uboComposition.zFar = camera.getFarClip();
 
 		// Current view position
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
 
 		uboComposition.debugDisplayTarget = debugDisplayTarget;
+		uboComposition.lightCount = lightCount;
+		uboComposition.clustered = clusteredShading ? 1 : 0;
 
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
 	}
@@ -782,6 +990,7 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		timestampQuery.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, TS_COUNT);
 		loadAssets();
 		prepareOffscreenFramebuffer();
 		prepareUniformBuffers();
@@ -799,7 +1008,9 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused)
+		timestampQuery.fetch();
+		// The light clusters depend on the camera, so the composition uniforms are also updated on camera changes
+		if (!paused || camera.updated)
 		{
 			updateUniformBufferComposition();
 		}
@@ -812,10 +1023,23 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->comboBox("Display", &debugDisplayTarget, {"Final composition", "Position", "Normals", "Albedo", "Specular" }))
+			if (overlay->comboBox("Display", &debugDisplayTarget, {"Final composition", "Position", "Normals", "Albedo", "Specular", "Lights per cluster" }))
 			{
 				updateUniformBufferComposition();
 			}
+			if (overlay->sliderInt("Light count", &lightCount, 6, MAX_LIGHT_COUNT))
+			{
+				updateUniformBufferComposition();
+			}
+			if (overlay->checkBox("Clustered shading", &clusteredShading))
+			{
+				updateUniformBufferComposition();
+				buildDeferredCommandBuffer();
+			}
+		}
+		if (timestampQuery.supported() && overlay->header("GPU timings")) {
+			overlay->text("Light culling: %.3f ms", timestampQuery.duration(TS_CULLING_START, TS_CULLING_END));
+			overlay->text("Lighting: %.3f ms", timestampQuery.duration(TS_COMPOSITION_START, TS_COMPOSITION_END));
 		}
 	}
 };
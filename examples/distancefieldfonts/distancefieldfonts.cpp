@@ -1,58 +1,485 @@
 /*
 * Vulkan Example - Font rendering using signed distance fields
 *
-* Font generated using https://github.com/libgdx/libgdx/wiki/Hiero
+* The glyph atlas is generated at runtime from a TrueType font
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <unordered_map>
 #include "vulkanexamplebase.h"
+#include "threadpool.hpp"
+
+// The implementation is kept local to this file, the ImGui font atlas compiles its own static copy
+// Only some of its functions are used, so warnings about unused static functions are disabled for the include
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#include "imstb_truetype.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
+// Size of the glyph atlas texture
+#define ATLAS_DIM 2048
+// Height of the rasterized glyphs (ascent to descent)
+#define FONT_PIXEL_HEIGHT 48
+// Distance in pixels covered by the distance field on either side of a glyph's outline, glyphs are padded by this
+#define SDF_SPREAD 6
+// Distance used for "no feature" in the distance transform, large enough to never be the minimum but without overflowing
+#define EDT_INF 1e20f
+
 // Vertex layout for this example
 struct Vertex {
 	float pos[3];
 	float uv[2];
 };
 
-// AngelCode .fnt format structs and classes
-struct bmchar {
-	uint32_t x, y;
-	uint32_t width;
-	uint32_t height;
-	int32_t xoffset;
-	int32_t yoffset;
-	int32_t xadvance;
-	uint32_t page;
-};
+/*
+	Glyph atlas generated at runtime from a TrueType font
+	Glyphs are added on demand, rasterized and converted to signed distance fields on worker threads and uploaded to the atlas incrementally
+	The atlas stores the distance field in the red and the rasterized coverage in the green channel
+*/
+class GlyphAtlas
+{
+public:
+	// Glyph metrics in pixels, offsets are relative to the top of the line (like the AngelCode format used by earlier versions)
+	struct Glyph {
+		uint32_t x, y;
+		uint32_t width;
+		uint32_t height;
+		int32_t xoffset;
+		int32_t yoffset;
+		float xadvance;
+	};
 
-// Quick and dirty : complete ASCII table
-// Only chars present in the .fnt are filled with data!
-std::array<bmchar, 255> fontChars;
+	struct {
+		uint32_t glyphCount = 0;
+		uint32_t lastBatchSize = 0;
+		float lastBatchTime = 0.0f;
+		uint32_t threadCount = 0;
+	} stats;
 
-int32_t nextValuePair(std::stringstream *stream)
-{
-	std::string pair;
-	*stream >> pair;
-	uint32_t spos = pair.find("=");
-	std::string value = pair.substr(spos + 1);
-	int32_t val = std::stoi(value);
-	return val;
-}
+	// Image views for the distance field and the coverage, both with the channel swizzled to alpha (see sdf.frag and bitmap.frag)
+	VkDescriptorImageInfo sdfDescriptor;
+	VkDescriptorImageInfo bitmapDescriptor;
+
+	float lineHeight = 0.0f;
+
+private:
+	vks::VulkanDevice *vulkanDevice;
+	VkQueue queue;
+
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView sdfView;
+	VkImageView bitmapView;
+	VkSampler sampler;
+
+	std::vector<uint8_t> fontData;
+	stbtt_fontinfo fontInfo;
+	float fontScale;
+	float ascent;
+
+	std::unordered_map<uint32_t, Glyph> glyphs;
+
+	// Simple shelf packing, glyphs are placed left to right in rows as high as the highest glyph in that row
+	struct {
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t height = 0;
+	} shelf;
+
+	vks::ThreadPool threadPool;
+
+	// Glyph waiting to be generated by a worker thread
+	struct PendingGlyph {
+		int glyphIndex;
+		Glyph *glyph;
+		std::vector<uint8_t> pixels;
+	};
+
+	void loadFont(std::string filename)
+	{
+#if defined(__ANDROID__)
+		// Font file is stored inside the apk
+		// So we need to load it using the asset manager
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		assert(asset);
+		size_t size = AAsset_getLength(asset);
+		assert(size > 0);
+		fontData.resize(size);
+		AAsset_read(asset, fontData.data(), size);
+		AAsset_close(asset);
+#else
+		std::ifstream is(filename, std::ios::binary | std::ios::ate);
+		if (!is.is_open()) {
+			vks::tools::exitFatal("Could not open font file \"" + filename + "\"", -1);
+		}
+		fontData.resize((size_t)is.tellg());
+		is.seekg(0, std::ios::beg);
+		is.read((char*)fontData.data(), fontData.size());
+#endif
+		if (!stbtt_InitFont(&fontInfo, fontData.data(), stbtt_GetFontOffsetForIndex(fontData.data(), 0))) {
+			vks::tools::exitFatal("Could not load font \"" + filename + "\"", -1);
+		}
+		fontScale = stbtt_ScaleForPixelHeight(&fontInfo, (float)FONT_PIXEL_HEIGHT);
+		int fontAscent, fontDescent, fontLineGap;
+		stbtt_GetFontVMetrics(&fontInfo, &fontAscent, &fontDescent, &fontLineGap);
+		ascent = fontAscent * fontScale;
+		lineHeight = (fontAscent - fontDescent + fontLineGap) * fontScale;
+	}
+
+	void prepareImage()
+	{
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R8G8_UNORM;
+		imageInfo.extent = { ATLAS_DIM, ATLAS_DIM, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageInfo, nullptr, &image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, image, &memReqs);
+		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
+		allocInfo.allocationSize = memReqs.size;
+		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &memory));
+		VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, image, memory, 0));
+
+		// Clear the atlas, so filtering at the borders of a glyph doesn't pick up undefined texels
+		VkCommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		vkCmdClearColorImage(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+		vks::tools::setImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(cmdBuffer, queue, true);
+
+		// The shaders read the font data from the alpha channel
+		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = imageInfo.format;
+		viewInfo.subresourceRange = subresourceRange;
+		viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R };
+		VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &viewInfo, nullptr, &sdfView));
+		viewInfo.components = { VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_G };
+		VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &viewInfo, nullptr, &bitmapView));
+
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.maxLod = 0.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sampler));
+
+		sdfDescriptor = vks::initializers::descriptorImageInfo(sampler, sdfView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		bitmapDescriptor = vks::initializers::descriptorImageInfo(sampler, bitmapView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	// Reserve space for a glyph in the atlas
+	bool allocate(uint32_t width, uint32_t height, uint32_t &x, uint32_t &y)
+	{
+		// Glyphs are separated by a texel, so linear filtering doesn't bleed into neighbors
+		if (shelf.x + width > ATLAS_DIM) {
+			shelf.x = 0;
+			shelf.y += shelf.height + 1;
+			shelf.height = 0;
+		}
+		if ((width > ATLAS_DIM) || (shelf.y + height > ATLAS_DIM)) {
+			return false;
+		}
+		x = shelf.x;
+		y = shelf.y;
+		shelf.x += width + 1;
+		shelf.height = std::max(shelf.height, height);
+		return true;
+	}
+
+	// One dimensional squared Euclidean distance transform (Felzenszwalb and Huttenlocher)
+	// Computes the lower envelope of the parabolas rooted at each sample, which takes linear time in the number of samples
+	static void distanceTransform1D(const float *f, float *d, uint32_t *v, float *z, uint32_t n)
+	{
+		uint32_t k = 0;
+		v[0] = 0;
+		z[0] = -EDT_INF;
+		z[1] = EDT_INF;
+		for (uint32_t q = 1; q < n; q++) {
+			float s = ((f[q] + (float)(q * q)) - (f[v[k]] + (float)(v[k] * v[k]))) / (2.0f * (float)q - 2.0f * (float)v[k]);
+			while (s <= z[k]) {
+				k--;
+				s = ((f[q] + (float)(q * q)) - (f[v[k]] + (float)(v[k] * v[k]))) / (2.0f * (float)q - 2.0f * (float)v[k]);
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = EDT_INF;
+		}
+		k = 0;
+		for (uint32_t q = 0; q < n; q++) {
+			while (z[k + 1] < (float)q) {
+				k++;
+			}
+			const float dist = (float)q - (float)v[k];
+			d[q] = dist * dist + f[v[k]];
+		}
+	}
+
+	// Two dimensional squared distance transform, separable into a pass over all columns followed by a pass over all rows
+	static void distanceTransform2D(std::vector<float> &grid, uint32_t width, uint32_t height)
+	{
+		const uint32_t n = std::max(width, height);
+		std::vector<float> f(n), d(n), z(n + 1);
+		std::vector<uint32_t> v(n);
+		for (uint32_t x = 0; x < width; x++) {
+			for (uint32_t y = 0; y < height; y++) {
+				f[y] = grid[y * width + x];
+			}
+			distanceTransform1D(f.data(), d.data(), v.data(), z.data(), height);
+			for (uint32_t y = 0; y < height; y++) {
+				grid[y * width + x] = d[y];
+			}
+		}
+		for (uint32_t y = 0; y < height; y++) {
+			distanceTransform1D(&grid[y * width], d.data(), v.data(), z.data(), width);
+			memcpy(&grid[y * width], d.data(), width * sizeof(float));
+		}
+	}
+
+	// Rasterize a glyph and compute its signed distance field, called from the worker threads
+	void generateGlyph(PendingGlyph &pending)
+	{
+		const uint32_t width = pending.glyph->width;
+		const uint32_t height = pending.glyph->height;
+		const uint32_t count = width * height;
+
+		// Coverage with the glyph placed inside the padding
+		std::vector<uint8_t> coverage(count, 0);
+		stbtt_MakeGlyphBitmap(&fontInfo, &coverage[SDF_SPREAD * width + SDF_SPREAD], width - 2 * SDF_SPREAD, height - 2 * SDF_SPREAD, width, fontScale, fontScale, pending.glyphIndex);
+
+		// Squared distances of the texels outside of the glyph to the closest texel inside and vice versa
+		std::vector<float> outside(count), inside(count);
+		for (uint32_t i = 0; i < count; i++) {
+			const bool isInside = coverage[i] >= 128;
+			outside[i] = isInside ? 0.0f : EDT_INF;
+			inside[i] = isInside ? EDT_INF : 0.0f;
+		}
+		distanceTransform2D(outside, width, height);
+		distanceTransform2D(inside, width, height);
+
+		// Map the signed distance to [0, 1], with the outline at 0.5 (see sdf.frag)
+		// Distances are measured between texel centers, so they are moved by half a texel towards the outline
+		pending.pixels.resize(count * 2);
+		for (uint32_t i = 0; i < count; i++) {
+			const float distance = (outside[i] > 0.0f) ? (sqrtf(outside[i]) - 0.5f) : -(sqrtf(inside[i]) - 0.5f);
+			const float value = std::min(std::max(0.5f - distance / (2.0f * SDF_SPREAD), 0.0f), 1.0f);
+			pending.pixels[i * 2 + 0] = (uint8_t)(value * 255.0f + 0.5f);
+			pending.pixels[i * 2 + 1] = coverage[i];
+		}
+	}
+
+	// Copy the generated glyphs to their places in the atlas
+	void upload(std::vector<PendingGlyph> &pendingGlyphs)
+	{
+		VkDeviceSize stagingSize = 0;
+		for (auto &pending : pendingGlyphs) {
+			stagingSize += pending.pixels.size();
+		}
+		if (stagingSize == 0) {
+			return;
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			stagingSize));
+		VK_CHECK_RESULT(stagingBuffer.map());
+
+		// Only the regions of the new glyphs are updated
+		std::vector<VkBufferImageCopy> copyRegions;
+		VkDeviceSize offset = 0;
+		for (auto &pending : pendingGlyphs) {
+			if (pending.pixels.empty()) {
+				continue;
+			}
+			memcpy((uint8_t*)stagingBuffer.mapped + offset, pending.pixels.data(), pending.pixels.size());
+			VkBufferImageCopy copyRegion = {};
+			copyRegion.bufferOffset = offset;
+			copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.imageOffset = { (int32_t)pending.glyph->x, (int32_t)pending.glyph->y, 0 };
+			copyRegion.imageExtent = { pending.glyph->width, pending.glyph->height, 1 };
+			copyRegions.push_back(copyRegion);
+			offset += pending.pixels.size();
+		}
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		stagingBuffer.destroy();
+	}
+
+public:
+	GlyphAtlas(vks::VulkanDevice *vulkanDevice, VkQueue queue, std::string fontFile)
+	{
+		this->vulkanDevice = vulkanDevice;
+		this->queue = queue;
+		loadFont(fontFile);
+		prepareImage();
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+		stats.threadCount = static_cast<uint32_t>(threadPool.threads.size());
+	}
+
+	~GlyphAtlas()
+	{
+		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
+		vkDestroyImageView(vulkanDevice->logicalDevice, sdfView, nullptr);
+		vkDestroyImageView(vulkanDevice->logicalDevice, bitmapView, nullptr);
+		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
+		vkFreeMemory(vulkanDevice->logicalDevice, memory, nullptr);
+	}
+
+	// Make sure all passed code points are present in the atlas, missing glyphs are generated in parallel and uploaded in a single batch
+	// Must not be called while the atlas is in use by the device
+	void requestGlyphs(const std::vector<uint32_t> &codePoints)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		std::vector<PendingGlyph> pendingGlyphs;
+		for (auto codePoint : codePoints) {
+			if (glyphs.find(codePoint) != glyphs.end()) {
+				continue;
+			}
+			Glyph &glyph = glyphs[codePoint];
+			glyph = {};
+			const int glyphIndex = stbtt_FindGlyphIndex(&fontInfo, (int)codePoint);
+			int advance, leftSideBearing;
+			stbtt_GetGlyphHMetrics(&fontInfo, glyphIndex, &advance, &leftSideBearing);
+			glyph.xadvance = advance * fontScale;
+			// Glyphs without an outline (e.g. spaces) only advance the cursor
+			if (stbtt_IsGlyphEmpty(&fontInfo, glyphIndex)) {
+				continue;
+			}
+			int x0, y0, x1, y1;
+			stbtt_GetGlyphBitmapBox(&fontInfo, glyphIndex, fontScale, fontScale, &x0, &y0, &x1, &y1);
+			glyph.width = (uint32_t)(x1 - x0) + 2 * SDF_SPREAD;
+			glyph.height = (uint32_t)(y1 - y0) + 2 * SDF_SPREAD;
+			glyph.xoffset = x0 - SDF_SPREAD;
+			glyph.yoffset = (int32_t)ascent + y0 - SDF_SPREAD;
+			if (!allocate(glyph.width, glyph.height, glyph.x, glyph.y)) {
+				std::cerr << "Glyph atlas is full, can't add code point " << codePoint << "\n";
+				glyph.width = glyph.height = 0;
+				continue;
+			}
+			pendingGlyphs.push_back({ glyphIndex, &glyph, {} });
+		}
+
+		if (pendingGlyphs.empty()) {
+			return;
+		}
+
+		// Distribute the glyphs evenly across the worker threads, the font data is only read so the threads can share it
+		const uint32_t threadCount = static_cast<uint32_t>(threadPool.threads.size());
+		for (uint32_t t = 0; t < threadCount; t++) {
+			threadPool.threads[t]->addJob([=, &pendingGlyphs] {
+				for (size_t i = t; i < pendingGlyphs.size(); i += threadCount) {
+					generateGlyph(pendingGlyphs[i]);
+				}
+			});
+		}
+		threadPool.wait();
+
+		upload(pendingGlyphs);
+
+		stats.glyphCount = static_cast<uint32_t>(glyphs.size());
+		stats.lastBatchSize = static_cast<uint32_t>(pendingGlyphs.size());
+		stats.lastBatchTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	// Glyph of a code point that has been requested before
+	const Glyph &glyph(uint32_t codePoint)
+	{
+		return glyphs[codePoint];
+	}
+
+	// Fraction of the atlas that has been filled
+	float usage()
+	{
+		return (float)(shelf.y + shelf.height) / (float)ATLAS_DIM;
+	}
+
+	// Decode an UTF-8 string into code points
+	static std::vector<uint32_t> decodeUTF8(const std::string &text)
+	{
+		std::vector<uint32_t> codePoints;
+		for (size_t i = 0; i < text.size();) {
+			const uint8_t c = (uint8_t)text[i];
+			uint32_t codePoint;
+			uint32_t length;
+			if (c < 0x80) {
+				codePoint = c;
+				length = 1;
+			} else if ((c >> 5) == 0x6) {
+				codePoint = c & 0x1F;
+				length = 2;
+			} else if ((c >> 4) == 0xE) {
+				codePoint = c & 0x0F;
+				length = 3;
+			} else {
+				codePoint = c & 0x07;
+				length = 4;
+			}
+			for (uint32_t j = 1; j < length && i + j < text.size(); j++) {
+				codePoint = (codePoint << 6) | ((uint8_t)text[i + j] & 0x3F);
+			}
+			codePoints.push_back(codePoint);
+			i += length;
+		}
+		return codePoints;
+	}
+};
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool splitScreen = true;
 
-	struct {
-		vks::Texture2D fontSDF;
-		vks::Texture2D fontBitmap;
-	} textures;
+	GlyphAtlas *glyphAtlas = nullptr;
+
+	// Sample texts, the combo box uses the UI font which only contains latin characters, so the texts are listed by name
+	const std::vector<std::string> textNames = { "Latin", "Latin-1", "Greek", "Cyrillic" };
+	const std::vector<std::string> texts = {
+		"Vulkan",
+		u8"\u00c0 bient\u00f4t",
+		u8"\u0393\u03b5\u03b9\u03ac \u03c3\u03bf\u03c5",
+		u8"\u041f\u0440\u0438\u0432\u0435\u0442"
+	};
+	int32_t textIndex = 0;
 
 	struct {
 		VkPipelineVertexInputStateCreateInfo inputState;
@@ -107,9 +534,7 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
-		// Clean up texture resources
-		textures.fontSDF.destroy();
-		textures.fontBitmap.destroy();
+		delete glyphAtlas;
 
 		vkDestroyPipeline(device, pipelines.sdf, nullptr);
 		vkDestroyPipeline(device, pipelines.bitmap, nullptr);
@@ -124,67 +549,9 @@ public:
 		uniformBuffers.fs.destroy();
 	}
 
-	// Basic parser for AngelCode bitmap font format files
-	// See http://www.angelcode.com/products/bmfont/doc/file_format.html for details
-	void parsebmFont()
-	{
-		std::string fileName = getAssetPath() + "font.fnt";
-
-#if defined(__ANDROID__)
-		// Font description file is stored inside the apk
-		// So we need to load it using the asset manager
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
-		assert(asset);
-		size_t size = AAsset_getLength(asset);
-
-		assert(size > 0);
-
-		void *fileData = malloc(size);
-		AAsset_read(asset, fileData, size);
-		AAsset_close(asset);
-
-		std::stringbuf sbuf((const char*)fileData);
-		std::istream istream(&sbuf);
-#else
-		std::filebuf fileBuffer;
-		fileBuffer.open(fileName, std::ios::in);
-		std::istream istream(&fileBuffer);
-#endif
-
-		assert(istream.good());
-
-		while (!istream.eof())
-		{
-			std::string line;
-			std::stringstream lineStream;
-			std::getline(istream, line);
-			lineStream << line;
-
-			std::string info;
-			lineStream >> info;
-
-			if (info == "char")
-			{
-				// char id
-				uint32_t charid = nextValuePair(&lineStream);
-				// Char properties
-				fontChars[charid].x = nextValuePair(&lineStream);
-				fontChars[charid].y = nextValuePair(&lineStream);
-				fontChars[charid].width = nextValuePair(&lineStream);
-				fontChars[charid].height = nextValuePair(&lineStream);
-				fontChars[charid].xoffset = nextValuePair(&lineStream);
-				fontChars[charid].yoffset = nextValuePair(&lineStream);
-				fontChars[charid].xadvance = nextValuePair(&lineStream);
-				fontChars[charid].page = nextValuePair(&lineStream);
-			}
-		}
-
-	}
-
 	void loadAssets()
 	{
-		textures.fontSDF.loadFromFile(getAssetPath() + "textures/font_sdf_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-		textures.fontBitmap.loadFromFile(getAssetPath() + "textures/font_bitmap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		glyphAtlas = new GlyphAtlas(vulkanDevice, queue, getAssetPath() + "Roboto-Medium.ttf");
 	}
 
 	void buildCommandBuffers()
@@ -245,28 +612,36 @@ public:
 		}
 	}
 
-	// Creates a vertex buffer containing quads for the passed text
+	// Creates a vertex buffer containing quads for the passed text (UTF-8 encoded)
+	// Glyphs not yet present in the atlas are generated on demand
 	void generateText(std:: string text)
 	{
 		std::vector<Vertex> vertices;
 		std::vector<uint32_t> indices;
 		uint32_t indexOffset = 0;
 
-		float w = textures.fontSDF.width;
+		const std::vector<uint32_t> codePoints = GlyphAtlas::decodeUTF8(text);
+		glyphAtlas->requestGlyphs(codePoints);
+
+		float w = (float)ATLAS_DIM;
+		float lineHeight = glyphAtlas->lineHeight;
 
 		float posx = 0.0f;
 		float posy = 0.0f;
 
-		for (uint32_t i = 0; i < text.size(); i++)
+		for (auto codePoint : codePoints)
 		{
-			bmchar *charInfo = &fontChars[(int)text[i]];
+			const GlyphAtlas::Glyph *charInfo = &glyphAtlas->glyph(codePoint);
 
 			if (charInfo->width == 0)
-				charInfo->width = 36;
+			{
+				posx += charInfo->xadvance / lineHeight;
+				continue;
+			}
 
-			float charw = ((float)(charInfo->width) / 36.0f);
+			float charw = ((float)(charInfo->width) / lineHeight);
 			float dimx = 1.0f * charw;
-			float charh = ((float)(charInfo->height) / 36.0f);
+			float charh = ((float)(charInfo->height) / lineHeight);
 			float dimy = 1.0f * charh;
 
 			float us = charInfo->x / w;
@@ -274,8 +649,8 @@ public:
 			float ts = charInfo->y / w;
 			float te = (charInfo->y + charInfo->height) / w;
 
-			float xo = charInfo->xoffset / 36.0f;
-			float yo = charInfo->yoffset / 36.0f;
+			float xo = charInfo->xoffset / lineHeight;
+			float yo = charInfo->yoffset / lineHeight;
 
 			posy = yo;
 
@@ -291,7 +666,7 @@ public:
 			}
 			indexOffset += 4;
 
-			float advance = ((float)(charInfo->xadvance) / 36.0f);
+			float advance = charInfo->xadvance / lineHeight;
 			posx += advance;
 		}
 		indexCount = indices.size();
@@ -420,12 +795,8 @@ public:
 		// Signed distance front descriptor set
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.sdf));
 
-		// Image descriptor for the color map texture
-		VkDescriptorImageInfo texDescriptor =
-			vks::initializers::descriptorImageInfo(
-				textures.fontSDF.sampler,
-				textures.fontSDF.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// Image descriptor for the distance field of the glyph atlas
+		VkDescriptorImageInfo texDescriptor = glyphAtlas->sdfDescriptor;
 
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
 		{
@@ -454,9 +825,8 @@ public:
 		// Default font rendering descriptor set
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.bitmap));
 
-		// Image descriptor for the color map texture
-		texDescriptor.sampler = textures.fontBitmap.sampler;
-		texDescriptor.imageView = textures.fontBitmap.view;
+		// Image descriptor for the rasterized coverage of the glyph atlas
+		texDescriptor = glyphAtlas->bitmapDescriptor;
 
 		writeDescriptorSets =
 		{
@@ -621,9 +991,8 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		parsebmFont();
 		loadAssets();
-		generateText("Vulkan");
+		generateText(texts[textIndex]);
 		setupVertexDescriptions();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -646,6 +1015,16 @@ public:
 		updateUniformBuffers();
 	}
 
+	// Replace the displayed text, the atlas and the buffers may still be in use, so wait for the queue first
+	void changeText()
+	{
+		vkQueueWaitIdle(queue);
+		vertexBuffer.destroy();
+		indexBuffer.destroy();
+		generateText(texts[textIndex]);
+		buildCommandBuffers();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
@@ -659,6 +1038,24 @@ public:
 				buildCommandBuffers();
 				updateUniformBuffers();
 			}
+			if (overlay->comboBox("Text", &textIndex, textNames)) {
+				changeText();
+			}
+			if (overlay->button("Add Latin-1, Greek and Cyrillic")) {
+				// Request large character sets at once to put the parallel glyph generation under load
+				std::vector<uint32_t> codePoints;
+				for (uint32_t c = 0x20; c <= 0x7E; c++) codePoints.push_back(c);
+				for (uint32_t c = 0xA0; c <= 0xFF; c++) codePoints.push_back(c);
+				for (uint32_t c = 0x370; c <= 0x3FF; c++) codePoints.push_back(c);
+				for (uint32_t c = 0x400; c <= 0x4FF; c++) codePoints.push_back(c);
+				vkQueueWaitIdle(queue);
+				glyphAtlas->requestGlyphs(codePoints);
+			}
+		}
+		if (overlay->header("Glyph atlas")) {
+			overlay->text("%d glyphs, %.0f%% used", glyphAtlas->stats.glyphCount, glyphAtlas->usage() * 100.0f);
+			overlay->text("Last batch: %d glyphs in %.2f ms", glyphAtlas->stats.lastBatchSize, glyphAtlas->stats.lastBatchTime);
+			overlay->text("%d worker threads", glyphAtlas->stats.threadCount);
 		}
 	}
 };
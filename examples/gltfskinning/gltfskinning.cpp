@@ -51,10 +51,8 @@ VulkanglTFModel::~VulkanglTFModel()
 		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
-	for (Skin skin : skins)
-	{
-		skin.ssbo.destroy();
-	}
+	jointMatrices.destroy();
+	skinnedVertices.destroy();
 }
 
 /*
@@ -198,18 +196,21 @@ void VulkanglTFModel::loadSkins(tinygltf::Model &input)
 			const tinygltf::Buffer &    buffer     = input.buffers[bufferView.buffer];
 			skins[i].inverseBindMatrices.resize(accessor.count);
 			memcpy(skins[i].inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
-
-			// Store inverse bind matrices for this skin in a shader storage buffer object
-			// To keep this sample simple, we create a host visible shader storage buffer
-			VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			    &skins[i].ssbo,
-			    sizeof(glm::mat4) * skins[i].inverseBindMatrices.size(),
-			    skins[i].inverseBindMatrices.data()));
-			VK_CHECK_RESULT(skins[i].ssbo.map());
 		}
+
+		// The joints of all skins are stored after each other
+		skins[i].jointOffset = jointCount;
+		jointCount += static_cast<uint32_t>(skins[i].joints.size());
 	}
+
+	// POI: The joint matrices of all skins and instances are stored in a single shader storage buffer object
+	// To keep this sample simple, we create a host visible shader storage buffer that stays mapped, so the matrices can be written to it directly
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	    &jointMatrices,
+	    sizeof(glm::mat4) * std::max(jointCount, 1u) * MAX_INSTANCE_COUNT));
+	VK_CHECK_RESULT(jointMatrices.map());
 }
 
 // POI: Load the animations from the glTF model
@@ -342,6 +343,7 @@ void VulkanglTFModel::loadNode(const tinygltf::Node &inputNode, const tinygltf::
 	if (inputNode.mesh > -1)
 	{
 		const tinygltf::Mesh mesh = input.meshes[inputNode.mesh];
+		node->mesh.firstVertex    = static_cast<uint32_t>(vertexBuffer.size());
 		// Iterate through all primitives of this node's mesh
 		for (size_t i = 0; i < mesh.primitives.size(); i++)
 		{
@@ -460,6 +462,7 @@ void VulkanglTFModel::loadNode(const tinygltf::Node &inputNode, const tinygltf::
 			primitive.materialIndex = glTFPrimitive.material;
 			node->mesh.primitives.push_back(primitive);
 		}
+		node->mesh.vertexCount = static_cast<uint32_t>(vertexBuffer.size()) - node->mesh.firstVertex;
 	}
 
 	if (parent)
@@ -476,62 +479,43 @@ void VulkanglTFModel::loadNode(const tinygltf::Node &inputNode, const tinygltf::
 	glTF vertex skinning functions
 */
 
-// POI: Traverse the node hierarchy to the top-most parent to get the local matrix of the given node
-glm::mat4 VulkanglTFModel::getNodeMatrix(VulkanglTFModel::Node *node)
+// POI: Update the global matrices of a node and its children from the current animated local matrices
+// This is done once for the whole hierarchy, so the joint matrices don't have to walk up the hierarchy for every joint
+void VulkanglTFModel::updateNodeMatrices(VulkanglTFModel::Node *node, const glm::mat4 &parentMatrix)
 {
-	glm::mat4              nodeMatrix    = node->getLocalMatrix();
-	VulkanglTFModel::Node *currentParent = node->parent;
-	while (currentParent)
+	node->globalMatrix = parentMatrix * node->getLocalMatrix();
+	for (auto &child : node->children)
 	{
-		nodeMatrix    = currentParent->getLocalMatrix() * nodeMatrix;
-		currentParent = currentParent->parent;
+		updateNodeMatrices(child, node->globalMatrix);
 	}
-	return nodeMatrix;
 }
 
-// POI: Update the joint matrices from the current animation frame and pass them to the GPU
-void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
+// POI: Calculate the joint matrices from the current animation frame and write them to the given instance's joint matrices
+void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node, glm::mat4 *instanceJointMatrices)
 {
 	if (node->skin > -1)
 	{
 		// Update the joint matrices
-		glm::mat4              inverseTransform = glm::inverse(getNodeMatrix(node));
-		Skin                   skin             = skins[node->skin];
-		size_t                 numJoints        = (uint32_t) skin.joints.size();
-		std::vector<glm::mat4> jointMatrices(numJoints);
-		for (size_t i = 0; i < numJoints; i++)
+		glm::mat4   inverseTransform = glm::inverse(node->globalMatrix);
+		const Skin &skin             = skins[node->skin];
+		for (size_t i = 0; i < skin.joints.size(); i++)
 		{
-			jointMatrices[i] = getNodeMatrix(skin.joints[i]) * skin.inverseBindMatrices[i];
-			jointMatrices[i] = inverseTransform * jointMatrices[i];
+			instanceJointMatrices[skin.jointOffset + i] = inverseTransform * skin.joints[i]->globalMatrix * skin.inverseBindMatrices[i];
 		}
-		// Update ssbo
-		skin.ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
 	}
 
 	for (auto &child : node->children)
 	{
-		updateJoints(child);
+		updateJoints(child, instanceJointMatrices);
 	}
 }
 
-// POI: Update the current animation
-void VulkanglTFModel::updateAnimation(float deltaTime)
+// POI: Apply the given animation at the given point in time to the animated nodes
+void VulkanglTFModel::applyAnimation(const Animation &animation, float time)
 {
-	if (activeAnimation > static_cast<uint32_t>(animations.size()) - 1)
-	{
-		std::cout << "No animation with index " << activeAnimation << std::endl;
-		return;
-	}
-	Animation &animation = animations[activeAnimation];
-	animation.currentTime += deltaTime;
-	if (animation.currentTime > animation.end)
-	{
-		animation.currentTime -= animation.end;
-	}
-
 	for (auto &channel : animation.channels)
 	{
-		AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
+		const AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
 		for (size_t i = 0; i < sampler.inputs.size() - 1; i++)
 		{
 			if (sampler.interpolation != "LINEAR")
@@ -541,9 +525,9 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 			}
 
 			// Get the input keyframe values for the current time stamp
-			if ((animation.currentTime >= sampler.inputs[i]) && (animation.currentTime <= sampler.inputs[i + 1]))
+			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1]))
 			{
-				float a = (animation.currentTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
+				float a = (time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
 				if (channel.path == "translation")
 				{
 					channel.node->translation = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
@@ -571,9 +555,99 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 			}
 		}
 	}
+}
+
+// POI: Update the joint matrices of all instances
+// Each instance plays the active animation with a different time offset, and the resulting joint matrices are written straight to the mapped joint matrix buffer
+void VulkanglTFModel::updateInstances()
+{
+	glm::mat4 *mappedJointMatrices = reinterpret_cast<glm::mat4 *>(jointMatrices.mapped);
+	for (uint32_t instance = 0; instance < instanceCount; instance++)
+	{
+		if (activeAnimation < static_cast<uint32_t>(animations.size()))
+		{
+			const Animation &animation = animations[activeAnimation];
+			applyAnimation(animation, fmod(animation.currentTime + static_cast<float>(instance) * 0.618034f * animation.end, animation.end));
+		}
+		for (auto &node : nodes)
+		{
+			updateNodeMatrices(node, glm::mat4(1.0f));
+		}
+		for (auto &node : nodes)
+		{
+			updateJoints(node, mappedJointMatrices + instance * jointCount);
+		}
+	}
+}
+
+// POI: Update the current animation
+void VulkanglTFModel::updateAnimation(float deltaTime)
+{
+	if (activeAnimation > static_cast<uint32_t>(animations.size()) - 1)
+	{
+		std::cout << "No animation with index " << activeAnimation << std::endl;
+		return;
+	}
+	Animation &animation = animations[activeAnimation];
+	animation.currentTime += deltaTime;
+	if (animation.currentTime > animation.end)
+	{
+		animation.currentTime -= animation.end;
+	}
+	updateInstances();
+}
+
+/*
+	glTF compute skinning functions
+*/
+
+// POI: Skin the vertices of a node's mesh for all instances
+void VulkanglTFModel::skinNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node *node)
+{
+	if (node->mesh.vertexCount > 0)
+	{
+		struct PushConstants
+		{
+			glm::mat4 nodeMatrix;
+			uint32_t  firstVertex;
+			uint32_t  vertexCount;
+			uint32_t  instanceVertexCount;
+			int32_t   jointOffset;
+			uint32_t  jointCount;
+			uint32_t  gridColumns;
+			float     gridSpacing;
+		} pushConstants;
+		// Traverse the node hierarchy to the top-most parent to get the final matrix of the current node
+		pushConstants.nodeMatrix             = node->matrix;
+		VulkanglTFModel::Node *currentParent = node->parent;
+		while (currentParent)
+		{
+			pushConstants.nodeMatrix = currentParent->matrix * pushConstants.nodeMatrix;
+			currentParent            = currentParent->parent;
+		}
+		pushConstants.firstVertex         = node->mesh.firstVertex;
+		pushConstants.vertexCount         = node->mesh.vertexCount;
+		pushConstants.instanceVertexCount = vertices.count;
+		pushConstants.jointOffset         = (node->skin > -1) ? static_cast<int32_t>(skins[node->skin].jointOffset) : -1;
+		pushConstants.jointCount          = jointCount;
+		// Instances are placed on a grid
+		pushConstants.gridColumns         = static_cast<uint32_t>(ceil(sqrt(static_cast<float>(instanceCount))));
+		pushConstants.gridSpacing         = 1.0f;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (node->mesh.vertexCount + 63) / 64, instanceCount, 1);
+	}
+	for (auto &child : node->children)
+	{
+		skinNode(commandBuffer, pipelineLayout, child);
+	}
+}
+
+// Skin all meshes of the glTF scene, needs to be called with the skinning compute pipeline bound
+void VulkanglTFModel::skin(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+{
 	for (auto &node : nodes)
 	{
-		updateJoints(node);
+		skinNode(commandBuffer, pipelineLayout, node);
 	}
 }
 
@@ -586,19 +660,7 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 {
 	if (node.mesh.primitives.size() > 0)
 	{
-		// Pass the node's matrix via push constants
-		// Traverse the node hierarchy to the top-most parent to get the final matrix of the current node
-		glm::mat4              nodeMatrix    = node.matrix;
-		VulkanglTFModel::Node *currentParent = node.parent;
-		while (currentParent)
-		{
-			nodeMatrix    = currentParent->matrix * nodeMatrix;
-			currentParent = currentParent->parent;
-		}
-		// Pass the final matrix to the vertex shader using push constants
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
-		// Bind SSBO with skin data for this node to set 1
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &skins[node.skin].descriptorSet, 0, nullptr);
+		// The node matrix and skinning have already been applied by the compute shader
 		for (VulkanglTFModel::Primitive &primitive : node.mesh.primitives)
 		{
 			if (primitive.indexCount > 0)
@@ -607,7 +669,8 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 				VulkanglTFModel::Texture texture = textures[materials[primitive.materialIndex].baseColorTextureIndex];
 				// Bind the descriptor for the current primitive's texture to set 2
 				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &images[texture.imageIndex].descriptorSet, 0, nullptr);
-				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+				// POI: All instances are drawn with a single draw, the vertex shader fetches the skinned vertices of the current instance
+				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, instanceCount, primitive.firstIndex, 0, 0);
 			}
 		}
 	}
@@ -659,7 +722,11 @@ VulkanExample::~VulkanExample()
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.jointMatrices, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.skinnedVertices, nullptr);
+
+	vkDestroyPipeline(device, skinning.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, skinning.pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, skinning.descriptorSetLayout, nullptr);
 
 	shaderData.buffer.destroy();
 }
@@ -698,11 +765,32 @@ void VulkanExample::buildCommandBuffers()
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+		// POI: Skin the vertices of all instances once with a compute shader
+		// The results are stored in a buffer that's used by all following draws, so additional passes don't need to skin the model again
+		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipeline);
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipelineLayout, 0, 1, &skinning.descriptorSet, 0, nullptr);
+		glTFModel.skin(drawCmdBuffers[i], skinning.pipelineLayout);
+
+		// Make the skinned vertices visible to the vertex shader
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask         = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask         = VK_ACCESS_SHADER_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer                = glTFModel.skinnedVertices.buffer;
+		bufferBarrier.size                  = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 		// Bind scene matrices descriptor to set 0
 		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		// Bind the skinned vertices to set 1
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &skinnedVerticesDescriptorSet, 0, nullptr);
+		// The vertex shader needs the number of vertices per instance to locate the skinned vertices of an instance
+		vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &glTFModel.vertices.count);
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
 		glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
 		drawUI(drawCmdBuffers[i]);
@@ -747,10 +835,7 @@ void VulkanExample::loadglTFFile(std::string filename)
 		glTFModel.loadSkins(glTFInput);
 		glTFModel.loadAnimations(glTFInput);
 		// Calculate initial pose
-		for (auto node : glTFModel.nodes)
-		{
-			glTFModel.updateJoints(node);
-		}
+		glTFModel.updateInstances();
 	}
 	else
 	{
@@ -762,6 +847,7 @@ void VulkanExample::loadglTFFile(std::string filename)
 	size_t vertexBufferSize = vertexBuffer.size() * sizeof(VulkanglTFModel::Vertex);
 	size_t indexBufferSize  = indexBuffer.size() * sizeof(uint32_t);
 	glTFModel.indices.count = static_cast<uint32_t>(indexBuffer.size());
+	glTFModel.vertices.count = static_cast<uint32_t>(vertexBuffer.size());
 
 	struct StagingBuffer
 	{
@@ -787,8 +873,9 @@ void VulkanExample::loadglTFFile(std::string filename)
 	    indexBuffer.data()));
 
 	// Create device local buffers (target)
+	// The vertex buffer is also read by the skinning compute shader
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 	    vertexBufferSize,
 	    &glTFModel.vertices.buffer,
@@ -814,6 +901,13 @@ void VulkanExample::loadglTFFile(std::string filename)
 	vkFreeMemory(device, vertexStaging.memory, nullptr);
 	vkDestroyBuffer(device, indexStaging.buffer, nullptr);
 	vkFreeMemory(device, indexStaging.memory, nullptr);
+
+	// POI: Buffer for the skinned vertices of all instances written by the compute shader
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	    &glTFModel.skinnedVertices,
+	    sizeof(VulkanglTFModel::SkinnedVertex) * vertexBuffer.size() * MAX_INSTANCE_COUNT));
 }
 
 void VulkanExample::setupDescriptors()
@@ -826,11 +920,11 @@ void VulkanExample::setupDescriptors()
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
 	    // One combined image sampler per material image/texture
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFModel.images.size())),
-	    // One ssbo per skin
-	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(glTFModel.skins.size())),
+	    // Skinned vertices for rendering, source vertices, joint matrices and skinned vertices for skinning
+	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
 	};
-	// Number of descriptor sets = One for the scene ubo + one per image + one per skin
-	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.skins.size()) + 1;
+	// Number of descriptor sets = One for the scene ubo + one per image + one for the skinned vertices + one for skinning
+	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + 3;
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
@@ -846,22 +940,22 @@ void VulkanExample::setupDescriptors()
 	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
 	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.textures));
 
-	// Descriptor set layout for passing skin joint matrices
+	// Descriptor set layout for passing the skinned vertices
 	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.jointMatrices));
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.skinnedVertices));
 
 	// The pipeline layout uses three sets:
 	// Set 0 = Scene matrices (VS)
-	// Set 1 = Joint matrices (VS)
+	// Set 1 = Skinned vertices (VS)
 	// Set 2 = Material texture (FS)
 	std::array<VkDescriptorSetLayout, 3> setLayouts = {
 	    descriptorSetLayouts.matrices,
-	    descriptorSetLayouts.jointMatrices,
+	    descriptorSetLayouts.skinnedVertices,
 	    descriptorSetLayouts.textures};
 	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
 
-	// We will use push constants to push the local matrices of a primitive to the vertex shader
-	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), 0);
+	// We will use push constants to pass the number of vertices per instance to the vertex shader
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t), 0);
 	// Push constant ranges are part of the pipeline layout
 	pipelineLayoutCI.pushConstantRangeCount = 1;
 	pipelineLayoutCI.pPushConstantRanges    = &pushConstantRange;
@@ -873,14 +967,39 @@ void VulkanExample::setupDescriptors()
 	VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &shaderData.buffer.descriptor);
 	vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
-	// Descriptor set for glTF model skin joint matrices
-	for (auto &skin : glTFModel.skins)
-	{
-		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.jointMatrices, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &skin.descriptorSet));
-		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(skin.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &skin.ssbo.descriptor);
-		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
-	}
+	// Descriptor set for the skinned vertices
+	allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.skinnedVertices, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &skinnedVerticesDescriptorSet));
+	writeDescriptorSet = vks::initializers::writeDescriptorSet(skinnedVerticesDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &glTFModel.skinnedVertices.descriptor);
+	vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+	// POI: Descriptor set for the skinning compute shader
+	// Binding 0 = Source vertices
+	// Binding 1 = Joint matrices of all instances
+	// Binding 2 = Skinned vertices of all instances
+	std::vector<VkDescriptorSetLayoutBinding> skinningSetLayoutBindings = {
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+	};
+	VkDescriptorSetLayoutCreateInfo skinningDescriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(skinningSetLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &skinningDescriptorSetLayoutCI, nullptr, &skinning.descriptorSetLayout));
+
+	VkPipelineLayoutCreateInfo skinningPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&skinning.descriptorSetLayout, 1);
+	VkPushConstantRange        skinningPushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(glm::mat4) + 7 * sizeof(uint32_t), 0);
+	skinningPipelineLayoutCI.pushConstantRangeCount      = 1;
+	skinningPipelineLayoutCI.pPushConstantRanges         = &skinningPushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &skinningPipelineLayoutCI, nullptr, &skinning.pipelineLayout));
+
+	allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &skinning.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &skinning.descriptorSet));
+	VkDescriptorBufferInfo            sourceVerticesDescriptor = {glTFModel.vertices.buffer, 0, VK_WHOLE_SIZE};
+	std::vector<VkWriteDescriptorSet> skinningWriteDescriptorSets = {
+	    vks::initializers::writeDescriptorSet(skinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceVerticesDescriptor),
+	    vks::initializers::writeDescriptorSet(skinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &glTFModel.jointMatrices.descriptor),
+	    vks::initializers::writeDescriptorSet(skinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &glTFModel.skinnedVertices.descriptor),
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(skinningWriteDescriptorSets.size()), skinningWriteDescriptorSets.data(), 0, nullptr);
 
 	// Descriptor sets for glTF model materials
 	for (auto &image : glTFModel.images)
@@ -907,14 +1026,10 @@ void VulkanExample::preparePipelines()
 	const std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
 	    vks::initializers::vertexInputBindingDescription(0, sizeof(VulkanglTFModel::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
 	};
+	// POI: Positions and normals are fetched from the skinned vertices, so only the unskinned attributes are passed as vertex attributes
 	const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
-	    {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkanglTFModel::Vertex, pos)},
-	    {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkanglTFModel::Vertex, normal)},
 	    {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkanglTFModel::Vertex, uv)},
 	    {3, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkanglTFModel::Vertex, color)},
-	    // POI: Per-Vertex Joint indices and weights are passed to the vertex shader
-	    {4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(VulkanglTFModel::Vertex, jointIndices)},
-	    {5, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(VulkanglTFModel::Vertex, jointWeights)},
 	};
 
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -949,6 +1064,11 @@ void VulkanExample::preparePipelines()
 		rasterizationStateCI.lineWidth   = 1.0f;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 	}
+
+	// POI: Compute pipeline for skinning the vertices
+	VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(skinning.pipelineLayout, 0);
+	computePipelineCI.stage                       = loadShader(getShadersPath() + "gltfskinning/skinning.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+	VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &skinning.pipeline));
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -1003,6 +1123,14 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay *overlay)
 		{
 			buildCommandBuffers();
 		}
+		int32_t instanceCount = static_cast<int32_t>(glTFModel.instanceCount);
+		if (overlay->sliderInt("Instances", &instanceCount, 1, MAX_INSTANCE_COUNT))
+		{
+			glTFModel.instanceCount = static_cast<uint32_t>(instanceCount);
+			glTFModel.updateInstances();
+			buildCommandBuffers();
+		}
+		overlay->text("Skinned vertices: %d", glTFModel.vertices.count * glTFModel.instanceCount);
 	}
 }
 
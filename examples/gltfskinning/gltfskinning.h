@@ -40,6 +40,9 @@
 
 #define ENABLE_VALIDATION false
 
+// Maximum number of animated model instances, used to size the joint matrix and skinned vertex buffers
+#define MAX_INSTANCE_COUNT 256
+
 // Contains everything required to render a glTF model in Vulkan
 // This class is heavily simplified (compared to glTF's feature set) but retains the basic glTF structure
 class VulkanglTFModel
@@ -54,6 +57,7 @@ class VulkanglTFModel
 
 	struct Vertices
 	{
+		uint32_t       count;
 		VkBuffer       buffer;
 		VkDeviceMemory memory;
 	} vertices;
@@ -94,6 +98,9 @@ class VulkanglTFModel
 	struct Mesh
 	{
 		std::vector<Primitive> primitives;
+		// Range of the mesh in the vertex buffer, used for skinning the mesh's vertices
+		uint32_t               firstVertex = 0;
+		uint32_t               vertexCount = 0;
 	};
 
 	struct Node
@@ -107,6 +114,8 @@ class VulkanglTFModel
 		glm::quat           rotation{};
 		int32_t             skin = -1;
 		glm::mat4           matrix;
+		// Current global matrix, updated from the animated local matrices of the node hierarchy
+		glm::mat4           globalMatrix{1.0f};
 		glm::mat4           getLocalMatrix();
 	};
 
@@ -130,8 +139,18 @@ class VulkanglTFModel
 		Node *                 skeletonRoot = nullptr;
 		std::vector<glm::mat4> inverseBindMatrices;
 		std::vector<Node *>    joints;
-		vks::Buffer            ssbo;
-		VkDescriptorSet        descriptorSet;
+		// Offset of the skin's joints in the joint matrices of an instance
+		uint32_t               jointOffset = 0;
+	};
+
+	/*
+		Vertex written by the skinning compute shader
+	*/
+
+	struct SkinnedVertex
+	{
+		glm::vec4 pos;
+		glm::vec4 normal;
 	};
 
 	/*
@@ -171,6 +190,15 @@ class VulkanglTFModel
 
 	uint32_t activeAnimation = 0;
 
+	// Number of instances that are animated and drawn
+	uint32_t instanceCount = 1;
+	// Number of joints of all skins, the joint matrices of each instance are stored consecutively
+	uint32_t jointCount = 0;
+	// Joint matrices of all instances (persistently mapped)
+	vks::Buffer jointMatrices;
+	// Vertices of all instances skinned by the compute shader
+	vks::Buffer skinnedVertices;
+
 	~VulkanglTFModel();
 	void      loadImages(tinygltf::Model &input);
 	void      loadTextures(tinygltf::Model &input);
@@ -180,9 +208,13 @@ class VulkanglTFModel
 	void      loadSkins(tinygltf::Model &input);
 	void      loadAnimations(tinygltf::Model &input);
 	void      loadNode(const tinygltf::Node &inputNode, const tinygltf::Model &input, VulkanglTFModel::Node *parent, uint32_t nodeIndex, std::vector<uint32_t> &indexBuffer, std::vector<VulkanglTFModel::Vertex> &vertexBuffer);
-	glm::mat4 getNodeMatrix(VulkanglTFModel::Node *node);
-	void      updateJoints(VulkanglTFModel::Node *node);
+	void      updateNodeMatrices(VulkanglTFModel::Node *node, const glm::mat4 &parentMatrix);
+	void      updateJoints(VulkanglTFModel::Node *node, glm::mat4 *instanceJointMatrices);
+	void      applyAnimation(const Animation &animation, float time);
+	void      updateInstances();
 	void      updateAnimation(float deltaTime);
+	void      skinNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node *node);
+	void      skin(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node);
 	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 };
@@ -214,9 +246,19 @@ class VulkanExample : public VulkanExampleBase
 	{
 		VkDescriptorSetLayout matrices;
 		VkDescriptorSetLayout textures;
-		VkDescriptorSetLayout jointMatrices;
+		VkDescriptorSetLayout skinnedVertices;
 	} descriptorSetLayouts;
 	VkDescriptorSet descriptorSet;
+	VkDescriptorSet skinnedVerticesDescriptorSet;
+
+	// POI: Compute pipeline that skins the vertices of all instances once per frame
+	struct Skinning
+	{
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet       descriptorSet;
+		VkPipelineLayout      pipelineLayout;
+		VkPipeline            pipeline;
+	} skinning;
 
 	VulkanglTFModel glTFModel;
 
@@ -13,11 +13,19 @@
 #include "VulkanglTFModel.h"
 
 #define ENABLE_VALIDATION false
-#define NODE_COUNT 20
+// Initial size of the node pool, the pool is resized based on the number of nodes the GPU requested in the previous frames
+#define INITIAL_NODES_PER_PIXEL 2
+// Max. number of fragments per pixel sorted by the resolve pass (needs to match the color fragment shader)
+#define MAX_FRAGMENT_COUNT 128
+// Number of consecutive frames the pool needs to be mostly unused before it is shrunk
+#define POOL_SHRINK_FRAMES 120
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum OITMethod { OIT_LINKED_LISTS = 0, OIT_WEIGHTED_BLENDED = 1 };
+	int32_t oitMethod = OIT_LINKED_LISTS;
+
 	struct {
 		vkglTF::Model sphere;
 		vkglTF::Model cube;
@@ -31,13 +39,26 @@ public:
 		glm::vec4 color;
 		float depth;
 		uint32_t next;
+		// Pads the node to the array stride of the shader struct
+		uint32_t padding[2];
 	};
 
 	struct {
+		// Number of nodes requested by the geometry pass, can be larger than the pool
 		uint32_t count;
 		uint32_t maxNodeCount;
+		// Longest per-pixel list encountered by the resolve pass
+		uint32_t peakFragmentCount;
 	} geometrySBO;
 
+	struct {
+		uint32_t requestedNodes = 0;
+		uint32_t peakFragmentCount = 0;
+		uint32_t overflowFrames = 0;
+		uint32_t underusedFrames = 0;
+		uint32_t resizes = 0;
+	} nodePoolStats;
+
 	struct GeometryPass {
 		VkRenderPass renderPass;
 		VkFramebuffer framebuffer;
@@ -46,6 +67,24 @@ public:
 		vks::Buffer linkedList;
 	} geometryPass;
 
+	struct FrameBufferAttachment {
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		VkFormat format;
+	};
+
+	// Weighted blended OIT accumulates all transparent fragments into two render targets without per-pixel lists
+	struct WeightedBlendedPass {
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer;
+		// Sum of weighted premultiplied colors (rgb) and weighted coverage (a)
+		FrameBufferAttachment accum;
+		// Product of (1 - alpha) of all fragments
+		FrameBufferAttachment revealage;
+		VkSampler sampler;
+	} weightedBlendedPass;
+
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -59,21 +98,26 @@ public:
 	struct {
 		VkDescriptorSetLayout geometry;
 		VkDescriptorSetLayout color;
+		VkDescriptorSetLayout weightedBlended;
 	} descriptorSetLayouts;
 
 	struct {
 		VkPipelineLayout geometry;
 		VkPipelineLayout color;
+		VkPipelineLayout weightedBlended;
 	} pipelineLayouts;
 
 	struct {
 		VkPipeline geometry;
 		VkPipeline color;
+		VkPipeline weightedBlendedGeometry;
+		VkPipeline weightedBlendedComposite;
 	} pipelines;
 
 	struct {
 		VkDescriptorSet geometry;
 		VkDescriptorSet color;
+		VkDescriptorSet weightedBlended;
 	} descriptorSets;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -89,15 +133,23 @@ public:
 	{
 		vkDestroyPipeline(device, pipelines.geometry, nullptr);
 		vkDestroyPipeline(device, pipelines.color, nullptr);
+		vkDestroyPipeline(device, pipelines.weightedBlendedGeometry, nullptr);
+		vkDestroyPipeline(device, pipelines.weightedBlendedComposite, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.geometry, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.color, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.weightedBlended, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.geometry, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.color, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.weightedBlended, nullptr);
 
 		destroyGeometryPass();
 
+		destroyWeightedBlendedFramebuffer();
+		vkDestroyRenderPass(device, weightedBlendedPass.renderPass, nullptr);
+		vkDestroySampler(device, weightedBlendedPass.sampler, nullptr);
+
 		uniformBuffers.renderPass.destroy();
 	}
 
@@ -116,6 +168,8 @@ public:
 		loadAssets();
 		prepareUniformBuffers();
 		prepareGeometryPass();
+		prepareWeightedBlendedPass();
+		prepareWeightedBlendedFramebuffer();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -130,12 +184,17 @@ public:
 		if (!prepared)
 			return;
 		draw();
+		if (oitMethod == OIT_LINKED_LISTS) {
+			updateNodePool();
+		}
 	}
 
 	void windowResized() override
 	{
 		destroyGeometryPass();
 		prepareGeometryPass();
+		destroyWeightedBlendedFramebuffer();
+		prepareWeightedBlendedFramebuffer();
 		vkResetDescriptorPool(device, descriptorPool, 0);
 		setupDescriptorSets();
 
@@ -148,6 +207,22 @@ public:
 		updateUniformBuffers();
 	}
 
+	void OnUpdateUIOverlay(vks::UIOverlay *overlay) override
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->comboBox("Method", &oitMethod, { "Linked lists", "Weighted blended" })) {
+				buildCommandBuffers();
+			}
+		}
+		if ((oitMethod == OIT_LINKED_LISTS) && overlay->header("Node pool")) {
+			overlay->text("Capacity: %u nodes (%.1f MB)", geometrySBO.maxNodeCount, (float)geometryPass.linkedList.size / (1024.0f * 1024.0f));
+			overlay->text("Requested: %u nodes", nodePoolStats.requestedNodes);
+			overlay->text("Peak list length: %u%s", nodePoolStats.peakFragmentCount, (nodePoolStats.peakFragmentCount >= MAX_FRAGMENT_COUNT) ? " (truncated)" : "");
+			overlay->text("Overflow frames: %u", nodePoolStats.overflowFrames);
+			overlay->text("Pool resizes: %u", nodePoolStats.resizes);
+		}
+	}
+
 private:
 	void loadAssets()
 	{
@@ -203,8 +278,7 @@ private:
 
 		// Set up GeometrySBO data.
 		geometrySBO.count = 0;
-		geometrySBO.maxNodeCount = NODE_COUNT * width * height;
-		memcpy(geometryPass.geometry.mapped, &geometrySBO, sizeof(geometrySBO));
+		geometrySBO.peakFragmentCount = 0;
 
 		// Create a texture for HeadIndex.
 		// This image will track the head index of each fragment.
@@ -258,13 +332,8 @@ private:
 		geometryPass.headIndex.sampler = VK_NULL_HANDLE;
 
 		// Create a buffer for LinkedListSBO
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&geometryPass.linkedList,
-			sizeof(Node) * geometrySBO.maxNodeCount));
-
-		VK_CHECK_RESULT(geometryPass.linkedList.map());
+		// The pool starts with an estimate and is resized at runtime based on the number of nodes requested by the GPU
+		createNodeBuffer(INITIAL_NODES_PER_PIXEL * width * height);
 
 		// Change HeadIndex image's layout from UNDEFINED to GENERAL
 		VkCommandBufferAllocateInfo cmdBufAllocInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
@@ -296,6 +365,197 @@ private:
 		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 	}
 
+	// Create the node pool for the linked lists, only accessed by the GPU
+	void createNodeBuffer(uint64_t nodeCount)
+	{
+		// The pool can't exceed the max. range of a storage buffer
+		const uint64_t maxNodeCount = vulkanDevice->properties.limits.maxStorageBufferRange / sizeof(Node);
+		geometrySBO.maxNodeCount = (uint32_t)std::min(nodeCount, maxNodeCount);
+		memcpy(geometryPass.geometry.mapped, &geometrySBO, sizeof(geometrySBO));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&geometryPass.linkedList,
+			sizeof(Node) * geometrySBO.maxNodeCount));
+	}
+
+	void resizeNodePool(uint64_t nodeCount)
+	{
+		vkQueueWaitIdle(queue);
+		geometryPass.linkedList.destroy();
+		createNodeBuffer(nodeCount);
+		nodePoolStats.resizes++;
+
+		// Descriptors referencing the pool need to be updated, which also invalidates the command buffers using them
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.geometry, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &geometryPass.linkedList.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.color, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &geometryPass.linkedList.descriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		buildCommandBuffers();
+	}
+
+	// Adjust the size of the node pool based on the statistics written by the GPU in the last frame
+	void updateNodePool()
+	{
+		// The frame has been completed at this point (submitFrame waits for the queue to become idle)
+		memcpy(&geometrySBO, geometryPass.geometry.mapped, sizeof(geometrySBO));
+		nodePoolStats.requestedNodes = geometrySBO.count;
+		nodePoolStats.peakFragmentCount = geometrySBO.peakFragmentCount;
+
+		const uint64_t requested = geometrySBO.count;
+		const uint64_t capacity = geometrySBO.maxNodeCount;
+		if (requested > capacity) {
+			// Nodes that did not fit into the pool have been dropped this frame, grow the pool with some headroom
+			nodePoolStats.overflowFrames++;
+			nodePoolStats.underusedFrames = 0;
+			const uint64_t maxNodeCount = vulkanDevice->properties.limits.maxStorageBufferRange / sizeof(Node);
+			if (capacity < maxNodeCount) {
+				resizeNodePool(requested + requested / 4);
+			}
+		} else if (requested < capacity / 4) {
+			// Only shrink if the pool has been mostly unused for a while, so it doesn't oscillate
+			if (++nodePoolStats.underusedFrames >= POOL_SHRINK_FRAMES) {
+				nodePoolStats.underusedFrames = 0;
+				const uint64_t nodeCount = std::max(requested + requested / 4, (uint64_t)width * height);
+				if (nodeCount < capacity) {
+					resizeNodePool(nodeCount);
+				}
+			}
+		} else {
+			nodePoolStats.underusedFrames = 0;
+		}
+	}
+
+	void prepareWeightedBlendedPass()
+	{
+		weightedBlendedPass.accum.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		weightedBlendedPass.revealage.format = VK_FORMAT_R16_SFLOAT;
+
+		std::array<VkAttachmentDescription, 2> attachmentDescs = {};
+		for (uint32_t i = 0; i < 2; i++) {
+			attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		attachmentDescs[0].format = weightedBlendedPass.accum.format;
+		attachmentDescs[1].format = weightedBlendedPass.revealage.format;
+
+		std::array<VkAttachmentReference, 2> colorReferences = {};
+		colorReferences[0] = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		colorReferences[1] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpassDescription.pColorAttachments = colorReferences.data();
+
+		// Use subpass dependencies for layout transitions, the attachments are read by the composition pass
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
+		renderPassInfo.pAttachments = attachmentDescs.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &weightedBlendedPass.renderPass));
+
+		// The composition pass fetches single texels, so no filtering is required
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = 1.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &weightedBlendedPass.sampler));
+	}
+
+	void createAttachment(FrameBufferAttachment* attachment)
+	{
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = attachment->format;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &attachment->image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->memory, 0));
+
+		VkImageViewCreateInfo imageViewInfo = vks::initializers::imageViewCreateInfo();
+		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewInfo.format = attachment->format;
+		imageViewInfo.image = attachment->image;
+		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewInfo, nullptr, &attachment->view));
+	}
+
+	void destroyAttachment(FrameBufferAttachment* attachment)
+	{
+		vkDestroyImageView(device, attachment->view, nullptr);
+		vkDestroyImage(device, attachment->image, nullptr);
+		vkFreeMemory(device, attachment->memory, nullptr);
+	}
+
+	// Render targets of the weighted blended pass, recreated on resize
+	void prepareWeightedBlendedFramebuffer()
+	{
+		createAttachment(&weightedBlendedPass.accum);
+		createAttachment(&weightedBlendedPass.revealage);
+
+		std::array<VkImageView, 2> attachments = { weightedBlendedPass.accum.view, weightedBlendedPass.revealage.view };
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = weightedBlendedPass.renderPass;
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbufCreateInfo.pAttachments = attachments.data();
+		fbufCreateInfo.width = width;
+		fbufCreateInfo.height = height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &weightedBlendedPass.framebuffer));
+	}
+
+	void destroyWeightedBlendedFramebuffer()
+	{
+		vkDestroyFramebuffer(device, weightedBlendedPass.framebuffer, nullptr);
+		destroyAttachment(&weightedBlendedPass.accum);
+		destroyAttachment(&weightedBlendedPass.revealage);
+	}
+
 	void setupDescriptorSetLayout()
 	{
 		// Create a geometry descriptor set layout.
@@ -345,6 +605,11 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
 				1),
+			// GeometrySBO (statistics)
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				2),
 		};
 
 		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -353,6 +618,27 @@ private:
 		// Create a color pipeline layout.
 		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.color, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.color));
+
+		// Create a weighted blended composition descriptor set layout.
+		setLayoutBindings = {
+			// Accumulation target
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				0),
+			// Revealage target
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				1),
+		};
+
+		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.weightedBlended));
+
+		// Create a weighted blended composition pipeline layout.
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.weightedBlended, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.weightedBlended));
 	}
 
 	void preparePipelines()
@@ -385,6 +671,32 @@ private:
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometry));
 
+		// Create a weighted blended geometry pipeline.
+		// Colors and coverage are accumulated additively, revealage is multiplied by (1 - alpha)
+		std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates = {
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE),
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE)
+		};
+		blendAttachmentStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStates[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStates[0].alphaBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStates[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachmentStates[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+		blendAttachmentStates[1].colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStates[1].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachmentStates[1].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentStates[1].alphaBlendOp = VK_BLEND_OP_ADD;
+		VkPipelineColorBlendStateCreateInfo weightedBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(blendAttachmentStates.size()), blendAttachmentStates.data());
+		pipelineCI.pColorBlendState = &weightedBlendState;
+		pipelineCI.renderPass = weightedBlendedPass.renderPass;
+
+		shaderStages[1] = loadShader(getShadersPath() + "oit/wboit.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedBlendedGeometry));
+
 		// Create a color pipeline.
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
@@ -410,6 +722,12 @@ private:
 		rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.color));
+
+		// Create a weighted blended composition pipeline.
+		pipelineCI.layout = pipelineLayouts.weightedBlended;
+		shaderStages[1] = loadShader(getShadersPath() + "oit/wboitcomposite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedBlendedComposite));
 	}
 
 	void setupDescriptorPool()
@@ -417,15 +735,16 @@ private:
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -491,10 +810,79 @@ private:
 				descriptorSets.color,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				1,
-				&geometryPass.linkedList.descriptor)
+				&geometryPass.linkedList.descriptor),
+			// Binding 2: GeometrySBO
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.color,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				2,
+				&geometryPass.geometry.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+		// Update a weighted blended composition descriptor set.
+		allocInfo =
+			vks::initializers::descriptorSetAllocateInfo(
+				descriptorPool,
+				&descriptorSetLayouts.weightedBlended,
+				1);
+
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.weightedBlended));
+
+		VkDescriptorImageInfo accumDescriptor = vks::initializers::descriptorImageInfo(weightedBlendedPass.sampler, weightedBlendedPass.accum.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo revealageDescriptor = vks::initializers::descriptorImageInfo(weightedBlendedPass.sampler, weightedBlendedPass.revealage.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		writeDescriptorSets = {
+			// Binding 0: Accumulation target
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.weightedBlended,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				0,
+				&accumDescriptor),
+			// Binding 1: Revealage target
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.weightedBlended,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				1,
+				&revealageDescriptor)
+		};
+
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+	}
+
+	// Render the transparent objects with the currently bound geometry pipeline
+	void drawScene(VkCommandBuffer commandBuffer)
+	{
+		models.sphere.bindBuffers(commandBuffer);
+
+		ObjectData objectData;
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
+		objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
+		for (int32_t x = 0; x < 5; x++)
+		{
+			for (int32_t y = 0; y < 5; y++)
+			{
+				for (int32_t z = 0; z < 5; z++)
+				{
+					glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
+					glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
+					objectData.model = T * S;
+					vkCmdPushConstants(commandBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+					models.sphere.draw(commandBuffer);
+				}
+			}
+		}
+
+		objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
+		for (uint32_t x = 0; x < 2; x++)
+		{
+			glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
+			glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
+			objectData.model = T * S;
+			vkCmdPushConstants(commandBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+			models.cube.draw(commandBuffer);
+		}
 	}
 
 	void buildCommandBuffers()
@@ -508,6 +896,11 @@ private:
 		clearValues[0].color = defaultClearColor;
 		clearValues[1].depthStencil = { 1.0f, 0 };
 
+		// Accumulation starts at zero, revealage at one (nothing covered)
+		VkClearValue weightedBlendedClearValues[2];
+		weightedBlendedClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		weightedBlendedClearValues[1].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderArea.offset.x = 0;
 		renderPassBeginInfo.renderArea.offset.y = 0;
@@ -527,63 +920,47 @@ private:
 			// Update dynamic scissor state
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			VkClearColorValue clearColor;
-			clearColor.uint32[0] = 0xffffffff;
-
-			VkImageSubresourceRange subresRange = {};
+			if (oitMethod == OIT_LINKED_LISTS)
+			{
+				VkClearColorValue clearColor;
+				clearColor.uint32[0] = 0xffffffff;
 
-			subresRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresRange.levelCount = 1;
-			subresRange.layerCount = 1;
+				VkImageSubresourceRange subresRange = {};
 
-			vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
+				subresRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				subresRange.levelCount = 1;
+				subresRange.layerCount = 1;
 
-			// Begin the geometry render pass
-			renderPassBeginInfo.renderPass = geometryPass.renderPass;
-			renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
-			renderPassBeginInfo.clearValueCount = 0;
-			renderPassBeginInfo.pClearValues = nullptr;
+				vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
-			uint32_t dynamicOffset = 0;
-			models.sphere.bindBuffers(drawCmdBuffers[i]);
+				// Begin the geometry render pass
+				renderPassBeginInfo.renderPass = geometryPass.renderPass;
+				renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
+				renderPassBeginInfo.clearValueCount = 0;
+				renderPassBeginInfo.pClearValues = nullptr;
 
-			// Render the scene
-			ObjectData objectData;
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
+				drawScene(drawCmdBuffers[i]);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
-			objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
-			for (int32_t x = 0; x < 5; x++)
-			{
-				for (int32_t y = 0; y < 5; y++)
-				{
-					for (int32_t z = 0; z < 5; z++)
-					{
-						glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
-						glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-						objectData.model = T * S;
-						vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-						models.sphere.draw(drawCmdBuffers[i]);
-					}
-				}
+				// Make a pipeline barrier to guarantee the geometry pass is done
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
 			}
-
-			objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
-			for (uint32_t x = 0; x < 2; x++)
+			else
 			{
-				glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
-				glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
-				objectData.model = T * S;
-				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-				models.cube.draw(drawCmdBuffers[i]);
+				// Begin the weighted blended accumulation render pass
+				renderPassBeginInfo.renderPass = weightedBlendedPass.renderPass;
+				renderPassBeginInfo.framebuffer = weightedBlendedPass.framebuffer;
+				renderPassBeginInfo.clearValueCount = 2;
+				renderPassBeginInfo.pClearValues = weightedBlendedClearValues;
+
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.weightedBlendedGeometry);
+				drawScene(drawCmdBuffers[i]);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-			// Make a pipeline barrier to guarantee the geometry pass is done
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
-
 			// Begin the color render pass
 			renderPassBeginInfo.renderPass = renderPass;
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
@@ -591,8 +968,18 @@ private:
 			renderPassBeginInfo.pClearValues = clearValues;
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+			if (oitMethod == OIT_LINKED_LISTS)
+			{
+				// Sort and blend the per-pixel lists
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+			}
+			else
+			{
+				// Resolve the accumulated colors
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.weightedBlendedComposite);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.weightedBlended, 0, 1, &descriptorSets.weightedBlended, 0, nullptr);
+			}
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 			drawUI(drawCmdBuffers[i]);
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -612,8 +999,10 @@ private:
 	{
 		VulkanExampleBase::prepareFrame();
 
-		// Clear previous geometry pass data
-		memset(geometryPass.geometry.mapped, 0, sizeof(uint32_t));
+		// Clear previous geometry pass data and statistics
+		geometrySBO.count = 0;
+		geometrySBO.peakFragmentCount = 0;
+		memcpy(geometryPass.geometry.mapped, &geometrySBO, sizeof(geometrySBO));
 
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
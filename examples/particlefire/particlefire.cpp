@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - CPU based fire particle system
 *
+* Particles are stored as a structure of arrays and updated four at a time using SIMD, split across multiple threads for large particle counts
+* Updated particles are written directly to the persistently mapped vertex buffer
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,16 +11,21 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "threadpool.hpp"
+#include "simd.hpp"
 
 #define ENABLE_VALIDATION false
-#define PARTICLE_COUNT 512
+#define DEFAULT_PARTICLE_COUNT 512
 #define PARTICLE_SIZE 10.0f
+// Minimum number of particles per worker thread, below that the update runs on the main thread
+#define PARTICLES_PER_JOB 16384
 
 #define FLAME_RADIUS 8.0f
 
 #define PARTICLE_TYPE_FLAME 0
 #define PARTICLE_TYPE_SMOKE 1
 
+// Particle vertex layout as read by the shader
 struct Particle {
 	glm::vec4 pos;
 	glm::vec4 color;
@@ -25,9 +33,6 @@ struct Particle {
 	float size;
 	float rotation;
 	uint32_t type;
-	// Attributes not used in shader
-	glm::vec4 vel;
-	float rotationSpeed;
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -93,9 +98,29 @@ public:
 		VkDescriptorSet environment;
 	} descriptorSets;
 
-	std::vector<Particle> particleBuffer;
-
-	std::default_random_engine rndEngine;
+	// Simulation state of all particles as a structure of arrays
+	// Particle counts are always a multiple of the SIMD width
+	struct {
+		std::vector<float> posX, posY, posZ;
+		std::vector<float> velX, velY, velZ;
+		// Particles are always grey, so a single channel is enough
+		std::vector<float> color;
+		std::vector<float> alpha;
+		std::vector<float> size;
+		std::vector<float> rotation;
+		std::vector<float> rotationSpeed;
+		std::vector<float> type;
+	} simulation;
+
+	uint32_t particleCount = DEFAULT_PARTICLE_COUNT;
+	std::vector<uint32_t> particleCounts = { 512, 4096, 32768, 262144, 1048576 };
+	int32_t particleCountIndex = 0;
+
+	vks::ThreadPool threadPool;
+	std::vector<vks::simd::Random> randomGenerators;
+	uint32_t rndSeed;
+	// CPU time of the last particle update in milliseconds
+	double updateTime = 0.0;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -105,7 +130,21 @@ public:
 		camera.setRotation(glm::vec3(-15.0f, 45.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 8.0f;
-		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		rndSeed = benchmark.active ? 0 : (unsigned)time(nullptr);
+
+		commandLineParser.add("particles", { "--particles" }, 1, "Number of particles (rounded up to a multiple of four)");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("particles")) {
+			particleCount = std::max(commandLineParser.getValueAsInt("particles", DEFAULT_PARTICLE_COUNT), 1);
+			particleCount = (particleCount + vks::simd::width - 1) / vks::simd::width * vks::simd::width;
+			if (std::find(particleCounts.begin(), particleCounts.end(), particleCount) == particleCounts.end()) {
+				particleCounts.push_back(particleCount);
+				std::sort(particleCounts.begin(), particleCounts.end());
+			}
+		}
+		particleCountIndex = static_cast<int32_t>(std::find(particleCounts.begin(), particleCounts.end(), particleCount) - particleCounts.begin());
+
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
 	}
 
 	~VulkanExample()
@@ -124,9 +163,7 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkUnmapMemory(device, particles.memory);
-		vkDestroyBuffer(device, particles.buffer, nullptr);
-		vkFreeMemory(device, particles.memory, nullptr);
+		destroyParticles();
 
 		uniformBuffers.environment.destroy();
 		uniformBuffers.fire.destroy();
@@ -185,7 +222,7 @@ public:
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.particles, 0, nullptr);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &particles.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
+			vkCmdDraw(drawCmdBuffers[i], particleCount, 1, 0, 0);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -195,114 +232,186 @@ public:
 		}
 	}
 
-	float rnd(float range)
+	// Sine approximation for the range [-pi, pi]
+	static vks::simd::float4 sinApprox(vks::simd::float4 x)
 	{
-		std::uniform_real_distribution<float> rndDist(0.0f, range);
-		return rndDist(rndEngine);
+		using namespace vks::simd;
+		const float b = 4.0f / float(M_PI);
+		const float c = -4.0f / float(M_PI * M_PI);
+		float4 y = b * x + c * x * abs(x);
+		// Extra precision step
+		return 0.225f * (y * abs(y) - y) + y;
 	}
 
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
+	// Cosine approximation for the range [-pi, pi]
+	static vks::simd::float4 cosApprox(vks::simd::float4 x)
 	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * float(M_PI));
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
-
-		// Get random sphere point
-		float theta = rnd(2.0f * float(M_PI));
-		float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
-		float r = rnd(FLAME_RADIUS);
-
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
-
-		particle->pos += glm::vec4(emitterPos, 0.0f);
+		using namespace vks::simd;
+		x = x + float(M_PI) / 2.0f;
+		x = select(x > set1(float(M_PI)), x - 2.0f * float(M_PI), x);
+		return sinApprox(x);
 	}
 
-	void transitionParticle(Particle *particle)
+	// (Re)spawns the particles of a group in the lanes set in respawnMask as flames and turns the ones set in smokeMask into smoke
+	void transitionParticles(uint32_t index, vks::simd::uint4 respawnMask, vks::simd::uint4 smokeMask, vks::simd::Random& rnd)
 	{
-		switch (particle->type)
-		{
-		case PARTICLE_TYPE_FLAME:
-			// Flame particles have a chance of turning into smoke
-			if (rnd(1.0f) < 0.05f)
-			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.25f + rnd(0.25f));
-				particle->pos.x *= 0.5f;
-				particle->pos.z *= 0.5f;
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
-			}
-			else
-			{
-				initParticle(particle, emitterPos);
+		using namespace vks::simd;
+		float4 r[10];
+		for (uint32_t i = 0; i < 10; i++) {
+			r[i] = rnd.next();
+		}
+		const float velRange = maxVel.y - minVel.y;
+
+		// Flame: Random point within a sphere around the emitter
+		float4 theta = r[7] * (2.0f * float(M_PI)) - float(M_PI);
+		float4 phi = r[8] * float(M_PI) - float(M_PI) / 2.0f;
+		float4 radius = r[9] * FLAME_RADIUS;
+		float4 cosPhi = cosApprox(phi);
+		float4 flamePosX = radius * cosApprox(theta) * cosPhi + emitterPos.x;
+		float4 flamePosY = radius * sinApprox(phi) + emitterPos.y;
+		float4 flamePosZ = radius * sinApprox(theta) * cosPhi + emitterPos.z;
+
+		float4 posX = load(&simulation.posX[index]);
+		float4 posZ = load(&simulation.posZ[index]);
+
+		store(&simulation.posX[index], select(respawnMask, flamePosX, select(smokeMask, posX * 0.5f, posX)));
+		store(&simulation.posY[index], select(respawnMask, flamePosY, load(&simulation.posY[index])));
+		store(&simulation.posZ[index], select(respawnMask, flamePosZ, select(smokeMask, posZ * 0.5f, posZ)));
+		store(&simulation.velX[index], select(respawnMask, set1(0.0f), select(smokeMask, r[2] - r[3], load(&simulation.velX[index]))));
+		store(&simulation.velY[index], select(respawnMask, r[1] * velRange + minVel.y, select(smokeMask, r[4] * velRange + minVel.y * 2.0f, load(&simulation.velY[index]))));
+		store(&simulation.velZ[index], select(respawnMask, set1(0.0f), select(smokeMask, r[5] - r[6], load(&simulation.velZ[index]))));
+		store(&simulation.color[index], select(respawnMask, set1(1.0f), select(smokeMask, r[1] * 0.25f + 0.25f, load(&simulation.color[index]))));
+		store(&simulation.alpha[index], select(respawnMask, r[2] * 0.75f, select(smokeMask, set1(0.0f), load(&simulation.alpha[index]))));
+		store(&simulation.size[index], select(respawnMask, r[3] * 0.5f + 1.0f, select(smokeMask, r[7] * 0.5f + 1.0f, load(&simulation.size[index]))));
+		store(&simulation.rotation[index], select(respawnMask, r[4] * (2.0f * float(M_PI)), load(&simulation.rotation[index])));
+		store(&simulation.rotationSpeed[index], select(respawnMask, (r[5] - r[6]) * 2.0f, select(smokeMask, r[8] - r[9], load(&simulation.rotationSpeed[index]))));
+		store(&simulation.type[index], select(respawnMask, set1(float(PARTICLE_TYPE_FLAME)), select(smokeMask, set1(float(PARTICLE_TYPE_SMOKE)), load(&simulation.type[index]))));
+	}
+
+	// Copy a group of particles to the vertex layout expected by the shader
+	void writeVertices(uint32_t index)
+	{
+		Particle* vertices = static_cast<Particle*>(particles.mappedMemory) + index;
+		for (uint32_t i = 0; i < vks::simd::width; i++) {
+			const uint32_t p = index + i;
+			// The vertex buffer is write combined memory, so it's written sequentially and never read
+			vertices[i].pos = glm::vec4(simulation.posX[p], simulation.posY[p], simulation.posZ[p], 1.0f);
+			vertices[i].color = glm::vec4(simulation.color[p]);
+			vertices[i].alpha = simulation.alpha[p];
+			vertices[i].size = simulation.size[p];
+			vertices[i].rotation = simulation.rotation[p];
+			vertices[i].type = static_cast<uint32_t>(simulation.type[p]);
+		}
+	}
+
+	// Simulate a range of particles, four at a time
+	void updateParticleRange(uint32_t first, uint32_t last, float deltaT, vks::simd::Random& rnd)
+	{
+		using namespace vks::simd;
+		const float particleTimer = deltaT * 0.45f;
+		for (uint32_t index = first; index < last; index += width) {
+			const uint4 smoke = load(&simulation.type[index]) > set1(0.5f);
+
+			// Flame particles only move upwards, smoke moves along its full velocity
+			float4 posX = load(&simulation.posX[index]);
+			float4 posY = load(&simulation.posY[index]);
+			float4 posZ = load(&simulation.posZ[index]);
+			posX = select(smoke, posX - load(&simulation.velX[index]) * deltaT, posX);
+			posY = posY - load(&simulation.velY[index]) * select(smoke, set1(deltaT), set1(particleTimer * 3.5f));
+			posZ = select(smoke, posZ - load(&simulation.velZ[index]) * deltaT, posZ);
+			store(&simulation.posX[index], posX);
+			store(&simulation.posY[index], posY);
+			store(&simulation.posZ[index], posZ);
+
+			float4 alpha = load(&simulation.alpha[index]) + select(smoke, set1(particleTimer * 1.25f), set1(particleTimer * 2.5f));
+			store(&simulation.alpha[index], alpha);
+			store(&simulation.size[index], load(&simulation.size[index]) + select(smoke, set1(particleTimer * 0.125f), set1(particleTimer * -0.5f)));
+			store(&simulation.color[index], load(&simulation.color[index]) - select(smoke, set1(particleTimer * 0.05f), set1(0.0f)));
+			store(&simulation.rotation[index], load(&simulation.rotation[index]) + load(&simulation.rotationSpeed[index]) * particleTimer);
+
+			// Transition particle state at the end of its life
+			const uint4 expired = alpha > set1(2.0f);
+			if (bitmask(expired) != 0) {
+				// Flame particles have a chance of turning into smoke, all others are respawned as flames
+				const uint4 toSmoke = andNot(expired & (rnd.next() < set1(0.05f)), smoke);
+				transitionParticles(index, andNot(expired, toSmoke), toSmoke, rnd);
 			}
-			break;
-		case PARTICLE_TYPE_SMOKE:
-			// Respawn at end of life
-			initParticle(particle, emitterPos);
-			break;
+
+			writeVertices(index);
 		}
 	}
 
 	void prepareParticles()
 	{
-		particleBuffer.resize(PARTICLE_COUNT);
-		for (auto& particle : particleBuffer)
-		{
-			initParticle(&particle, emitterPos);
-			particle.alpha = 1.0f - (abs(particle.pos.y) / (FLAME_RADIUS * 2.0f));
+		const uint32_t count = particleCount;
+		for (auto* values : { &simulation.posX, &simulation.posY, &simulation.posZ, &simulation.velX, &simulation.velY, &simulation.velZ, &simulation.color, &simulation.alpha, &simulation.size, &simulation.rotation, &simulation.rotationSpeed, &simulation.type }) {
+			values->assign(count, 0.0f);
 		}
 
-		particles.size = particleBuffer.size() * sizeof(Particle);
+		particles.size = count * sizeof(Particle);
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			particles.size,
 			&particles.buffer,
-			&particles.memory,
-			particleBuffer.data()));
+			&particles.memory));
 
 		// Map the memory and store the pointer for reuse
 		VK_CHECK_RESULT(vkMapMemory(device, particles.memory, 0, particles.size, 0, &particles.mappedMemory));
+
+		// Every worker has its own random number generator
+		const uint32_t workerCount = std::max(1u, std::min(static_cast<uint32_t>(threadPool.threads.size()), count / PARTICLES_PER_JOB));
+		randomGenerators.resize(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++) {
+			randomGenerators[i].seed(rndSeed + i);
+		}
+
+		const vks::simd::uint4 all = vks::simd::set1(~0u);
+		const vks::simd::uint4 none = vks::simd::set1(0u);
+		for (uint32_t index = 0; index < count; index += vks::simd::width) {
+			transitionParticles(index, all, none, randomGenerators[0]);
+			for (uint32_t i = index; i < index + vks::simd::width; i++) {
+				simulation.alpha[i] = 1.0f - (fabsf(simulation.posY[i]) / (FLAME_RADIUS * 2.0f));
+			}
+			writeVertices(index);
+		}
+	}
+
+	void destroyParticles()
+	{
+		vkUnmapMemory(device, particles.memory);
+		vkDestroyBuffer(device, particles.buffer, nullptr);
+		vkFreeMemory(device, particles.memory, nullptr);
 	}
 
+	// Update all particles and write them straight to the mapped vertex buffer, split across the worker threads for large particle counts
 	void updateParticles()
 	{
-		float particleTimer = frameTimer * 0.45f;
-		for (auto& particle : particleBuffer)
-		{
-			switch (particle.type)
-			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * frameTimer * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
-			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
-			// Transition particle state
-			if (particle.alpha > 2.0f)
-			{
-				transitionParticle(&particle);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		const float deltaT = frameTimer;
+		const uint32_t workerCount = static_cast<uint32_t>(randomGenerators.size());
+		if (workerCount == 1) {
+			updateParticleRange(0, particleCount, deltaT, randomGenerators[0]);
+		} else {
+			const uint32_t groupCount = particleCount / vks::simd::width;
+			for (uint32_t i = 0; i < workerCount; i++) {
+				const uint32_t first = groupCount * i / workerCount * vks::simd::width;
+				const uint32_t last = groupCount * (i + 1) / workerCount * vks::simd::width;
+				threadPool.threads[i]->addJob([=] { updateParticleRange(first, last, deltaT, randomGenerators[i]); });
 			}
+			threadPool.wait();
 		}
-		size_t size = particleBuffer.size() * sizeof(Particle);
-		memcpy(particles.mappedMemory, particleBuffer.data(), size);
+		updateTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	void changeParticleCount()
+	{
+		vkDeviceWaitIdle(device);
+		particleCount = particleCounts[particleCountIndex];
+		destroyParticles();
+		prepareParticles();
+		buildCommandBuffers();
 	}
 
 	void loadAssets()
@@ -589,6 +698,23 @@ public:
 			updateUniformBuffers();
 		}
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			std::vector<std::string> particleCountNames;
+			for (auto count : particleCounts) {
+				particleCountNames.push_back(std::to_string(count));
+			}
+			if (overlay->comboBox("Particles", &particleCountIndex, particleCountNames)) {
+				changeParticleCount();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("CPU update: %.3f ms", updateTime);
+			overlay->text("Worker threads: %d", (int32_t)randomGenerators.size());
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
@@ -12,6 +12,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTextureCache.h"
 
 #define ENABLE_VALIDATION false
 
@@ -34,6 +35,10 @@ public:
 		vks::Texture2D roughnessMap;
 	} textures;
 
+	// Generated textures are cached on disk and only regenerated if any of their inputs change
+	vks::TextureCache iblCache;
+	uint64_t environmentCubeHash = 0;
+
 	struct Meshes {
 		vkglTF::Model skybox;
 		vkglTF::Model object;
@@ -175,6 +180,7 @@ public:
 		models.skybox.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.object.loadFromFile(getAssetPath() + "models/cerberus/cerberus.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		textures.environmentCube.loadFromFile(getAssetPath() + "textures/hdr/gcanyon_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
+		environmentCubeHash = vks::TextureCache::hashFile(getAssetPath() + "textures/hdr/gcanyon_cube.ktx");
 		textures.albedoMap.loadFromFile(getAssetPath() + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.normalMap.loadFromFile(getAssetPath() + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.aoMap.loadFromFile(getAssetPath() + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
@@ -283,6 +289,16 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.pbr));
 	}
 
+	// Key for the cache entry of a generated texture, covers the generation parameters and the shaders used to generate it
+	uint64_t getIBLCacheKey(uint64_t seed, const std::vector<float>& params, const std::vector<std::string>& shaders)
+	{
+		uint64_t key = vks::TextureCache::hash(params.data(), params.size() * sizeof(float), seed);
+		for (auto& shader : shaders) {
+			key = vks::TextureCache::hashFile(getShadersPath() + "pbrtexture/" + shader, key);
+		}
+		return key;
+	}
+
 	// Generate a BRDF integration map used as a look-up-table (stores roughness / NdotV)
 	void generateBRDFLUT()
 	{
@@ -302,7 +318,7 @@ public:
 		imageCI.arrayLayers = 1;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -339,6 +355,14 @@ public:
 		textures.lutBrdf.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		textures.lutBrdf.device = vulkanDevice;
 
+		// The BRDF LUT doesn't depend on the environment map
+		const uint64_t cacheKey = getIBLCacheKey(vks::TextureCache::hashSeed, { (float)format, (float)dim }, { "genbrdflut.vert.spv", "genbrdflut.frag.spv" });
+		if (iblCache.load("brdflut", cacheKey, textures.lutBrdf.image, format, dim, dim, 1, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)) {
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Loading BRDF LUT from cache took " << tDiff << " ms" << std::endl;
+			return;
+		}
+
 		// FB, Att, RP, Pipe, etc.
 		VkAttachmentDescription attDesc = {};
 		// Color attachment
@@ -485,6 +509,8 @@ public:
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
+
+		iblCache.store("brdflut", cacheKey, textures.lutBrdf.image, format, dim, dim, 1, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	}
 
 	// Generate an irradiance cube map from the environment cube map
@@ -508,7 +534,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.irradianceCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -546,6 +572,20 @@ public:
 		textures.irradianceCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		textures.irradianceCube.device = vulkanDevice;
 
+		struct PushBlock {
+			glm::mat4 mvp;
+			// Sampling deltas
+			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
+			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
+		} pushBlock;
+
+		const uint64_t cacheKey = getIBLCacheKey(environmentCubeHash, { (float)format, (float)dim, (float)numMips, pushBlock.deltaPhi, pushBlock.deltaTheta }, { "filtercube.vert.spv", "irradiancecube.frag.spv" });
+		if (iblCache.load("irradiance", cacheKey, textures.irradianceCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)) {
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Loading irradiance cube from cache took " << tDiff << " ms" << std::endl;
+			return;
+		}
+
 		// FB, Att, RP, Pipe, etc.
 		VkAttachmentDescription attDesc = {};
 		// Color attachment
@@ -679,13 +719,6 @@ public:
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
 		// Pipeline layout
-		struct PushBlock {
-			glm::mat4 mvp;
-			// Sampling deltas
-			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
-			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
-		} pushBlock;
-
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
 			vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),
@@ -864,6 +897,8 @@ public:
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+
+		iblCache.store("irradiance", cacheKey, textures.irradianceCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	}
 
 	// Prefilter environment cubemap
@@ -888,7 +923,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.prefilteredCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -926,6 +961,19 @@ public:
 		textures.prefilteredCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		textures.prefilteredCube.device = vulkanDevice;
 
+		struct PushBlock {
+			glm::mat4 mvp;
+			float roughness;
+			uint32_t numSamples = 32u;
+		} pushBlock;
+
+		const uint64_t cacheKey = getIBLCacheKey(environmentCubeHash, { (float)format, (float)dim, (float)numMips, (float)pushBlock.numSamples }, { "filtercube.vert.spv", "prefilterenvmap.frag.spv" });
+		if (iblCache.load("prefiltered", cacheKey, textures.prefilteredCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)) {
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Loading pre-filtered environment cube from cache took " << tDiff << " ms" << std::endl;
+			return;
+		}
+
 		// FB, Att, RP, Pipe, etc.
 		VkAttachmentDescription attDesc = {};
 		// Color attachment
@@ -1059,12 +1107,6 @@ public:
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 
 		// Pipeline layout
-		struct PushBlock {
-			glm::mat4 mvp;
-			float roughness;
-			uint32_t numSamples = 32u;
-		} pushBlock;
-
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
 			vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),
@@ -1244,6 +1286,8 @@ public:
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+
+		iblCache.store("prefiltered", cacheKey, textures.prefilteredCube.image, format, dim, dim, numMips, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -1319,9 +1363,11 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		iblCache.create(vulkanDevice, queue, "iblcache");
 		generateBRDFLUT();
 		generateIrradianceCube();
 		generatePrefilteredCube();
+		std::cout << "IBL cache: " << iblCache.hits << " hits, " << iblCache.misses << " misses" << std::endl;
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
@@ -1353,6 +1399,10 @@ public:
 				buildCommandBuffers();
 			}
 		}
+		if (overlay->header("IBL cache")) {
+			overlay->text("Hits: %d", iblCache.hits);
+			overlay->text("Misses: %d", iblCache.misses);
+		}
 	}
 };
 
@@ -15,10 +15,20 @@
 
 	A further optimization could be done using a geometry shader to do a single-pass render for the depth map
 	cascades instead of multiple passes (geometry shaders are not supported on all target devices).
+
+	Cascades are not re-rendered every frame: The nearest cascade is updated every frame, the others only every
+	few frames (staggered so they don't all update in the same frame). Cascade projections are snapped to shadow
+	map texels, so they often don't change at all between updates. The depth of static casters is kept in a
+	separate layered image that is only re-rendered if a cascade's projection changed, and copied into the
+	shadow map before the dynamic casters are rendered on top of it. As every cascade's projection depends on
+	the light direction, the cache only pays off while the light is static, which is why the light is not
+	animated by default.
 */
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -40,6 +50,18 @@ public:
 
 	float cascadeSplitLambda = 0.95f;
 
+	// Number of frames between updates of all but the first cascade
+	int32_t cascadeUpdateInterval = 4;
+	// Keep the depth of static casters in a separate image and only re-render it when a cascade's projection changes
+	bool cacheStaticCasters = true;
+	// One of the trees is moving, so it needs to be rendered into the shadow map separately from the static casters
+	bool moveDynamicCaster = true;
+	// A moving light changes all cascade projections in every frame and invalidates the static caster cache
+	bool animateLight = false;
+	uint32_t frameIndex = 0;
+	// Forces all cascades to be updated in the next frame
+	bool cascadeUpdateRequired = true;
+
 	float zNear = 0.5f;
 	float zFar = 48.0f;
 
@@ -50,6 +72,26 @@ public:
 		vkglTF::Model tree;
 	} models;
 
+	struct SceneObject {
+		vkglTF::Model* model;
+		glm::vec3 position;
+		// Dynamic objects are never part of the cached static shadow caster depth
+		bool dynamic;
+	};
+	std::vector<SceneObject> sceneObjects;
+
+	enum CasterFilter { castersAll, castersStatic, castersDynamic };
+
+	struct Statistics {
+		uint32_t cascadesRendered = 0;
+		uint32_t staticCascadesRendered = 0;
+		uint32_t castersRendered = 0;
+		uint32_t castersCulled = 0;
+	} stats;
+
+	// Measures the GPU time of the shadow map passes
+	vks::TimestampQuery timestampQuery;
+
 	struct uniformBuffers {
 		vks::Buffer VS;
 		vks::Buffer FS;
@@ -92,6 +134,10 @@ public:
 	// Resources of the depth map generation pass
 	struct DepthPass {
 		VkRenderPass renderPass;
+		// Renders static casters into the cache
+		VkRenderPass renderPassStatic;
+		// Renders dynamic casters on top of the depth copied from the cache
+		VkRenderPass renderPassLoad;
 		VkPipelineLayout pipelineLayout;
 		VkPipeline pipeline;
 		vks::Buffer uniformBuffer;
@@ -115,19 +161,35 @@ public:
 			vkDestroySampler(device, sampler, nullptr);
 		}
 	} depth;
+	// Layered depth image containing the depth of the static casters for each cascade
+	DepthImage staticDepth;
+	VkFormat depthFormat;
 
 	// Contains all resources required for a single shadow map cascade
 	struct Cascade {
 		VkFramebuffer frameBuffer;
 		VkDescriptorSet descriptorSet;
 		VkImageView view;
+		// Static caster cache layer of this cascade
+		VkFramebuffer staticFrameBuffer;
+		VkImageView staticView;
 
-		float splitDepth;
-		glm::mat4 viewProjMatrix;
+		float splitDepth = 0.0f;
+		glm::mat4 viewProjMatrix = glm::mat4(0.0f);
+		// Side planes of the cascade's projection are used to cull casters
+		vks::Frustum frustum;
+
+		// Set for the current frame if the cascade's shadow map (and its static caster cache) need to be rendered
+		bool render = false;
+		bool renderStatic = false;
+		// True if the static caster cache matches the cascade's current projection
+		bool staticValid = false;
 
 		void destroy(VkDevice device) {
 			vkDestroyImageView(device, view, nullptr);
 			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+			vkDestroyImageView(device, staticView, nullptr);
+			vkDestroyFramebuffer(device, staticFrameBuffer, nullptr);
 		}
 	};
 	std::array<Cascade, SHADOW_MAP_CASCADE_COUNT> cascades;
@@ -150,8 +212,12 @@ public:
 			cascade.destroy(device);
 		}
 		depth.destroy(device);
+		staticDepth.destroy(device);
 
 		vkDestroyRenderPass(device, depthPass.renderPass, nullptr);
+		vkDestroyRenderPass(device, depthPass.renderPassStatic, nullptr);
+		vkDestroyRenderPass(device, depthPass.renderPassLoad, nullptr);
+		timestampQuery.destroy();
 
 		vkDestroyPipeline(device, pipelines.debugShadowMap, nullptr);
 		vkDestroyPipeline(device, depthPass.pipeline, nullptr);
@@ -178,56 +244,59 @@ public:
 	/*
 		Render the example scene with given command buffer, pipeline layout and descriptor set
 		Used by the scene rendering and depth pass generation command buffer
+		If a cascade frustum is passed, objects outside of it are culled
 	*/
-	void renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, uint32_t cascadeIndex = 0) {
+	void renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, uint32_t cascadeIndex = 0, CasterFilter filter = castersAll, vks::Frustum* cascadeFrustum = nullptr) {
 		// We use push constants for passing shadow cascade info to the shaders
 		PushConstBlock pushConstBlock = { glm::vec4(0.0f), cascadeIndex };
 
 		// Set 0 contains the vertex and fragment shader uniform buffers, set 1 for images will be set by the glTF model class at draw time
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-		// Floor
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
-		models.terrain.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
-
-		// Trees
-		const std::vector<glm::vec3> positions = {
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(1.25f, 0.25f, 1.25f),
-			glm::vec3(-1.25f, -0.2f, 1.25f),
-			glm::vec3(1.25f, 0.1f, -1.25f),
-			glm::vec3(-1.25f, -0.25f, -1.25f),
-		};
-
-		for (auto position : positions) {
-			pushConstBlock.position = glm::vec4(position, 0.0f);
+		for (auto& object : sceneObjects) {
+			if (((filter == castersStatic) && object.dynamic) || ((filter == castersDynamic) && !object.dynamic)) {
+				continue;
+			}
+			if (cascadeFrustum) {
+				if (!casterVisible(*cascadeFrustum, object.position + object.model->dimensions.center, object.model->dimensions.radius)) {
+					stats.castersCulled++;
+					continue;
+				}
+				stats.castersRendered++;
+			}
+			pushConstBlock.position = glm::vec4(object.position, 0.0f);
 			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-			models.tree.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
+			object.model->draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
 		}
 	}
 
 	/*
-		Setup resources used by the depth pass
-		The depth image is layered with each layer storing one shadow map cascade
+		Casters are only tested against the side planes of a cascade
+		Casters in front of the near plane are clamped to it (depth clamp), so they still need to be rendered
 	*/
-	void prepareDepthPass()
+	bool casterVisible(const vks::Frustum& frustum, glm::vec3 center, float radius)
 	{
-		VkFormat depthFormat = vulkanDevice->getSupportedDepthFormat(true);
-
-		/*
-			Depth map renderpass
-		*/
+		for (uint32_t i = vks::Frustum::LEFT; i <= vks::Frustum::BOTTOM; i++) {
+			if (glm::dot(glm::vec3(frustum.planes[i]), center) + frustum.planes[i].w <= -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
 
+	// Create a render pass for rendering into a single depth layer
+	VkRenderPass createDepthRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout)
+	{
 		VkAttachmentDescription attachmentDescription{};
 		attachmentDescription.format = depthFormat;
 		attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-		attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachmentDescription.loadOp = loadOp;
 		attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		attachmentDescription.initialLayout = initialLayout;
+		attachmentDescription.finalLayout = finalLayout;
 
 		VkAttachmentReference depthReference = {};
 		depthReference.attachment = 0;
@@ -239,22 +308,23 @@ public:
 		subpass.pDepthStencilAttachment = &depthReference;
 
 		// Use subpass dependencies for layout transitions
+		// The depth layers are read by fragment shaders (shadow lookup) and transfers (static caster cache copies)
 		std::array<VkSubpassDependency, 2> dependencies;
 
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
 		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		VkRenderPassCreateInfo renderPassCreateInfo = vks::initializers::renderPassCreateInfo();
@@ -265,12 +335,14 @@ public:
 		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassCreateInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &depthPass.renderPass));
-
-		/*
-			Layered depth image and views
-		*/
+		VkRenderPass renderPass;
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass));
+		return renderPass;
+	}
 
+	// Create a layered depth image with one layer per cascade
+	void createLayeredDepthImage(DepthImage& image, VkImageUsageFlags usage)
+	{
 		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageInfo.extent.width = SHADOWMAP_DIM;
@@ -281,15 +353,15 @@ public:
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageInfo.format = depthFormat;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &depth.image));
+		imageInfo.usage = usage;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &image.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, depth.image, &memReqs);
+		vkGetImageMemoryRequirements(device, image.image, &memReqs);
 		memAlloc.allocationSize = memReqs.size;
 		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, depth.image, depth.mem, 0));
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &image.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, image.image, image.mem, 0));
 		// Full depth map view (all layers)
 		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
@@ -300,33 +372,66 @@ public:
 		viewInfo.subresourceRange.levelCount = 1;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = SHADOW_MAP_CASCADE_COUNT;
-		viewInfo.image = depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &depth.view));
+		viewInfo.image = image.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &image.view));
+		image.sampler = VK_NULL_HANDLE;
+	}
+
+	// Create a view and a framebuffer for rendering to a single layer of a layered depth image
+	void createLayerFramebuffer(VkImage image, uint32_t layer, VkImageView& view, VkFramebuffer& frameBuffer)
+	{
+		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = depthFormat;
+		viewInfo.subresourceRange = {};
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = layer;
+		viewInfo.subresourceRange.layerCount = 1;
+		viewInfo.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &view));
+		// All depth render passes are compatible, so the framebuffer can be used with any of them
+		VkFramebufferCreateInfo framebufferInfo = vks::initializers::framebufferCreateInfo();
+		framebufferInfo.renderPass = depthPass.renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &view;
+		framebufferInfo.width = SHADOWMAP_DIM;
+		framebufferInfo.height = SHADOWMAP_DIM;
+		framebufferInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &frameBuffer));
+	}
+
+	/*
+		Setup resources used by the depth pass
+		The depth image is layered with each layer storing one shadow map cascade
+	*/
+	void prepareDepthPass()
+	{
+		depthFormat = vulkanDevice->getSupportedDepthFormat(true);
+
+		/*
+			Depth map renderpasses
+		*/
+
+		depthPass.renderPass = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		// The static caster cache is only ever copied from, so it's left in transfer source layout
+		depthPass.renderPassStatic = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		// Keeps the static caster depth copied into the layer
+		depthPass.renderPassLoad = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
-		// One image and framebuffer per cascade
+		/*
+			Layered depth images and views
+		*/
+
+		createLayeredDepthImage(depth, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		createLayeredDepthImage(staticDepth, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+		// One image and framebuffer per cascade (and per static caster cache layer)
+		// The image view is used to render to that specific depth image layer
 		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-			// Image view for this cascade's layer (inside the depth map)
-			// This view is used to render to that specific depth image layer
-			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-			viewInfo.format = depthFormat;
-			viewInfo.subresourceRange = {};
-			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			viewInfo.subresourceRange.baseMipLevel = 0;
-			viewInfo.subresourceRange.levelCount = 1;
-			viewInfo.subresourceRange.baseArrayLayer = i;
-			viewInfo.subresourceRange.layerCount = 1;
-			viewInfo.image = depth.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &cascades[i].view));
-			// Framebuffer
-			VkFramebufferCreateInfo framebufferInfo = vks::initializers::framebufferCreateInfo();
-			framebufferInfo.renderPass = depthPass.renderPass;
-			framebufferInfo.attachmentCount = 1;
-			framebufferInfo.pAttachments = &cascades[i].view;
-			framebufferInfo.width = SHADOWMAP_DIM;
-			framebufferInfo.height = SHADOWMAP_DIM;
-			framebufferInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cascades[i].frameBuffer));
+			createLayerFramebuffer(depth.image, i, cascades[i].view, cascades[i].frameBuffer);
+			createLayerFramebuffer(staticDepth.image, i, cascades[i].staticView, cascades[i].staticFrameBuffer);
 		}
 
 		// Shared sampler for cascade depth reads
@@ -344,104 +449,187 @@ public:
 		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &depth.sampler));
 	}
+	/*
+		Copy the cached static caster depth of a cascade into its shadow map layer
+		The layer is left in attachment layout, so the dynamic casters can be rendered on top of it
+	*/
+	void copyStaticCasterDepth(VkCommandBuffer commandBuffer, uint32_t cascadeIndex)
+	{
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+			subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = 1;
+		subresourceRange.baseArrayLayer = cascadeIndex;
+		subresourceRange.layerCount = 1;
+
+		// Previous contents of the layer are discarded
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+		imageMemoryBarrier.image = depth.image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+		VkImageCopy copyRegion = {};
+		copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		copyRegion.srcSubresource.baseArrayLayer = cascadeIndex;
+		copyRegion.srcSubresource.mipLevel = 0;
+		copyRegion.srcSubresource.layerCount = 1;
+		copyRegion.dstSubresource = copyRegion.srcSubresource;
+		copyRegion.extent.width = SHADOWMAP_DIM;
+		copyRegion.extent.height = SHADOWMAP_DIM;
+		copyRegion.extent.depth = 1;
+		vkCmdCopyImage(commandBuffer, staticDepth.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, depth.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
+
 	void buildCommandBuffers()
+	{
+		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
+			buildCommandBuffer(i);
+		}
+	}
+
+	/*
+		Command buffers are rebuilt every frame, as the cascades that need to be rendered change from frame to frame
+	*/
+	void buildCommandBuffer(int32_t i)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VkDeviceSize offsets[1] = { 0 };
+		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
+		if (timestampQuery.supported()) {
+			timestampQuery.reset(drawCmdBuffers[i]);
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+		}
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		/*
+			Generate depth map cascades
 
-			/*
-				Generate depth map cascades
+			Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
+			Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
 
-				Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
-				Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
-			*/
-			{
-				VkClearValue clearValues[1];
-				clearValues[0].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = depthPass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
-				renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// One pass per cascade
-				// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
-				for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
+			Only cascades scheduled for an update in this frame are rendered, all other layers keep their contents
+			With static caster caching enabled, the cached static caster depth is (re-)rendered if the cascade's projection
+			changed, copied into the shadow map layer and the dynamic casters are then rendered on top of it
+		*/
+		{
+			VkClearValue clearValues[1];
+			clearValues[0].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderArea.offset.x = 0;
+			renderPassBeginInfo.renderArea.offset.y = 0;
+			renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
+			renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			// One pass per cascade
+			// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
+			for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
+				if (!cascades[j].render) {
+					continue;
+				}
+				if (cacheStaticCasters) {
+					if (cascades[j].renderStatic) {
+						renderPassBeginInfo.renderPass = depthPass.renderPassStatic;
+						renderPassBeginInfo.framebuffer = cascades[j].staticFrameBuffer;
+						vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+						vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
+						renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j, castersStatic, &cascades[j].frustum);
+						vkCmdEndRenderPass(drawCmdBuffers[i]);
+					}
+					copyStaticCasterDepth(drawCmdBuffers[i], j);
+					renderPassBeginInfo.renderPass = depthPass.renderPassLoad;
 					renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
 					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
-					renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j);
+					renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j, castersDynamic, &cascades[j].frustum);
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+				} else {
+					renderPassBeginInfo.renderPass = depthPass.renderPass;
+					renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
+					renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j, castersAll, &cascades[j].frustum);
 					vkCmdEndRenderPass(drawCmdBuffers[i]);
 				}
 			}
+		}
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
+		if (timestampQuery.supported()) {
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+		}
 
-			/*
-				Scene rendering using depth cascades for shadow mapping
-			*/
+		/*
+			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+		*/
 
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// Visualize shadow map cascade
-				if (displayDepthMap) {
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
-					PushConstBlock pushConstBlock = {};
-					pushConstBlock.cascadeIndex = displayDepthMapCascadeIndex;
-					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
-					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-				}
+		/*
+			Scene rendering using depth cascades for shadow mapping
+		*/
+
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
+			clearValues[1].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[i];
+			renderPassBeginInfo.renderArea.offset.x = 0;
+			renderPassBeginInfo.renderArea.offset.y = 0;
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
 
-				// Render shadowed scene
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
-				renderScene(drawCmdBuffers[i], pipelineLayout, descriptorSet);
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				drawUI(drawCmdBuffers[i]);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			// Visualize shadow map cascade
+			if (displayDepthMap) {
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
+				PushConstBlock pushConstBlock = {};
+				pushConstBlock.cascadeIndex = displayDepthMapCascadeIndex;
+				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			// Render shadowed scene
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
+			renderScene(drawCmdBuffers[i], pipelineLayout, descriptorSet);
+
+			drawUI(drawCmdBuffers[i]);
+
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
 		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 
 	void loadAssets()
@@ -449,6 +637,16 @@ public:
 		uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY;
 		models.terrain.loadFromFile(getAssetPath() + "models/terrain_gridlines.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.tree.loadFromFile(getAssetPath() + "models/oaktree.gltf", vulkanDevice, queue, glTFLoadingFlags);
+
+		// The tree in the center is moved around, all other objects are static
+		sceneObjects = {
+			{ &models.terrain, glm::vec3(0.0f), false },
+			{ &models.tree, glm::vec3(0.0f), true },
+			{ &models.tree, glm::vec3(1.25f, 0.25f, 1.25f), false },
+			{ &models.tree, glm::vec3(-1.25f, -0.2f, 1.25f), false },
+			{ &models.tree, glm::vec3(1.25f, 0.1f, -1.25f), false },
+			{ &models.tree, glm::vec3(-1.25f, -0.25f, -1.25f), false },
+		};
 	}
 
 	void setupLayoutsAndDescriptors()
@@ -633,11 +831,18 @@ public:
 	/*
 		Calculate frustum split depths and matrices for the shadow map cascades
 		Based on https://johanmedestrom.wordpress.com/2016/03/18/opengl-cascaded-shadow-maps/
+
+		The first cascade is updated every frame, the others only every cascadeUpdateInterval frames
+		Updates are staggered, so that the far cascades are not all rendered in the same frame
+		A cascade due for an update is only re-rendered if its projection changed or dynamic casters moved
 	*/
-	void updateCascades()
+	void updateCascades(bool forceUpdate = false)
 	{
 		float cascadeSplits[SHADOW_MAP_CASCADE_COUNT];
 
+		frameIndex++;
+		const bool dynamicCastersMoved = moveDynamicCaster && !paused;
+
 		float nearClip = camera.getNearClip();
 		float farClip = camera.getFarClip();
 		float clipRange = farClip - nearClip;
@@ -663,6 +868,14 @@ public:
 		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
 			float splitDist = cascadeSplits[i];
 
+			cascades[i].render = false;
+			cascades[i].renderStatic = false;
+			const bool updateDue = forceUpdate || (i == 0) || ((frameIndex + i) % cascadeUpdateInterval == 0);
+			if (!updateDue) {
+				lastSplitDist = cascadeSplits[i];
+				continue;
+			}
+
 			glm::vec3 frustumCorners[8] = {
 				glm::vec3(-1.0f,  1.0f, -1.0f),
 				glm::vec3( 1.0f,  1.0f, -1.0f),
@@ -701,18 +914,44 @@ public:
 			}
 			radius = std::ceil(radius * 16.0f) / 16.0f;
 
-			glm::vec3 maxExtents = glm::vec3(radius);
-			glm::vec3 minExtents = -maxExtents;
-
+			/*
+				The light view only depends on the light direction, and the cascade's bounds are snapped to shadow map texels
+				in light space. This keeps shadow edges from shimmering when the camera moves, and the projection stays the
+				same as long as the frustum moves less than a texel, so the cached depth of the cascade remains valid.
+			*/
 			glm::vec3 lightDir = normalize(-lightPos);
-			glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * -minExtents.z, frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
-			glm::mat4 lightOrthoMatrix = glm::ortho(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, 0.0f, maxExtents.z - minExtents.z);
-
-			// Store split distance and matrix in cascade
-			cascades[i].splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
-			cascades[i].viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			glm::mat4 lightViewMatrix = glm::lookAt(glm::vec3(0.0f), lightDir, glm::vec3(0.0f, 1.0f, 0.0f));
+			float texelSize = (2.0f * radius) / static_cast<float>(SHADOWMAP_DIM);
+			glm::vec3 center = glm::vec3(lightViewMatrix * glm::vec4(frustumCenter, 1.0f));
+			center = glm::floor(center / texelSize) * texelSize;
+			glm::mat4 lightOrthoMatrix = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius, -center.z - radius, -center.z + radius);
+
+			glm::mat4 viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			float splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
+			const bool projectionChanged = (viewProjMatrix != cascades[i].viewProjMatrix) || (splitDepth != cascades[i].splitDepth);
+			// The static caster cache is only used (and kept up to date) while caching is enabled
+			if (projectionChanged) {
+				cascades[i].staticValid = false;
+			}
+			const bool renderStatic = cacheStaticCasters && !cascades[i].staticValid;
 
 			lastSplitDist = cascadeSplits[i];
+
+			// Nothing changed for this cascade, the depth stored in its shadow map layer is still valid
+			if (!projectionChanged && !renderStatic && !dynamicCastersMoved) {
+				continue;
+			}
+
+			// Store split distance and matrix in cascade
+			// These are only updated along with the cascade's shadow map, so the shadow lookups always match the depth stored in it
+			cascades[i].splitDepth = splitDepth;
+			cascades[i].viewProjMatrix = viewProjMatrix;
+			cascades[i].frustum.update(viewProjMatrix);
+			cascades[i].render = true;
+			cascades[i].renderStatic = renderStatic;
+			if (renderStatic) {
+				cascades[i].staticValid = true;
+			}
 		}
 	}
 
@@ -754,13 +993,40 @@ public:
 		memcpy(uniformBuffers.FS.mapped, &uboFS, sizeof(uboFS));
 	}
 
+	void updateDynamicCasters()
+	{
+		float angle = glm::radians(timer * 360.0f * 2.0f);
+		for (auto& object : sceneObjects) {
+			if (object.dynamic) {
+				object.position = glm::vec3(sin(angle) * 0.35f, 0.0f, cos(angle) * 0.35f);
+			}
+		}
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+
+		// Decide which cascades to render in this frame and record the command buffer accordingly
+		updateCascades(cascadeUpdateRequired);
+		cascadeUpdateRequired = false;
+		updateUniformBuffers();
+		stats.castersRendered = 0;
+		stats.castersCulled = 0;
+		buildCommandBuffer(currentBuffer);
+		stats.cascadesRendered = 0;
+		stats.staticCascadesRendered = 0;
+		for (auto& cascade : cascades) {
+			stats.cascadesRendered += cascade.render ? 1 : 0;
+			stats.staticCascadesRendered += (cascade.render && cascade.renderStatic) ? 1 : 0;
+		}
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
+
+		timestampQuery.fetch();
 	}
 
 	void prepare()
@@ -768,7 +1034,9 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		updateLight();
-		updateCascades();
+		updateDynamicCasters();
+		updateCascades(true);
+		timestampQuery.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 2);
 		prepareDepthPass();
 		prepareUniformBuffers();
 		setupLayoutsAndDescriptors();
@@ -781,20 +1049,32 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
-		if (!paused || camera.updated) {
-			updateLight();
-			updateCascades();
-			updateUniformBuffers();
+		if (!paused) {
+			if (animateLight) {
+				updateLight();
+			}
+			if (moveDynamicCaster) {
+				updateDynamicCasters();
+			}
 		}
+		draw();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			if (overlay->sliderFloat("Split lambda", &cascadeSplitLambda, 0.1f, 1.0f)) {
-				updateCascades();
-				updateUniformBuffers();
+				// All split depths change, so all cascades need to be rendered again
+				cascadeUpdateRequired = true;
+			}
+			overlay->sliderInt("Cascade update interval", &cascadeUpdateInterval, 1, 8);
+			if (overlay->checkBox("Cache static casters", &cacheStaticCasters)) {
+				cascadeUpdateRequired = true;
+			}
+			overlay->checkBox("Move dynamic caster", &moveDynamicCaster);
+			overlay->checkBox("Animate light", &animateLight);
+			if (animateLight && cacheStaticCasters) {
+				overlay->text("Caching only helps while the light is static");
 			}
 			if (overlay->checkBox("Color cascades", &colorCascades)) {
 				updateUniformBuffers();
@@ -811,6 +1091,15 @@ public:
 				buildCommandBuffers();
 			}
 		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Cascades rendered: %d", stats.cascadesRendered);
+			overlay->text("Static cache updates: %d", stats.staticCascadesRendered);
+			overlay->text("Casters rendered: %d", stats.castersRendered);
+			overlay->text("Casters culled: %d", stats.castersCulled);
+			if (timestampQuery.supported()) {
+				overlay->text("Shadow passes: %.3f ms", timestampQuery.duration(0, 1));
+			}
+		}
 	}
 };
 
@@ -6,8 +6,16 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+/*
+* If supported (VK_EXT_shader_viewport_index_layer), all six faces of the shadow cube map are rendered in a single
+* layered render pass directly into the cube map. Each scene primitive is culled against the frustums of the six faces
+* and drawn instanced once per face it's visible in, with the vertex shader selecting the target layer.
+* Otherwise the scene is rendered once per face into an offscreen framebuffer that's then copied to the cube map face.
+*/
+
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -23,6 +31,11 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool displayCubeMap = false;
+	// Render all cube map faces in a single pass (requires VK_EXT_shader_viewport_index_layer)
+	bool layeredRenderingSupported = false;
+	bool layeredRendering = true;
+	// Cull shadow casters against the frustum of each cube map face
+	bool faceCulling = true;
 
 	float zNear = 0.1f;
 	float zFar = 1024.0f;
@@ -51,11 +64,33 @@ public:
 		glm::vec4 lightPos;
 	};
 
-	UBO uboVSscene, uboOffscreenVS;
+	UBO uboVSscene;
+
+	struct UBOOffscreen {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 model;
+		glm::vec4 lightPos;
+		// Combined projection and view matrices of all cube map faces, used by the layered pass
+		glm::mat4 faceViewProjection[6];
+	} uboOffscreenVS;
+
+	// Scene primitives with world space bounding spheres for culling against the cube map face frustums
+	struct ShadowCaster {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		glm::vec3 center;
+		float radius;
+	};
+	std::vector<ShadowCaster> shadowCasters;
+	std::array<vks::Frustum, 6> faceFrustums;
+	// Number of face draws issued for the shadow cube map in the last frame
+	uint32_t faceDrawCount = 0;
 
 	struct {
 		VkPipeline scene;
 		VkPipeline offscreen;
+		VkPipeline offscreenLayered;
 		VkPipeline cubemapDisplay;
 	} pipelines;
 
@@ -88,6 +123,16 @@ public:
 		VkDescriptorImageInfo descriptor;
 	} offscreenPass;
 
+	// Single pass rendering to all cube map faces
+	struct LayeredPass {
+		VkFramebuffer frameBuffer;
+		// Layered depth attachment with one layer per cube map face
+		FrameBufferAttachment depth;
+		// Array view of the cube map used as the color attachment
+		VkImageView colorView;
+		VkRenderPass renderPass;
+	} layeredPass;
+
 	VkFormat fbDepthFormat;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -100,6 +145,23 @@ public:
 		timerSpeed *= 0.5f;
 	}
 
+	virtual void getEnabledFeatures()
+	{
+		// Writing the layer from the vertex shader allows rendering all cube map faces in a single pass
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			if (strcmp(extension.extensionName, VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME) == 0) {
+				layeredRenderingSupported = true;
+				enabledDeviceExtensions.push_back(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+				break;
+			}
+		}
+		layeredRendering = layeredRenderingSupported;
+	}
+
 	~VulkanExample()
 	{
 		// Clean up used Vulkan resources
@@ -127,6 +189,17 @@ public:
 
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
+		// Layered pass
+		if (layeredRenderingSupported) {
+			vkDestroyImageView(device, layeredPass.colorView, nullptr);
+			vkDestroyImageView(device, layeredPass.depth.view, nullptr);
+			vkDestroyImage(device, layeredPass.depth.image, nullptr);
+			vkFreeMemory(device, layeredPass.depth.mem, nullptr);
+			vkDestroyFramebuffer(device, layeredPass.frameBuffer, nullptr);
+			vkDestroyRenderPass(device, layeredPass.renderPass, nullptr);
+			vkDestroyPipeline(device, pipelines.offscreenLayered, nullptr);
+		}
+
 		// Pipelines
 		vkDestroyPipeline(device, pipelines.scene, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
@@ -159,7 +232,8 @@ public:
 		imageCreateInfo.arrayLayers = 6;
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// The layered pass renders directly into the cube map, the per-face passes copy to it
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
@@ -331,26 +405,9 @@ public:
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBuffer));
 	}
 
-	// Updates a single cube map face
-	// Renders the scene with face's view and does a copy from framebuffer to cube face
-	// Uses push constants for quick update of view matrix for the current cube map face
-	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	// Returns the view matrix for rendering the scene from the light into the given cube map face
+	glm::mat4 getCubeFaceViewMatrix(uint32_t faceIndex)
 	{
-		VkClearValue clearValues[2];
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		// Reuse render pass from example pass
-		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffer;
-		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
-		renderPassBeginInfo.clearValueCount = 2;
-		renderPassBeginInfo.pClearValues = clearValues;
-
-		// Update view matrix via push constant
-
 		glm::mat4 viewMatrix = glm::mat4(1.0f);
 		switch (faceIndex)
 		{
@@ -375,6 +432,194 @@ public:
 			viewMatrix = glm::rotate(viewMatrix, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 			break;
 		}
+		return viewMatrix;
+	}
+
+	// Prepare a render pass and framebuffer for rendering to all cube map faces in a single pass
+	// The vertex shader selects the cube map face (layer) to render to
+	void prepareLayeredPass()
+	{
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		// Color attachment is the cube map itself, so it ends up in shader read layout
+		attachments[0].format = FB_COLOR_FORMAT;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		// Depth attachment
+		attachments[1].format = fbDepthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+		subpass.pDepthStencilAttachment = &depthReference;
+
+		// Use subpass dependencies for layout transitions
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassCreateInfo = vks::initializers::renderPassCreateInfo();
+		renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCreateInfo.pAttachments = attachments.data();
+		renderPassCreateInfo.subpassCount = 1;
+		renderPassCreateInfo.pSubpasses = &subpass;
+		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCreateInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &layeredPass.renderPass));
+
+		// Layered depth attachment
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = fbDepthFormat;
+		imageCreateInfo.extent = { shadowCubeMap.width, shadowCubeMap.height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 6;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &layeredPass.depth.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, layeredPass.depth.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &layeredPass.depth.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, layeredPass.depth.image, layeredPass.depth.mem, 0));
+
+		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		view.format = fbDepthFormat;
+		view.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 6 };
+		if (fbDepthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+			view.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		view.image = layeredPass.depth.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &layeredPass.depth.view));
+
+		// The cube map view can't be used as an attachment, so we need an array view of all faces
+		view.format = FB_COLOR_FORMAT;
+		view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
+		view.image = shadowCubeMap.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &layeredPass.colorView));
+
+		VkImageView fbAttachments[2] = { layeredPass.colorView, layeredPass.depth.view };
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = layeredPass.renderPass;
+		fbufCreateInfo.attachmentCount = 2;
+		fbufCreateInfo.pAttachments = fbAttachments;
+		fbufCreateInfo.width = shadowCubeMap.width;
+		fbufCreateInfo.height = shadowCubeMap.height;
+		fbufCreateInfo.layers = 6;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &layeredPass.frameBuffer));
+	}
+
+	// Shadow casters are drawn individually, so the scene's buffers need to be bound manually
+	void bindSceneBuffers(VkCommandBuffer commandBuffer)
+	{
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &models.scene.vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, models.scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	// Returns true if the shadow caster is (partially) inside the frustum of the given cube map face
+	bool casterVisible(const ShadowCaster& caster, uint32_t faceIndex)
+	{
+		return !faceCulling || faceFrustums[faceIndex].checkSphere(caster.center, caster.radius);
+	}
+
+	// Renders all cube map faces in a single pass
+	// Each caster is drawn with one instance per face it's visible in, the face indices are passed via push constant
+	void updateCubeFacesLayered(VkCommandBuffer commandBuffer)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = layeredPass.renderPass;
+		renderPassBeginInfo.framebuffer = layeredPass.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = shadowCubeMap.width;
+		renderPassBeginInfo.renderArea.extent.height = shadowCubeMap.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenLayered);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
+		bindSceneBuffers(commandBuffer);
+
+		for (auto& caster : shadowCasters) {
+			// Three bits per face index
+			uint32_t faces = 0;
+			uint32_t faceCount = 0;
+			for (uint32_t face = 0; face < 6; face++) {
+				if (casterVisible(caster, face)) {
+					faces |= face << (faceCount * 3);
+					faceCount++;
+				}
+			}
+			if (faceCount == 0) {
+				continue;
+			}
+			vkCmdPushConstants(commandBuffer, pipelineLayouts.offscreen, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &faces);
+			vkCmdDrawIndexed(commandBuffer, caster.indexCount, faceCount, caster.firstIndex, 0, 0);
+			faceDrawCount += faceCount;
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	// Updates a single cube map face
+	// Renders the scene with face's view and does a copy from framebuffer to cube face
+	// Uses push constants for quick update of view matrix for the current cube map face
+	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		// Reuse render pass from example pass
+		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
+		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		// Update view matrix via push constant
+		glm::mat4 viewMatrix = getCubeFaceViewMatrix(faceIndex);
 
 		// Render scene from cube face's point of view
 		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -391,7 +636,13 @@ public:
 
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
-		models.scene.draw(commandBuffer);
+		bindSceneBuffers(commandBuffer);
+		for (auto& caster : shadowCasters) {
+			if (casterVisible(caster, faceIndex)) {
+				vkCmdDrawIndexed(commandBuffer, caster.indexCount, 1, caster.firstIndex, 0, 0);
+				faceDrawCount++;
+			}
+		}
 
 		vkCmdEndRenderPass(commandBuffer);
 		// Make sure color writes to the framebuffer are finished before using it as transfer source
@@ -465,79 +716,92 @@ public:
 
 	void buildCommandBuffers()
 	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			buildCommandBuffer(i);
+		}
+	}
 
-			/*
-				Generate shadow cube maps using one render pass per face
-			*/
-			{
-				VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+	/*
+		Command buffers are rebuilt every frame, as the shadow casters visible in each cube map face change with the light position
+	*/
+	void buildCommandBuffer(int32_t i)
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+		/*
+			Generate shadow cube maps using a single layered render pass, or one render pass per face
+		*/
+		{
+			VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
-				VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
+			faceDrawCount = 0;
+			if (layeredRendering) {
+				updateCubeFacesLayered(drawCmdBuffers[i]);
+			} else {
 				for (uint32_t face = 0; face < 6; face++) {
 					updateCubeFace(face, drawCmdBuffers[i]);
 				}
 			}
+		}
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
+		/*
+			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+		*/
 
-			/*
-				Scene rendering with applied shadow map
-			*/
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = defaultClearColor;
-				clearValues[1].depthStencil = { 1.0f, 0 };
+		/*
+			Scene rendering with applied shadow map
+		*/
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = defaultClearColor;
+			clearValues[1].depthStencil = { 1.0f, 0 };
 
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[i];
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
 
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				VkDeviceSize offsets[1] = { 0 };
+			VkDeviceSize offsets[1] = { 0 };
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
 
-				if (displayCubeMap)
-				{
-					// Display all six sides of the shadow cube map
-					// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
-					models.debugcube.draw(drawCmdBuffers[i]);
-				}
-				else
-				{
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
-					models.scene.draw(drawCmdBuffers[i]);
-				}
-
-				drawUI(drawCmdBuffers[i]);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			if (displayCubeMap)
+			{
+				// Display all six sides of the shadow cube map
+				// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
+				models.debugcube.draw(drawCmdBuffers[i]);
+			}
+			else
+			{
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
+				models.scene.draw(drawCmdBuffers[i]);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			drawUI(drawCmdBuffers[i]);
+
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
 		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 
 	void loadAssets()
@@ -545,6 +809,38 @@ public:
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.debugcube.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.scene.loadFromFile(getAssetPath() + "models/shadowscene_fire.gltf", vulkanDevice, queue, glTFLoadingFlags);
+
+		// Get world space bounds for all scene primitives to cull them against the cube map face frustums
+		// Primitive dimensions are stored in node space, while the vertices have been pre-transformed and flipped at load time
+		for (auto node : models.scene.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			const glm::mat4 nodeMatrix = node->getMatrix();
+			for (auto primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				glm::vec3 min = glm::vec3(FLT_MAX);
+				glm::vec3 max = glm::vec3(-FLT_MAX);
+				for (uint32_t corner = 0; corner < 8; corner++) {
+					glm::vec3 pos = glm::vec3(
+						(corner & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x,
+						(corner & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y,
+						(corner & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+					pos = glm::vec3(nodeMatrix * glm::vec4(pos, 1.0f));
+					pos.y *= -1.0f;
+					min = glm::min(min, pos);
+					max = glm::max(max, pos);
+				}
+				ShadowCaster caster;
+				caster.firstIndex = primitive->firstIndex;
+				caster.indexCount = primitive->indexCount;
+				caster.center = (min + max) * 0.5f;
+				caster.radius = glm::distance(min, max) * 0.5f;
+				shadowCasters.push_back(caster);
+			}
+		}
 	}
 
 	void setupDescriptorPool()
@@ -707,6 +1003,13 @@ public:
 		pipelineCI.renderPass = offscreenPass.renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
 
+		// Layered offscreen pipeline rendering to all cube map faces at once
+		if (layeredRenderingSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/offscreen_layered.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCI.renderPass = layeredPass.renderPass;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreenLayered));
+		}
+
 		// Cube map display pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -760,12 +1063,17 @@ public:
 		uboOffscreenVS.view = glm::mat4(1.0f);
 		uboOffscreenVS.model = glm::translate(glm::mat4(1.0f), glm::vec3(-lightPos.x, -lightPos.y, -lightPos.z));
 		uboOffscreenVS.lightPos = lightPos;
+		for (uint32_t face = 0; face < 6; face++) {
+			uboOffscreenVS.faceViewProjection[face] = uboOffscreenVS.projection * getCubeFaceViewMatrix(face);
+			faceFrustums[face].update(uboOffscreenVS.faceViewProjection[face] * uboOffscreenVS.model);
+		}
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		buildCommandBuffer(currentBuffer);
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -780,6 +1088,9 @@ public:
 		prepareCubeMap();
 		setupDescriptorSetLayout();
 		prepareOffscreenRenderpass();
+		if (layeredRenderingSupported) {
+			prepareLayeredPass();
+		}
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
@@ -806,6 +1117,15 @@ public:
 			if (overlay->checkBox("Display shadow cube render target", &displayCubeMap)) {
 				buildCommandBuffers();
 			}
+			if (layeredRenderingSupported) {
+				overlay->checkBox("Single pass cube map rendering", &layeredRendering);
+			}
+			overlay->checkBox("Per-face caster culling", &faceCulling);
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Shadow casters: %d", (int32_t)shadowCasters.size());
+			overlay->text("Face draws: %d / %d", faceDrawCount, (int32_t)shadowCasters.size() * 6);
+			overlay->text("Shadow passes: %d", layeredRendering ? 1 : 6);
 		}
 	}
 };
@@ -8,11 +8,14 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTimestampQuery.hpp"
 
 #define ENABLE_VALIDATION false
 
 #define SSAO_KERNEL_SIZE 32
 #define SSAO_RADIUS 0.3f
+// Number of frames the SSAO kernel is distributed across with temporal accumulation enabled
+#define SSAO_TEMPORAL_FRAMES 4
 
 #if defined(__ANDROID__)
 #define SSAO_NOISE_DIM 8
@@ -42,34 +45,65 @@ public:
 		int32_t ssao = true;
 		int32_t ssaoOnly = false;
 		int32_t ssaoBlur = true;
+		// Subset of the kernel sampled in the current frame (every kernelStride-th sample starting at kernelOffset)
+		int32_t kernelOffset = 0;
+		int32_t kernelStride = 1;
+		int32_t frameIndex = 0;
+		int32_t historyValid = false;
+		float _pad;
+		// Transforms a view space position of the current frame into the clip space of the previous frame
+		glm::mat4 reprojection;
 	} uboSSAOParams;
 
+	// SSAO can be generated at a lower resolution than the G-Buffer and is then upsampled in the composition pass
+	const std::vector<std::string> resolutionNames = { "Full", "Half", "Quarter" };
+#if defined(__ANDROID__)
+	int32_t resolutionIndex = 1;
+#else
+	int32_t resolutionIndex = 0;
+#endif
+	// Spreads the SSAO kernel across multiple frames and accumulates the results in a reprojected history
+	bool temporalAccumulation = false;
+	glm::mat4 previousView = glm::mat4(1.0f);
+
+	// Timestamps written between the passes to measure their GPU times
+	enum Timestamps { TS_START, TS_GBUFFER, TS_DOWNSAMPLE, TS_SSAO, TS_TEMPORAL, TS_BLUR, TS_COMPOSITION, TS_COUNT };
+	vks::TimestampQuery timestampQuery;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
+		VkPipeline downsample;
 		VkPipeline ssao;
+		VkPipeline ssaoTemporal;
 		VkPipeline ssaoBlur;
 	} pipelines;
 
 	struct {
 		VkPipelineLayout gBuffer;
+		VkPipelineLayout downsample;
 		VkPipelineLayout ssao;
+		VkPipelineLayout ssaoTemporal;
 		VkPipelineLayout ssaoBlur;
 		VkPipelineLayout composition;
 	} pipelineLayouts;
 
 	struct {
-		const uint32_t count = 5;
+		const uint32_t count = 7;
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
+		VkDescriptorSet downsample;
 		VkDescriptorSet ssao;
+		VkDescriptorSet ssaoTemporal;
 		VkDescriptorSet ssaoBlur;
 		VkDescriptorSet composition;
 	} descriptorSets;
 
 	struct {
 		VkDescriptorSetLayout gBuffer;
+		VkDescriptorSetLayout downsample;
 		VkDescriptorSetLayout ssao;
+		VkDescriptorSetLayout ssaoTemporal;
 		VkDescriptorSetLayout ssaoBlur;
 		VkDescriptorSetLayout composition;
 	} descriptorSetLayouts;
@@ -82,20 +116,24 @@ public:
 
 	// Framebuffer for offscreen rendering
 	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
 		VkFormat format;
 		void destroy(VkDevice device)
 		{
 			vkDestroyImage(device, image, nullptr);
 			vkDestroyImageView(device, view, nullptr);
 			vkFreeMemory(device, mem, nullptr);
+			image = VK_NULL_HANDLE;
+			view = VK_NULL_HANDLE;
+			mem = VK_NULL_HANDLE;
 		}
 	};
+	// Render passes are created once, frame buffers are recreated on resize and resolution changes
 	struct FrameBuffer {
 		int32_t width, height;
-		VkFramebuffer frameBuffer;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
 		VkRenderPass renderPass;
 		void setSize(int32_t w, int32_t h)
 		{
@@ -105,7 +143,7 @@ public:
 		void destroy(VkDevice device)
 		{
 			vkDestroyFramebuffer(device, frameBuffer, nullptr);
-			vkDestroyRenderPass(device, renderPass, nullptr);
+			frameBuffer = VK_NULL_HANDLE;
 		}
 	};
 
@@ -113,11 +151,18 @@ public:
 		struct Offscreen : public FrameBuffer {
 			FrameBufferAttachment position, normal, albedo, depth;
 		} offscreen;
+		// Downsampled position+depth and normals used as SSAO input at lower resolutions
+		struct SSAOInput : public FrameBuffer {
+			FrameBufferAttachment position, normal;
+		} ssaoInput;
 		struct SSAO : public FrameBuffer {
 			FrameBufferAttachment color;
-		} ssao, ssaoBlur;
+		} ssao, ssaoTemporal, ssaoBlur;
 	} frameBuffers;
 
+	// Temporally accumulated SSAO of the previous frame, copied from the temporal pass target
+	FrameBufferAttachment ssaoHistory;
+
 	// One sampler for the frame buffer color attachments
 	VkSampler colorSampler;
 
@@ -137,34 +182,39 @@ public:
 	{
 		vkDestroySampler(device, colorSampler, nullptr);
 
-		// Attachments
-		frameBuffers.offscreen.position.destroy(device);
-		frameBuffers.offscreen.normal.destroy(device);
-		frameBuffers.offscreen.albedo.destroy(device);
-		frameBuffers.offscreen.depth.destroy(device);
-		frameBuffers.ssao.color.destroy(device);
-		frameBuffers.ssaoBlur.color.destroy(device);
+		// Attachments and framebuffers
+		destroyOffscreenFramebuffers();
 
-		// Framebuffers
-		frameBuffers.offscreen.destroy(device);
-		frameBuffers.ssao.destroy(device);
-		frameBuffers.ssaoBlur.destroy(device);
+		// Render passes
+		vkDestroyRenderPass(device, frameBuffers.offscreen.renderPass, nullptr);
+		vkDestroyRenderPass(device, frameBuffers.ssaoInput.renderPass, nullptr);
+		vkDestroyRenderPass(device, frameBuffers.ssao.renderPass, nullptr);
+		vkDestroyRenderPass(device, frameBuffers.ssaoTemporal.renderPass, nullptr);
+		vkDestroyRenderPass(device, frameBuffers.ssaoBlur.renderPass, nullptr);
 
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
+		vkDestroyPipeline(device, pipelines.downsample, nullptr);
 		vkDestroyPipeline(device, pipelines.ssao, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoTemporal, nullptr);
 		vkDestroyPipeline(device, pipelines.ssaoBlur, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.downsample, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoTemporal, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.downsample, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoTemporal, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoBlur, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 
+		timestampQuery.destroy();
+
 		// Uniform buffers
 		uniformBuffers.sceneParams.destroy();
 		uniformBuffers.ssaoKernel.destroy();
@@ -181,28 +231,23 @@ public:
 	// Create a frame buffer attachment
 	void createAttachment(
 		VkFormat format,
-		VkImageUsageFlagBits usage,
+		VkImageUsageFlags usage,
 		FrameBufferAttachment *attachment,
 		uint32_t width,
 		uint32_t height)
 	{
 		VkImageAspectFlags aspectMask = 0;
-		VkImageLayout imageLayout;
 
 		attachment->format = format;
 
-		if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
-		{
-			aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		}
 		if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
 		{
 			aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-			imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		}
-
-		assert(aspectMask > 0);
+		else
+		{
+			aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		}
 
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 		image.imageType = VK_IMAGE_TYPE_2D;
@@ -239,39 +284,96 @@ public:
 		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
 	}
 
-	void prepareOffscreenFramebuffers()
+	// Divisor of the SSAO resolution relative to the G-Buffer resolution
+	uint32_t getSSAODivisor()
 	{
-		// Attachments
-#if defined(__ANDROID__)
-		const uint32_t ssaoWidth = width / 2;
-		const uint32_t ssaoHeight = height / 2;
-#else
-		const uint32_t ssaoWidth = width;
-		const uint32_t ssaoHeight = height;
-#endif
+		return 1u << resolutionIndex;
+	}
 
-		frameBuffers.offscreen.setSize(width, height);
-		frameBuffers.ssao.setSize(ssaoWidth, ssaoHeight);
-		frameBuffers.ssaoBlur.setSize(width, height);
+	// Render pass for fullscreen passes writing to one or more color attachments that are sampled afterwards
+	VkRenderPass createColorRenderPass(const std::vector<VkFormat>& formats)
+	{
+		std::vector<VkAttachmentDescription> attachmentDescriptions(formats.size());
+		std::vector<VkAttachmentReference> colorReferences(formats.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(formats.size()); i++)
+		{
+			attachmentDescriptions[i].format = formats[i];
+			attachmentDescriptions[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescriptions[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachmentDescriptions[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescriptions[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescriptions[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescriptions[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescriptions[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			colorReferences[i] = { i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		}
 
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.pAttachments = attachmentDescriptions.data();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = dependencies.data();
+		VkRenderPass renderPass;
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+		return renderPass;
+	}
+
+	void createFrameBuffer(FrameBuffer* frameBuffer, const std::vector<VkImageView>& attachments)
+	{
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = frameBuffer->renderPass;
+		fbufCreateInfo.pAttachments = attachments.data();
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbufCreateInfo.width = frameBuffer->width;
+		fbufCreateInfo.height = frameBuffer->height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffer->frameBuffer));
+	}
+
+	void prepareRenderPasses()
+	{
 		// Find a suitable depth format
 		VkFormat attDepthFormat;
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
 		assert(validDepthFormat);
 
-		// G-Buffer
-		createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.position, width, height);	// Position + Depth
-		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.normal, width, height);			// Normals
-		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.albedo, width, height);			// Albedo (color)
-		createAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.offscreen.depth, width, height);			// Depth
-
-		// SSAO
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight);				// Color
-
-		// SSAO blur
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height);					// Color
-
-		// Render passes
+		frameBuffers.offscreen.position.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		frameBuffers.offscreen.normal.format = VK_FORMAT_R8G8B8A8_UNORM;
+		frameBuffers.offscreen.albedo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		frameBuffers.offscreen.depth.format = attDepthFormat;
+		frameBuffers.ssaoInput.position.format = frameBuffers.offscreen.position.format;
+		frameBuffers.ssaoInput.normal.format = frameBuffers.offscreen.normal.format;
+		frameBuffers.ssao.color.format = VK_FORMAT_R8_UNORM;
+		// Accumulated occlusion + linear depth for rejecting the history
+		frameBuffers.ssaoTemporal.color.format = VK_FORMAT_R16G16_SFLOAT;
+		frameBuffers.ssaoBlur.color.format = VK_FORMAT_R8_UNORM;
+		ssaoHistory.format = frameBuffers.ssaoTemporal.color.format;
 
 		// G-Buffer creation
 		{
@@ -337,136 +439,16 @@ public:
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
 			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.offscreen.renderPass));
-
-			std::array<VkImageView, 4> attachments;
-			attachments[0] = frameBuffers.offscreen.position.view;
-			attachments[1] = frameBuffers.offscreen.normal.view;
-			attachments[2] = frameBuffers.offscreen.albedo.view;
-			attachments[3] = frameBuffers.offscreen.depth.view;
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.offscreen.renderPass;
-			fbufCreateInfo.pAttachments = attachments.data();
-			fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			fbufCreateInfo.width = frameBuffers.offscreen.width;
-			fbufCreateInfo.height = frameBuffers.offscreen.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.offscreen.frameBuffer));
 		}
 
+		// SSAO input downsampling
+		frameBuffers.ssaoInput.renderPass = createColorRenderPass({ frameBuffers.ssaoInput.position.format, frameBuffers.ssaoInput.normal.format });
 		// SSAO
-		{
-			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssao.color.format;
-			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = &colorReference;
-			subpass.colorAttachmentCount = 1;
-
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = &attachmentDescription;
-			renderPassInfo.attachmentCount = 1;
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssao.renderPass));
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.ssao.renderPass;
-			fbufCreateInfo.pAttachments = &frameBuffers.ssao.color.view;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.width = frameBuffers.ssao.width;
-			fbufCreateInfo.height = frameBuffers.ssao.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssao.frameBuffer));
-		}
-
+		frameBuffers.ssao.renderPass = createColorRenderPass({ frameBuffers.ssao.color.format });
+		// SSAO temporal accumulation
+		frameBuffers.ssaoTemporal.renderPass = createColorRenderPass({ frameBuffers.ssaoTemporal.color.format });
 		// SSAO Blur
-		{
-			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssaoBlur.color.format;
-			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = &colorReference;
-			subpass.colorAttachmentCount = 1;
-
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = &attachmentDescription;
-			renderPassInfo.attachmentCount = 1;
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoBlur.renderPass));
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-			fbufCreateInfo.pAttachments = &frameBuffers.ssaoBlur.color.view;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.width = frameBuffers.ssaoBlur.width;
-			fbufCreateInfo.height = frameBuffers.ssaoBlur.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssaoBlur.frameBuffer));
-		}
+		frameBuffers.ssaoBlur.renderPass = createColorRenderPass({ frameBuffers.ssaoBlur.color.format });
 
 		// Shared sampler used for all color attachments
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
@@ -484,6 +466,75 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
 	}
 
+	// (Re)create all size dependent attachments and frame buffers
+	void prepareOffscreenFramebuffers()
+	{
+		// All SSAO passes run at the selected SSAO resolution, the composition pass upsamples the result
+		const uint32_t divisor = getSSAODivisor();
+		const uint32_t ssaoWidth = std::max(width / divisor, 1u);
+		const uint32_t ssaoHeight = std::max(height / divisor, 1u);
+
+		frameBuffers.offscreen.setSize(width, height);
+		frameBuffers.ssaoInput.setSize(ssaoWidth, ssaoHeight);
+		frameBuffers.ssao.setSize(ssaoWidth, ssaoHeight);
+		frameBuffers.ssaoTemporal.setSize(ssaoWidth, ssaoHeight);
+		frameBuffers.ssaoBlur.setSize(ssaoWidth, ssaoHeight);
+
+		// G-Buffer
+		createAttachment(frameBuffers.offscreen.position.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.position, width, height);	// Position + Depth
+		createAttachment(frameBuffers.offscreen.normal.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.normal, width, height);		// Normals
+		createAttachment(frameBuffers.offscreen.albedo.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.albedo, width, height);		// Albedo (color)
+		createAttachment(frameBuffers.offscreen.depth.format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.offscreen.depth, width, height);	// Depth
+		createFrameBuffer(&frameBuffers.offscreen, { frameBuffers.offscreen.position.view, frameBuffers.offscreen.normal.view, frameBuffers.offscreen.albedo.view, frameBuffers.offscreen.depth.view });
+
+		// Downsampled SSAO input, at full resolution the G-Buffer is used directly
+		if (divisor > 1) {
+			createAttachment(frameBuffers.ssaoInput.position.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoInput.position, ssaoWidth, ssaoHeight);
+			createAttachment(frameBuffers.ssaoInput.normal.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoInput.normal, ssaoWidth, ssaoHeight);
+			createFrameBuffer(&frameBuffers.ssaoInput, { frameBuffers.ssaoInput.position.view, frameBuffers.ssaoInput.normal.view });
+		}
+
+		// SSAO
+		createAttachment(frameBuffers.ssao.color.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight);
+		createFrameBuffer(&frameBuffers.ssao, { frameBuffers.ssao.color.view });
+
+		// SSAO temporal accumulation, the result is copied to the history image for the next frame
+		createAttachment(frameBuffers.ssaoTemporal.color.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &frameBuffers.ssaoTemporal.color, ssaoWidth, ssaoHeight);
+		createFrameBuffer(&frameBuffers.ssaoTemporal, { frameBuffers.ssaoTemporal.color.view });
+		createAttachment(ssaoHistory.format, VK_IMAGE_USAGE_TRANSFER_DST_BIT, &ssaoHistory, ssaoWidth, ssaoHeight);
+
+		// SSAO blur
+		createAttachment(frameBuffers.ssaoBlur.color.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, ssaoWidth, ssaoHeight);
+		createFrameBuffer(&frameBuffers.ssaoBlur, { frameBuffers.ssaoBlur.color.view });
+
+		// The history is only ever sampled or copied to, so it's transitioned to the shader read layout once
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(layoutCmd, ssaoHistory.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
+		uboSSAOParams.historyValid = false;
+	}
+
+	void destroyOffscreenFramebuffers()
+	{
+		frameBuffers.offscreen.position.destroy(device);
+		frameBuffers.offscreen.normal.destroy(device);
+		frameBuffers.offscreen.albedo.destroy(device);
+		frameBuffers.offscreen.depth.destroy(device);
+		frameBuffers.ssaoInput.position.destroy(device);
+		frameBuffers.ssaoInput.normal.destroy(device);
+		frameBuffers.ssao.color.destroy(device);
+		frameBuffers.ssaoTemporal.color.destroy(device);
+		frameBuffers.ssaoBlur.color.destroy(device);
+		ssaoHistory.destroy(device);
+
+		frameBuffers.offscreen.destroy(device);
+		frameBuffers.ssaoInput.destroy(device);
+		frameBuffers.ssao.destroy(device);
+		frameBuffers.ssaoTemporal.destroy(device);
+		frameBuffers.ssaoBlur.destroy(device);
+	}
+
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
@@ -491,16 +542,49 @@ public:
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
 	}
 
+	// Record a fullscreen pass into the given frame buffer
+	void drawFullscreenPass(VkCommandBuffer commandBuffer, FrameBuffer& frameBuffer, uint32_t colorAttachmentCount, VkPipeline pipeline, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet)
+	{
+		std::vector<VkClearValue> clearValues(colorAttachmentCount);
+		for (auto& clearValue : clearValues) {
+			clearValue.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		}
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.framebuffer = frameBuffer.frameBuffer;
+		renderPassBeginInfo.renderPass = frameBuffer.renderPass;
+		renderPassBeginInfo.renderArea.extent.width = frameBuffer.width;
+		renderPassBeginInfo.renderArea.extent.height = frameBuffer.height;
+		renderPassBeginInfo.clearValueCount = colorAttachmentCount;
+		renderPassBeginInfo.pClearValues = clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)frameBuffer.width, (float)frameBuffer.height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(frameBuffer.width, frameBuffer.height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VkDeviceSize offsets[1] = { 0 };
+		const uint32_t divisor = getSSAODivisor();
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			timestampQuery.reset(drawCmdBuffers[i]);
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TS_START);
+
 			/*
 				Offscreen SSAO generation
 			*/
@@ -539,54 +623,70 @@ public:
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+				timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TS_GBUFFER);
+
 				/*
-					Second pass: SSAO generation
+					Second pass: Downsample positions and normals to the SSAO resolution
 				*/
 
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues.data();
+				if (divisor > 1) {
+					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.downsample, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &divisor);
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssaoInput, 2, pipelines.downsample, pipelineLayouts.downsample, descriptorSets.downsample);
+				}
 
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TS_DOWNSAMPLE);
 
-				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+				/*
+					Third pass: SSAO generation
+				*/
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssao, 1, pipelines.ssao, pipelineLayouts.ssao, descriptorSets.ssao);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TS_SSAO);
 
 				/*
-					Third pass: SSAO blur
+					Fourth pass: Temporal accumulation of the partial SSAO kernels
 				*/
 
-				renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				if (temporalAccumulation) {
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssaoTemporal, 1, pipelines.ssaoTemporal, pipelineLayouts.ssaoTemporal, descriptorSets.ssaoTemporal);
+
+					// Copy the accumulated result to the history for the next frame
+					VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoTemporal.color.image,
+						VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+						VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], ssaoHistory.image,
+						VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+						VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+
+					VkImageCopy copyRegion = {};
+					copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+					copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+					copyRegion.extent = { (uint32_t)frameBuffers.ssaoTemporal.width, (uint32_t)frameBuffers.ssaoTemporal.height, 1 };
+					vkCmdCopyImage(drawCmdBuffers[i], frameBuffers.ssaoTemporal.color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ssaoHistory.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoTemporal.color.image,
+						VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], ssaoHistory.image,
+						VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+				}
+
+				timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TS_TEMPORAL);
 
-				viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+				/*
+					Fifth pass: SSAO blur
+				*/
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssaoBlur, 1, pipelines.ssaoBlur, pipelineLayouts.ssaoBlur, descriptorSets.ssaoBlur);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TS_BLUR);
 			}
 
 			/*
@@ -628,6 +728,8 @@ public:
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			timestampQuery.write(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TS_COMPOSITION);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -636,7 +738,7 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes,  descriptorSets.count);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -649,7 +751,6 @@ public:
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo();
 		VkDescriptorSetAllocateInfo descriptorAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, nullptr, 1);
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-		std::vector<VkDescriptorImageInfo> imageDescriptors;
 
 		// G-Buffer creation (offscreen scene rendering)
 		setLayoutBindings = {
@@ -671,6 +772,24 @@ public:
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 		pipelineLayoutCreateInfo.setLayoutCount = 1;
 
+		// SSAO input downsampling
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Normals
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.downsample));
+		// Downsampling factor is passed as a push constant
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(uint32_t), 0);
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.downsample));
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.downsample));
+
 		// SSAO Generation
 		setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
@@ -685,18 +804,20 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssao));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssao;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssao));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),					// FS Position+Depth
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),					// FS Normals
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.ssaoNoise.descriptor),		// FS SSAO Noise
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoKernel.descriptor),		// FS SSAO Kernel UBO
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.ssaoParams.descriptor),		// FS SSAO Params UBO
+
+		// SSAO temporal accumulation
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS SSAO of the current frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS SSAO history
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),								// FS Params UBO
 		};
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoTemporal));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoTemporal));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoTemporal));
 
 		// SSAO Blur
 		setLayoutBindings = {
@@ -708,13 +829,6 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoBlur));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoBlur;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoBlur));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
-		};
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
 		// Composition
 		setLayoutBindings = {
@@ -724,6 +838,7 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),						// FS SSAO
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),						// FS SSAO blurred
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),								// FS Lights UBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),						// FS Position+Depth at SSAO resolution
 		};
 		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.composition));
@@ -731,12 +846,78 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.composition;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.composition));
+
+		updateDescriptorSets();
+	}
+
+	// Update the descriptors referencing frame buffer attachments, needs to be called after these have been recreated or the SSAO setup has changed
+	void updateDescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		std::vector<VkDescriptorImageInfo> imageDescriptors;
+
+		// At lower resolutions the SSAO passes read the downsampled G-Buffer
+		FrameBufferAttachment& ssaoPosition = (getSSAODivisor() > 1) ? frameBuffers.ssaoInput.position : frameBuffers.offscreen.position;
+		FrameBufferAttachment& ssaoNormal = (getSSAODivisor() > 1) ? frameBuffers.ssaoInput.normal : frameBuffers.offscreen.normal;
+		// With temporal accumulation, blur and composition use the accumulated SSAO
+		FrameBufferAttachment& ssaoResult = temporalAccumulation ? frameBuffers.ssaoTemporal.color : frameBuffers.ssao.color;
+
+		// SSAO input downsampling
 		imageDescriptors = {
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS Normals
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO Generation
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, ssaoPosition.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, ssaoNormal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),					// FS Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),					// FS Normals
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.ssaoNoise.descriptor),		// FS SSAO Noise
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoKernel.descriptor),		// FS SSAO Kernel UBO
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.ssaoParams.descriptor),		// FS SSAO Params UBO
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO temporal accumulation
+		imageDescriptors = {
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, ssaoHistory.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, ssaoPosition.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),		// FS SSAO of the current frame
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),		// FS SSAO history
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[2]),		// FS Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO Blur
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, ssaoResult.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Composition
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, ssaoResult.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoBlur.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, ssaoPosition.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 		};
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Sampler Position+Depth
@@ -745,6 +926,7 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &imageDescriptors[3]),			// FS Sampler SSAO
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &imageDescriptors[4]),			// FS Sampler SSAO blurred
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &imageDescriptors[5]),			// FS Sampler Position+Depth at SSAO resolution
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
@@ -802,6 +984,19 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssao));
 		}
 
+		// SSAO temporal accumulation pipeline
+		{
+			pipelineCreateInfo.renderPass = frameBuffers.ssaoTemporal.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoTemporal;
+			// Number of frames the kernel is distributed across determines the history weight
+			int32_t temporalFrames = SSAO_TEMPORAL_FRAMES;
+			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(int32_t));
+			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(temporalFrames), &temporalFrames);
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/temporal.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1].pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoTemporal));
+		}
+
 		// SSAO blur pipeline
 		{
 			pipelineCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
@@ -810,6 +1005,20 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoBlur));
 		}
 
+		// SSAO input downsampling pipeline (writes position+depth and normals)
+		{
+			pipelineCreateInfo.renderPass = frameBuffers.ssaoInput.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.downsample;
+			std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates = {
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
+			};
+			colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+			colorBlendState.pAttachments = blendAttachmentStates.data();
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/downsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.downsample));
+		}
+
 		// Fill G-Buffer pipeline
 		{
 			// Vertex input state from glTF model loader
@@ -907,6 +1116,18 @@ public:
 	void updateUniformBufferSSAOParams()
 	{
 		uboSSAOParams.projection = camera.matrices.perspective;
+		if (temporalAccumulation) {
+			// Each frame samples a different subset of the kernel with a different noise rotation
+			uboSSAOParams.frameIndex++;
+			uboSSAOParams.kernelOffset = uboSSAOParams.frameIndex % SSAO_TEMPORAL_FRAMES;
+			uboSSAOParams.kernelStride = SSAO_TEMPORAL_FRAMES;
+			uboSSAOParams.reprojection = camera.matrices.perspective * previousView * glm::inverse(camera.matrices.view);
+			previousView = camera.matrices.view;
+		} else {
+			uboSSAOParams.frameIndex = 0;
+			uboSSAOParams.kernelOffset = 0;
+			uboSSAOParams.kernelStride = 1;
+		}
 
 		VK_CHECK_RESULT(uniformBuffers.ssaoParams.map());
 		uniformBuffers.ssaoParams.copyTo(&uboSSAOParams, sizeof(uboSSAOParams));
@@ -926,23 +1147,51 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		prepareRenderPasses();
 		prepareOffscreenFramebuffers();
 		prepareUniformBuffers();
 		setupDescriptorPool();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
+		timestampQuery.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, TS_COUNT);
 		buildCommandBuffers();
 		prepared = true;
 	}
 
+	// Recreate all SSAO attachments, e.g. after the window or the SSAO resolution changed
+	void recreateOffscreenFramebuffers()
+	{
+		vkDeviceWaitIdle(device);
+		destroyOffscreenFramebuffers();
+		prepareOffscreenFramebuffers();
+		updateDescriptorSets();
+		updateUniformBufferSSAOParams();
+		buildCommandBuffers();
+	}
+
+	virtual void windowResized()
+	{
+		if (prepared) {
+			recreateOffscreenFramebuffers();
+		}
+	}
+
 	virtual void render()
 	{
 		if (!prepared) {
 			return;
 		}
 		draw();
+		timestampQuery.fetch();
 		if (camera.updated) {
 			updateUniformBufferMatrices();
+		}
+		if (temporalAccumulation) {
+			// The history written by the frame that has just been submitted is valid for the next one
+			uboSSAOParams.historyValid = true;
+		}
+		// The kernel subset and reprojection change every frame with temporal accumulation
+		if (camera.updated || temporalAccumulation) {
 			updateUniformBufferSSAOParams();
 		}
 	}
@@ -959,6 +1208,25 @@ public:
 			if (overlay->checkBox("SSAO pass only", &uboSSAOParams.ssaoOnly)) {
 				updateUniformBufferSSAOParams();
 			}
+			if (overlay->comboBox("Resolution", &resolutionIndex, resolutionNames)) {
+				recreateOffscreenFramebuffers();
+			}
+			if (overlay->checkBox("Temporal accumulation", &temporalAccumulation)) {
+				vkDeviceWaitIdle(device);
+				uboSSAOParams.historyValid = false;
+				updateDescriptorSets();
+				updateUniformBufferSSAOParams();
+				buildCommandBuffers();
+			}
+		}
+		if (timestampQuery.supported() && overlay->header("GPU timings")) {
+			overlay->text("G-Buffer: %.3f ms", timestampQuery.duration(TS_START, TS_GBUFFER));
+			overlay->text("Downsample: %.3f ms", timestampQuery.duration(TS_GBUFFER, TS_DOWNSAMPLE));
+			overlay->text("SSAO: %.3f ms", timestampQuery.duration(TS_DOWNSAMPLE, TS_SSAO));
+			overlay->text("Temporal: %.3f ms", timestampQuery.duration(TS_SSAO, TS_TEMPORAL));
+			overlay->text("Blur: %.3f ms", timestampQuery.duration(TS_TEMPORAL, TS_BLUR));
+			overlay->text("Composition: %.3f ms", timestampQuery.duration(TS_BLUR, TS_COMPOSITION));
+			overlay->text("Total: %.3f ms", timestampQuery.duration(TS_START, TS_COMPOSITION));
 		}
 	}
 };
@@ -9,6 +9,7 @@
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "frustum.hpp"
+#include "VulkanChunkedTerrain.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -19,6 +20,12 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool wireframe = false;
 	bool tessellation = true;
+	// Render the tiled terrain with CPU selected detail levels instead of the tessellated patch
+	bool chunked = false;
+
+	// Height data and tiles for the chunked terrain, which extends beyond the height map by mirroring it
+	vks::HeightMap* chunkedHeightMap = nullptr;
+	vks::ChunkedTerrain chunkedTerrain;
 
 	// Holds the buffers for rendering the tessellated terrain
 	struct {
@@ -70,6 +77,8 @@ public:
 		VkPipeline terrain;
 		VkPipeline wireframe = VK_NULL_HANDLE;
 		VkPipeline skysphere;
+		VkPipeline chunkedTerrain = VK_NULL_HANDLE;
+		VkPipeline chunkedWireframe = VK_NULL_HANDLE;
 	} pipelines;
 
 	struct {
@@ -117,6 +126,12 @@ public:
 			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 		}
 		vkDestroyPipeline(device, pipelines.skysphere, nullptr);
+		if (pipelines.chunkedTerrain != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.chunkedTerrain, nullptr);
+		}
+		if (pipelines.chunkedWireframe != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.chunkedWireframe, nullptr);
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.skysphere, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.terrain, nullptr);
@@ -136,6 +151,9 @@ public:
 		vkDestroyBuffer(device, terrain.indices.buffer, nullptr);
 		vkFreeMemory(device, terrain.indices.memory, nullptr);
 
+		chunkedTerrain.destroy();
+		delete chunkedHeightMap;
+
 		if (queryPool != VK_NULL_HANDLE) {
 			vkDestroyQueryPool(device, queryPool, nullptr);
 			vkDestroyBuffer(device, queryResult.buffer, nullptr);
@@ -277,6 +295,14 @@ public:
 	}
 
 	void buildCommandBuffers()
+	{
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			buildCommandBuffer(i);
+		}
+	}
+
+	void buildCommandBuffer(int32_t i)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -293,55 +319,58 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		renderPassBeginInfo.framebuffer = frameBuffers[i];
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
-			}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+		}
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
+		vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
 
-			VkDeviceSize offsets[1] = { 0 };
+		VkDeviceSize offsets[1] = { 0 };
 
-			// Skysphere
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
-			models.skysphere.draw(drawCmdBuffers[i]);
+		// Skysphere
+		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
+		models.skysphere.draw(drawCmdBuffers[i]);
 
-			// Tessellated terrain
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// Begin pipeline statistics query
-				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
-			}
-			// Render
+		// Terrain
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Begin pipeline statistics query
+			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
+		}
+		// Render
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
+		if (chunked) {
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.chunkedWireframe : pipelines.chunkedTerrain);
+			chunkedTerrain.draw(drawCmdBuffers[i]);
+		}
+		else {
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 			vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// End pipeline statistics query
-				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
-			}
+		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// End pipeline statistics query
+			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+		}
 
-			drawUI(drawCmdBuffers[i]);
+		drawUI(drawCmdBuffers[i]);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(drawCmdBuffers[i]);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 
 	// Encapsulate height map data for easy sampling
@@ -547,6 +576,31 @@ public:
 		delete[] indices;
 	}
 
+	// Prepare the chunked terrain on first use, its tiles are generated on worker threads once the camera position is known
+	// Note: The height map itself is fully loaded up front, only the tile geometry is generated and evicted around the camera
+	void prepareChunkedTerrain()
+	{
+		if (chunkedHeightMap) {
+			return;
+		}
+		chunkedHeightMap = new vks::HeightMap(vulkanDevice, queue);
+#if defined(__ANDROID__)
+		chunkedHeightMap->loadHeightData(getAssetPath() + "textures/terrain_heightmap_r16.ktx", androidApp->activity->assetManager);
+#else
+		chunkedHeightMap->loadHeightData(getAssetPath() + "textures/terrain_heightmap_r16.ktx");
+#endif
+		// Same displacement as the tessellated terrain
+		chunkedHeightMap->heightScale = uboTess.displacementFactor;
+
+		// The height map covers the same area as the tessellated patch (PATCH_SIZE quads of two units, centered at the origin)
+		vks::ChunkedTerrain::Settings settings;
+		settings.heightMapSize = 128.0f;
+		settings.heightMapOrigin = glm::vec2(-64.0f);
+		chunkedTerrain.create(vulkanDevice, queue, chunkedHeightMap, settings);
+
+		prepareChunkedPipelines();
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
@@ -573,10 +627,10 @@ public:
 		// Terrain
 		setLayoutBindings =
 		{
-			// Binding 0 : Shared Tessellation shader ubo
+			// Binding 0 : Shared Tessellation shader ubo (also used by the vertex shader of the chunked terrain)
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
 				0),
 			// Binding 1 : Height map
 			vks::initializers::descriptorSetLayoutBinding(
@@ -727,6 +781,50 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skysphere));
 	}
 
+	// Tiles are already displaced triangle lists, so the chunked terrain pipelines have no tessellation stages
+	void prepareChunkedPipelines()
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(vks::HeightMap::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+		};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::HeightMap::Vertex, pos)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::HeightMap::Vertex, normal)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(vks::HeightMap::Vertex, uv)),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo(vertexInputBindings, vertexInputAttributes);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+		shaderStages[0] = loadShader(getShadersPath() + "terraintessellation/terrain_chunked.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "terraintessellation/terrain.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.terrain, renderPass);
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.chunkedTerrain));
+
+		if (deviceFeatures.fillModeNonSolid) {
+			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.chunkedWireframe));
+		}
+	}
+
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
@@ -786,6 +884,12 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (chunked) {
+			// Tiles are generated and evicted as the camera moves, so the command buffer is recorded every frame
+			chunkedTerrain.update(glm::vec3(glm::inverse(camera.matrices.view)[3]), frustum);
+			buildCommandBuffer(currentBuffer);
+		}
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -832,11 +936,22 @@ public:
 	{
 		if (overlay->header("Settings")) {
 
-			if (overlay->checkBox("Tessellation", &tessellation)) {
-				updateUniformBuffers();
+			if (overlay->checkBox("Chunked LOD terrain", &chunked)) {
+				if (chunked) {
+					prepareChunkedTerrain();
+				}
+				buildCommandBuffers();
 			}
-			if (overlay->inputFloat("Factor", &uboTess.tessellationFactor, 0.05f, 2)) {
-				updateUniformBuffers();
+			if (chunked) {
+				overlay->sliderFloat("LOD distance", &chunkedTerrain.settings.lodDistance, 8.0f, 128.0f);
+			}
+			else {
+				if (overlay->checkBox("Tessellation", &tessellation)) {
+					updateUniformBuffers();
+				}
+				if (overlay->inputFloat("Factor", &uboTess.tessellationFactor, 0.05f, 2)) {
+					updateUniformBuffers();
+				}
 			}
 			if (deviceFeatures.fillModeNonSolid) {
 				if (overlay->checkBox("Wireframe", &wireframe)) {
@@ -850,6 +965,14 @@ public:
 				overlay->text("TE invocations: %d", pipelineStats[1]);
 			}
 		}
+		if (chunked) {
+			if (overlay->header("Chunked terrain")) {
+				overlay->text("Resident tiles: %d", chunkedTerrain.stats.residentTiles);
+				overlay->text("Pending tiles: %d", chunkedTerrain.stats.pendingTiles);
+				overlay->text("Visible tiles: %d", chunkedTerrain.stats.visibleTiles);
+				overlay->text("Triangles: %d", chunkedTerrain.stats.triangles);
+			}
+		}
 	}
 };
 
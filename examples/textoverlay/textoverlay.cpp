@@ -14,7 +14,7 @@
 
 #define ENABLE_VALIDATION false
 
-// Max. number of chars the text overlay buffer can hold
+// Max. number of chars the text overlay buffer can hold per frame
 #define TEXTOVERLAY_MAX_CHAR_COUNT 2048
 
 /*
@@ -35,8 +35,6 @@ private:
 	VkSampler sampler;
 	VkImage image;
 	VkImageView view;
-	VkBuffer buffer;
-	VkDeviceMemory memory;
 	VkDeviceMemory imageMemory;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -49,11 +47,37 @@ private:
 	std::vector<VkFramebuffer*> frameBuffers;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
-	// Pointer to mapped vertex buffer
-	glm::vec4 *mapped = nullptr;
+	// Each glyph is drawn as an instanced quad, with the corners generated in the vertex shader (see text.vert)
+	struct GlyphInstance {
+		glm::vec4 rect;								// Corners of the quad in normalized device coordinates
+		glm::vec4 uv;								// Corners of the glyph in the font texture
+	};
+
+	// A single call to addText, the glyphs are kept for reuse if the same text is added again in the next update
+	struct TextRun {
+		std::string text;
+		float x, y;
+		uint32_t align;
+		std::vector<GlyphInstance> glyphs;
+	};
+
+	// Persistently mapped ring of glyph instances with one region of TEXTOVERLAY_MAX_CHAR_COUNT glyphs per frame
+	vks::Buffer glyphBuffer;
+	// One indirect draw command per frame, so the glyph count can change without recording the command buffers again
+	vks::Buffer indirectBuffer;
+
+	std::vector<TextRun> textRuns;
+	uint32_t textRunCount = 0;
+	uint32_t textRunWidth = 0;
+	uint32_t textRunHeight = 0;
+	bool textChanged = false;
+	// Glyphs of the last complete text update
+	std::vector<GlyphInstance> glyphs;
+	// Each text update that changes the glyphs gets a new version, frames only copy the glyphs if their region is outdated
+	uint32_t textVersion = 1;
+	std::vector<uint32_t> frameTextVersions;
 
 	stb_fontchar stbFontData[STB_FONT_consolas_24_latin1_NUM_CHARS];
-	uint32_t numLetters;
 public:
 
 	enum TextAlign { alignLeft, alignCenter, alignRight };
@@ -89,9 +113,11 @@ public:
 		this->frameBufferHeight = framebufferheight;
 
 		cmdBuffers.resize(framebuffers.size());
+		frameTextVersions.resize(framebuffers.size(), 0);
 		prepareResources();
 		prepareRenderPass();
 		preparePipeline();
+		updateCommandBuffers();
 	}
 
 	~TextOverlay()
@@ -100,8 +126,8 @@ public:
 		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
 		vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, memory, nullptr);
+		glyphBuffer.destroy();
+		indirectBuffer.destroy();
 		vkFreeMemory(vulkanDevice->logicalDevice, imageMemory, nullptr);
 		vkDestroyDescriptorSetLayout(vulkanDevice->logicalDevice, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, nullptr);
@@ -139,22 +165,27 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
 
-		// Vertex buffer
-		VkDeviceSize bufferSize = TEXTOVERLAY_MAX_CHAR_COUNT * sizeof(glm::vec4);
+		// Instance buffer with a region of glyphs for each frame
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&glyphBuffer,
+			cmdBuffers.size() * TEXTOVERLAY_MAX_CHAR_COUNT * sizeof(GlyphInstance)));
+		VK_CHECK_RESULT(glyphBuffer.map());
 
-		VkBufferCreateInfo bufferInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, bufferSize);
-		VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferInfo, nullptr, &buffer));
+		// Indirect draw commands, starting without any glyphs
+		std::vector<VkDrawIndirectCommand> drawCommands(cmdBuffers.size(), { 4, 0, 0, 0 });
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&indirectBuffer,
+			drawCommands.size() * sizeof(VkDrawIndirectCommand),
+			drawCommands.data()));
+		VK_CHECK_RESULT(indirectBuffer.map());
 
 		VkMemoryRequirements memReqs;
 		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
 
-		vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, buffer, &memReqs);
-		allocInfo.allocationSize = memReqs.size;
-		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, buffer, memory, 0));
-
 		// Font texture
 		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -365,13 +396,13 @@ public:
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 
-		std::array<VkVertexInputBindingDescription, 2> vertexInputBindings = {
-			vks::initializers::vertexInputBindingDescription(0, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
-			vks::initializers::vertexInputBindingDescription(1, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
+		// Glyph quads are instanced, there is no per-vertex data
+		std::array<VkVertexInputBindingDescription, 1> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE),
 		};
 		std::array<VkVertexInputAttributeDescription, 2> vertexInputAttributes = {
-			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, 0),					// Location 0: Position
-			vks::initializers::vertexInputAttributeDescription(1, 1, VK_FORMAT_R32G32_SFLOAT, sizeof(glm::vec2)),	// Location 1: UV
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, rect)),	// Location 0: Quad corners
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, uv)),	// Location 1: Texture coordinate corners
 		};
 
 		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -475,38 +506,42 @@ public:
 		VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
 	}
 
-	// Map buffer
+	// Start a new text update
+	// Text runs generated for the current frame buffer size can be reused, so they are only discarded if the size changed
 	void beginTextUpdate()
 	{
-		VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, (void **)&mapped));
-		numLetters = 0;
+		if ((textRunWidth != *frameBufferWidth) || (textRunHeight != *frameBufferHeight))
+		{
+			textRuns.clear();
+			textRunWidth = *frameBufferWidth;
+			textRunHeight = *frameBufferHeight;
+		}
+		textRunCount = 0;
+		textChanged = false;
 	}
 
-	// Add text to the current buffer
-	// todo : drop shadow? color attribute?
-	void addText(std::string text, float x, float y, TextAlign align)
+	// Generate a uv mapped quad per char of the text
+	void generateGlyphs(TextRun &textRun)
 	{
 		const uint32_t firstChar = STB_FONT_consolas_24_latin1_FIRST_CHAR;
 
-		assert(mapped != nullptr);
-
 		const float charW = 1.5f / *frameBufferWidth;
 		const float charH = 1.5f / *frameBufferHeight;
 
 		float fbW = (float)*frameBufferWidth;
 		float fbH = (float)*frameBufferHeight;
-		x = (x / fbW * 2.0f) - 1.0f;
-		y = (y / fbH * 2.0f) - 1.0f;
+		float x = (textRun.x / fbW * 2.0f) - 1.0f;
+		float y = (textRun.y / fbH * 2.0f) - 1.0f;
 
 		// Calculate text width
 		float textWidth = 0;
-		for (auto letter : text)
+		for (auto letter : textRun.text)
 		{
 			stb_fontchar *charData = &stbFontData[(uint32_t)letter - firstChar];
 			textWidth += charData->advance * charW;
 		}
 
-		switch (align)
+		switch (textRun.align)
 		{
 			case alignRight:
 				x -= textWidth;
@@ -516,50 +551,92 @@ public:
 				break;
 		}
 
-		// Generate a uv mapped quad per char in the new text
-		for (auto letter : text)
+		textRun.glyphs.resize(textRun.text.size());
+		for (size_t i = 0; i < textRun.text.size(); i++)
 		{
-			stb_fontchar *charData = &stbFontData[(uint32_t)letter - firstChar];
+			stb_fontchar *charData = &stbFontData[(uint32_t)textRun.text[i] - firstChar];
 
-			mapped->x = (x + (float)charData->x0 * charW);
-			mapped->y = (y + (float)charData->y0 * charH);
-			mapped->z = charData->s0;
-			mapped->w = charData->t0;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x1 * charW);
-			mapped->y = (y + (float)charData->y0 * charH);
-			mapped->z = charData->s1;
-			mapped->w = charData->t0;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x0 * charW);
-			mapped->y = (y + (float)charData->y1 * charH);
-			mapped->z = charData->s0;
-			mapped->w = charData->t1;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x1 * charW);
-			mapped->y = (y + (float)charData->y1 * charH);
-			mapped->z = charData->s1;
-			mapped->w = charData->t1;
-			mapped++;
+			GlyphInstance &glyph = textRun.glyphs[i];
+			glyph.rect = glm::vec4(x + (float)charData->x0 * charW, y + (float)charData->y0 * charH, x + (float)charData->x1 * charW, y + (float)charData->y1 * charH);
+			glyph.uv = glm::vec4(charData->s0, charData->t0, charData->s1, charData->t1);
 
 			x += charData->advance * charW;
+		}
+	}
 
-			numLetters++;
+	// Add text to the current update
+	// todo : drop shadow? color attribute?
+	void addText(std::string text, float x, float y, TextAlign align)
+	{
+		// Text runs are matched by the order they are added in, unchanged runs keep their glyphs
+		if (textRunCount < textRuns.size())
+		{
+			TextRun &textRun = textRuns[textRunCount];
+			if ((textRun.text == text) && (textRun.x == x) && (textRun.y == y) && (textRun.align == align))
+			{
+				textRunCount++;
+				return;
+			}
+		}
+		else
+		{
+			textRuns.resize(textRunCount + 1);
 		}
+
+		TextRun &textRun = textRuns[textRunCount];
+		textRun.text = text;
+		textRun.x = x;
+		textRun.y = y;
+		textRun.align = align;
+		generateGlyphs(textRun);
+		textRunCount++;
+		textChanged = true;
 	}
 
-	// Unmap buffer and update command buffers
+	// Finish the text update, the glyphs are copied to the frames once they are drawn (see updateFrame)
 	void endTextUpdate()
 	{
-		vkUnmapMemory(vulkanDevice->logicalDevice, memory);
-		mapped = nullptr;
-		updateCommandBuffers();
+		if (textRunCount != textRuns.size())
+		{
+			textRuns.resize(textRunCount);
+			textChanged = true;
+		}
+		if (!textChanged)
+		{
+			return;
+		}
+
+		glyphs.clear();
+		for (auto &textRun : textRuns)
+		{
+			glyphs.insert(glyphs.end(), textRun.glyphs.begin(), textRun.glyphs.end());
+		}
+		if (glyphs.size() > TEXTOVERLAY_MAX_CHAR_COUNT)
+		{
+			glyphs.resize(TEXTOVERLAY_MAX_CHAR_COUNT);
+		}
+		textVersion++;
+	}
+
+	// Needs to be called by the application before submitting the command buffer of a frame, once that frame's previous submission has finished
+	// Copies the glyphs of the last text update to the frame's region of the persistently mapped ring buffer, if they changed since the frame was last drawn
+	void updateFrame(uint32_t frameIndex)
+	{
+		if (frameTextVersions[frameIndex] == textVersion)
+		{
+			return;
+		}
+		if (!glyphs.empty())
+		{
+			GlyphInstance *frameGlyphs = (GlyphInstance*)glyphBuffer.mapped + frameIndex * TEXTOVERLAY_MAX_CHAR_COUNT;
+			memcpy(frameGlyphs, glyphs.data(), glyphs.size() * sizeof(GlyphInstance));
+		}
+		VkDrawIndirectCommand *drawCommand = (VkDrawIndirectCommand*)indirectBuffer.mapped + frameIndex;
+		drawCommand->instanceCount = static_cast<uint32_t>(glyphs.size());
+		frameTextVersions[frameIndex] = textVersion;
 	}
 
-	// Needs to be called by the application
+	// Needs to be called by the application if the frame buffers change, text updates don't require the command buffers to be recorded again
 	void updateCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -591,14 +668,10 @@ public:
 			vkCmdBindPipeline(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			vkCmdBindDescriptorSets(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-			VkDeviceSize offsets = 0;
-			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &buffer, &offsets);
-			vkCmdBindVertexBuffers(cmdBuffers[i], 1, 1, &buffer, &offsets);
-			for (uint32_t j = 0; j < numLetters; j++)
-			{
-				vkCmdDraw(cmdBuffers[i], 4, 1, j * 4, 0);
-			}
-
+			// Each frame draws the glyphs from its own region of the ring buffer, the number of glyphs is read from the indirect draw command
+			VkDeviceSize offsets = i * TEXTOVERLAY_MAX_CHAR_COUNT * sizeof(GlyphInstance);
+			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &glyphBuffer.buffer, &offsets);
+			vkCmdDrawIndirect(cmdBuffers[i], indirectBuffer.buffer, i * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
 
 			vkCmdEndRenderPass(cmdBuffers[i]);
 
@@ -853,6 +926,7 @@ public:
 			drawCmdBuffers[currentBuffer]
 		};
 		if (textOverlay->visible) {
+			textOverlay->updateFrame(currentBuffer);
 			commandBuffers.push_back(textOverlay->cmdBuffers[currentBuffer]);
 		}
 
@@ -887,20 +961,19 @@ public:
 		draw();
 		if (frameCounter == 0)
 		{
-			vkDeviceWaitIdle(device);
 			updateTextOverlay();
 		}
 	}
 
 	virtual void viewChanged()
 	{
-		vkDeviceWaitIdle(device);
 		updateUniformBuffers();
 		updateTextOverlay();
 	}
 
 	virtual void windowResized()
 	{
+		textOverlay->updateCommandBuffers();
 		updateTextOverlay();
 	}
 
@@ -1,12 +1,18 @@
 /*
 * Vulkan Example - 3D texture loading (and generation using perlin noise) example
 *
+* Noise is generated four voxels at a time using SIMD on a background job, so new volumes don't stall rendering
+* Finished volumes are uploaded through a persistent staging buffer into the currently unused one of two 3D images
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <atomic>
+#include <thread>
 #include "vulkanexamplebase.h"
+#include "simd.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -85,6 +91,65 @@ public:
 			lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
 		return res;
 	}
+
+	// Four wide version of the above
+	vks::simd::float4 fade(vks::simd::float4 t)
+	{
+		return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+	}
+	vks::simd::float4 lerp(vks::simd::float4 t, vks::simd::float4 a, vks::simd::float4 b)
+	{
+		return a + t * (b - a);
+	}
+	vks::simd::float4 grad(vks::simd::uint4 hash, vks::simd::float4 x, vks::simd::float4 y, vks::simd::float4 z)
+	{
+		using namespace vks::simd;
+		uint4 h = hash & set1(15u);
+		float4 u = select(h < set1(8u), x, y);
+		float4 v = select(h < set1(4u), y, select((h == set1(12u)) | (h == set1(14u)), x, z));
+		// Flip the sign bits depending on the lowest two bits of the hash
+		u = asFloat(asUint(u) ^ shiftLeft<31>(h & set1(1u)));
+		v = asFloat(asUint(v) ^ shiftLeft<30>(h & set1(2u)));
+		return u + v;
+	}
+	vks::simd::float4 noise(vks::simd::float4 x, vks::simd::float4 y, vks::simd::float4 z)
+	{
+		using namespace vks::simd;
+		// Find unit cube that contains point
+		float4 fx = floor(x);
+		float4 fy = floor(y);
+		float4 fz = floor(z);
+		uint4 X = toInt(fx) & set1(255u);
+		uint4 Y = toInt(fy) & set1(255u);
+		uint4 Z = toInt(fz) & set1(255u);
+		// Find relative x,y,z of point in cube
+		x = x - fx;
+		y = y - fy;
+		z = z - fz;
+
+		// Compute fade curves for each of x,y,z
+		float4 u = fade(x);
+		float4 v = fade(y);
+		float4 w = fade(z);
+
+		// Hash coordinates of the 8 cube corners
+		const uint4 one = set1(1u);
+		uint4 A = gather(permutations, X) + Y;
+		uint4 AA = gather(permutations, A) + Z;
+		uint4 AB = gather(permutations, A + one) + Z;
+		uint4 B = gather(permutations, X + one) + Y;
+		uint4 BA = gather(permutations, B) + Z;
+		uint4 BB = gather(permutations, B + one) + Z;
+
+		// And add blended results for 8 corners of the cube;
+		float4 x1 = x - 1.0f;
+		float4 y1 = y - 1.0f;
+		float4 z1 = z - 1.0f;
+		float4 res = lerp(w, lerp(v,
+			lerp(u, grad(gather(permutations, AA), x, y, z), grad(gather(permutations, BA), x1, y, z)), lerp(u, grad(gather(permutations, AB), x, y1, z), grad(gather(permutations, BB), x1, y1, z))),
+			lerp(v, lerp(u, grad(gather(permutations, AA + one), x, y, z1), grad(gather(permutations, BA + one), x1, y, z1)), lerp(u, grad(gather(permutations, AB + one), x, y1, z1), grad(gather(permutations, BB + one), x1, y1, z1))));
+		return res;
+	}
 };
 
 // Fractal noise generator based on perlin noise above
@@ -123,6 +188,25 @@ public:
 		sum = sum / max;
 		return (sum + (T)1.0) / (T)2.0;
 	}
+
+	vks::simd::float4 noise(vks::simd::float4 x, vks::simd::float4 y, vks::simd::float4 z)
+	{
+		using namespace vks::simd;
+		float4 sum = set1(0.0f);
+		float frequency = 1.0f;
+		float amplitude = 1.0f;
+		float max = 0.0f;
+		for (uint32_t i = 0; i < octaves; i++)
+		{
+			sum = sum + perlinNoise.noise(x * frequency, y * frequency, z * frequency) * amplitude;
+			max += amplitude;
+			amplitude *= persistence;
+			frequency *= 2.0f;
+		}
+
+		sum = sum * (1.0f / max);
+		return (sum + 1.0f) * 0.5f;
+	}
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -139,7 +223,29 @@ public:
 		VkFormat format;
 		uint32_t width, height, depth;
 		uint32_t mipLevels;
-	} texture;
+	};
+	// The noise volume is double buffered: new noise is uploaded to the texture that's currently not displayed
+	std::array<Texture, 2> textures;
+	uint32_t currentTexture = 0;
+
+	enum class NoiseState { Idle, Generating, Uploading };
+
+	// Noise is generated on a background thread directly into a persistently mapped staging buffer
+	struct {
+		vks::Buffer staging;
+		std::thread thread;
+		std::atomic<uint32_t> slicesDone{ 0 };
+		std::atomic<bool> cancel{ false };
+		std::atomic<bool> finished{ false };
+		NoiseState state = NoiseState::Idle;
+		// Duration of the last completed generation in milliseconds
+		double time = 0.0;
+		VkCommandBuffer uploadCmdBuffer = VK_NULL_HANDLE;
+		VkFence uploadFence = VK_NULL_HANDLE;
+	} noiseGeneration;
+
+	std::vector<uint32_t> volumeSizes = { 64, 128, 256, 512 };
+	int32_t volumeSizeIndex = 1;
 
 	struct {
 		VkPipelineVertexInputStateCreateInfo inputState;
@@ -165,7 +271,8 @@ public:
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
-	VkDescriptorSet descriptorSet;
+	// One descriptor set per noise texture
+	std::array<VkDescriptorSet, 2> descriptorSets;
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -183,7 +290,13 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
-		destroyTextureImage(texture);
+		cancelNoiseGeneration();
+		vkDestroyFence(device, noiseGeneration.uploadFence, nullptr);
+		vkFreeCommandBuffers(device, vulkanDevice->commandPool, 1, &noiseGeneration.uploadCmdBuffer);
+		noiseGeneration.staging.destroy();
+		for (auto& texture : textures) {
+			destroyTextureImage(texture);
+		}
 
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
 
@@ -195,21 +308,14 @@ public:
 		uniformBufferVS.destroy();
 	}
 
-	// Prepare all Vulkan resources for the 3D texture (including descriptors)
-	// Does not fill the texture with data
+	// Prepare all Vulkan resources for the 3D textures (including descriptors) and the staging buffer used to upload the noise
+	// Does not fill the textures with data, they're cleared to zero until the first noise volume has been generated
 	void prepareNoiseTexture(uint32_t width, uint32_t height, uint32_t depth)
 	{
-		// A 3D texture is described as width x height x depth
-		texture.width = width;
-		texture.height = height;
-		texture.depth = depth;
-		texture.mipLevels = 1;
-		texture.format = VK_FORMAT_R8_UNORM;
-
 		// Format support check
 		// 3D texture support in Vulkan is mandatory (in contrast to OpenGL) so no need to check if it's supported
 		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, texture.format, &formatProperties);
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8_UNORM, &formatProperties);
 		// Check if format supports transfer
 		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_TRANSFER_DST_BIT))
 		{
@@ -224,143 +330,181 @@ public:
 			return;
 		}
 
-		// Create optimal tiled target image
-		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_3D;
-		imageCreateInfo.format = texture.format;
-		imageCreateInfo.mipLevels = texture.mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.extent.width = texture.width;
-		imageCreateInfo.extent.height = texture.height;
-		imageCreateInfo.extent.depth = texture.depth;
-		// Set initial layout of the image to undefined
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
-
-		// Device local memory to back up image
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs = {};
-		vkGetImageMemoryRequirements(device, texture.image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &texture.deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, texture.image, texture.deviceMemory, 0));
-
-		// Create sampler
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = VK_FILTER_LINEAR;
-		sampler.minFilter = VK_FILTER_LINEAR;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		sampler.mipLodBias = 0.0f;
-		sampler.compareOp = VK_COMPARE_OP_NEVER;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 0.0f;
-		sampler.maxAnisotropy = 1.0;
-		sampler.anisotropyEnable = VK_FALSE;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &texture.sampler));
-
-		// Create image view
-		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
-		view.image = texture.image;
-		view.viewType = VK_IMAGE_VIEW_TYPE_3D;
-		view.format = texture.format;
-		view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		view.subresourceRange.baseMipLevel = 0;
-		view.subresourceRange.baseArrayLayer = 0;
-		view.subresourceRange.layerCount = 1;
-		view.subresourceRange.levelCount = 1;
-		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
-
-		// Fill image descriptor image info to be used descriptor set setup
-		texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		texture.descriptor.imageView = texture.view;
-		texture.descriptor.sampler = texture.sampler;
+		for (auto& texture : textures)
+		{
+			// A 3D texture is described as width x height x depth
+			texture.width = width;
+			texture.height = height;
+			texture.depth = depth;
+			texture.mipLevels = 1;
+			texture.format = VK_FORMAT_R8_UNORM;
+
+			// Create optimal tiled target image
+			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_3D;
+			imageCreateInfo.format = texture.format;
+			imageCreateInfo.mipLevels = texture.mipLevels;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.extent.width = texture.width;
+			imageCreateInfo.extent.height = texture.height;
+			imageCreateInfo.extent.depth = texture.depth;
+			// Set initial layout of the image to undefined
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
+
+			// Device local memory to back up image
+			VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+			VkMemoryRequirements memReqs = {};
+			vkGetImageMemoryRequirements(device, texture.image, &memReqs);
+			memAllocInfo.allocationSize = memReqs.size;
+			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &texture.deviceMemory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, texture.image, texture.deviceMemory, 0));
+
+			// Create sampler
+			VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+			sampler.magFilter = VK_FILTER_LINEAR;
+			sampler.minFilter = VK_FILTER_LINEAR;
+			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			sampler.mipLodBias = 0.0f;
+			sampler.compareOp = VK_COMPARE_OP_NEVER;
+			sampler.minLod = 0.0f;
+			sampler.maxLod = 0.0f;
+			sampler.maxAnisotropy = 1.0;
+			sampler.anisotropyEnable = VK_FALSE;
+			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &texture.sampler));
+
+			// Create image view
+			VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
+			view.image = texture.image;
+			view.viewType = VK_IMAGE_VIEW_TYPE_3D;
+			view.format = texture.format;
+			view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+			view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			view.subresourceRange.baseMipLevel = 0;
+			view.subresourceRange.baseArrayLayer = 0;
+			view.subresourceRange.layerCount = 1;
+			view.subresourceRange.levelCount = 1;
+			VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
+
+			// Fill image descriptor image info to be used descriptor set setup
+			texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			texture.descriptor.imageLayout = texture.imageLayout;
+			texture.descriptor.imageView = texture.view;
+			texture.descriptor.sampler = texture.sampler;
+		}
 
-		updateNoiseTexture();
+		// Clear both images so they contain defined data and are in the layout expected by the shader
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		for (auto& texture : textures)
+		{
+			vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+			vkCmdClearColorImage(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+			vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.imageLayout, subresourceRange);
+		}
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		// The staging buffer is created once per volume size and stays mapped, the generator writes straight into it
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&noiseGeneration.staging,
+			width * height * depth));
+		VK_CHECK_RESULT(noiseGeneration.staging.map());
 	}
 
-	// Generate randomized noise and upload it to the 3D texture using staging
-	void updateNoiseTexture()
+	// Generate randomized perlin based noise into the given memory
+	// Runs on the background thread, the x axis is evaluated four voxels at a time
+	void generateNoise(uint8_t* data, uint32_t width, uint32_t height, uint32_t depth, float noiseScale)
 	{
-		const uint32_t texMemSize = texture.width * texture.height * texture.depth;
-
-		uint8_t *data = new uint8_t[texMemSize];
-		memset(data, 0, texMemSize);
-
-		// Generate perlin based noise
-		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture..." << std::endl;
-
-		auto tStart = std::chrono::high_resolution_clock::now();
+		using namespace vks::simd;
 
 		PerlinNoise<float> perlinNoise;
 		FractalNoise<float> fractalNoise(perlinNoise);
 
-		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+		const float4 laneOffsets = set(0.0f, 1.0f, 2.0f, 3.0f);
+		const uint32_t simdWidth = width - width % vks::simd::width;
 
 #pragma omp parallel for
-		for (int32_t z = 0; z < texture.depth; z++)
+		for (int32_t z = 0; z < (int32_t)depth; z++)
 		{
-			for (int32_t y = 0; y < texture.height; y++)
+			// Can't break out of an OpenMP loop, so remaining slices are skipped instead
+			if (noiseGeneration.cancel) {
+				continue;
+			}
+			const float nz = (float)z / (float)depth * noiseScale;
+			for (uint32_t y = 0; y < height; y++)
 			{
-				for (int32_t x = 0; x < texture.width; x++)
+				const float ny = (float)y / (float)height * noiseScale;
+				uint8_t* row = data + y * width + z * width * height;
+				uint32_t x = 0;
+				for (; x < simdWidth; x += vks::simd::width)
 				{
-					float nx = (float)x / (float)texture.width;
-					float ny = (float)y / (float)texture.height;
-					float nz = (float)z / (float)texture.depth;
-#define FRACTAL
-#ifdef FRACTAL
-					float n = fractalNoise.noise(nx * noiseScale, ny * noiseScale, nz * noiseScale);
-#else
-					float n = 20.0 * perlinNoise.noise(nx, ny, nz);
-#endif
+					float4 nx = (set1((float)x) + laneOffsets) * (noiseScale / (float)width);
+					float4 n = fractalNoise.noise(nx, set1(ny), set1(nz));
 					n = n - floor(n);
-
-					data[x + y * texture.width + z * texture.width * texture.height] = static_cast<uint8_t>(floor(n * 255));
+					// n is positive, so truncation is the same as rounding down
+					uint32_t values[4];
+					store(values, toInt(n * 255.0f));
+					row[x + 0] = static_cast<uint8_t>(values[0]);
+					row[x + 1] = static_cast<uint8_t>(values[1]);
+					row[x + 2] = static_cast<uint8_t>(values[2]);
+					row[x + 3] = static_cast<uint8_t>(values[3]);
+				}
+				for (; x < width; x++)
+				{
+					float n = fractalNoise.noise((float)x / (float)width * noiseScale, ny, nz);
+					n = n - std::floor(n);
+					row[x] = static_cast<uint8_t>(std::floor(n * 255));
 				}
 			}
+			noiseGeneration.slicesDone++;
 		}
+	}
 
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-
-		std::cout << "Done in " << tDiff << "ms" << std::endl;
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		// Buffer object
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = texMemSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Allocate host visible memory for data upload
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs = {};
-		vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
-
-		// Copy texture data into staging buffer
-		uint8_t *mapped;
-		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&mapped));
-		memcpy(mapped, data, texMemSize);
-		vkUnmapMemory(device, stagingMemory);
+	// Start generating a new noise volume in the background, ignored if a previous one hasn't been displayed yet
+	void updateNoiseTexture()
+	{
+		if (noiseGeneration.state != NoiseState::Idle) {
+			return;
+		}
+		const Texture& texture = textures[currentTexture];
+		const uint32_t width = texture.width;
+		const uint32_t height = texture.height;
+		const uint32_t depth = texture.depth;
+		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+		uint8_t* data = static_cast<uint8_t*>(noiseGeneration.staging.mapped);
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		noiseGeneration.slicesDone = 0;
+		noiseGeneration.finished = false;
+		noiseGeneration.state = NoiseState::Generating;
+		noiseGeneration.thread = std::thread([this, data, width, height, depth, noiseScale]
+		{
+			auto tStart = std::chrono::high_resolution_clock::now();
+			generateNoise(data, width, height, depth, noiseScale);
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			noiseGeneration.time = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			noiseGeneration.finished = true;
+		});
+	}
+
+	// Copy the generated noise from the staging buffer to the texture that's currently not displayed
+	void uploadNoiseTexture()
+	{
+		Texture& texture = textures[1 - currentTexture];
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(noiseGeneration.uploadCmdBuffer, &cmdBufInfo));
 
 		// The sub resource range describes the regions of the image we will be transitioned
 		VkImageSubresourceRange subresourceRange = {};
@@ -369,10 +513,9 @@ public:
 		subresourceRange.levelCount = 1;
 		subresourceRange.layerCount = 1;
 
-		// Optimal image will be used as destination for the copy, so we must transfer from our
-		// initial undefined image layout to the transfer destination layout
+		// The previous contents of the image are overwritten, so we can transition from an undefined layout
 		vks::tools::setImageLayout(
-			copyCmd,
+			noiseGeneration.uploadCmdBuffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -391,28 +534,81 @@ public:
 		bufferCopyRegion.imageExtent.depth = texture.depth;
 
 		vkCmdCopyBufferToImage(
-			copyCmd,
-			stagingBuffer,
+			noiseGeneration.uploadCmdBuffer,
+			noiseGeneration.staging.buffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
 			&bufferCopyRegion);
 
-		// Change texture image layout to shader read after all mip levels have been copied
-		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		// Change texture image layout to shader read after the copy
 		vks::tools::setImageLayout(
-			copyCmd,
+			noiseGeneration.uploadCmdBuffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			texture.imageLayout,
 			subresourceRange);
 
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		VK_CHECK_RESULT(vkEndCommandBuffer(noiseGeneration.uploadCmdBuffer));
 
-		// Clean up staging resources
-		delete[] data;
-		vkFreeMemory(device, stagingMemory, nullptr);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		// The fence is checked once per frame instead of blocking until the copy is done
+		VK_CHECK_RESULT(vkResetFences(device, 1, &noiseGeneration.uploadFence));
+		VkSubmitInfo uploadSubmitInfo = vks::initializers::submitInfo();
+		uploadSubmitInfo.commandBufferCount = 1;
+		uploadSubmitInfo.pCommandBuffers = &noiseGeneration.uploadCmdBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &uploadSubmitInfo, noiseGeneration.uploadFence));
+	}
+
+	// Advance the noise generation state, called once per frame
+	void updateNoiseGeneration()
+	{
+		if ((noiseGeneration.state == NoiseState::Generating) && noiseGeneration.finished)
+		{
+			noiseGeneration.thread.join();
+			uploadNoiseTexture();
+			noiseGeneration.state = NoiseState::Uploading;
+		}
+		if ((noiseGeneration.state == NoiseState::Uploading) && (vkGetFenceStatus(device, noiseGeneration.uploadFence) == VK_SUCCESS))
+		{
+			// Display the new texture
+			currentTexture = 1 - currentTexture;
+			noiseGeneration.state = NoiseState::Idle;
+			buildCommandBuffers();
+		}
+	}
+
+	// Stop a running generation and wait for a pending upload
+	void cancelNoiseGeneration()
+	{
+		if (noiseGeneration.thread.joinable())
+		{
+			noiseGeneration.cancel = true;
+			noiseGeneration.thread.join();
+			noiseGeneration.cancel = false;
+		}
+		if (noiseGeneration.state == NoiseState::Uploading)
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &noiseGeneration.uploadFence, VK_TRUE, UINT64_MAX));
+		}
+		noiseGeneration.state = NoiseState::Idle;
+	}
+
+	// Recreate the textures and the staging buffer for the selected volume size and start generating noise for it
+	void changeVolumeSize()
+	{
+		cancelNoiseGeneration();
+		vkDeviceWaitIdle(device);
+		for (auto& texture : textures) {
+			destroyTextureImage(texture);
+			texture = Texture();
+		}
+		noiseGeneration.staging.destroy();
+		noiseGeneration.staging = vks::Buffer();
+		const uint32_t size = volumeSizes[volumeSizeIndex];
+		prepareNoiseTexture(size, size, size);
+		updateDescriptorSets();
+		buildCommandBuffers();
+		updateNoiseTexture();
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -460,7 +656,7 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentTexture], 0, NULL);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
 
 			VkDeviceSize offsets[1] = { 0 };
@@ -567,11 +763,11 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses one ubo and one image sampler
+		// Example uses one ubo and one image sampler per noise texture
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -616,31 +812,41 @@ public:
 
 	void setupDescriptorSet()
 	{
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, descriptorSetLayout };
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(
 				descriptorPool,
-				&descriptorSetLayout,
-				1);
+				setLayouts.data(),
+				static_cast<uint32_t>(setLayouts.size()));
 
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()));
 
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
-		{
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(
-				descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				0,
-				&uniformBufferVS.descriptor),
-			// Binding 1 : Fragment shader texture sampler
-			vks::initializers::writeDescriptorSet(
-				descriptorSet,
-				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				1,
-				&texture.descriptor)
-		};
+		updateDescriptorSets();
+	}
 
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	// Also called when the noise textures are recreated
+	void updateDescriptorSets()
+	{
+		for (size_t i = 0; i < descriptorSets.size(); i++)
+		{
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+			{
+				// Binding 0 : Vertex shader uniform buffer
+				vks::initializers::writeDescriptorSet(
+					descriptorSets[i],
+					VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+					0,
+					&uniformBufferVS.descriptor),
+				// Binding 1 : Fragment shader texture sampler
+				vks::initializers::writeDescriptorSet(
+					descriptorSets[i],
+					VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					1,
+					&textures[i].descriptor)
+			};
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
 	}
 
 	void preparePipelines()
@@ -755,12 +961,16 @@ public:
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
-		prepareNoiseTexture(128, 128, 128);
+		prepareNoiseTexture(volumeSizes[volumeSizeIndex], volumeSizes[volumeSizeIndex], volumeSizes[volumeSizeIndex]);
+		noiseGeneration.uploadCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &noiseGeneration.uploadFence));
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
+		updateNoiseTexture();
 		prepared = true;
 	}
 
@@ -768,6 +978,7 @@ public:
 	{
 		if (!prepared)
 			return;
+		updateNoiseGeneration();
 		draw();
 		if (!paused || camera.updated)
 			updateUniformBuffers(camera.updated);
@@ -776,10 +987,25 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
+			std::vector<std::string> volumeSizeNames;
+			for (auto size : volumeSizes) {
+				volumeSizeNames.push_back(std::to_string(size) + " x " + std::to_string(size) + " x " + std::to_string(size));
+			}
+			if (overlay->comboBox("Volume size", &volumeSizeIndex, volumeSizeNames)) {
+				changeVolumeSize();
+			}
 			if (overlay->button("Generate new texture")) {
 				updateNoiseTexture();
 			}
 		}
+		if (overlay->header("Statistics")) {
+			if (noiseGeneration.state == NoiseState::Generating) {
+				overlay->text("Generating noise: %d%%", noiseGeneration.slicesDone * 100 / textures[currentTexture].depth);
+			}
+			else {
+				overlay->text("Noise generated in %.2f ms", noiseGeneration.time);
+			}
+		}
 	}
 };
 
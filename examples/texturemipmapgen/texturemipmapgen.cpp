@@ -8,6 +8,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanMipGenerator.hpp"
+#include "VulkanTimestampQuery.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -20,10 +22,22 @@ public:
 		VkImage image;
 		VkDeviceMemory deviceMemory;
 		VkImageView view;
+		VkFormat format;
 		uint32_t width, height;
 		uint32_t mipLevels;
 	} texture;
 
+	// The mip chain can either be generated with one blit per level or with a single compute dispatch
+	enum MipGenerationMethod { Blit = 0, Compute = 1 };
+	std::vector<std::string> mipGenerationNames{ "Blit (one per level)", "Compute (single pass)" };
+	int32_t mipGenerationMethod = Compute;
+	bool blitSupported = false;
+	bool computeSupported = false;
+	vks::MipGenerator mipGenerator;
+	// GPU time of the last mip chain generation per method
+	vks::TimestampQuery timestamps;
+	std::array<double, 2> mipGenerationTimes{};
+
 	// To demonstrate mip mapping and filtering this example uses separate samplers
 	std::vector<std::string> samplerNames{ "No mip maps" , "Mip maps (bilinear)" , "Mip maps (anisotropic)" };
 	std::vector<VkSampler> samplers;
@@ -61,6 +75,8 @@ public:
 	~VulkanExample()
 	{
 		destroyTextureImage(texture);
+		mipGenerator.destroy();
+		timestamps.destroy();
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -76,6 +92,10 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		}
+		// Required for writing the mip levels from the compute shader regardless of the image format
+		if (deviceFeatures.shaderStorageImageWriteWithoutFormat) {
+			enabledFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+		}
 	}
 
 	void loadTexture(std::string filename, VkFormat format, bool forceLinearTiling)
@@ -106,6 +126,7 @@ public:
 #endif
 		assert(result == KTX_SUCCESS);
 
+		texture.format = format;
 		texture.width = ktxTexture->baseWidth;
 		texture.height = ktxTexture->baseHeight;
 		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
@@ -119,9 +140,14 @@ public:
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
-		// Mip-chain generation requires support for blit source and destination
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		// Mip-chain generation with blits requires support for blit source and destination
+		blitSupported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		// Compute based generation works with formats that lack blit support, as long as they can be used as storage images
+		computeSupported = mipGenerator.isSupported(format, texture.width, texture.height) && (texture.mipLevels <= vks::MipGenerator::maxMipLevels);
+		if (!blitSupported && !computeSupported) {
+			vks::tools::exitFatal("Selected image format does not support mip chain generation!", VK_ERROR_FORMAT_NOT_SUPPORTED);
+		}
+		mipGenerationMethod = computeSupported ? Compute : Blit;
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs = {};
@@ -160,6 +186,10 @@ public:
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { texture.width, texture.height, 1 };
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (computeSupported) {
+			imageCreateInfo.usage |= vks::MipGenerator::getImageUsage();
+			imageCreateInfo.flags |= vks::MipGenerator::getImageCreateFlags(format);
+		}
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
 		vkGetImageMemoryRequirements(device, texture.image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
@@ -198,16 +228,16 @@ public:
 
 		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
-		// Transition first mip level to transfer source for read during blit
+		// Transition first mip level to shader read, the mip chain generation methods start from this layout
 		vks::tools::insertImageMemoryBarrier(
 			copyCmd,
 			texture.image,
 			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 			subresourceRange);
 
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
@@ -217,11 +247,75 @@ public:
 		vkDestroyBuffer(device, stagingBuffer, nullptr);
 		ktxTexture_Destroy(ktxTexture);
 
-		// Generate the mip chain
-		// ---------------------------------------------------------------
+		generateMipChain();
+
+		// Create samplers
+		samplers.resize(3);
+		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		sampler.mipLodBias = 0.0f;
+		sampler.compareOp = VK_COMPARE_OP_NEVER;
+		sampler.minLod = 0.0f;
+		sampler.maxLod = 0.0f;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		sampler.maxAnisotropy = 1.0;
+		sampler.anisotropyEnable = VK_FALSE;
+
+		// Without mip mapping
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[0]));
+
+		// With mip mapping
+		sampler.maxLod = (float)texture.mipLevels;
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[1]));
+
+		// With mip mapping and anisotropic filtering
+		if (vulkanDevice->features.samplerAnisotropy)
+		{
+			sampler.maxAnisotropy = vulkanDevice->properties.limits.maxSamplerAnisotropy;
+			sampler.anisotropyEnable = VK_TRUE;
+		}
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[2]));
+
+		// Create image view
+		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
+		view.image = texture.image;
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view.format = format;
+		view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		view.subresourceRange.baseMipLevel = 0;
+		view.subresourceRange.baseArrayLayer = 0;
+		view.subresourceRange.layerCount = 1;
+		view.subresourceRange.levelCount = texture.mipLevels;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
+	}
+
+	// Generate the mip chain with one blit per level
+	void generateMipChainBlit(VkCommandBuffer blitCmd)
+	{
 		// We copy down the whole mip chain doing a blit from mip-1 to mip
 		// An alternative way would be to always blit from the first mip level and sample that one down
-		VkCommandBuffer blitCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		// Transition first mip level to transfer source for read during blit
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = 1;
+		subresourceRange.layerCount = 1;
+		vks::tools::insertImageMemoryBarrier(
+			blitCmd,
+			texture.image,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange);
 
 		// Copy down mips from n-1 to n
 		for (int32_t i = 1; i < texture.mipLevels; i++)
@@ -298,54 +392,26 @@ public:
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 			subresourceRange);
+	}
 
-		vulkanDevice->flushCommandBuffer(blitCmd, queue, true);
-		// ---------------------------------------------------------------
-
-		// Create samplers
-		samplers.resize(3);
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = VK_FILTER_LINEAR;
-		sampler.minFilter = VK_FILTER_LINEAR;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-		sampler.mipLodBias = 0.0f;
-		sampler.compareOp = VK_COMPARE_OP_NEVER;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 0.0f;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		sampler.maxAnisotropy = 1.0;
-		sampler.anisotropyEnable = VK_FALSE;
-
-		// Without mip mapping
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[0]));
-
-		// With mip mapping
-		sampler.maxLod = (float)texture.mipLevels;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[1]));
-
-		// With mip mapping and anisotropic filtering
-		if (vulkanDevice->features.samplerAnisotropy)
-		{
-			sampler.maxAnisotropy = vulkanDevice->properties.limits.maxSamplerAnisotropy;
-			sampler.anisotropyEnable = VK_TRUE;
+	// Generate the mip chain with the selected method and measure the GPU time it takes
+	void generateMipChain()
+	{
+		VkCommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		timestamps.reset(cmdBuffer);
+		timestamps.write(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+		if (mipGenerationMethod == Compute) {
+			// All mip levels are generated with a single dispatch
+			mipGenerator.generate(cmdBuffer, texture.image, texture.format, texture.width, texture.height, texture.mipLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		} else {
+			generateMipChainBlit(cmdBuffer);
+		}
+		timestamps.write(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+		vulkanDevice->flushCommandBuffer(cmdBuffer, queue, true);
+		mipGenerator.releaseResources();
+		if (timestamps.fetch()) {
+			mipGenerationTimes[mipGenerationMethod] = timestamps.duration(0, 1);
 		}
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[2]));
-
-		// Create image view
-		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
-		view.image = texture.image;
-		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		view.format = format;
-		view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		view.subresourceRange.baseMipLevel = 0;
-		view.subresourceRange.baseArrayLayer = 0;
-		view.subresourceRange.layerCount = 1;
-		view.subresourceRange.levelCount = texture.mipLevels;
-		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -547,6 +613,8 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		mipGenerator.create(vulkanDevice, getShadersPath() + "base/mipgen.comp.spv");
+		timestamps.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 2);
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -577,6 +645,16 @@ public:
 			if (overlay->comboBox("Sampler type", &uboVS.samplerIndex, samplerNames)) {
 				updateUniformBuffers();
 			}
+			if (blitSupported && computeSupported) {
+				if (overlay->comboBox("Mip generation", &mipGenerationMethod, mipGenerationNames)) {
+					vkDeviceWaitIdle(device);
+					generateMipChain();
+				}
+			}
+		}
+		if (overlay->header("Mip generation GPU time")) {
+			overlay->text("Blit: %.3f ms", mipGenerationTimes[Blit]);
+			overlay->text("Compute: %.3f ms", mipGenerationTimes[Compute]);
 		}
 	}
 };
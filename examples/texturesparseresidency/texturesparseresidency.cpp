@@ -7,11 +7,28 @@
 */
 
 /*
-* Note : This sample is work-in-progress and works basically, but it's not yet finished
+* Note : See texturesparseresidency.h for an overview of how pages are requested, streamed and evicted
 */
 
 #include "texturesparseresidency.h"
 
+// Directory for generated files that can safely be deleted between runs
+static std::string getTempDirectory()
+{
+	const char* variables[] = { "TMPDIR", "TEMP", "TMP" };
+	for (const char* variable : variables) {
+		const char* value = getenv(variable);
+		if (value && (value[0] != '\0')) {
+			return value;
+		}
+	}
+#if defined(_WIN32)
+	return ".";
+#else
+	return "/tmp";
+#endif
+}
+
 /*
 	Virtual texture page 
 	Contains all functions and objects for a single page of a virtual texture
@@ -21,6 +38,9 @@ VirtualTexturePage::VirtualTexturePage()
 {
 	// Pages are initially not backed up by memory (non-resident)
 	imageMemoryBind.memory = VK_NULL_HANDLE;
+	poolSlot = -1;
+	lastRequested = 0;
+	pending = false;
 }
 
 bool VirtualTexturePage::resident()
@@ -28,44 +48,259 @@ bool VirtualTexturePage::resident()
 	return (imageMemoryBind.memory != VK_NULL_HANDLE);
 }
 
-// Allocate Vulkan memory for the virtual page
-bool VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
+// Back the virtual page with a slot of the page memory pool
+void VirtualTexturePage::bind(VkDeviceMemory memory, VkDeviceSize memoryOffset, int32_t slot)
 {
-	if (imageMemoryBind.memory != VK_NULL_HANDLE)
-	{
-		return false;
-	};
-
-	imageMemoryBind = {};
-
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = size;
-	allocInfo.memoryTypeIndex = memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemoryBind.memory));
-
 	VkImageSubresource subResource{};
 	subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	subResource.mipLevel = mipLevel;
 	subResource.arrayLayer = layer;
 
 	// Sparse image memory binding
+	imageMemoryBind = {};
 	imageMemoryBind.subresource = subResource;
 	imageMemoryBind.extent = extent;
 	imageMemoryBind.offset = offset;
-	return true;
+	imageMemoryBind.memory = memory;
+	imageMemoryBind.memoryOffset = memoryOffset;
+	poolSlot = slot;
+}
+
+// Remove the memory backing, the page's binding needs to be updated with a null memory handle
+void VirtualTexturePage::unbind()
+{
+	imageMemoryBind.memory = VK_NULL_HANDLE;
+	imageMemoryBind.memoryOffset = 0;
+	poolSlot = -1;
+}
+
+/*
+	Virtual texture page pool
+	Single device memory allocation that's split into page sized slots
+*/
+
+void VirtualTexturePagePool::create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, uint32_t pageCount)
+{
+	this->device = device;
+	this->pageSize = pageSize;
+	this->pageCount = pageCount;
+	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
+	allocInfo.allocationSize = pageSize * pageCount;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &memory));
+	freeSlots.resize(pageCount);
+	for (uint32_t i = 0; i < pageCount; i++) {
+		freeSlots[i] = static_cast<int32_t>(pageCount - 1 - i);
+	}
+}
+
+int32_t VirtualTexturePagePool::acquire()
+{
+	if (freeSlots.empty()) {
+		return -1;
+	}
+	int32_t slot = freeSlots.back();
+	freeSlots.pop_back();
+	return slot;
+}
+
+void VirtualTexturePagePool::release(int32_t slot)
+{
+	assert(slot >= 0);
+	freeSlots.push_back(slot);
+}
+
+VkDeviceSize VirtualTexturePagePool::offset(int32_t slot)
+{
+	return static_cast<VkDeviceSize>(slot) * pageSize;
 }
 
-// Release Vulkan memory allocated for this page
-bool VirtualTexturePage::release(VkDevice device)
+void VirtualTexturePagePool::destroy()
+{
+	if (memory != VK_NULL_HANDLE) {
+		vkFreeMemory(device, memory, nullptr);
+		memory = VK_NULL_HANDLE;
+	}
+}
+
+/*
+	Virtual texture source
+	Tiled page file with asynchronous page loading
+*/
+
+VirtualTextureSource::~VirtualTextureSource()
+{
+	close();
+}
+
+void VirtualTextureSource::setupLayout(uint32_t width, uint32_t height, uint32_t mipCount, VkExtent3D pageExtent)
+{
+	this->pageExtent = pageExtent;
+	mipLevels.resize(mipCount);
+	pageCount = 0;
+	for (uint32_t i = 0; i < mipCount; i++) {
+		MipLevel& mipLevel = mipLevels[i];
+		mipLevel.width = std::max(width >> i, 1u);
+		mipLevel.height = std::max(height >> i, 1u);
+		mipLevel.pagesX = (mipLevel.width + pageExtent.width - 1) / pageExtent.width;
+		mipLevel.pagesY = (mipLevel.height + pageExtent.height - 1) / pageExtent.height;
+		mipLevel.firstPage = pageCount;
+		pageCount += mipLevel.pagesX * mipLevel.pagesY;
+	}
+}
+
+VkExtent3D VirtualTextureSource::getPageExtent(uint32_t pageIndex)
+{
+	for (auto& mipLevel : mipLevels) {
+		if (pageIndex < mipLevel.firstPage + mipLevel.pagesX * mipLevel.pagesY) {
+			const uint32_t x = (pageIndex - mipLevel.firstPage) % mipLevel.pagesX;
+			const uint32_t y = (pageIndex - mipLevel.firstPage) / mipLevel.pagesX;
+			return { std::min(pageExtent.width, mipLevel.width - x * pageExtent.width), std::min(pageExtent.height, mipLevel.height - y * pageExtent.height), 1 };
+		}
+	}
+	return { 0, 0, 0 };
+}
+
+bool VirtualTextureSource::validate(uint32_t width, uint32_t height, uint32_t mipCount)
+{
+	std::ifstream is(filename, std::ios::binary | std::ios::ate);
+	if (!is.is_open()) {
+		return false;
+	}
+	const size_t pageSize = pageExtent.width * pageExtent.height * 4;
+	if (static_cast<size_t>(is.tellg()) != sizeof(Header) + pageCount * pageSize) {
+		return false;
+	}
+	Header header;
+	is.seekg(0);
+	is.read(reinterpret_cast<char*>(&header), sizeof(Header));
+	return (header.magic == magic) && (header.width == width) && (header.height == height) && (header.mipCount == mipCount) && (header.pageWidth == pageExtent.width) && (header.pageHeight == pageExtent.height);
+}
+
+// Generates the page file with a procedural pattern
+// Page borders are tinted with a color per mip level, so the resolution of the resident pages is visible
+void VirtualTextureSource::generate()
+{
+	std::cout << "Generating virtual texture page file \"" << filename << "\"" << std::endl;
+	const glm::vec3 mipColors[8] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 1.0f, 0.0f),
+		glm::vec3(1.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 1.0f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f)
+	};
+	std::ofstream os(filename, std::ios::binary);
+	Header header = { magic, mipLevels[0].width, mipLevels[0].height, static_cast<uint32_t>(mipLevels.size()), pageExtent.width, pageExtent.height };
+	os.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	std::vector<uint8_t> page(pageExtent.width * pageExtent.height * 4);
+	for (uint32_t level = 0; level < mipLevels.size(); level++) {
+		const MipLevel& mipLevel = mipLevels[level];
+		for (uint32_t py = 0; py < mipLevel.pagesY; py++) {
+			for (uint32_t px = 0; px < mipLevel.pagesX; px++) {
+				const VkExtent3D extent = getPageExtent(mipLevel.firstPage + py * mipLevel.pagesX + px);
+				std::fill(page.begin(), page.end(), 0);
+				uint8_t* texel = page.data();
+				for (uint32_t y = 0; y < extent.height; y++) {
+					for (uint32_t x = 0; x < extent.width; x++) {
+						// The pattern is a function of the texture coordinate, so all mip levels show the same image
+						const float u = (px * pageExtent.width + x + 0.5f) / mipLevel.width;
+						const float v = (py * pageExtent.height + y + 0.5f) / mipLevel.height;
+						glm::vec3 color = glm::vec3(
+							0.5f + 0.5f * sin(u * 37.0f + sin(v * 11.0f) * 2.0f),
+							0.5f + 0.5f * sin(v * 29.0f + cos(u * 7.0f) * 3.0f),
+							0.5f + 0.5f * sin((u + v) * 23.0f));
+						if ((x < 2) || (y < 2) || (x >= extent.width - 2) || (y >= extent.height - 2)) {
+							color = mipColors[level % 8];
+						}
+						for (uint32_t c = 0; c < 3; c++) {
+							*texel++ = static_cast<uint8_t>(color[c] * 255.0f);
+						}
+						*texel++ = 255;
+					}
+				}
+				os.write(reinterpret_cast<const char*>(page.data()), page.size());
+			}
+		}
+	}
+}
+
+void VirtualTextureSource::open(const std::string& filename, uint32_t width, uint32_t height, uint32_t mipCount, VkExtent3D pageExtent)
+{
+	this->filename = filename;
+	setupLayout(width, height, mipCount, pageExtent);
+	if (!validate(width, height, mipCount)) {
+		generate();
+	}
+	file.open(filename, std::ios::binary);
+	if (!file.is_open()) {
+		vks::tools::exitFatal("Could not open virtual texture page file \"" + filename + "\"", -1);
+	}
+	stopLoader = false;
+	loaderThread = std::thread(&VirtualTextureSource::loaderLoop, this);
+}
+
+void VirtualTextureSource::readPage(uint32_t pageIndex, std::vector<uint8_t>& data)
+{
+	// Pages are stored tightly packed at the start of their slot
+	const VkExtent3D extent = getPageExtent(pageIndex);
+	const size_t pageSize = pageExtent.width * pageExtent.height * 4;
+	data.resize(extent.width * extent.height * 4);
+	std::lock_guard<std::mutex> lock(fileMutex);
+	file.seekg(sizeof(Header) + pageIndex * pageSize);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+}
+
+void VirtualTextureSource::request(uint32_t pageIndex)
 {
-	del= false;
-	if (imageMemoryBind.memory != VK_NULL_HANDLE)
 	{
-		vkFreeMemory(device, imageMemoryBind.memory, nullptr);
-		imageMemoryBind.memory = VK_NULL_HANDLE;
-		return true;
+		std::lock_guard<std::mutex> lock(queueMutex);
+		requests.push_back(pageIndex);
+	}
+	queueCondition.notify_one();
+}
+
+void VirtualTextureSource::fetchLoaded(std::vector<PageData>& pages, uint32_t maxCount)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	while (!loaded.empty() && (pages.size() < maxCount)) {
+		pages.push_back(std::move(loaded.front()));
+		loaded.pop_front();
+	}
+}
+
+void VirtualTextureSource::loaderLoop()
+{
+	while (true) {
+		uint32_t pageIndex;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return stopLoader || !requests.empty(); });
+			if (stopLoader) {
+				return;
+			}
+			pageIndex = requests.front();
+			requests.pop_front();
+		}
+		PageData pageData;
+		pageData.pageIndex = pageIndex;
+		readPage(pageIndex, pageData.data);
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			loaded.push_back(std::move(pageData));
+		}
+	}
+}
+
+void VirtualTextureSource::close()
+{
+	if (loaderThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopLoader = true;
+		}
+		queueCondition.notify_all();
+		loaderThread.join();
+	}
+	if (file.is_open()) {
+		file.close();
 	}
-	return false;
 }
 
 /*
@@ -85,30 +320,22 @@ VirtualTexturePage* VirtualTexture::addPage(VkOffset3D offset, VkExtent3D extent
 	newPage.imageMemoryBind = {};
 	newPage.imageMemoryBind.offset = offset;
 	newPage.imageMemoryBind.extent = extent;
-	newPage.del = false;
 	pages.push_back(newPage);
 	return &pages.back();
 }
 
 // Call before sparse binding to update memory bind list etc.
-void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del)
+// Only pages whose residency changed need to be passed, non-resident pages are unbound
+void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage*> &bindingChangedPages, bool bindMipTail)
 {
-	// Update list of memory-backed sparse image memory binds
-	//sparseImageMemoryBinds.resize(pages.size());
+	// Update list of changed sparse image memory binds
 	sparseImageMemoryBinds.clear();
 	for (auto page : bindingChangedPages)
 	{
-		sparseImageMemoryBinds.push_back(page.imageMemoryBind);
-		if (del)
-		{
-			sparseImageMemoryBinds[sparseImageMemoryBinds.size() - 1].memory = VK_NULL_HANDLE;
-		}
+		sparseImageMemoryBinds.push_back(page->imageMemoryBind);
 	}
 	// Update sparse bind info
 	bindSparseInfo = vks::initializers::bindSparseInfo();
-	// todo: Semaphore for queue submission
-	// bindSparseInfo.signalSemaphoreCount = 1;
-	// bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
 
 	// Image memory binds
 	imageMemoryBindInfo = {};
@@ -122,25 +349,18 @@ void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindi
 	opaqueMemoryBindInfo.image = image;
 	opaqueMemoryBindInfo.bindCount = static_cast<uint32_t>(opaqueMemoryBinds.size());
 	opaqueMemoryBindInfo.pBinds = opaqueMemoryBinds.data();
-	bindSparseInfo.imageOpaqueBindCount = (opaqueMemoryBindInfo.bindCount > 0) ? 1 : 0;
+	bindSparseInfo.imageOpaqueBindCount = (bindMipTail && (opaqueMemoryBindInfo.bindCount > 0)) ? 1 : 0;
 	bindSparseInfo.pImageOpaqueBinds = &opaqueMemoryBindInfo;
 }
 
 // Release all Vulkan resources
+// Page memory is owned by the page pool
 void VirtualTexture::destroy()
 {
-	for (auto page : pages)
-	{
-		page.release(device);
-	}
 	for (auto bind : opaqueMemoryBinds)
 	{
 		vkFreeMemory(device, bind.memory, nullptr);
 	}
-	// Clean up mip tail
-	if (mipTailimageMemoryBind.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(device, mipTailimageMemoryBind.memory, nullptr);
-	}
 }
 
 /*
@@ -154,14 +374,26 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setPosition(glm::vec3(0.0f, 0.0f, -12.0f));
 	camera.setRotation(glm::vec3(-90.0f, 0.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+	commandLineParser.add("pagefile", { "--pagefile" }, 1, "Path of the generated virtual texture page file");
+	commandLineParser.parse(args);
+	pageFileName = commandLineParser.getValueAsString("pagefile", getTempDirectory() + "/texturesparseresidency.pages");
 }
 
 VulkanExample::~VulkanExample()
 {
 	// Clean up used Vulkan resources
 	// Note : Inherited destructor cleans up resources stored in base class
+	pageSource.close();
 	destroyTextureImage(texture);
+	pagePool.destroy();
 	vkDestroySemaphore(device, bindSparseSemaphore, nullptr);
+	for (uint32_t i = 0; i < 2; i++) {
+		vkDestroyFence(device, stagingRing.fences[i], nullptr);
+	}
+	vkFreeCommandBuffers(device, cmdPool, 2, stagingRing.commandBuffers.data());
+	stagingRing.buffer.destroy();
+	feedbackBuffer.destroy();
+	pageTableBuffer.destroy();
 	vkDestroyPipeline(device, pipeline, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -179,6 +411,10 @@ void VulkanExample::getEnabledFeatures()
 	else {
 		std::cout << "Sparse binding not supported" << std::endl;
 	}
+	// Required for writing page requests to the feedback buffer from the fragment shader
+	if (deviceFeatures.fragmentStoresAndAtomics) {
+		enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+	}
 }
 
 glm::uvec3 VulkanExample::alignedDivision(const VkExtent3D& extent, const VkExtent3D& granularity)
@@ -433,13 +669,10 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &bindSparseSemaphore));
 
-	// Prepare bind sparse info for reuse in queue submission
-	texture.updateSparseBindInfo(texture.pages);
-
-	// Bind to queue
-	// todo: in draw?
+	// Initially only the mip tail is backed by memory, pages are bound on demand
+	std::vector<VirtualTexturePage*> bindingChangedPages;
+	texture.updateSparseBindInfo(bindingChangedPages, true);
 	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE);
-	//todo: use sparse bind semaphore
 	vkQueueWaitIdle(queue);
 
 	// Create sampler
@@ -548,11 +781,12 @@ void VulkanExample::loadAssets()
 
 void VulkanExample::setupDescriptorPool()
 {
-	// Example uses one ubo and one image sampler
+	// Example uses two ubos, one image sampler and one storage buffer
 	std::vector<VkDescriptorPoolSize> poolSizes =
 	{
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
 	};
 
 	VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -577,7 +811,17 @@ void VulkanExample::setupDescriptorSetLayout()
 		vks::initializers::descriptorSetLayoutBinding(
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			VK_SHADER_STAGE_FRAGMENT_BIT,
-			1)
+			1),
+		// Binding 2 : Fragment shader page request feedback buffer
+		vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			2),
+		// Binding 3 : Fragment shader page table uniform buffer
+		vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			3)
 	};
 
 	VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -618,7 +862,19 @@ void VulkanExample::setupDescriptorSet()
 			descriptorSet,
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			1,
-			&texture.descriptor)
+			&texture.descriptor),
+		// Binding 2 : Fragment shader page request feedback buffer
+		vks::initializers::writeDescriptorSet(
+			descriptorSet,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			2,
+			&feedbackBuffer.descriptor),
+		// Binding 3 : Fragment shader page table uniform buffer
+		vks::initializers::writeDescriptorSet(
+			descriptorSet,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			3,
+			&pageTableBuffer.descriptor)
 	};
 
 	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -686,10 +942,14 @@ void VulkanExample::prepare()
 	if (!vulkanDevice->features.sparseResidencyImage2D) {
 		vks::tools::exitFatal("Device does not support sparse residency for 2D images!", VK_ERROR_FEATURE_NOT_PRESENT);
 	}
+	if (!vulkanDevice->features.fragmentStoresAndAtomics) {
+		vks::tools::exitFatal("Device does not support fragment shader stores (required for page request feedback)!", VK_ERROR_FEATURE_NOT_PRESENT);
+	}
 	loadAssets();
 	prepareUniformBuffers();
 	// Create a virtual texture with max. possible dimension (does not take up any VRAM yet)
 	prepareSparseTexture(4096, 4096, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	prepareStreaming();
 	setupDescriptorSetLayout();
 	preparePipelines();
 	setupDescriptorPool();
@@ -703,195 +963,298 @@ void VulkanExample::render()
 	if (!prepared)
 		return;
 	draw();
+	if (streaming) {
+		updateStreaming();
+	}
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
 }
 
-// Fills a buffer with random colors
-void VulkanExample::randomPattern(uint8_t* buffer, uint32_t width, uint32_t height)
+// Sets up the resources for page streaming
+void VulkanExample::prepareStreaming()
 {
-	std::random_device rd;
-	std::mt19937 rndEngine(rd());
-	std::uniform_int_distribution<uint32_t> rndDist(0, 255);
-	uint8_t rndVal[4] = { 0, 0, 0, 0 };
-	while (rndVal[0] + rndVal[1] + rndVal[2] < 10) {
-		rndVal[0] = (uint8_t)rndDist(rndEngine);
-		rndVal[1] = (uint8_t)rndDist(rndEngine);
-		rndVal[2] = (uint8_t)rndDist(rndEngine);
-	}
-	rndVal[3] = 255;
-	for (uint32_t y = 0; y < height; y++) {
-		for (uint32_t x = 0; x < width; x++) {
-			for (uint32_t c = 0; c < 4; c++, ++buffer) {
-				*buffer = rndVal[c];
-			}
-		}
-	}
-}
+	const VkExtent3D pageExtent = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
 
-void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
-{
-	// Generate some random image data and upload as a buffer
-	const size_t bufferSize = 4 * page.extent.width * page.extent.height;
+	// All page memory is taken from a pool with a fixed budget
+	pagePool.create(device, texture.memoryTypeIndex, texture.pages[0].size, pagePoolSize);
 
-	vks::Buffer imageBuffer;
+	// The tiled page file uses the same page layout as the virtual texture, so page indices are the same
+	// Pages of the mip tail levels are stored after the pages of the regular mip levels
+	assert(texture.layerCount == 1);
+	pageSource.open(pageFileName, texture.width, texture.height, texture.mipLevels, pageExtent);
+	assert((texture.mipTailStart >= texture.mipLevels) || (pageSource.mipLevels[texture.mipTailStart].firstPage == texture.pages.size()));
+
+	// Feedback buffer with one page request entry per page
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&imageBuffer,
-		bufferSize));
-	imageBuffer.map();
-
-	uint8_t* data = (uint8_t*)imageBuffer.mapped;
-	randomPattern(data, page.extent.height, page.extent.width);
+		&feedbackBuffer,
+		texture.pages.size() * sizeof(uint32_t)));
+	VK_CHECK_RESULT(feedbackBuffer.map());
+	memset(feedbackBuffer.mapped, 0, feedbackBuffer.size);
+
+	// Page table for calculating page indices in the shader
+	pageTable = {};
+	pageTable.dimensions = glm::uvec4(texture.width, texture.height, pageExtent.width, pageExtent.height);
+	for (uint32_t i = 0; i < std::min(texture.mipTailStart, (uint32_t)MAX_PAGE_TABLE_LEVELS); i++) {
+		const VirtualTextureSource::MipLevel& mipLevel = pageSource.mipLevels[i];
+		pageTable.mipLevels[i] = glm::uvec4(mipLevel.pagesX, mipLevel.pagesY, mipLevel.firstPage, 0);
+	}
+	pageTable.mipTailStart = std::min(texture.mipTailStart, (uint32_t)MAX_PAGE_TABLE_LEVELS);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&pageTableBuffer,
+		sizeof(pageTable),
+		&pageTable));
 
-	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-	VkBufferImageCopy region{};
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.layerCount = 1;
-	region.imageSubresource.mipLevel = page.mipLevel;
-	region.imageOffset = page.offset;
-	region.imageExtent = page.extent;
-	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-	vulkanDevice->flushCommandBuffer(copyCmd, queue);
+	// Persistently mapped staging ring for page uploads
+	stagingRing.slotCount = MAX_UPLOADS_PER_FRAME * 2;
+	stagingRing.slotSize = pageExtent.width * pageExtent.height * 4;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingRing.buffer,
+		stagingRing.slotCount * stagingRing.slotSize));
+	VK_CHECK_RESULT(stagingRing.buffer.map());
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 2);
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, stagingRing.commandBuffers.data()));
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	for (uint32_t i = 0; i < 2; i++) {
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &stagingRing.fences[i]));
+	}
 
-	imageBuffer.destroy();
+	// The mip tail is always resident and serves as the last fallback
+	fillMipTail();
 }
 
-void VulkanExample::fillRandomPages()
+// Reads the page requests written by the fragment shader, schedules page loads and uploads loaded pages
+void VulkanExample::updateStreaming()
 {
-	vkDeviceWaitIdle(device);
-
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
-
-	std::vector<VirtualTexturePage> updatedPages;
-	std::vector<VirtualTexturePage> bindingChangedPages;
-	for (auto& page : texture.pages) {
-		if (rndDist(rndEngine) < 0.5f) {
+	frameIndex++;
+	stats = {};
+
+	// The queue is idle at this point (see submitFrame), so the feedback buffer can be read and reset directly
+	uint32_t* requests = static_cast<uint32_t*>(feedbackBuffer.mapped);
+	std::vector<uint32_t> loadRequests;
+	for (uint32_t i = 0; i < texture.pages.size(); i++) {
+		if (requests[i] == 0) {
 			continue;
 		}
-		if (page.allocate(device, texture.memoryTypeIndex))
-		{
-			bindingChangedPages.push_back(page);
+		// Also request the coarser pages covering the same area, so a close fallback stays resident
+		uint32_t pageIndex = i;
+		while (true) {
+			VirtualTexturePage& page = texture.pages[pageIndex];
+			if (page.lastRequested == frameIndex) {
+				break;
+			}
+			page.lastRequested = frameIndex;
+			stats.requestedPages++;
+			if (page.resident()) {
+				// Move to the front of the least recently used list
+				lruPages.splice(lruPages.begin(), lruPages, page.lruPosition);
+			} else if (!page.pending) {
+				loadRequests.push_back(pageIndex);
+			}
+			if (page.mipLevel + 1 >= texture.mipTailStart) {
+				break;
+			}
+			const VirtualTextureSource::MipLevel& parentLevel = pageSource.mipLevels[page.mipLevel + 1];
+			const uint32_t parentX = (page.offset.x / 2) / pageSource.pageExtent.width;
+			const uint32_t parentY = (page.offset.y / 2) / pageSource.pageExtent.height;
+			pageIndex = parentLevel.firstPage + parentY * parentLevel.pagesX + parentX;
 		}
-		updatedPages.push_back(page);
 	}
+	memset(feedbackBuffer.mapped, 0, feedbackBuffer.size);
 
-	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
+	// Coarse pages are loaded first, as they are the fallback for the finer ones
+	std::sort(loadRequests.begin(), loadRequests.end(), [this](uint32_t a, uint32_t b) { return texture.pages[a].mipLevel > texture.pages[b].mipLevel; });
+	for (auto pageIndex : loadRequests) {
+		if (pendingLoads >= maxPendingLoads) {
+			break;
+		}
+		texture.pages[pageIndex].pending = true;
+		pageSource.request(pageIndex);
+		pendingLoads++;
+	}
 
-	for (auto &page: updatedPages) {
-		uploadContent(page, texture.image);
+	// Make pages loaded by the source resident
+	std::vector<VirtualTextureSource::PageData> pageData;
+	pageSource.fetchLoaded(pageData, static_cast<uint32_t>(maxUploadsPerFrame));
+	if (pageData.empty()) {
+		return;
 	}
+	pendingLoads -= static_cast<uint32_t>(pageData.size());
+
+	std::vector<VirtualTextureSource::PageData> uploads;
+	std::vector<VirtualTexturePage*> bindingChangedPages;
+	for (auto& data : pageData) {
+		VirtualTexturePage& page = texture.pages[data.pageIndex];
+		page.pending = false;
+		// Pages that haven't been requested for a few frames are no longer needed (e.g. after fast camera movement)
+		if (frameIndex - page.lastRequested > 8) {
+			stats.droppedPages++;
+			continue;
+		}
+		int32_t slot = pagePool.acquire();
+		if (slot < 0) {
+			slot = evictPage(bindingChangedPages);
+		}
+		if (slot < 0) {
+			// All pages in the pool are needed for the current frame, the budget is too small for this view
+			stats.droppedPages++;
+			continue;
+		}
+		page.bind(pagePool.memory, pagePool.offset(slot), slot);
+		lruPages.push_front(data.pageIndex);
+		page.lruPosition = lruPages.begin();
+		bindingChangedPages.push_back(&page);
+		uploads.push_back(std::move(data));
+	}
+	uploadPages(uploads, bindingChangedPages);
 }
 
-void VulkanExample::fillMipTail()
+// Evicts the least recently requested page if it's not needed in the current frame and returns its pool slot
+int32_t VulkanExample::evictPage(std::vector<VirtualTexturePage*>& bindingChangedPages)
 {
-	// Clean up previous mip tail memory allocation
-	if (texture.mipTailimageMemoryBind.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(device, texture.mipTailimageMemoryBind.memory, nullptr);
+	if (lruPages.empty()) {
+		return -1;
 	}
+	VirtualTexturePage& page = texture.pages[lruPages.back()];
+	if (page.lastRequested == frameIndex) {
+		return -1;
+	}
+	lruPages.pop_back();
+	const int32_t slot = page.poolSlot;
+	page.unbind();
+	bindingChangedPages.push_back(&page);
+	stats.evictedPages++;
+	return slot;
+}
 
-	//@todo: WIP
-	VkDeviceSize imageMipTailSize = texture.sparseImageMemoryRequirements.imageMipTailSize;
-	VkDeviceSize imageMipTailOffset = texture.sparseImageMemoryRequirements.imageMipTailOffset;
-	// Stride between memory bindings for each mip level if not single mip tail (VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT not set)
-	VkDeviceSize imageMipTailStride = texture.sparseImageMemoryRequirements.imageMipTailStride;
-
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = imageMipTailSize;
-	allocInfo.memoryTypeIndex = texture.memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &texture.mipTailimageMemoryBind.memory));
-
-	uint32_t mipLevel = texture.sparseImageMemoryRequirements.imageMipTailFirstLod;
-	uint32_t width = std::max(texture.width >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t height = std::max(texture.height >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t depth = 1;
-
-	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
-
-		const uint32_t width = std::max(texture.width >> i, 1u);
-		const uint32_t height = std::max(texture.height >> i, 1u);
-
-		// Generate some random image data and upload as a buffer
-		const size_t bufferSize = 4 * width * height;
-
-		vks::Buffer imageBuffer;
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&imageBuffer,
-			bufferSize));
-		imageBuffer.map();
+void VulkanExample::evictAllPages()
+{
+	vkQueueWaitIdle(queue);
+	std::vector<VirtualTexturePage*> bindingChangedPages;
+	for (auto pageIndex : lruPages) {
+		VirtualTexturePage& page = texture.pages[pageIndex];
+		pagePool.release(page.poolSlot);
+		page.unbind();
+		bindingChangedPages.push_back(&page);
+	}
+	lruPages.clear();
+	std::vector<VirtualTextureSource::PageData> uploads;
+	uploadPages(uploads, bindingChangedPages);
+}
 
-		// Fill buffer with random colors
-		std::random_device rd;
-		std::mt19937 rndEngine(rd());
-		std::uniform_int_distribution<uint32_t> rndDist(0, 255);
-		uint8_t* data = (uint8_t*)imageBuffer.mapped;
-		randomPattern(data, width, height);
+// Updates the sparse bindings of the changed pages and uploads the page data through the staging ring
+void VulkanExample::uploadPages(std::vector<VirtualTextureSource::PageData>& pageData, std::vector<VirtualTexturePage*>& bindingChangedPages)
+{
+	if (bindingChangedPages.empty()) {
+		return;
+	}
+	assert(pageData.size() <= MAX_UPLOADS_PER_FRAME);
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	// Only the pages whose residency changed are (un)bound
+	// The bind signals a semaphore, so the uploads only start once the memory is bound
+	texture.updateSparseBindInfo(bindingChangedPages);
+	texture.bindSparseInfo.signalSemaphoreCount = 1;
+	texture.bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+
+	// Each upload batch uses one half of the staging ring, make sure the batch that used it before has been processed
+	const uint32_t ringHalf = stagingRing.batchIndex % 2;
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &stagingRing.fences[ringHalf], VK_TRUE, UINT64_MAX));
+	VK_CHECK_RESULT(vkResetFences(device, 1, &stagingRing.fences[ringHalf]));
+
+	std::vector<VkBufferImageCopy> regions;
+	for (size_t i = 0; i < pageData.size(); i++) {
+		const VirtualTexturePage& page = texture.pages[pageData[i].pageIndex];
+		const VkDeviceSize bufferOffset = (ringHalf * MAX_UPLOADS_PER_FRAME + i) * stagingRing.slotSize;
+		memcpy(static_cast<uint8_t*>(stagingRing.buffer.mapped) + bufferOffset, pageData[i].data.data(), pageData[i].data.size());
 		VkBufferImageCopy region{};
+		region.bufferOffset = bufferOffset;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		region.imageSubresource.layerCount = 1;
-		region.imageSubresource.mipLevel = i;
-		region.imageOffset = {};
-		region.imageExtent = { width, height, 1 };
-		vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue);
+		region.imageSubresource.mipLevel = page.mipLevel;
+		region.imageOffset = page.offset;
+		region.imageExtent = page.extent;
+		regions.push_back(region);
+	}
 
-		imageBuffer.destroy();
+	// The command buffer is also submitted if there's nothing to upload, as it needs to wait on the sparse bind semaphore
+	VkCommandBuffer copyCmd = stagingRing.commandBuffers[ringHalf];
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
+	if (!regions.empty()) {
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdCopyBufferToImage(copyCmd, stagingRing.buffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 	}
+	VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
+
+	VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo uploadSubmitInfo = vks::initializers::submitInfo();
+	uploadSubmitInfo.waitSemaphoreCount = 1;
+	uploadSubmitInfo.pWaitSemaphores = &bindSparseSemaphore;
+	uploadSubmitInfo.pWaitDstStageMask = &waitStageMask;
+	uploadSubmitInfo.commandBufferCount = 1;
+	uploadSubmitInfo.pCommandBuffers = &copyCmd;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &uploadSubmitInfo, stagingRing.fences[ringHalf]));
+
+	stagingRing.batchIndex++;
+	stats.uploadedPages = static_cast<uint32_t>(regions.size());
 }
 
-void VulkanExample::flushRandomPages()
+// Uploads all mip levels of the mip tail from the page source
+// The mip tail's memory is bound at creation time and stays resident
+void VulkanExample::fillMipTail()
 {
-	vkDeviceWaitIdle(device);
-
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
-
-	std::vector<VirtualTexturePage> updatedPages;
-	std::vector<VirtualTexturePage> bindingChangedPages;
-	for (auto& page : texture.pages)
-	{
-		if (rndDist(rndEngine) < 0.5f) {
-			continue;
-		}
-		if (page.imageMemoryBind.memory != VK_NULL_HANDLE){
-			page.del = true;
-			bindingChangedPages.push_back(page);
+	std::vector<std::vector<uint8_t>> pageData;
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize bufferSize = 0;
+	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
+		const VirtualTextureSource::MipLevel& mipLevel = pageSource.mipLevels[i];
+		for (uint32_t y = 0; y < mipLevel.pagesY; y++) {
+			for (uint32_t x = 0; x < mipLevel.pagesX; x++) {
+				const uint32_t pageIndex = mipLevel.firstPage + y * mipLevel.pagesX + x;
+				pageData.push_back(std::vector<uint8_t>());
+				pageSource.readPage(pageIndex, pageData.back());
+				VkBufferImageCopy region{};
+				region.bufferOffset = bufferSize;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.layerCount = 1;
+				region.imageSubresource.mipLevel = i;
+				region.imageOffset = { (int32_t)(x * pageSource.pageExtent.width), (int32_t)(y * pageSource.pageExtent.height), 0 };
+				region.imageExtent = pageSource.getPageExtent(pageIndex);
+				regions.push_back(region);
+				bufferSize += pageData.back().size();
+			}
 		}
 	}
+	if (regions.empty()) {
+		return;
+	}
 
-	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages, true);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
-	for (auto& page : texture.pages)
-	{
-		if (page.del)
-		{
-			page.release(device);
-		}
+	vks::Buffer imageBuffer;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&imageBuffer,
+		bufferSize));
+	VK_CHECK_RESULT(imageBuffer.map());
+	for (size_t i = 0; i < pageData.size(); i++) {
+		memcpy(static_cast<uint8_t*>(imageBuffer.mapped) + regions[i].bufferOffset, pageData[i].data(), pageData[i].size());
 	}
+
+	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	vulkanDevice->flushCommandBuffer(copyCmd, queue);
+
+	imageBuffer.destroy();
 }
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
@@ -900,20 +1263,18 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		if (overlay->sliderFloat("LOD bias", &uboVS.lodBias, -(float)texture.mipLevels, (float)texture.mipLevels)) {
 			updateUniformBuffers();
 		}
-		if (overlay->button("Fill random pages")) {
-			fillRandomPages();
-		}
-		if (overlay->button("Flush random pages")) {
-			flushRandomPages();
-		}
-		if (overlay->button("Fill mip tail")) {
-			fillMipTail();
+		overlay->checkBox("Stream pages", &streaming);
+		overlay->sliderInt("Uploads per frame", &maxUploadsPerFrame, 1, MAX_UPLOADS_PER_FRAME);
+		if (overlay->button("Evict all pages")) {
+			evictAllPages();
 		}
 	}
 	if (overlay->header("Statistics")) {
-		uint32_t respages = 0;
-		std::for_each(texture.pages.begin(), texture.pages.end(), [&respages](VirtualTexturePage page) { respages += (page.resident()) ? 1 : 0; });
-		overlay->text("Resident pages: %d of %d", respages, static_cast<uint32_t>(texture.pages.size()));
+		overlay->text("Resident pages: %d of %d", static_cast<uint32_t>(lruPages.size()), static_cast<uint32_t>(texture.pages.size()));
+		overlay->text("Page budget: %d pages (%.1f MB)", pagePool.pageCount, (float)(pagePool.pageCount * pagePool.pageSize) / (1024.0f * 1024.0f));
+		overlay->text("Requested pages: %d", stats.requestedPages);
+		overlay->text("Pending loads: %d", pendingLoads);
+		overlay->text("Uploaded: %d, evicted: %d, dropped: %d", stats.uploadedPages, stats.evictedPages, stats.droppedPages);
 		overlay->text("Mip tail starts at: %d", texture.mipTailStart);
 	}
 
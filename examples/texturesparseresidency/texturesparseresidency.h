@@ -7,14 +7,30 @@
 */
 
 /*
-* Note : This sample is work-in-progress and works basically, but it's not yet finished
+* Pages of the virtual texture are streamed based on GPU feedback:
+* The fragment shader flags the pages (mip level and position) it would like to sample in a feedback buffer
+* Requested pages are loaded asynchronously from a tiled page file on disk and uploaded through a staging ring
+* The page file (about 90 MB) is generated on first run in the system's temporary directory, use --pagefile to choose a different path
+* Page memory is taken from a fixed size pool, if the pool is exhausted the least recently requested pages are evicted
+* Only pages whose residency changed are passed to the sparse binding queue
 */
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <fstream>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 
 #define ENABLE_VALIDATION false
 
+// Max. number of mip levels supported by the page table passed to the shader
+#define MAX_PAGE_TABLE_LEVELS 16
+// Max. number of pages uploaded per frame, the staging ring holds twice as many pages
+#define MAX_UPLOADS_PER_FRAME 32
+
 // Virtual texture page as a part of the partially resident texture
 // Contains memory bindings, offsets and status information
 struct VirtualTexturePage
@@ -26,12 +42,90 @@ struct VirtualTexturePage
 	uint32_t mipLevel;													// Mip level that this page belongs to
 	uint32_t layer;														// Array layer that this page belongs to
 	uint32_t index;
-    bool del;
+	int32_t poolSlot;													// Slot in the page memory pool backing this page (-1 if not resident)
+	uint64_t lastRequested;												// Last frame this page has been requested by the feedback pass
+	bool pending;														// Page is being loaded
+	std::list<uint32_t>::iterator lruPosition;							// Position in the least recently used list (only valid if resident)
 
 	VirtualTexturePage();
 	bool resident();
-	bool allocate(VkDevice device, uint32_t memoryTypeIndex);
-	bool release(VkDevice device);
+	void bind(VkDeviceMemory memory, VkDeviceSize memoryOffset, int32_t slot);
+	void unbind();
+};
+
+// Fixed size device memory pool that pages are sub-allocated from
+// Limits the memory footprint of the virtual texture and avoids one allocation per page
+struct VirtualTexturePagePool
+{
+	VkDevice device;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize pageSize;
+	uint32_t pageCount;
+	std::vector<int32_t> freeSlots;
+
+	void create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, uint32_t pageCount);
+	// Returns -1 if the pool is exhausted
+	int32_t acquire();
+	void release(int32_t slot);
+	VkDeviceSize offset(int32_t slot);
+	void destroy();
+};
+
+// Tiled on-disk source for the pages of all mip levels of the virtual texture
+// Each page is stored at a fixed size slot, so it can be read with a single seek
+// Pages are loaded asynchronously on a separate thread
+class VirtualTextureSource
+{
+public:
+	struct PageData {
+		uint32_t pageIndex;
+		std::vector<uint8_t> data;
+	};
+
+	// Source page layout for each mip level
+	struct MipLevel {
+		uint32_t width, height;
+		uint32_t pagesX, pagesY;
+		uint32_t firstPage;
+	};
+	std::vector<MipLevel> mipLevels;
+	VkExtent3D pageExtent;
+	uint32_t pageCount = 0;
+
+	~VirtualTextureSource();
+	// Opens the page file, creates it if it doesn't exist or doesn't match the requested layout
+	void open(const std::string& filename, uint32_t width, uint32_t height, uint32_t mipCount, VkExtent3D pageExtent);
+	VkExtent3D getPageExtent(uint32_t pageIndex);
+	// Synchronous read of a single page
+	void readPage(uint32_t pageIndex, std::vector<uint8_t>& data);
+	// Queue an asynchronous page load
+	void request(uint32_t pageIndex);
+	// Get up to maxCount pages that have been loaded since the last call
+	void fetchLoaded(std::vector<PageData>& pages, uint32_t maxCount);
+	void close();
+
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t width, height;
+		uint32_t mipCount;
+		uint32_t pageWidth, pageHeight;
+	};
+	static const uint32_t magic = 0x47505456;
+	std::string filename;
+	std::ifstream file;
+	std::mutex fileMutex;
+	std::thread loaderThread;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<uint32_t> requests;
+	std::deque<PageData> loaded;
+	bool stopLoader = false;
+
+	void setupLayout(uint32_t width, uint32_t height, uint32_t mipCount, VkExtent3D pageExtent);
+	bool validate(uint32_t width, uint32_t height, uint32_t mipCount);
+	void generate();
+	void loaderLoop();
 };
 
 // Virtual texture object containing all pages
@@ -41,7 +135,7 @@ struct VirtualTexture
 	VkImage image;														// Texture image handle
 	VkBindSparseInfo bindSparseInfo;									// Sparse queue binding information
 	std::vector<VirtualTexturePage> pages;								// Contains all virtual pages of the texture
-	std::vector<VkSparseImageMemoryBind> sparseImageMemoryBinds;		// Sparse image memory bindings of all memory-backed virtual tables
+	std::vector<VkSparseImageMemoryBind> sparseImageMemoryBinds;		// Sparse image memory bindings of all pages whose residency changed
 	std::vector<VkSparseMemoryBind>	opaqueMemoryBinds;					// Sparse opaque memory bindings for the mip tail (if present)
 	VkSparseImageMemoryBindInfo imageMemoryBindInfo;					// Sparse image memory bind info
 	VkSparseImageOpaqueMemoryBindInfo opaqueMemoryBindInfo;				// Sparse image opaque memory bind info (mip tail)
@@ -49,8 +143,6 @@ struct VirtualTexture
 	VkSparseImageMemoryRequirements sparseImageMemoryRequirements;		// @todo: Comment
 	uint32_t memoryTypeIndex;											// @todo: Comment
 
-	VkSparseImageMemoryBind mipTailimageMemoryBind{};
-
 	// @todo: comment
 	struct MipTailInfo {
 		bool singleMipTail;
@@ -58,7 +150,8 @@ struct VirtualTexture
 	} mipTailInfo;
 
 	VirtualTexturePage *addPage(VkOffset3D offset, VkExtent3D extent, const VkDeviceSize size, const uint32_t mipLevel, uint32_t layer);
-	void updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del = false);
+	// Only the passed pages are (un)bound, the mip tail is only bound if requested
+	void updateSparseBindInfo(std::vector<VirtualTexturePage*> &bindingChangedPages, bool bindMipTail = false);
 	// @todo: replace with dtor?
 	void destroy();
 };
@@ -81,6 +174,51 @@ public:
 
 	vkglTF::Model plane;
 
+	// Page streaming
+	VirtualTexturePagePool pagePool;
+	VirtualTextureSource pageSource;
+	// Path of the generated page file, defaults to the system's temporary directory
+	std::string pageFileName;
+	// Least recently requested resident pages are at the back
+	std::list<uint32_t> lruPages;
+	// Memory budget for resident pages (in pages)
+	uint32_t pagePoolSize = 256;
+	bool streaming = true;
+	int32_t maxUploadsPerFrame = 16;
+	uint32_t maxPendingLoads = 64;
+	uint32_t pendingLoads = 0;
+	uint64_t frameIndex = 0;
+
+	// Host visible buffer the fragment shader writes page requests to (one entry per page)
+	vks::Buffer feedbackBuffer;
+
+	// Page layout of the virtual texture passed to the fragment shader for writing page requests
+	struct PageTable {
+		// xy = texture size, zw = page size
+		glm::uvec4 dimensions;
+		// x = number of pages horizontally, y = number of pages vertically, z = index of the first page
+		glm::uvec4 mipLevels[MAX_PAGE_TABLE_LEVELS];
+		uint32_t mipTailStart;
+	} pageTable;
+	vks::Buffer pageTableBuffer;
+
+	// Page uploads go through a double buffered staging ring, each half used by one upload batch
+	struct StagingRing {
+		vks::Buffer buffer;
+		uint32_t slotCount;
+		VkDeviceSize slotSize;
+		uint32_t batchIndex = 0;
+		std::array<VkCommandBuffer, 2> commandBuffers;
+		std::array<VkFence, 2> fences;
+	} stagingRing;
+
+	struct Statistics {
+		uint32_t requestedPages = 0;
+		uint32_t uploadedPages = 0;
+		uint32_t evictedPages = 0;
+		uint32_t droppedPages = 0;
+	} stats;
+
 	struct UboVS {
 		glm::mat4 projection;
 		glm::mat4 model;
@@ -94,14 +232,13 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	//todo: comment
+	// Signaled by the sparse binding, page uploads wait on it
 	VkSemaphore bindSparseSemaphore = VK_NULL_HANDLE;
 
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
 	glm::uvec3 alignedDivision(const VkExtent3D& extent, const VkExtent3D& granularity);
-	void randomPattern(uint8_t* buffer, uint32_t width, uint32_t height);
 	void prepareSparseTexture(uint32_t width, uint32_t height, uint32_t layerCount, VkFormat format);
 	// @todo: move to dtor of texture
 	void destroyTextureImage(SparseTexture texture);
@@ -116,9 +253,11 @@ public:
 	void updateUniformBuffers();
 	void prepare();
 	virtual void render();
-	void uploadContent(VirtualTexturePage page, VkImage image);
-	void fillRandomPages();
+	void prepareStreaming();
+	void updateStreaming();
+	int32_t evictPage(std::vector<VirtualTexturePage*>& bindingChangedPages);
+	void evictAllPages();
+	void uploadPages(std::vector<VirtualTextureSource::PageData>& pageData, std::vector<VirtualTexturePage*>& bindingChangedPages);
 	void fillMipTail();
-	void flushRandomPages();
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
 };